@@ -0,0 +1,225 @@
+"""Stand-in for server.py's /submit that misbehaves on purpose, to see what a
+flaky link does to the device. Point a device (server_address/server_port in
+its config) at this instead of server.py.
+
+    python fault_server.py --profile drip
+    python fault_server.py --bench 10     # every profile for 10 min, then a table
+
+Profiles match the ones in sim/sim.cpp (sim --bench), so the simulator's
+numbers can be checked against real hardware row for row. "loss" is a request
+that never gets an answer; for packet-level loss put netem in front instead
+(tc qdisc add dev eth0 root netem loss 10%).
+
+Plain sockets rather than Flask: resets and byte-at-a-time responses need
+control below the WSGI layer.
+"""
+import argparse
+import json
+import random
+import socket
+import socketserver
+import struct
+import threading
+import time
+
+# latency_ms: request -> first response byte; loss / reset: probability per
+# request; drip_ms: then one byte at a time; burst: 503 for burst_s out of
+# every burst_every_s seconds; down: every connection is reset for down_s out
+# of every down_every_s seconds
+PROFILES = [
+    ("none",    dict(latency_ms=5,    loss=0,    reset=0,    drip_ms=0,   burst_every_s=0,   burst_s=0,  down_every_s=0,    down_s=0)),
+    ("latency", dict(latency_ms=2000, loss=0,    reset=0,    drip_ms=0,   burst_every_s=0,   burst_s=0,  down_every_s=0,    down_s=0)),
+    ("loss",    dict(latency_ms=5,    loss=0.2,  reset=0,    drip_ms=0,   burst_every_s=0,   burst_s=0,  down_every_s=0,    down_s=0)),
+    ("reset",   dict(latency_ms=5,    loss=0,    reset=0.2,  drip_ms=0,   burst_every_s=0,   burst_s=0,  down_every_s=0,    down_s=0)),
+    ("drip",    dict(latency_ms=5,    loss=0,    reset=0,    drip_ms=200, burst_every_s=0,   burst_s=0,  down_every_s=0,    down_s=0)),
+    ("5xx",     dict(latency_ms=5,    loss=0,    reset=0,    drip_ms=0,   burst_every_s=100, burst_s=20, down_every_s=0,    down_s=0)),
+    ("down",    dict(latency_ms=5,    loss=0,    reset=0,    drip_ms=0,   burst_every_s=0,   burst_s=0,  down_every_s=1800, down_s=300)),
+    ("flaky",   dict(latency_ms=500,  loss=0.05, reset=0.05, drip_ms=20,  burst_every_s=600, burst_s=30, down_every_s=0,    down_s=0)),
+]
+PROFILE = dict(PROFILES)
+
+LOST_HOLD_S = 60  # keep a "lost" connection open past the device's 30s timeout
+
+
+class Phase:
+    def __init__(self, name):
+        self.name = name
+        self.started = time.time()
+        self.ended = None
+        self.requests = 0  # reached the server
+        self.stored = 0  # ... and were answered 200 with a sample in them
+        self.lost = self.resets = self.errors = 0
+        self.loop_p99_us = 0  # worst loop() stage the device reported meanwhile
+        self.loop_max_us = 0
+
+
+lock = threading.Lock()
+phases = []
+rng = random.Random(1)
+
+
+def current_phase():
+    return phases[-1]
+
+
+def read_request(rfile):
+    line = rfile.readline(1024).decode("latin-1").strip()
+    parts = line.split()
+    if len(parts) < 2:
+        raise ValueError("bad request line")
+    headers = {}
+    while True:
+        h = rfile.readline(1024).decode("latin-1").strip()
+        if not h:
+            break
+        key, _, value = h.partition(":")
+        headers[key.strip().lower()] = value.strip()
+    body = rfile.read(int(headers.get("content-length", 0)))
+    return parts[0], parts[1], body
+
+
+def in_window(every_s, length_s):
+    return every_s and time.time() % every_s < length_s
+
+
+class Handler(socketserver.StreamRequestHandler):
+    def handle(self):
+        with lock:
+            p = PROFILE[current_phase().name]
+            down = in_window(p["down_every_s"], p["down_s"])
+        if down:
+            self.connection.setsockopt(socket.SOL_SOCKET, socket.SO_LINGER, struct.pack("ii", 1, 0))
+            return
+        try:
+            method, path, body = read_request(self.rfile)
+        except (ValueError, OSError):
+            return
+        if method != "POST" or path != "/submit":
+            self.respond(404, "Not Found", PROFILE["none"])
+            return
+
+        with lock:
+            phase = current_phase()
+            p = PROFILE[phase.name]
+            if rng.random() < p["loss"]:
+                phase.lost += 1
+                action = "lose"
+            else:
+                phase.requests += 1
+                if rng.random() < p["reset"]:
+                    phase.resets += 1
+                    action = "reset"
+                elif in_window(p["burst_every_s"], p["burst_s"]):
+                    phase.errors += 1
+                    action = "503"
+                else:
+                    action = "ok"
+                    self.account(phase, body)
+
+        if action == "lose":
+            # swallow it: the device gets nothing until it gives up
+            self.connection.settimeout(LOST_HOLD_S)
+            try:
+                while self.connection.recv(1024):
+                    pass
+            except OSError:
+                pass
+        elif action == "reset":
+            # SO_LINGER 0 turns close() into an RST
+            self.connection.setsockopt(socket.SOL_SOCKET, socket.SO_LINGER, struct.pack("ii", 1, 0))
+        elif action == "503":
+            self.respond(503, "Service Unavailable", p)
+        else:
+            self.respond(200, "Data received", p)
+
+    def account(self, phase, body):
+        try:
+            data = json.loads(body)
+        except ValueError:
+            return
+        if not isinstance(data, dict):
+            return
+        # one window summary or raw sample (both during a raw burst), plus
+        # whatever the device queued while it couldn't get through
+        phase.stored += ("send_val" in data) + ("window" in data)
+        phase.stored += sum(1 for q in data.get("backlog", []) if isinstance(q, dict) and ("send_val" in q or "window" in q))
+        loop = data.get("latency", {}).get("loop")
+        if loop:
+            phase.loop_p99_us = max(phase.loop_p99_us, loop.get("p99_us", 0))
+            phase.loop_max_us = max(phase.loop_max_us, loop.get("max_us", 0))
+
+    def respond(self, status, text, p):
+        reason = {200: "OK", 404: "Not Found", 503: "Service Unavailable"}[status]
+        out = ("HTTP/1.1 %d %s\r\nContent-Type: text/plain\r\nContent-Length: %d\r\n"
+               "Connection: close\r\n\r\n%s" % (status, reason, len(text), text)).encode()
+        time.sleep(p["latency_ms"] / 1000.0)
+        try:
+            if p["drip_ms"]:
+                for i in range(len(out)):
+                    self.wfile.write(out[i:i + 1])
+                    self.wfile.flush()
+                    time.sleep(p["drip_ms"] / 1000.0)
+            else:
+                self.wfile.write(out)
+        except OSError:
+            pass
+
+
+class Server(socketserver.ThreadingTCPServer):
+    daemon_threads = True
+    allow_reuse_address = True
+
+
+def print_table(uplink_period_ms):
+    # stall is what the device itself reported for loop(), see include/latency.h
+    print("%-8s %9s %9s %7s %8s %8s %8s %11s %11s" % ("profile", "requests", "stored", "lost", "dropped",
+                                                      "resets", "5xx", "stall p99", "stall max"))
+    for ph in phases:
+        elapsed = (ph.ended or time.time()) - ph.started
+        expected = int(elapsed * 1000 / uplink_period_ms)
+        lost = 100.0 * (expected - ph.stored) / expected if expected > ph.stored else 0.0
+        print("%-8s %9d %9d %6.1f%% %8d %8d %8d %9dus %9dus" % (ph.name, ph.requests, ph.stored, lost, ph.lost,
+                                                               ph.resets, ph.errors, ph.loop_p99_us, ph.loop_max_us))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--port", type=int, default=5000)
+    ap.add_argument("--profile", choices=[n for n, _ in PROFILES], default="none")
+    ap.add_argument("--bench", type=float, metavar="MINUTES",
+                    help="run every profile for this long, print a table and exit")
+    ap.add_argument("--uplink-period", type=int, default=60000, metavar="MS",
+                    help="the device's aggregate_window (uplink_period if that is 0), "
+                         "to count windows/samples that never arrived; give the device "
+                         "heartbeat_period 0 for a bench, or the deadband's skips count as lost")
+    ap.add_argument("--seed", type=int, default=1)
+    args = ap.parse_args()
+    rng.seed(args.seed)
+
+    names = [n for n, _ in PROFILES] if args.bench else [args.profile]
+    phases.append(Phase(names[0]))
+    server = Server(("0.0.0.0", args.port), Handler)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    print("fault server on :%d, profile %s" % (args.port, names[0]), flush=True)
+
+    try:
+        if args.bench:
+            for name in names[1:]:
+                time.sleep(args.bench * 60)
+                with lock:
+                    phases[-1].ended = time.time()
+                    phases.append(Phase(name))
+                print("profile %s" % name, flush=True)
+            time.sleep(args.bench * 60)
+            phases[-1].ended = time.time()
+        else:
+            while True:
+                time.sleep(3600)
+    except KeyboardInterrupt:
+        pass
+    server.shutdown()
+    print_table(args.uplink_period)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,32 @@
+#!/bin/sh
+# Self-signed CA and a server certificate for the TLS uplink (transport 2,
+# see include/tls_client.h), for tls_proxy.py or any other front end.
+#
+#   sh make_certs.sh 3.149.230.7      # the address devices have as server_address
+#
+# Writes certs/ca.key, ca.pem, server.key, server.pem here. The firmware
+# build compiles certs/ca.pem in (scripts/tls_ca.py), so rebuild and flash
+# afterwards. Keys are P-256: an ECDSA verify and ECDHE are what the ESP32
+# does fastest. The server name goes in the CN as well as the SAN, since
+# mbedTLS 2.x only matches a hostname (or IP written as one) against
+# those DNS names.
+set -e
+cd "$(dirname "$0")"
+NAME=${1:?usage: make_certs.sh <server address>}
+mkdir -p certs
+
+openssl ecparam -name prime256v1 -genkey -noout -out certs/ca.key
+openssl req -x509 -new -key certs/ca.key -sha256 -days 3650 -subj "/CN=plant monitor CA" -out certs/ca.pem
+
+case "$NAME" in
+*[!0-9.]*) SAN="DNS:$NAME" ;;
+*) SAN="DNS:$NAME,IP:$NAME" ;;
+esac
+openssl ecparam -name prime256v1 -genkey -noout -out certs/server.key
+openssl req -new -key certs/server.key -subj "/CN=$NAME" -out certs/server.csr
+printf 'subjectAltName=%s\nbasicConstraints=CA:FALSE\nkeyUsage=digitalSignature\nextendedKeyUsage=serverAuth\n' "$SAN" > certs/server.ext
+openssl x509 -req -in certs/server.csr -CA certs/ca.pem -CAkey certs/ca.key -CAcreateserial -sha256 -days 825 \
+    -extfile certs/server.ext -out certs/server.pem
+rm certs/server.csr certs/server.ext
+
+echo "CA in certs/ca.pem: rebuild and flash the firmware; serve with: python3 tls_proxy.py"
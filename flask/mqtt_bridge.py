@@ -0,0 +1,73 @@
+"""server.py for devices on the MQTT transport (config transport 1, see
+include/transport.h). Runs the same Flask app, plus a client on the broker
+that feeds every plant/<id>/up publish through the /submit handler and
+publishes the answer, if any, to plant/<id>/down. A /config change goes
+out to every device seen so far straight away instead of with its next
+uplink.
+
+    mosquitto -p 1883 &
+    python3 mqtt_bridge.py --broker 127.0.0.1
+
+Needs paho-mqtt (pip install paho-mqtt) besides Flask.
+"""
+import argparse
+import json
+import threading
+
+import paho.mqtt.client as mqtt
+
+import server
+
+UP = "plant/+/up"
+
+devices = set()  # client ids seen on UP
+devices_lock = threading.Lock()
+
+
+def down_topic(device):
+    return "plant/%s/down" % device
+
+
+def on_connect(client, userdata, flags, rc):
+    # (re)subscribe on every connect, the broker forgets clean sessions
+    client.subscribe(UP, qos=1)
+
+
+def on_message(client, userdata, msg):
+    device = msg.topic.split("/")[1]
+    try:
+        data = json.loads(msg.payload)
+    except ValueError:
+        return
+    with devices_lock:
+        devices.add(device)
+    reply = server.handle_submit(data)
+    if reply:
+        client.publish(down_topic(device), json.dumps(reply), qos=0)
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--broker", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--http-port", type=int, default=5000)
+    args = parser.parse_args()
+
+    client = mqtt.Client(client_id="plant-server")
+    client.on_connect = on_connect
+    client.on_message = on_message
+    client.connect(args.broker, args.port, keepalive=60)
+
+    def push_config(reply):
+        with devices_lock:
+            targets = list(devices)
+        for device in targets:
+            client.publish(down_topic(device), json.dumps(reply), qos=0)
+    server.config_listeners.append(push_config)
+
+    client.loop_start()
+    server.app.run(host="0.0.0.0", port=args.http_port)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,175 @@
+"""Firmware delta patches for OTA updates.
+
+A patch rebuilds a new firmware image from the one running on the device.
+The format is decoded on the device by OtaPatcher (include/ota_patch.h):
+
+    header: b"SSP2" | u32 old_size | u32 new_size | sha256(old) | sha256(new)
+    ops:    b"C" u32 off u32 len          copy from the old image
+            b"D" u32 off u32 len <bytes>  old[off + i] + diff[i] (mod 256)
+            b"A" u32 len <bytes>          literal bytes
+            b"E"                          end
+
+and the whole stream is zlib compressed. DIFF regions are mostly zero bytes
+where code only moved (bsdiff style), which is what makes them compress well.
+
+Usage:
+    python3 ota_delta.py make old.bin new.bin out.patch
+    python3 ota_delta.py apply old.bin in.patch out.bin
+    python3 ota_delta.py roundtrip old.bin new.bin
+    python3 ota_delta.py e2e http://127.0.0.1:5000 old.bin
+"""
+import hashlib
+import json
+import struct
+import sys
+import urllib.request
+import zlib
+
+MAGIC = b"SSP2"
+SEED = 16  # bytes that must match exactly to start a region
+INDEX_STEP = 4  # old image offsets indexed for seeds
+
+
+def _index(old):
+    index = {}
+    for i in range(0, len(old) - SEED + 1, INDEX_STEP):
+        index.setdefault(old[i:i + SEED], i)
+    return index
+
+
+def _extend(old, new, i, j):
+    """Length of the region starting at old[i]/new[j] worth encoding as a diff,
+    and how many of its bytes are equal. Keeps the prefix with the best
+    matches-vs-mismatches score, like bsdiff."""
+    n = min(len(old) - i, len(new) - j)
+    score = best_score = 0
+    best_len = equal = best_equal = 0
+    for k in range(n):
+        if old[i + k] == new[j + k]:
+            score += 1
+            equal += 1
+        else:
+            score -= 1
+        if score > best_score:
+            best_score, best_len, best_equal = score, k + 1, equal
+        elif score < best_score - 32:
+            break
+    return best_len, best_equal
+
+
+def make_patch(old, new):
+    ops = [MAGIC + struct.pack("<II", len(old), len(new)) + hashlib.sha256(old).digest() + hashlib.sha256(new).digest()]
+    index = _index(old)
+    literal_start = 0
+    j = 0
+
+    def flush_literal(end):
+        if end > literal_start:
+            ops.append(b"A" + struct.pack("<I", end - literal_start) + new[literal_start:end])
+
+    while j <= len(new) - SEED:
+        i = index.get(new[j:j + SEED])
+        if i is None:
+            j += 1
+            continue
+        length, equal = _extend(old, new, i, j)
+        flush_literal(j)
+        if equal == length:
+            ops.append(b"C" + struct.pack("<II", i, length))
+        else:
+            diff = bytes((new[j + k] - old[i + k]) & 0xFF for k in range(length))
+            ops.append(b"D" + struct.pack("<II", i, length) + diff)
+        j += length
+        literal_start = j
+    flush_literal(len(new))
+    ops.append(b"E")
+    return zlib.compress(b"".join(ops), 9)
+
+
+def make_full_patch(old_size, old_sha, new):
+    """Patch for a device whose image we don't have: one literal op, for the
+    image it says it runs (size and sha256 as hex)."""
+    if len(old_sha) != 64:
+        raise ValueError("expected a sha256")
+    header = MAGIC + struct.pack("<II", old_size, len(new)) + bytes.fromhex(old_sha) + hashlib.sha256(new).digest()
+    return zlib.compress(header + b"A" + struct.pack("<I", len(new)) + new + b"E", 9)
+
+
+def apply_patch(old, patch):
+    """Reference decoder, same checks as the device."""
+    data = zlib.decompress(patch)
+    if data[:4] != MAGIC:
+        raise ValueError("bad magic")
+    old_size, new_size = struct.unpack_from("<II", data, 4)
+    if old_size != len(old) or data[12:44] != hashlib.sha256(old).digest():
+        raise ValueError("patch is for another image")
+    sha = data[44:76]
+    out = bytearray()
+    p = 76
+    while True:
+        op = data[p:p + 1]
+        p += 1
+        if op == b"E":
+            break
+        if op == b"C":
+            off, n = struct.unpack_from("<II", data, p)
+            p += 8
+            out += old[off:off + n]
+        elif op == b"D":
+            off, n = struct.unpack_from("<II", data, p)
+            p += 8
+            out += bytes((old[off + k] + data[p + k]) & 0xFF for k in range(n))
+            p += n
+        elif op == b"A":
+            (n,) = struct.unpack_from("<I", data, p)
+            p += 4
+            out += data[p:p + n]
+            p += n
+        else:
+            raise ValueError("bad op %r at %d" % (op, p - 1))
+    if len(out) != new_size or hashlib.sha256(out).digest() != sha:
+        raise ValueError("patched image does not verify")
+    return bytes(out)
+
+
+def _read(path):
+    with open(path, "rb") as f:
+        return f.read()
+
+
+def main(argv):
+    if len(argv) < 2:
+        print(__doc__)
+        return 2
+    cmd = argv[1]
+    if cmd == "make" and len(argv) == 5:
+        with open(argv[4], "wb") as f:
+            f.write(make_patch(_read(argv[2]), _read(argv[3])))
+    elif cmd == "apply" and len(argv) == 5:
+        with open(argv[4], "wb") as f:
+            f.write(apply_patch(_read(argv[2]), _read(argv[3])))
+    elif cmd == "roundtrip" and len(argv) == 4:
+        old, new = _read(argv[2]), _read(argv[3])
+        patch = make_patch(old, new)
+        assert apply_patch(old, patch) == new
+        print("patch %d bytes, full image %d bytes (%.1f%%)" % (len(patch), len(new), 100.0 * len(patch) / len(new)))
+    elif cmd == "e2e" and len(argv) == 4:
+        # does what the device does against a running server.py
+        server, old = argv[2].rstrip("/"), _read(argv[3])
+        sha = hashlib.sha256(old).hexdigest()
+        manifest = json.load(urllib.request.urlopen("%s/firmware/manifest?sha=%s&size=%d" % (server, sha, len(old))))
+        if not manifest.get("patch"):
+            print("up to date")
+            return 0
+        patch = urllib.request.urlopen(server + manifest["patch"]).read()
+        new = apply_patch(old, patch)
+        assert hashlib.sha256(new).hexdigest() == manifest["sha256"]
+        print("updated to %s: %d patch bytes for a %d byte image" % (manifest["sha256"][:12], len(patch), len(new)))
+    else:
+        print(__doc__)
+        return 2
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
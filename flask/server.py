@@ -1,30 +1,270 @@
-from flask import Flask, request, render_template, jsonify
+from flask import Flask, request, render_template, jsonify, Response
 import datetime
+import hashlib
+import json
+import os
+import ota_delta
 
 app = Flask(__name__)
 
 sensor_data = []
 
+# Fleet config pushed to devices: every key set through /config.
+# Devices send the rev they're on with each /submit and get the whole set
+# back if they're behind; keys match DeviceConfig in include/config.h.
+# Both are kept in CONFIG_FILE across restarts: devices store their rev in
+# NVS, and one a restarted server counted from 0 again would look old to
+# them. A device reporting a rev past ours (the file was lost) moves ours
+# up to it, so the next change still reaches it.
+CONFIG_FILE = os.path.join(os.path.dirname(os.path.abspath(__file__)), "fleet_config.json")
+
+def load_config():
+    try:
+        with open(CONFIG_FILE) as f:
+            saved = json.load(f)
+        return saved.get('config', {}), saved.get('config_rev', 0)
+    except (OSError, ValueError):
+        return {}, 0
+
+def save_config():
+    tmp = CONFIG_FILE + ".tmp"
+    with open(tmp, "w") as f:
+        json.dump({'config_rev': config_rev, 'config': fleet_config}, f)
+    os.replace(tmp, CONFIG_FILE)
+
+fleet_config, config_rev = load_config()
+# Called with that same reply on every change, for transports that can
+# reach a device without waiting for its next uplink (mqtt_bridge.py)
+config_listeners = []
+
+# Devices upload per-window summaries (aggregate_window, 1 min by default);
+# POST /raw {"seconds": n, "plant": i} has them send every raw sample of
+# one plant for a while too.
+# Carried in the next /submit response, so it reaches whichever device
+# checks in first; one device per server is the common case.
+RAW_MAX_S = 3600  # UPLINK_RAW_MAX in include/uplink.h
+PLANTS_MAX = 32  # include/plants.h
+raw_request = None
+
+# Devices only report when a value has moved past its deadband or their
+# heartbeat is due (include/deadband.h), so each reading stands until the
+# next one replaces it: charts draw steps, and /data extends the last one to
+# now. Past two missed heartbeats the device is presumed gone and the last
+# reading is no longer carried forward.
+DEFAULT_HEARTBEAT_MS = 900000  # heartbeat_period in include/config.h
+last_contact = None
+
+# OTA: drop firmware.bin builds into flask/firmware/, the newest one is what
+# devices get. Every older build kept there can be patched against.
+FIRMWARE_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "firmware")
+patch_cache = {}  # (from sha, to sha) -> patch bytes
+
+# A device can look after several plants (include/plants.h). Anything from
+# a plant other than 0 says which; every entry here records it, and /data
+# serves one plant at a time (?plant=i, 0 by default).
+
+# Loop stage latency, summed over every snapshot devices have sent.
+# Device bucket i counts samples in [2^i, 2^(i+1)) us, see include/latency.h
+LATENCY_BUCKETS = 26
+latency_totals = {}  # stage -> {'b': [...], 'n': count, 'sum': us}
+latency_latest = {}  # stage -> last snapshot as sent
+
 @app.route("/")
 def index():
-    if sensor_data:
-        latest_data = sensor_data[-1]['data']
+    readings = plant_entries(0)
+    if readings:
+        latest_data = readings[-1]['data']
     else:
         latest_data = "No data available"
     return render_template("index.html", latest_data=latest_data)
 
+def window_entry(timestamp, window):
+    # same text as a raw sample, from the window means, so the charts on
+    # index.html plot windows and samples alike; the full stats ride along
+    # as [min, max, mean, stddev] per channel
+    def mean(name):
+        stats = window.get(name, [])
+        return stats[2] if len(stats) == 4 else 0
+    text = "Temperature: %.2f°C, Moisture: %.2f%%, Light: %d%% (%.0f lx)" % (mean('temp'), mean('moisture'), round(mean('light')), mean('lux'))
+    return {'timestamp': timestamp, 'data': text, 'window': window, 'plant': window.get('plant', 0)}
+
+def plant_entries(plant):
+    return [e for e in sensor_data if e.get('plant', 0) == plant]
+
 @app.route("/submit", methods=["POST"])
 def submit():
-    global sensor_data
-    data = request.get_json()
-    if data and 'send_val' in data:
-        timestamp = datetime.datetime.now().strftime('%Y-%m-%d %H:%M:%S')
-        sensor_data.append({'timestamp': timestamp, 'data': data['send_val']})
+    reply = handle_submit(request.get_json())
+    if reply:
+        return jsonify(reply), 200
     return "Data received", 200
 
+def handle_submit(data):
+    # one uplink document, from POST /submit or MQTT (mqtt_bridge.py);
+    # returns what to answer the device with, {} for nothing
+    global sensor_data, raw_request, last_contact, config_rev
+    if data:
+        last_contact = datetime.datetime.now()
+    if data and isinstance(data.get('config_rev'), int) and data['config_rev'] > config_rev:
+        config_rev = data['config_rev']
+        save_config()
+    if data and ('send_val' in data or 'window' in data):
+        timestamp = datetime.datetime.now().strftime('%Y-%m-%d %H:%M:%S')
+        if 'window' in data:
+            entry = window_entry(timestamp, data['window'])
+        else:
+            entry = {'timestamp': timestamp, 'data': data['send_val'], 'plant': 0}
+        if 'power' in data:
+            # per-subsystem on/off residency and mAh estimate, sent about once a minute
+            entry['power'] = data['power']
+        if 'heap' in data:
+            # free / low-water / largest block, a shrinking block means fragmentation
+            entry['heap'] = data['heap']
+        if 'boot' in data:
+            # startup phase timestamps (ms since reset), sent once per boot
+            entry['boot'] = data['boot']
+        if 'latency' in data:
+            record_latency(data['latency'])
+        if 'dropped' in data:
+            # samples the device's queue had to give up on during an outage
+            entry['dropped'] = data['dropped']
+        # samples queued during an outage come first, oldest first, each with
+        # its age in ms at send time
+        now = datetime.datetime.now()
+        for queued in data.get('backlog', []):
+            if not isinstance(queued, dict):
+                continue
+            taken = (now - datetime.timedelta(milliseconds=queued.get('age', 0))).strftime('%Y-%m-%d %H:%M:%S')
+            if 'window' in queued:
+                sensor_data.append(dict(window_entry(taken, queued['window']), queued=True))
+            elif 'send_val' in queued:
+                sensor_data.append({'timestamp': taken, 'data': queued['send_val'], 'plant': queued.get('plant', 0),
+                                    'queued': True})
+        if 'window' in data and 'send_val' in data:
+            # a raw burst is running: the sample goes in on its own as well
+            sensor_data.append({'timestamp': timestamp, 'data': data['send_val'], 'plant': 0})
+        sensor_data.append(entry)
+    reply = {}
+    if data and fleet_config and data.get('config_rev', 0) < config_rev:
+        reply.update({'config_rev': config_rev, 'config': fleet_config})
+    if data and raw_request is not None:
+        reply.update(raw_request)
+        raw_request = None
+    return reply
+
+@app.route("/raw", methods=["POST"])
+def raw_burst():
+    # e.g. curl -X POST -H 'Content-Type: application/json' -d '{"seconds": 300, "plant": 2}' host:5000/raw
+    global raw_request
+    body = request.get_json(silent=True) or {}
+    seconds = body.get('seconds')
+    plant = body.get('plant', 0)
+    if not isinstance(seconds, int) or seconds < 0 or not isinstance(plant, int) or not 0 <= plant < PLANTS_MAX:
+        return "Expected {\"seconds\": n, \"plant\": i}", 400
+    raw_request = {'raw_s': min(seconds, RAW_MAX_S), 'raw_plant': plant}
+    return jsonify(raw_request)
+
+@app.route("/config", methods=["GET", "POST"])
+def update_config():
+    # e.g. curl -X POST -H 'Content-Type: application/json' -d '{"uplink_period": 10000}' host:5000/config
+    global config_rev
+    if request.method == "POST":
+        delta = request.get_json()
+        if not isinstance(delta, dict) or not delta:
+            return "Expected a JSON object", 400
+        fleet_config.update(delta)
+        config_rev += 1
+        save_config()
+        for push in config_listeners:
+            push({'config_rev': config_rev, 'config': fleet_config})
+    return jsonify({'config_rev': config_rev, 'config': fleet_config})
+
+def held_tail(readings):
+    # the last reading, restated at the current time
+    if not readings or last_contact is None:
+        return []
+    heartbeat_ms = fleet_config.get('heartbeat_period', DEFAULT_HEARTBEAT_MS) or DEFAULT_HEARTBEAT_MS
+    now = datetime.datetime.now()
+    if now - last_contact > datetime.timedelta(milliseconds=2 * heartbeat_ms):
+        return []
+    return [dict(readings[-1], timestamp=now.strftime('%Y-%m-%d %H:%M:%S'), held=True)]
+
 @app.route("/data", methods=["GET"])
 def get_data():
-    return jsonify(sensor_data)
+    readings = plant_entries(request.args.get('plant', 0, type=int))
+    return jsonify(readings + held_tail(readings))
+
+def record_latency(snapshot):
+    for stage, h in snapshot.items():
+        total = latency_totals.setdefault(stage, {'b': [0] * LATENCY_BUCKETS, 'n': 0, 'sum': 0})
+        for i, count in enumerate(h.get('b', [])[:LATENCY_BUCKETS]):
+            total['b'][i] += count
+        total['n'] += h.get('n', 0)
+        total['sum'] += h.get('n', 0) * h.get('mean_us', 0)
+        latency_latest[stage] = h
+
+@app.route("/metrics", methods=["GET"])
+def metrics():
+    # Prometheus text format, so the histograms can be scraped and charted as-is
+    lines = ["# TYPE succulent_stage_latency_us histogram"]
+    for stage, total in sorted(latency_totals.items()):
+        cumulative = 0
+        for i, count in enumerate(total['b']):
+            cumulative += count
+            le = "+Inf" if i == LATENCY_BUCKETS - 1 else str(2 ** (i + 1))
+            lines.append('succulent_stage_latency_us_bucket{stage="%s",le="%s"} %d' % (stage, le, cumulative))
+        lines.append('succulent_stage_latency_us_sum{stage="%s"} %d' % (stage, total['sum']))
+        lines.append('succulent_stage_latency_us_count{stage="%s"} %d' % (stage, total['n']))
+    lines.append("# TYPE succulent_stage_latency_recent_us gauge")
+    for stage, h in sorted(latency_latest.items()):
+        for key in ("p50_us", "p99_us", "max_us"):
+            lines.append('succulent_stage_latency_recent_us{stage="%s",stat="%s"} %d' % (stage, key[:-3], h.get(key, 0)))
+    return Response("\n".join(lines) + "\n", mimetype="text/plain")
+
+def firmware_images():
+    images = {}
+    if os.path.isdir(FIRMWARE_DIR):
+        for name in os.listdir(FIRMWARE_DIR):
+            if name.endswith(".bin"):
+                path = os.path.join(FIRMWARE_DIR, name)
+                with open(path, "rb") as f:
+                    data = f.read()
+                images[hashlib.sha256(data).hexdigest()] = (os.path.getmtime(path), data)
+    return images
+
+def latest_firmware(images):
+    if not images:
+        return None, None
+    sha = max(images, key=lambda s: images[s][0])
+    return sha, images[sha][1]
+
+@app.route("/firmware/manifest", methods=["GET"])
+def firmware_manifest():
+    # device asks with the sha256/size of the image it is running
+    sha = request.args.get("sha", "")
+    size = request.args.get("size", "0")
+    latest_sha, latest = latest_firmware(firmware_images())
+    if latest is None or sha == latest_sha:
+        return jsonify({})
+    return jsonify({"sha256": latest_sha, "size": len(latest),
+                    "patch": "/firmware/patch/%s?size=%s" % (sha, size)})
+
+@app.route("/firmware/patch/<sha>", methods=["GET"])
+def firmware_patch(sha):
+    images = firmware_images()
+    latest_sha, latest = latest_firmware(images)
+    if latest is None:
+        return "No firmware", 404
+    key = (sha, latest_sha)
+    if key not in patch_cache:
+        if sha in images:
+            patch_cache[key] = ota_delta.make_patch(images[sha][1], latest)
+        else:
+            # unknown base image, the device gets the whole thing
+            try:
+                patch_cache[key] = ota_delta.make_full_patch(int(request.args.get("size", 0)), sha, latest)
+            except ValueError:
+                return "Expected the sha256 and size of the running image", 400
+    return Response(patch_cache[key], mimetype="application/octet-stream")
 
 if __name__ == "__main__":
     app.run(debug=True)
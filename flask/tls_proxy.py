@@ -0,0 +1,134 @@
+"""TLS front end for server.py, for devices on the HTTPS transport (config
+transport 2, see include/transport.h). Terminates TLS with the certificate
+from make_certs.sh, keeps each device's connection open between uplinks
+(Flask's development server closes after every request) and forwards the
+requests to server.py over plain HTTP on localhost.
+
+    sh make_certs.sh 3.149.230.7
+    python3 server.py &
+    python3 tls_proxy.py
+
+Session tickets and the session ID cache are OpenSSL's defaults, so a
+device reconnecting after an idle close resumes instead of paying for the
+full handshake again. Each connection is logged with whether it resumed
+and how long the handshake took, which is what to check the simulator's
+figures (test/fakes/fake_tls.h) against.
+"""
+import argparse
+import http.client
+import os
+import socket
+import ssl
+import threading
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+HEAD_MAX = 8192
+BODY_MAX = 65536
+
+
+def read_request(conn, buf):
+    """One HTTP/1.1 request off conn: (head bytes, body bytes, rest of buf),
+    or None once the device has closed."""
+    while b"\r\n\r\n" not in buf:
+        if len(buf) > HEAD_MAX:
+            return None
+        chunk = conn.recv(4096)
+        if not chunk:
+            return None
+        buf += chunk
+    head, buf = buf.split(b"\r\n\r\n", 1)
+    length = 0
+    for line in head.split(b"\r\n")[1:]:
+        name, _, value = line.partition(b":")
+        if name.strip().lower() == b"content-length":
+            length = int(value.strip())
+    if length > BODY_MAX:
+        return None
+    while len(buf) < length:
+        chunk = conn.recv(4096)
+        if not chunk:
+            return None
+        buf += chunk
+    return head, buf[:length], buf[length:]
+
+
+def forward(backend, head, body):
+    """The request to server.py; the response as bytes for the device."""
+    lines = head.decode("latin-1").split("\r\n")
+    method, path, _ = lines[0].split(" ", 2)
+    headers = {}
+    for line in lines[1:]:
+        name, _, value = line.partition(":")
+        if name.lower() not in ("connection", "host", "content-length"):
+            headers[name] = value.strip()
+    backend.request(method, path, body=body, headers=headers)
+    resp = backend.getresponse()
+    payload = resp.read()
+    out = "HTTP/1.1 %d %s\r\n" % (resp.status, resp.reason)
+    for name, value in resp.getheaders():
+        if name.lower() not in ("connection", "content-length", "transfer-encoding"):
+            out += "%s: %s\r\n" % (name, value)
+    out += "Content-Length: %d\r\nConnection: keep-alive\r\n\r\n" % len(payload)
+    return out.encode("latin-1") + payload
+
+
+def serve(raw, addr, ctx, args):
+    start = time.monotonic()
+    try:
+        conn = ctx.wrap_socket(raw, server_side=True)
+    except (ssl.SSLError, OSError) as e:
+        print("%s handshake failed: %s" % (addr[0], e))
+        raw.close()
+        return
+    ms = (time.monotonic() - start) * 1000
+    print("%s %s handshake %.0f ms, %s" % (addr[0], "resumed" if conn.session_reused else "full", ms, conn.version()))
+
+    backend = http.client.HTTPConnection(args.backend_host, args.backend_port, timeout=10)
+    conn.settimeout(args.idle_timeout)
+    buf, requests = b"", 0
+    try:
+        while True:
+            req = read_request(conn, buf)
+            if req is None:
+                break
+            head, body, buf = req
+            conn.sendall(forward(backend, head, body))
+            requests += 1
+    except socket.timeout:
+        pass  # kept alive long enough; the device resumes next time
+    except (ssl.SSLError, OSError, http.client.HTTPException) as e:
+        print("%s: %s" % (addr[0], e))
+    finally:
+        print("%s closed after %d requests" % (addr[0], requests))
+        backend.close()
+        try:
+            conn.unwrap()
+        except (ssl.SSLError, OSError):
+            pass
+        conn.close()
+
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    p.add_argument("--port", type=int, default=8443)
+    p.add_argument("--cert", default=os.path.join(HERE, "certs", "server.pem"))
+    p.add_argument("--key", default=os.path.join(HERE, "certs", "server.key"))
+    p.add_argument("--backend-host", default="127.0.0.1")
+    p.add_argument("--backend-port", type=int, default=5000)
+    p.add_argument("--idle-timeout", type=float, default=75, help="s a quiet connection is kept")
+    args = p.parse_args()
+
+    ctx = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+    ctx.minimum_version = ssl.TLSVersion.TLSv1_2
+    ctx.load_cert_chain(args.cert, args.key)
+
+    sock = socket.create_server(("", args.port))
+    print("TLS on :%d -> %s:%d" % (args.port, args.backend_host, args.backend_port))
+    while True:
+        raw, addr = sock.accept()
+        threading.Thread(target=serve, args=(raw, addr, ctx, args), daemon=True).start()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+#include "sample.h"
+
+// Windowed statistics of the sensor readings, so the uplink can send one
+// summary a minute instead of every 1 Hz sample. Each channel keeps
+// min/max and Welford's running mean and sum of squared deviations: one
+// pass, constant space, and no catastrophic cancellation in float the way
+// sum/sum-of-squares has once a window holds a few hundred readings.
+
+#define AGGREGATE_WINDOW_MAX 3600000 // ms, keeps n well inside uint16_t at 1 Hz
+
+struct Welford {
+    float min, max;
+    float mean;
+    float m2; // sum of squared deviations from the running mean
+};
+
+struct WindowStats {
+    uint32_t start; // millis() of the window's first moment
+    uint32_t ms; // length, set when it is closed
+    uint16_t n; // valid samples in it
+    uint8_t plant; // registry index (plants.h), set by whoever sends it
+    Welford temp; // °C
+    Welford moisture; // % RH
+    Welford light; // %, light_percent() of each reading
+    Welford lux; // light_lux() of each reading
+};
+
+void window_start(WindowStats &w, uint32_t now);
+void window_add(WindowStats &w, const SensorData &s); // invalid samples are skipped
+void window_close(WindowStats &w, uint32_t now);
+
+void welford_add(Welford &c, uint16_t n, float x); // n counts x already
+float welford_stddev(const Welford &c, uint16_t n); // sample stddev, 0 below two samples
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Timestamps of the startup phases, relative to reset. Marks can come from
+// setup() or later (e.g. when WiFi finally associates); the set is reported
+// once, with the first uplink that goes out after it is complete enough.
+
+#define BOOT_MAX_MARKS 12
+
+struct BootMark {
+    const char *phase;
+    uint32_t us; // micros() when the phase finished
+};
+
+void boot_mark(const char *phase, uint32_t now_us);
+bool boot_marked(const char *phase);
+size_t boot_mark_count();
+const BootMark &boot_mark_at(size_t i);
+void boot_print(); // dumps the table to Serial (device only)
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+// Circuit breaker for the uplink. After BREAKER_THRESHOLD failures in a row
+// it opens and requests are skipped outright (the caller queues the sample)
+// until a jittered, exponentially growing backoff runs out. Then a single
+// probe goes through (half-open): success closes the breaker, failure opens
+// it again for twice as long. The jitter keeps a fleet that lost the server
+// at the same moment from all coming back at the same moment.
+
+#define BREAKER_THRESHOLD 3 // consecutive failures before opening
+#define BREAKER_BACKOFF_MIN 2000 // ms, first open period (before jitter)
+#define BREAKER_BACKOFF_MAX 300000 // ms
+
+enum BreakerState {
+    BREAKER_CLOSED, // requests go through
+    BREAKER_OPEN, // skip until open_until
+    BREAKER_HALF_OPEN, // one probe is out
+};
+
+struct Breaker {
+    BreakerState state;
+    uint32_t failures; // in a row
+    uint32_t backoff; // ms, doubles per failed probe
+    uint32_t opened_at;
+    uint32_t open_for; // backoff with jitter applied
+    uint32_t trips; // times it opened, for the logs
+};
+
+void breaker_init(Breaker &b);
+// Whether a request may be sent now; moves OPEN -> HALF_OPEN when the wait is over
+bool breaker_allow(Breaker &b, uint32_t now);
+void breaker_success(Breaker &b);
+// rnd is any uniformly random value (esp_random()); it picks the jitter
+void breaker_failure(Breaker &b, uint32_t now, uint32_t rnd);
+const char *breaker_name(BreakerState s);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Buzzer driven by the LEDC peripheral. Each step of a pattern is started
+// from an esp_timer callback, so playing a pattern costs no loop() time.
+
+#define BUZZER_PIN 15
+#define BUZZER_LEDC_CHANNEL 0
+#define BUZZER_LEDC_RESOLUTION 10 // bits
+#define BUZZER_LEDC_DUTY 512 // 50% at 10 bits
+
+struct BuzzerStep {
+    uint16_t freq; // Hz, 0 = silent step
+    uint16_t on_ms; // tone length
+    uint16_t off_ms; // silence after the tone
+};
+
+struct BuzzerPattern {
+    const BuzzerStep *steps;
+    size_t len;
+    uint8_t repeat; // times the whole sequence is played
+};
+
+extern const BuzzerPattern BUZZER_PATTERN_CONTINUOUS; // original 10s low tone
+extern const BuzzerPattern BUZZER_PATTERN_CHIRP; // short high chirps
+
+void buzzer_hw_setup();
+void buzzer_set_pattern(const BuzzerPattern *pattern);
+void buzzer_play(); // returns immediately, pattern plays from timer callbacks
+void buzzer_stop();
+bool buzzer_busy();
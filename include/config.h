@@ -0,0 +1,58 @@
+#pragma once
+
+#include <ArduinoJson.h>
+#include <stdint.h>
+
+// Runtime configuration, stored as one blob in NVS and loaded once at boot.
+// The server can send a delta back in a /submit response; a delta is checked
+// field by field on a copy and only swapped in (and saved) if all of it is
+// valid. Fields are append-only: a blob written by an older firmware keeps
+// its values and the new fields get their defaults. Its version, not its
+// length, says which fields it has; add each new version's first field to
+// version_end[] in config.cpp.
+
+#define CONFIG_VERSION 7
+#define CONFIG_PERIODS_MAX 20 // storage for drying periods is sized for this
+
+struct DeviceConfig {
+    uint16_t version;
+    uint32_t rev; // server-side revision this config corresponds to
+    char server_address[40];
+    uint16_t server_port;
+    uint8_t periods_stored; // 5 for demo, 20 for real application (enought to calibrate drying times)
+    int16_t dry; // this number and below indicates a dry plant
+    int16_t shade; // this number and below indicates not in a sunny spot
+    uint32_t buzzer_off_time; // ms between buzzer patterns
+    uint32_t sensor_period; // ms
+    uint32_t display_period; // ms
+    uint32_t uplink_period; // ms
+    // version 2
+    uint32_t ota_period; // ms between firmware checks, 0 = never
+    // version 3
+    uint32_t aggregate_window; // ms per uploaded summary, 0 = send every sample
+    // version 4, see deadband.h
+    uint32_t heartbeat_period; // ms, longest gap between uploads; 0 = upload everything
+    uint16_t temp_deadband; // 0.1 °C
+    uint16_t moisture_deadband; // 0.1 %RH
+    uint16_t light_deadband; // %
+    // version 5, this device's light sensor calibration, see lux.h
+    uint16_t lux_gain; // ‰ applied to the table's lux, 1000 = as modeled
+    int16_t adc_offset; // counts added to each raw light reading
+    // version 6, see transport.h
+    uint8_t transport; // TransportKind, how uplinks reach the server
+    uint8_t mqtt_qos; // 0 or 1
+    uint16_t mqtt_port; // broker on server_address
+    // version 7
+    uint16_t tls_port; // TLS front end on server_address, for TRANSPORT_HTTPS
+};
+
+extern DeviceConfig config;
+
+void config_setup(); // defaults, then whatever is in NVS
+// Applies a delta such as {"uplink_period": 5000}. Returns true if the
+// running config changed; false if nothing changed or the delta was rejected.
+bool config_apply(JsonObjectConst delta, uint32_t rev);
+// Called after a delta has been applied, so periods etc. can be re-armed
+void config_on_change(void (*callback)());
+bool config_validate(const DeviceConfig &c);
+void config_defaults(DeviceConfig &c);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+#include "aggregate.h"
+#include "sample.h"
+
+// Report-by-exception for the uplink. A window (or, with aggregation off, a
+// sample) only goes up if one of its values has moved past that metric's
+// deadband since the last one that went up, or heartbeat_period has passed
+// without an upload. The server holds each reported value until the next
+// one arrives. A pot that sits at the same temperature and moisture all
+// afternoon costs a heartbeat every 15 minutes instead of a request every
+// minute. Thresholds are in config (0.1 °C, 0.1 %RH, light %); a
+// heartbeat_period of 0 turns this off and everything is sent.
+//
+// Windows are compared by their means, so a one-second blip doesn't trigger
+// an upload; its min/max still go up with the next window that does.
+
+struct Deadband {
+    bool primed; // something has been reported since boot
+    float temp, moisture, light; // as last reported
+    uint32_t reported_at;
+    uint32_t sent, skipped; // since boot
+};
+
+void deadband_init(Deadband &d);
+// Whether w should be sent; if so it becomes the new reference
+bool deadband_window(Deadband &d, const WindowStats &w, uint32_t now);
+bool deadband_sample(Deadband &d, const SensorData &s, uint32_t now);
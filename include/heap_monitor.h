@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+
+// Heap health: free heap, lowest free heap since boot and the largest block
+// that can still be allocated. The gap between free and largest block is
+// fragmentation, which is what eventually kills long-running units.
+
+#define HEAP_MONITOR_PERIOD 10000 // ms
+#define HEAP_LOW_BLOCK 8192 // warn when the largest free block drops under this
+
+struct HeapStats {
+    uint32_t free;
+    uint32_t min_free;
+    uint32_t largest_block;
+    uint32_t baseline_free; // free heap at the end of setup()
+    uint8_t fragmentation; // % of free heap not in the largest block
+};
+
+void heap_monitor_setup(); // call last in setup()
+HeapStats heap_monitor_sample();
+void heap_monitor_job(); // periodic check, logs when things look bad
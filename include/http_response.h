@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+class WiFiClient;
+
+// Reads an HTTP/1.x response straight off the WiFiClient, in place of
+// HttpClient::responseStatusCode()/skipResponseHeaders()/read(). Those poll
+// one byte at a time and sleep a whole second whenever nothing is there yet;
+// this waits on the socket becoming readable (select() on client.fd()) and
+// pulls whatever has arrived into the caller's buffer in one go, so a
+// request takes about as long as the network round trip.
+
+#define HTTP_RESPONSE_TIMEOUT 5000 // ms for the whole response, first byte to last
+#define HTTP_POLL_MS 1 // when the client has no socket to select() on
+
+enum HttpResponseError {
+    HTTP_RESP_TIMEOUT = -1, // nothing complete before the deadline
+    HTTP_RESP_CLOSED = -2, // connection closed or reset mid-response
+    HTTP_RESP_OVERFLOW = -3, // headers + body don't fit the buffer
+    HTTP_RESP_INVALID = -4, // not an HTTP status line
+};
+
+struct HttpResponse {
+    int status;
+    int content_length; // -1 if the server didn't send one (body runs to close)
+    const char *body; // inside the caller's buffer, NUL-terminated
+    size_t body_len;
+};
+
+// Blocks until c has something to say (bytes, or the peer closing) or ms
+// pass. Callers re-check available()/connected() afterwards either way.
+void wait_readable(WiFiClient &c, uint32_t ms);
+
+// Returns the status code, or a negative HttpResponseError. The whole
+// response ends up in buf, which needs room for one extra NUL.
+int http_read_response(WiFiClient &c, char *buf, size_t len, uint32_t timeout_ms, HttpResponse &resp);
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The sensor bus (DHT20s and TCA9548A muxes), in fast mode: both parts are
+// rated for 400 kHz, which quarters the time every transfer holds the loop.
+// Every transfer is counted by outcome, so the uplink can tell an unplugged
+// sensor (address NACKs) from a marginal cable (short reads, CRC errors)
+// from a wedged bus (timeouts).
+//
+// A slave reset or browned out mid-byte can hold SDA low forever, and then
+// every transfer fails until a power cycle. When SDA is found low after a
+// failed transfer, or after I2C_RECOVER_AFTER timeouts/bus errors in a row,
+// i2c_recover() takes the pins from the controller, clocks SCL until the
+// slave lets go of SDA, sends a STOP and restarts the controller.
+
+#define I2C_SDA_PIN 21
+#define I2C_SCL_PIN 22
+#define I2C_CLOCK_HZ 400000
+#define I2C_TIMEOUT_MS 10 // per transfer, a 7-byte read is ~0.2 ms at 400 kHz
+#define I2C_RECOVER_AFTER 3 // timeouts/bus errors in a row
+#define I2C_RECOVER_CLOCKS 9 // enough to finish any byte a slave is stuck in
+#define I2C_RECOVER_HALF_US 5 // half an SCL period while bit-banging, 100 kHz
+
+enum I2cResult {
+    I2C_OK,
+    I2C_NACK_ADDR, // nobody there: unplugged, or its mux channel is closed
+    I2C_NACK_DATA,
+    I2C_SHORT_READ, // fewer bytes than asked for
+    I2C_TIMEOUT, // SCL held low past I2C_TIMEOUT_MS
+    I2C_BUS_ERROR, // anything else the controller reports
+    I2C_CRC, // the transfer worked, the payload's checksum didn't (driver)
+    I2C_NOT_READY, // read before the part finished converting (driver)
+    I2C_RESULTS,
+};
+
+struct I2cStats {
+    uint32_t count[I2C_RESULTS]; // [I2C_OK] is transfers that worked
+    uint32_t recoveries; // SDA released by i2c_recover()
+    uint32_t recover_failed; // still held low after I2C_RECOVER_CLOCKS
+};
+
+void i2c_setup();
+// Address-only when len is 0, which is how parts are probed
+I2cResult i2c_write(uint8_t addr, const uint8_t *data, size_t len);
+I2cResult i2c_read(uint8_t addr, uint8_t *buf, size_t len);
+// For payload checks done above the bus (I2C_CRC, I2C_NOT_READY)
+void i2c_count(I2cResult r);
+bool i2c_recover(); // true if SDA is high afterwards
+
+const I2cStats &i2c_stats();
+const char *i2c_result_name(I2cResult r);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+
+// The T-Display's two buttons (active low, external pull-ups). A falling-edge
+// interrupt debounces and timestamps each press and drops it into a FreeRTOS
+// queue; the UI task blocks on that queue, so a press is handled right away
+// even while loop() sits in delay() or waits on the server. display_job()
+// posts a refresh through the same queue when there is new data.
+
+#define BUTTON_LEFT_PIN 0 // BOOT button
+#define BUTTON_RIGHT_PIN 35 // input-only pin
+#define BUTTON_DEBOUNCE_US 50000 // contact bounce, and the fastest anyone re-presses
+#define INPUT_QUEUE_LEN 8
+
+enum InputEventType : uint8_t {
+    INPUT_BUTTON_LEFT, // previous page
+    INPUT_BUTTON_RIGHT, // next page
+    INPUT_REFRESH, // new sample to show
+};
+
+struct InputEvent {
+    uint8_t type;
+    uint32_t at_us; // when it happened, for input-to-screen latency
+};
+
+void input_setup();
+// From a task, not an ISR. A refresh is skipped if events are already
+// queued, the redraw they cause shows the new data anyway.
+bool input_post(uint8_t type);
+bool input_wait(InputEvent &ev, uint32_t timeout_ms); // false on timeout
+uint32_t input_dropped(); // presses lost to a full queue
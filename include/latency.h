@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+
+// Fixed-bucket latency histograms per loop stage. Bucket i counts samples in
+// [2^i, 2^(i+1)) us (bucket 0 also takes < 1us), the last bucket is open
+// ended. Recording is a couple of instructions, so it stays on in release
+// builds; the uplink takes a snapshot every LATENCY_REPORT_PERIOD and hands it
+// back with latency_merge() when the request carrying it isn't delivered.
+
+#define LATENCY_BUCKETS 26 // up to 2^25 us = 33.5s, past the HTTP timeout
+#define LATENCY_REPORT_PERIOD 60000 // ms
+
+enum LatencyStage {
+    LAT_LOOP, // one scheduler pass, all due jobs
+    LAT_SENSOR, // DHT20 read
+    LAT_DISPLAY, // display_loop SPI drawing
+    LAT_JSON, // building + serializing the uplink document
+    LAT_HTTP_CONNECT, // TCP connect + request headers
+    LAT_HTTP_RESPONSE, // waiting for and parsing the status line
+    LAT_LOCAL, // answering one request to the local endpoint
+    LAT_STAGES
+};
+
+struct LatencyHistogram {
+    uint32_t buckets[LATENCY_BUCKETS];
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t sum_us;
+};
+
+// Start/stop timestamps, from the CPU cycle counter on the ESP32
+struct LatencyTimer {
+    uint32_t cycles;
+    uint32_t us; // cycles wrap every ~18s at 240MHz, micros() covers longer stages
+};
+
+LatencyTimer latency_start();
+void latency_stop(LatencyStage stage, const LatencyTimer &t);
+void latency_record(LatencyStage stage, uint32_t us);
+
+const LatencyHistogram &latency_histogram(LatencyStage stage);
+uint32_t latency_percentile(const LatencyHistogram &h, float p); // upper bound of the bucket, us
+void latency_reset();
+void latency_take(LatencyHistogram out[LAT_STAGES]); // copy, then reset
+void latency_merge(const LatencyHistogram in[LAT_STAGES]);
+const char *latency_name(LatencyStage stage);
+int latency_bucket(uint32_t us);
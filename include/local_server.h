@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+
+// A small HTTP server on the board itself, so anything on the LAN can read
+// the plants without a round trip through the cloud server:
+//
+//   GET /recent.json[?plant=P][&n=N][&since=MS]
+//   GET /recent.csv  (same parameters)
+//
+// The newest N readings (default LOCAL_ROWS_DEFAULT) from the recent ring
+// (recent.h), of plant P or of every plant, optionally only those read after
+// millis() MS; "now" in the JSON is the board's millis(), to age them by.
+//
+// One connection at a time, served from loop() and never waited on. A small
+// task blocks in select() on the listening socket and wakes loop() when a
+// client connects, so an idle board sleeps until one does and still accepts
+// it at once; a request arriving in pieces is picked up over several polls
+// LOCAL_SERVER_PERIOD apart (local_server_busy()). Rows are formatted one at
+// a time into a stack buffer and go out as HTTP/1.1 chunks, a TCP segment
+// each (segment_writer.h), so a response needs no buffer of its own however
+// many rows it has.
+
+#define LOCAL_SERVER_PORT 80
+#define LOCAL_SERVER_PERIOD 5 // ms between polls while a request is coming in
+#define LOCAL_SERVER_IDLE_PERIOD 200 // ms between checks for WiFi to listen on
+#define LOCAL_REQUEST_TIMEOUT 2000 // ms from accept to the end of the headers
+#define LOCAL_LINE_MAX 160 // request line, longer gets 414
+#define LOCAL_ROWS_DEFAULT 120
+#define LOCAL_ACCEPT_TASK_STACK 2048 // bytes
+#define LOCAL_ACCEPT_TASK_PRIORITY 1 // loop()'s, it only wakes it
+#define LOCAL_ACCEPT_TASK_CORE 1
+
+struct LocalServerStats {
+    uint32_t requests; // answered with 200
+    uint32_t errors; // answered with 4xx
+    uint32_t timeouts; // closed before the request was complete
+    uint32_t rows; // readings sent
+    uint32_t bytes; // payload, not counting headers and chunk framing
+    uint32_t segments;
+};
+
+void local_server_setup(); // from loop()'s task, which the accept task wakes
+void local_server_loop(); // the job, starts listening once WiFi is up
+bool local_server_busy(); // a connection is open: poll at LOCAL_SERVER_PERIOD
+bool local_server_listening(); // else the accept task wakes loop() for the next
+const LocalServerStats &local_server_stats();
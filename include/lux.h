@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stdint.h>
+
+// Illuminance from the photoresistor's raw 12-bit ADC reading. A reading
+// goes through three nonlinear steps, and all three are folded into one
+// 4096-entry table the compiler fills in, indexed by the raw value:
+//
+//   ADC: the ESP32's at 11 dB reads 0 below ~0.1 V and flattens out above
+//     ~2.6 V; LUX_ADC_* is the usual 4th-order fit of volts against raw.
+//   Divider: the photoresistor from 3.3 V to the pin, LUX_R_FIXED to
+//     ground, so R_ldr = R_fixed * (Vcc - V) / V.
+//   Photoresistor: GL5528-type, R = R10 * (lux / 10)^-gamma.
+//
+// Entries are 0.1 lux, 8 KB in flash. Parts vary (the LDR's R10 by about
+// ±30%, the ADC's reference by a few %), so each device carries its own
+// calibration in its config: config.adc_offset counts added to the raw
+// reading before the lookup, and config.lux_gain (‰) applied after it.
+// With a 10k fixed resistor the circuit tops out around 1250 lux; bright
+// sun reads as the top of the table.
+
+#define LUX_VCC 3.3 // V across the divider
+#define LUX_R_FIXED 10000.0 // ohm, pin to ground
+#define LUX_R10 15000.0 // ohm at 10 lux, GL5528 is 10-20k
+#define LUX_GAMMA 0.7 // log(R) per log(lux), GL5528 is 0.6-0.8
+#define LUX_TABLE_MAX 65535 // 0.1 lux, where the table saturates
+
+// V = a4 x^4 + a3 x^3 + a2 x^2 + a1 x + a0, x = raw
+#define LUX_ADC_A4 -0.000000000000016
+#define LUX_ADC_A3 0.000000000118171
+#define LUX_ADC_A2 -0.000000301211691
+#define LUX_ADC_A1 0.001109019271794
+#define LUX_ADC_A0 0.034143524634089
+
+namespace lux_detail {
+
+// <cmath> isn't constexpr; these are good to ~1e-12 over the range used
+constexpr double ln(double x)
+{
+    // x = m * 2^k with m in [0.75, 1.5), then ln(m) = 2 atanh((m-1)/(m+1))
+    int k = 0;
+    while (x >= 1.5) {
+        x /= 2;
+        k++;
+    }
+    while (x < 0.75) {
+        x *= 2;
+        k--;
+    }
+    double y = (x - 1) / (x + 1), y2 = y * y, term = y, sum = 0;
+    for (int n = 1; n < 60; n += 2) {
+        sum += term / n;
+        term *= y2;
+    }
+    return 2 * sum + k * 0.69314718055994530942;
+}
+
+constexpr double exp(double x)
+{
+    // x = k ln2 + r, |r| <= ln2 / 2
+    int k = (int)(x / 0.69314718055994530942 + (x < 0 ? -0.5 : 0.5));
+    double r = x - k * 0.69314718055994530942, term = 1, sum = 1;
+    for (int n = 1; n < 30; n++) {
+        term *= r / n;
+        sum += term;
+    }
+    for (; k > 0; k--)
+        sum *= 2;
+    for (; k < 0; k++)
+        sum /= 2;
+    return sum;
+}
+
+constexpr double adc_volts(int raw)
+{
+    double x = raw;
+    return (((LUX_ADC_A4 * x + LUX_ADC_A3) * x + LUX_ADC_A2) * x + LUX_ADC_A1) * x + LUX_ADC_A0;
+}
+
+constexpr uint16_t entry(int raw)
+{
+    if (raw <= 0)
+        return 0; // anything under ~0.1 V: dark as far as the ADC can tell
+    double v = adc_volts(raw);
+    if (v >= LUX_VCC)
+        return LUX_TABLE_MAX;
+    double r = LUX_R_FIXED * (LUX_VCC - v) / v;
+    double lux = 10 * exp(ln(r / LUX_R10) / -LUX_GAMMA);
+    double deci = lux * 10 + 0.5;
+    return deci >= LUX_TABLE_MAX ? LUX_TABLE_MAX : (uint16_t)deci;
+}
+
+struct Table {
+    uint16_t deci_lux[4096];
+};
+
+constexpr Table make_table()
+{
+    Table t = {};
+    for (int raw = 0; raw < 4096; raw++)
+        t.deci_lux[raw] = entry(raw);
+    return t;
+}
+
+} // namespace lux_detail
+
+// Calibrated lux for a raw reading, using config's calibration
+float light_lux(int raw);
+// The same without calibration, straight from the table
+float light_lux_uncalibrated(int raw);
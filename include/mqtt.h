@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+class SegmentWriter;
+class WiFiClient;
+
+// Just enough MQTT 3.1.1 for the uplink (transport.h): one clean session to
+// one broker, publishing at QoS 0 or 1, and one QoS 0 subscription for what
+// the server pushes back. The connection stays up between uplinks, so a
+// publish costs a 2-5 byte fixed header, the topic and the payload, instead
+// of a TCP handshake and HTTP headers each time.
+//
+// Incoming packets collect in a fixed buffer until they are whole; nothing
+// is allocated. mqtt_loop() takes pushes and sends PINGREQ when the link has
+// been quiet for half the keep-alive, so NAT and the broker don't drop it.
+
+#define MQTT_KEEPALIVE_S 120
+#define MQTT_TIMEOUT_MS 5000 // CONNACK, PUBACK, PINGRESP
+#define MQTT_RX_MAX 1280 // largest packet taken, a push is at most UPLINK_RESPONSE_MAX
+#define MQTT_TOPIC_MAX 48
+#define MQTT_CLIENT_ID_MAX 24
+
+enum MqttPacketType {
+    MQTT_CONNECT = 1,
+    MQTT_CONNACK = 2,
+    MQTT_PUBLISH = 3,
+    MQTT_PUBACK = 4,
+    MQTT_SUBSCRIBE = 8,
+    MQTT_SUBACK = 9,
+    MQTT_PINGREQ = 12,
+    MQTT_PINGRESP = 13,
+    MQTT_DISCONNECT = 14,
+};
+
+struct MqttStats {
+    uint32_t connects; // sessions the broker accepted
+    uint32_t connect_failures; // TCP refused, or no/negative CONNACK
+    uint32_t drops; // sessions lost (timeouts, resets, bad packets)
+    uint32_t published;
+    uint32_t acked; // PUBACKs for our QoS 1 publishes
+    uint32_t pushes; // messages on the subscription
+    uint32_t pings;
+};
+
+// Remaining-length encoding, 1-4 bytes written to out
+size_t mqtt_encode_length(uint8_t *out, uint32_t n);
+// Bytes the length took, 0 if p doesn't hold all of it yet, -1 if malformed
+int mqtt_decode_length(const uint8_t *p, size_t len, uint32_t &n);
+
+typedef void (*MqttMessageFn)(const char *topic, const uint8_t *payload, size_t len);
+void mqtt_on_message(MqttMessageFn fn);
+
+// Blocks up to MQTT_TIMEOUT_MS for the CONNACK; subscribes to sub_topic
+// without waiting for the SUBACK
+bool mqtt_connect(const char *host, uint16_t port, const char *client_id, const char *sub_topic);
+bool mqtt_connected();
+void mqtt_disconnect(); // DISCONNECT, then close
+
+// A PUBLISH of len payload bytes: writes the fixed header, topic and packet
+// id to out, the caller writes the payload and flushes. Returns the packet
+// id for mqtt_wait_puback(), 0 for QoS 0.
+uint16_t mqtt_publish_begin(SegmentWriter &out, const char *topic, size_t len, uint8_t qos);
+void mqtt_publish_end(bool written); // the payload went out, or the session is dropped
+bool mqtt_wait_puback(uint16_t id, uint32_t timeout_ms); // pushes arriving meanwhile are handled
+void mqtt_loop(uint32_t now);
+
+WiFiClient &mqtt_socket(); // for SegmentWriter
+const MqttStats &mqtt_stats();
@@ -0,0 +1,14 @@
+#pragma once
+
+// Firmware updates from the Flask server (flask/server.py). The device asks
+// /firmware/manifest with the sha256 of the image it runs; if there is a newer
+// build it downloads a zlib-compressed delta (see ota_patch.h) and rebuilds
+// the new image into the other OTA partition. The result has to match the
+// manifest's sha256 and pass esp_ota_end()'s image check before the boot
+// partition is switched and the device restarts.
+
+#define OTA_NETWORK_TIMEOUT 10000 // ms without data before the download is abandoned
+
+// Returns false if no update was found or it failed; restarts on success
+bool ota_check();
+const char *ota_running_sha256(); // hex, computed once
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming decoder for the firmware patches produced by flask/ota_delta.py.
+// Input is the (already inflated) patch stream, fed in arbitrary chunks:
+//
+//   header: "SSP2" | u32 old_size | u32 new_size | 32 byte sha256 of the old
+//           image | 32 byte sha256 of the new one
+//   ops:    'C' u32 off u32 len            copy len bytes of the old image
+//           'D' u32 off u32 len <len>      old[off + i] + diff[i] (mod 256)
+//           'A' u32 len <len>              literal bytes
+//           'E'                            end of patch
+//
+// All integers are little endian. Old bytes come from read_old (the running
+// partition on the device), new bytes go to write_new in order. A patch
+// made against any image but the one begin() was given is refused before
+// anything is written.
+
+#define OTA_PATCH_MAGIC "SSP2"
+#define OTA_PATCH_HEADER_LEN 76
+
+enum OtaPatchStatus {
+    OTA_PATCH_OK,
+    OTA_PATCH_DONE,
+    OTA_PATCH_BAD_HEADER,
+    OTA_PATCH_BAD_OP,
+    OTA_PATCH_OUT_OF_RANGE, // op reads past the old image or writes past new_size
+    OTA_PATCH_IO_ERROR, // read_old/write_new failed
+    OTA_PATCH_TRAILING_DATA,
+    OTA_PATCH_WRONG_BASE // made against another image than the running one
+};
+
+typedef bool (*OtaReadOld)(uint32_t offset, uint8_t *buf, size_t len, void *ctx);
+typedef bool (*OtaWriteNew)(const uint8_t *buf, size_t len, void *ctx);
+
+class OtaPatcher {
+public:
+    void begin(uint32_t old_size, const uint8_t old_sha256[32], OtaReadOld read_old, OtaWriteNew write_new,
+               void *ctx);
+    OtaPatchStatus feed(const uint8_t *data, size_t len);
+
+    OtaPatchStatus status() const { return state_status; }
+    uint32_t new_size() const { return target_size; }
+    uint32_t written() const { return out_pos; }
+    const uint8_t *new_sha256() const { return target_sha; }
+
+private:
+    enum Stage { HEADER, OP, ARGS, DIFF_BODY, ADD_BODY, END };
+
+    OtaReadOld read_old;
+    OtaWriteNew write_new;
+    void *ctx;
+
+    Stage stage;
+    OtaPatchStatus state_status;
+    uint32_t base_size; // size of the image we patch against
+    uint8_t base_sha[32];
+    uint32_t target_size;
+    uint8_t target_sha[32];
+    uint32_t out_pos;
+
+    uint8_t scratch[OTA_PATCH_HEADER_LEN]; // header or op arguments being collected
+    size_t scratch_len;
+    size_t scratch_need;
+    uint8_t op;
+    uint32_t op_off;
+    uint32_t op_left;
+
+    OtaPatchStatus fail(OtaPatchStatus s);
+    OtaPatchStatus start_op();
+    OtaPatchStatus copy_old(uint32_t off, uint32_t len);
+};
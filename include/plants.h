@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "aggregate.h"
+#include "deadband.h"
+#include "prediction.h"
+#include "sample.h"
+
+// Registry of the plants one board looks after. Each has a DHT20, either
+// straight on the bus (the original single-pot wiring) or behind one channel
+// of a TCA9548A mux, and a light reading off an ADC pin that the pots on one
+// shelf (one mux) share. plants_discover() finds them; plants_add() is there
+// for wiring it can't guess. Every plant keeps its own countdown, window and
+// deadband.
+//
+// Sampling is round-robin: each plants_sample_next() visits one plant and
+// polls its drivers (sensor_driver.h), which collect the conversion started
+// on its previous visit and start the next one, so a visit is a few I2C
+// transfers and never waits out the 80 ms conversion. The sensor job runs
+// every sensor_period / count, so each plant is still read once per
+// sensor_period and a loop() pass costs the same with one plant or thirty.
+
+#define PLANTS_MAX 32
+#define PLANT_MUX_BASE 0x70 // TCA9548A, A0-A2 pick 0x70..0x77
+#define PLANT_MUXES 8
+#define PLANT_MUX_CHANNELS 8
+#define PLANT_NO_MUX 0xFF // DHT20 straight on the bus
+#define PLANT_TICK_MIN 20 // ms, fastest the round-robin moves on
+
+struct PlantWiring {
+    uint8_t mux; // TCA9548A address, or PLANT_NO_MUX
+    uint8_t channel;
+    uint8_t light_pin; // ADC1 GPIO
+};
+
+struct Plant {
+    PlantWiring wiring;
+    bool present; // DHT20 answered when added
+    SensorData last;
+    Prediction prediction;
+    WindowStats window;
+    Deadband deadband;
+    uint32_t reads, errors;
+};
+
+void plants_clear();
+// Returns the new plant's index, or -1 if the registry is full
+int plants_add(const PlantWiring &w, uint32_t now);
+// Scans every mux for DHT20s; shelf (mux) m gets light_pins[m % n_pins].
+// Without any mux it registers the one sensor on the bus. Returns the count.
+size_t plants_discover(const uint8_t *light_pins, size_t n_pins, uint32_t now);
+size_t plants_count();
+Plant &plant_at(size_t i);
+
+// Visits the next plant. Returns its index if it produced a fresh reading,
+// -1 otherwise (first visit, sensor missing or a failed transfer).
+int plants_sample_next();
+uint32_t plants_tick(uint32_t sensor_period); // sensor job period for the current count
+void plant_nvs_key(const Plant &p, char *buf, size_t len); // where its drying history lives
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+// Active-time / state-residency accounting per subsystem, with a charge
+// estimate from configurable current figures. Callers pass the time in, so
+// this also runs against a virtual clock on the host.
+
+enum PowerSubsystem {
+    POWER_RADIO, // WiFi associated or associating
+    POWER_DISPLAY, // backlight on
+    POWER_SENSOR, // DHT20 transaction in progress
+    POWER_BUZZER, // pattern playing
+    POWER_CPU, // running jobs (off = idle in vTaskDelay)
+    POWER_SUBSYSTEMS
+};
+
+// Default current draw (mA) in the on/off state, rough datasheet figures
+#define POWER_RADIO_ON_MA 100.0f
+#define POWER_RADIO_OFF_MA 0.0f
+#define POWER_DISPLAY_ON_MA 20.0f
+#define POWER_DISPLAY_OFF_MA 0.0f
+#define POWER_SENSOR_ON_MA 1.0f
+#define POWER_SENSOR_OFF_MA 0.0f
+#define POWER_BUZZER_ON_MA 30.0f
+#define POWER_BUZZER_OFF_MA 0.0f
+#define POWER_CPU_ON_MA 50.0f
+#define POWER_CPU_OFF_MA 30.0f
+
+struct PowerResidency {
+    uint64_t on_ms;
+    uint64_t off_ms;
+    uint32_t transitions; // off -> on edges
+    float mah; // estimated charge used so far
+};
+
+void power_stats_setup(uint32_t now);
+void power_set(PowerSubsystem sub, bool on, uint32_t now);
+void power_set_current(PowerSubsystem sub, float on_ma, float off_ma);
+// Brings every counter up to `now` and copies it out
+PowerResidency power_residency(PowerSubsystem sub, uint32_t now);
+float power_total_mah(uint32_t now);
+const char *power_name(PowerSubsystem sub);
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+
+// Watering countdown: remembers how long the plant took to dry out after the
+// last few waterings and counts down from their average after each watering.
+// Time is passed in, so it runs the same against a virtual clock.
+
+// A just-watered plant saturates the sensor. The DHT20's 20-bit RH tops out
+// at 0xFFFFF = 99.9999%, so "watered" can't be an exact 100.
+#define WATERED_RH 99.9f
+
+struct Prediction {
+    uint32_t periods[CONFIG_PERIODS_MAX]; // drying periods, oldest first
+    size_t count;
+    size_t capacity; // config.periods_stored
+    uint32_t last_watered;
+    uint32_t last_update; // time of the previous sample
+    uint32_t millis_left;
+    float days_left;
+    bool predicted; // a countdown has been started
+    bool dry_recorded; // this drying cycle's period is already stored
+    bool dirty; // periods changed since the last NVS write
+};
+
+void prediction_init(Prediction &p, size_t capacity, uint32_t now);
+void prediction_load(Prediction &p, const uint32_t *periods, size_t n); // from NVS, oldest first
+void prediction_set_capacity(Prediction &p, size_t capacity); // drops the oldest periods if needed
+void prediction_sample(Prediction &p, float moisture, int dry, uint32_t now);
+
+uint32_t prediction_average(const Prediction &p); // 0 with no history
+float millis_to_days(uint32_t ms);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sample.h"
+
+// The last RECENT_MAX readings of every plant together, in RAM, for the
+// local endpoint (local_server.h) to serve without going through the cloud.
+// Readings are stored as fixed point, 12 bytes each, and the oldest is
+// overwritten once it is full. Written and read from loop() only.
+
+#define RECENT_MAX 1024 // readings, 12 KB; ~17 min of one plant at 1 Hz
+
+struct RecentSample {
+    uint32_t ms; // millis() when read
+    int16_t temp; // 0.01 °C
+    uint16_t moisture; // 0.01 %RH
+    uint16_t light; // raw 12-bit ADC
+    uint8_t plant; // registry index (plants.h)
+    uint8_t pad;
+};
+
+void recent_clear();
+void recent_add(const SensorData &s, uint8_t plant, uint32_t now); // invalid readings are skipped
+size_t recent_count();
+const RecentSample &recent_at(size_t i); // 0 is the oldest held
+
+inline float recent_temp(const RecentSample &r) { return r.temp * 0.01f; }
+inline float recent_moisture(const RecentSample &r) { return r.moisture * 0.01f; }
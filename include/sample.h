@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stddef.h>
+
+// One reading of the plant's sensors, kept as numbers; text is only produced
+// into caller-provided buffers when it is displayed or sent.
+
+struct SensorData {
+    float temp; // °C
+    float moisture; // % RH
+    int light; // raw 12-bit ADC
+    bool valid; // false until the first successful read
+};
+
+#define SAMPLE_MSG_MAX 128 // longest message is ~90 bytes (UTF-8 degree signs)
+
+// Photoresistor mapping
+const int lightMin = 0;
+const int lightMax = 4095;
+
+const int desiredMin = 0;
+const int desiredMax = 100;
+
+int light_percent(int raw);
+float celsius_to_fahrenheit(float c);
+
+// "Temperature: 21.50°C / 70.70°F, Low Moisture: 40.00%, Light: 75% (120 lx)"
+// Returns the length written (snprintf semantics, truncated to len - 1)
+size_t sample_message(const SensorData &s, int dry, int shade, char *buf, size_t len);
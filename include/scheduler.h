@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Small fixed-size min-heap scheduler for the periodic jobs in loop().
+// Time is passed in by the caller (millis() on the device, a virtual clock
+// in host tests), and all deadline comparisons are done on the signed
+// difference so the 49.7 day millis() wrap is harmless.
+
+#define SCHED_MAX_JOBS 12
+
+typedef void (*JobFn)();
+
+struct Job {
+    const char *name;
+    JobFn fn;
+    uint32_t period; // ms between runs, 0 = one-shot
+    uint32_t deadline; // next time the job is due
+    uint32_t runs;
+    uint32_t skipped; // periods dropped because the job fell behind
+    bool active;
+};
+
+// true if time a is before time b, valid as long as they are < 2^31 ms apart
+inline bool sched_before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+class Scheduler {
+public:
+    Scheduler();
+
+    // Returns the job id, or -1 if the table is full
+    int add(const char *name, JobFn fn, uint32_t period, uint32_t first_delay, uint32_t now);
+    void set_period(int id, uint32_t period, uint32_t now);
+    void run_at(int id, uint32_t deadline); // (re)arm a job for a specific time
+    void cancel(int id);
+
+    // Runs every job that is due at `now`, returns ms until the next deadline
+    // (0 if something is already due again, UINT32_MAX if nothing is armed)
+    uint32_t run_due(uint32_t now);
+    uint32_t time_until_next(uint32_t now) const;
+
+    const Job &job(int id) const { return jobs[id]; }
+    size_t size() const { return job_count; }
+
+private:
+    Job jobs[SCHED_MAX_JOBS];
+    uint8_t heap[SCHED_MAX_JOBS]; // job ids ordered by deadline
+    uint8_t heap_pos[SCHED_MAX_JOBS]; // position of each job in heap, 0xFF if not queued
+    size_t job_count;
+    size_t heap_count;
+
+    bool heap_less(size_t i, size_t j) const;
+    void heap_swap(size_t i, size_t j);
+    void sift_up(size_t i);
+    void sift_down(size_t i);
+    void heap_push(uint8_t id);
+    void heap_remove(uint8_t id);
+};
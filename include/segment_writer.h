@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+class WiFiClient;
+
+// Collects small writes (a request line, headers, serializeJson()'s output a
+// few bytes at a time) and hands them to the client one full TCP segment at a
+// time, so nothing is built up in a second buffer and no segment goes out
+// half empty. It has the write() pair ArduinoJson's custom writers need.
+
+#define TCP_SEGMENT 1436 // lwIP's TCP_MSS on the ESP32
+
+class SegmentWriter {
+public:
+    explicit SegmentWriter(WiFiClient &c) : client(c), used(0), total(0), segments(0), failed(false) {}
+
+    size_t write(uint8_t b) { return write(&b, 1); }
+    size_t write(const uint8_t *data, size_t n);
+    size_t print(const char *s);
+    bool flush(); // sends the partial segment; false if any write came up short
+
+    size_t written() const { return total; } // accepted so far, buffered or sent
+    uint32_t sent_segments() const { return segments; }
+    bool ok() const { return !failed; }
+
+private:
+    bool send(const uint8_t *data, size_t n);
+
+    WiFiClient &client;
+    uint8_t buf[TCP_SEGMENT];
+    size_t used;
+    size_t total;
+    uint32_t segments;
+    bool failed;
+};
+
+// The same for a response whose length isn't known up front: HTTP/1.1
+// chunked encoding, one chunk per TCP segment. The chunk's size line and
+// trailing CRLF are written around the payload in the one buffer, so each
+// chunk is still a single client.write(); head() puts the status line and
+// headers in front of the first chunk, and a response that fits one segment
+// goes out, terminating chunk included, in one write.
+
+#define CHUNK_SIZE_LINE 6 // "05A0\r\n", the size in 4 hex digits
+#define CHUNK_TAIL 7 // "\r\n" after the data, "0\r\n\r\n" after the last
+
+class ChunkedWriter {
+public:
+    explicit ChunkedWriter(WiFiClient &c)
+        : client(c), chunk_at(0), used(CHUNK_SIZE_LINE), total(0), segments(0), failed(false) {}
+
+    bool head(const char *s); // before any write(); false if it can't fit the first segment
+    size_t write(uint8_t b) { return write(&b, 1); }
+    size_t write(const uint8_t *data, size_t n);
+    size_t print(const char *s);
+    bool finish(); // the last chunk and the terminating empty one
+
+    size_t written() const { return total; } // payload accepted, not counting framing
+    uint32_t sent_segments() const { return segments; }
+    bool ok() const { return !failed; }
+
+private:
+    bool send(bool last);
+
+    WiFiClient &client;
+    uint8_t buf[TCP_SEGMENT];
+    size_t chunk_at; // where this segment's size line goes, after head()'s bytes
+    size_t used;
+    size_t total;
+    uint32_t segments;
+    bool failed;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "sample.h"
+
+// Sensor drivers bound at compile time. A driver derives from
+// SensorDriver<itself> and provides
+//
+//   bool begin();               true if the part answers
+//   bool start();               trigger a conversion, true if it was accepted
+//   bool busy();                the conversion is still running
+//   bool fetch(SensorData &s);  read it into the fields of s this part owns
+//
+// and inherits poll(), the pipelined read the sampling loop uses: collect
+// the conversion a previous poll() started, then start the next, so a call
+// never waits one out. A part with nothing to wait for (an ADC pin) says
+// busy() == false and is read on every poll().
+//
+// SensorPipeline<Climate, Light> is what one plant is read through. All of
+// it is templates over concrete types: no virtual calls, every poll()
+// inlines down to the driver's bus transfers, and a new part is one more
+// class in sensor_drivers.h (or a mock in a test) with no cost to the
+// others.
+
+enum SensorPoll {
+    SENSOR_IDLE, // nothing new yet, a conversion is still running
+    SENSOR_FRESH, // s was updated
+    SENSOR_ERROR, // the part didn't answer or the reading was bad
+};
+
+template <typename Derived>
+class SensorDriver {
+public:
+    SensorPoll poll(SensorData &s)
+    {
+        if (!pending && !(pending = self().start()))
+            return SENSOR_ERROR;
+        if (self().busy())
+            return SENSOR_IDLE;
+        bool ok = self().fetch(s);
+        pending = self().start(); // runs until the next poll()
+        return ok ? SENSOR_FRESH : SENSOR_ERROR;
+    }
+
+    // the bus was pointed elsewhere mid-conversion, start over next time
+    void abandon() { pending = false; }
+    bool converting() const { return pending; }
+
+private:
+    Derived &self() { return static_cast<Derived &>(*this); }
+
+    bool pending = false;
+};
+
+// temp/moisture from Climate, light from Light; valid once Climate has
+// produced a reading
+template <typename Climate, typename Light>
+struct SensorPipeline {
+    Climate climate;
+    Light light;
+
+    bool begin()
+    {
+        light.begin();
+        return climate.begin();
+    }
+
+    SensorPoll poll(SensorData &s)
+    {
+        light.poll(s);
+        SensorPoll r = climate.poll(s);
+        if (r == SENSOR_FRESH)
+            s.valid = true;
+        return r;
+    }
+};
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <Arduino.h>
+#include "i2c_bus.h"
+#include "sensor_driver.h"
+
+// The parts on the board, see sensor_driver.h for the interface.
+
+#define DHT20_ADDR 0x38
+#define DHT20_CONVERSION_MS 80
+#define DHT20_STATUS_BUSY 0x80
+#define DHT20_STATUS_READY 0x18 // both set once the sensor is initialized
+
+// DHT20 (AHT20 inside): temperature and RH. Spoken to directly rather than
+// through the Arduino library, whose every trigger and poll costs an extra
+// status read and a delay(1): here a sample is one 3-byte trigger and one
+// 7-byte read, and the status byte that read starts with does the job of
+// the separate status polls. Only talks to whatever 0x38 the bus reaches,
+// so muxing is the caller's job.
+class Dht20Climate : public SensorDriver<Dht20Climate> {
+public:
+    bool begin()
+    {
+        uint8_t status;
+        if (i2c_write(DHT20_ADDR, nullptr, 0) != I2C_OK || i2c_read(DHT20_ADDR, &status, 1) != I2C_OK)
+            return false;
+        reinit = (status & DHT20_STATUS_READY) != DHT20_STATUS_READY;
+        return true;
+    }
+
+    bool start()
+    {
+        static const uint8_t trigger[] = {0xAC, 0x33, 0x00};
+        if (reinit)
+            reinit = !init_registers();
+        if (i2c_write(DHT20_ADDR, trigger, sizeof(trigger)) != I2C_OK)
+            return false;
+        started = millis();
+        return true;
+    }
+
+    // from the clock, no bus traffic; fetch() checks the sensor agrees
+    bool busy() { return millis() - started < DHT20_CONVERSION_MS; }
+
+    bool fetch(SensorData &s)
+    {
+        uint8_t b[7];
+        if (i2c_read(DHT20_ADDR, b, sizeof(b)) != I2C_OK)
+            return false;
+        if (b[0] & DHT20_STATUS_BUSY) {
+            i2c_count(I2C_NOT_READY);
+            return false;
+        }
+        if ((b[0] & DHT20_STATUS_READY) != DHT20_STATUS_READY) {
+            reinit = true; // lost its calibration state (brown-out), redo it before the next trigger
+            i2c_count(I2C_NOT_READY);
+            return false;
+        }
+        if (crc8(b, 6) != b[6]) {
+            i2c_count(I2C_CRC);
+            return false;
+        }
+        uint32_t h = ((uint32_t)b[1] << 12) | ((uint32_t)b[2] << 4) | (b[3] >> 4);
+        uint32_t t = ((uint32_t)(b[3] & 0x0F) << 16) | ((uint32_t)b[4] << 8) | b[5];
+        s.moisture = h * (100.0f / 1048576.0f);
+        s.temp = t * (200.0f / 1048576.0f) - 50.0f;
+        return true;
+    }
+
+private:
+    static uint8_t crc8(const uint8_t *p, int len) // poly 0x31, init 0xFF
+    {
+        uint8_t crc = 0xFF;
+        while (len--) {
+            crc ^= *p++;
+            for (int i = 0; i < 8; i++)
+                crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+        }
+        return crc;
+    }
+
+    // Datasheet 7.4 step 1, done the way the vendor's demo code does it:
+    // read 0x1B, 0x1C and 0x1E back and write them to 0xB0 | reg. Blocks
+    // ~60 ms, but only after power-up or a brown-out of the sensor.
+    static bool init_registers()
+    {
+        static const uint8_t regs[] = {0x1B, 0x1C, 0x1E};
+        for (uint8_t reg : regs) {
+            uint8_t cmd[3] = {reg, 0x00, 0x00};
+            uint8_t v[3];
+            if (i2c_write(DHT20_ADDR, cmd, sizeof(cmd)) != I2C_OK)
+                return false;
+            delay(5);
+            if (i2c_read(DHT20_ADDR, v, sizeof(v)) != I2C_OK)
+                return false;
+            delay(10);
+            uint8_t back[3] = {(uint8_t)(0xB0 | reg), v[1], v[2]};
+            if (i2c_write(DHT20_ADDR, back, sizeof(back)) != I2C_OK)
+                return false;
+            delay(5);
+        }
+        return true;
+    }
+
+    uint32_t started = 0;
+    bool reinit = false;
+};
+
+// Photoresistor divider on an ADC1 pin, raw 12-bit
+class AdcLight : public SensorDriver<AdcLight> {
+public:
+    uint8_t pin = 0;
+
+    bool begin()
+    {
+        pinMode(pin, INPUT);
+        return true;
+    }
+    bool start() { return true; }
+    bool busy() { return false; }
+
+    bool fetch(SensorData &s)
+    {
+        s.light = analogRead(pin);
+        return true;
+    }
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <ArduinoJson.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Bump allocator over a fixed array, for JsonDocuments that are rebuilt on
+// every use: clear() the document, reset() the pool, fill it again. Nothing
+// touches the heap, and running out shows up as doc.overflowed().
+
+template <size_t N>
+class StaticPool : public ArduinoJson::Allocator {
+public:
+    StaticPool() : top(0), last(nullptr), high_water(0) {}
+
+    void *allocate(size_t size) override
+    {
+        size_t need = header + align(size);
+        if (need > N - top)
+            return nullptr;
+        uint8_t *block = storage + top;
+        *(size_t *)block = size;
+        top += need;
+        if (top > high_water)
+            high_water = top;
+        last = block + header;
+        return last;
+    }
+
+    void deallocate(void *ptr) override
+    {
+        // only the most recent block can actually be given back
+        if (ptr != nullptr && ptr == last) {
+            top = (uint8_t *)ptr - header - storage;
+            last = nullptr;
+        }
+    }
+
+    void *reallocate(void *ptr, size_t size) override
+    {
+        if (ptr == nullptr)
+            return allocate(size);
+        size_t old_size = *(size_t *)((uint8_t *)ptr - header);
+        if (ptr == last) {
+            // grow/shrink in place at the top of the pool
+            size_t start = (uint8_t *)ptr - storage;
+            if (align(size) > N - start)
+                return nullptr;
+            *(size_t *)((uint8_t *)ptr - header) = size;
+            top = start + align(size);
+            if (top > high_water)
+                high_water = top;
+            return ptr;
+        }
+        void *fresh = allocate(size);
+        if (fresh != nullptr)
+            memcpy(fresh, ptr, old_size < size ? old_size : size);
+        return fresh;
+    }
+
+    void reset()
+    {
+        top = 0;
+        last = nullptr;
+    }
+
+    size_t used() const { return top; }
+    size_t peak() const { return high_water; }
+    size_t capacity() const { return N; }
+
+private:
+    static const size_t header = 8; // size of the block, keeps the payload 8-byte aligned
+    static size_t align(size_t n) { return (n + 7) & ~(size_t)7; }
+
+    alignas(8) uint8_t storage[N];
+    size_t top;
+    void *last;
+    size_t high_water;
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <WiFi.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/x509_crt.h"
+
+// TLS 1.2 over a WiFiClient, with mbedTLS driven directly rather than
+// through WiFiClientSecure: that one can't hand a session from one
+// connection to the next, so every reconnect would pay the full handshake
+// (certificate chain verify and ECDHE, a couple of hundred ms of CPU on
+// the ESP32, plus a second round trip).
+//
+// Here the session from the last full handshake is kept and offered again
+// on connect(). A server that still holds it (session ticket or session
+// ID) answers with the abbreviated handshake: one round trip, no public
+// key operations. The server's certificate must chain to the one CA given
+// to begin(); the host passed to connect() must match its name.
+//
+// It is a WiFiClient, so SegmentWriter and http_read_response() work on it
+// unchanged; available()/read() hand out decrypted bytes. The mbedTLS
+// contexts and their record buffers are set up once in begin(), called from
+// setup() (transport_setup()), and reused for every connection. A handshake
+// still allocates inside mbedTLS: the ECDHE keys and handshake state, freed
+// once it is done, and the session (with the server's certificate) kept for
+// the next connection.
+
+#define TLS_HANDSHAKE_TIMEOUT 10000 // ms, both round trips
+
+extern const char TLS_CA_PEM[]; // src/tls_ca.cpp, from flask/certs/ca.pem by scripts/tls_ca.py
+
+struct TlsStats {
+    uint32_t handshakes; // full ones
+    uint32_t resumed; // abbreviated, a saved session accepted
+    uint32_t failures; // TCP refused, handshake or certificate check failed
+    uint64_t handshake_us; // connect() to established, both kinds
+    uint32_t handshake_max_us;
+    int last_error; // mbedTLS code of the last failure
+};
+
+class TlsClient : public WiFiClient {
+public:
+    TlsClient();
+    ~TlsClient() override;
+    TlsClient(const TlsClient &) = delete;
+    TlsClient &operator=(const TlsClient &) = delete;
+
+    bool begin(const char *ca_pem); // once; false if the CA doesn't parse
+
+    // TCP connect and handshake, resuming the saved session if there is one
+    int connect(const char *host, uint16_t port) override;
+    int connect(IPAddress, uint16_t) override { return 0; } // needs a name to check the certificate against
+
+    size_t write(uint8_t b) override { return write(&b, 1); }
+    size_t write(const uint8_t *buf, size_t size) override;
+    int available() override;
+    int read() override;
+    int read(uint8_t *buf, size_t size) override;
+    int peek() override;
+    void flush() override {}
+    uint8_t connected() override;
+    void stop() override; // close_notify; the session is kept for next time
+
+    bool resumed() const { return was_resumed; } // the last handshake was abbreviated
+    void forget_session();
+    const TlsStats &stats() const { return st; }
+
+private:
+    static int bio_send(void *ctx, const unsigned char *buf, size_t len);
+    static int bio_recv(void *ctx, unsigned char *buf, size_t len);
+    int handshake();
+    void drop(int err);
+
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_config conf;
+    mbedtls_x509_crt ca;
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_ssl_session session; // from the last handshake, offered on the next
+    bool have_session = false;
+    bool ready = false; // begin() succeeded
+    bool up = false; // handshake done, not closed
+    bool was_resumed = false;
+    int peeked = -1; // a byte available() had to decrypt to know there was one
+    TlsStats st = {};
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// How the uplink document (uplink.h) gets to the server, picked by
+// config.transport:
+//
+//   TRANSPORT_HTTP: POST /submit on a fresh connection each time, the
+//     server's answer in the response body. Works with flask/server.py alone.
+//   TRANSPORT_MQTT: PUBLISH to plant/<id>/up over a session kept open
+//     between uplinks (mqtt.h), at config.mqtt_qos. The server's answers
+//     come back on plant/<id>/down whenever it has one, which also lets it
+//     push a config change without waiting to be asked. Needs a broker on
+//     server_address:mqtt_port and flask/mqtt_bridge.py.
+//   TRANSPORT_HTTPS: the same POST /submit, over TLS to
+//     server_address:tls_port (tls_client.h) on a keep-alive connection.
+//     Between uplinks the connection stays open, so a sample pays only for
+//     its records' AES-GCM; once it has been idle TLS_IDLE_CLOSE_MS, or the
+//     server has closed it, the next uplink reconnects and resumes the
+//     session rather than running the full handshake again. Needs
+//     flask/tls_proxy.py (or any TLS front end) with a certificate from
+//     flask/make_certs.sh. transport_setup() sets the TLS client up at boot,
+//     but every handshake still allocates inside mbedTLS (the server's
+//     certificate chain, ECDHE, the session kept for resuming), so
+//     -DSS_STATIC_HEAP builds, which allocate nothing after setup(), leave
+//     it out (transport_available()).
+//
+// QoS 1 counts as delivered at the broker's PUBACK; QoS 0 as soon as the
+// bytes are written, so a sample lost in a session drop is gone for good
+// rather than queued (uplink_queue()) and retried.
+
+enum TransportKind {
+    TRANSPORT_HTTP,
+    TRANSPORT_MQTT,
+    TRANSPORT_HTTPS,
+    TRANSPORTS
+};
+
+#define TRANSPORT_POLL_PERIOD 100 // ms, keep-alive and pushes between uplinks
+#define MQTT_DEFAULT_PORT 1883
+#define TLS_DEFAULT_PORT 8443
+#define TLS_IDLE_CLOSE_MS 70000 // ms; over a 60 s aggregate window, under nginx's 75 s keep-alive
+
+struct Transport {
+    const char *name;
+    // uplink_document(), body_len bytes serialized, to the server; true once
+    // it counts as delivered
+    bool (*send)(size_t body_len);
+    void (*poll)(uint32_t now);
+    void (*stop)(); // closes anything held open, when config.transport changes
+};
+
+struct TransportStats {
+    uint32_t sends;
+    uint32_t delivered;
+    uint32_t replies; // server answers handed to the reply callback
+    uint64_t busy_us; // inside send(), i.e. loop() held up
+    uint32_t busy_max_us;
+};
+
+// What the server says back, config deltas and raw requests, for
+// uplink_handle_response()
+typedef void (*TransportReplyFn)(const char *body, size_t len);
+void transport_on_reply(TransportReplyFn fn);
+void transport_setup(); // from setup(), allocates what the transports keep
+bool transport_available(uint8_t kind); // in this build, what config_validate() takes
+
+bool transport_send(size_t body_len); // through config.transport's
+void transport_poll(uint32_t now); // the job, every TRANSPORT_POLL_PERIOD
+const Transport &transport_current();
+const char *transport_name(uint8_t kind);
+const TransportStats &transport_stats();
+void transport_stats_reset();
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "input.h"
+#include "plants.h"
+#include "sample.h"
+
+class TFT_eSPI;
+
+// Multi-page display. loop() publishes a snapshot of what there is to show;
+// a UI task of its own, above loop() in priority, waits on the input queue
+// and draws. A button press therefore gets a new page within one frame even
+// while loop() is in the middle of an uplink, and the TFT is only ever touched
+// from that one task.
+
+#define UI_TASK_STACK 4096 // bytes
+#define UI_TASK_PRIORITY 2 // loop() runs at 1
+#define UI_TASK_CORE 1 // with loop(), WiFi keeps core 0
+
+enum UiPage {
+    UI_PAGE_LIVE, // the original single screen
+    UI_PAGE_HISTORY, // stored drying periods
+    UI_PAGE_COUNTDOWN, // where the countdown comes from, or every plant's
+    UI_PAGE_STATUS, // network and diagnostics
+    UI_PAGES
+};
+
+struct UiSnapshot {
+    SensorData sensor; // plant 0, as are the countdown fields below
+    int16_t dry, shade;
+
+    bool predicted;
+    float days_left;
+    uint32_t since_watered_ms;
+    uint32_t periods[CONFIG_PERIODS_MAX]; // oldest first
+    size_t period_count;
+    uint8_t plant_count;
+    bool plant_predicted[PLANTS_MAX];
+    float plant_days_left[PLANTS_MAX];
+
+    bool wifi_up;
+    int8_t rssi;
+    uint32_t ip;
+    uint8_t breaker; // BreakerState
+    uint32_t queued, queue_dropped;
+    uint32_t heap_free, heap_largest;
+    uint32_t uptime_s;
+    uint32_t config_rev;
+};
+
+struct UiStats {
+    uint32_t frames;
+    uint32_t last_frame_us; // drawing time of the last frame
+    uint32_t max_frame_us;
+    uint32_t max_input_us; // button press -> page drawn
+};
+
+void ui_setup(TFT_eSPI &tft); // starts the UI task
+void ui_publish(const UiSnapshot &s); // from loop(); drawn on the next event
+void ui_handle(const InputEvent &ev); // what the task does with each event
+UiPage ui_page();
+const UiStats &ui_stats();
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <ArduinoJson.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "aggregate.h"
+#include "sample.h"
+
+// The /submit request body: the sample text and/or a closed aggregation
+// window (see aggregate.h), plus whichever periodic reports
+// (power/heap, boot phases, latency histograms) are due. The document lives
+// on a static pool that is reset per request and reused for the response, so
+// none of this touches the heap. It is never serialized into a buffer of its
+// own: uplink_build() measures it for the Content-Length, and the caller
+// streams it into the connection with serializeJson(uplink_document(), w).
+//
+// Samples and windows that couldn't be sent wait in a fixed ring and ride
+// along, oldest first, as a "backlog" batch with each request that does go
+// out.
+//
+// By default only window summaries go up. The server can ask for raw
+// samples of one plant for a while ({"raw_s": 300, "raw_plant": 2} in a
+// response) when it wants to look closely; those are sent every
+// uplink_period alongside the windows. Anything from a plant other than
+// plant 0 carries "plant": n.
+
+#define UPLINK_POOL_SIZE 16384 // JsonDocument storage, request and response; a batch of windows is ~250 values
+#define UPLINK_BODY_MAX 4096 // serialized request, bigger means something has gone wrong
+#define UPLINK_RESPONSE_MAX 1024 // what the server says back, a config delta at most
+#define POWER_REPORT_PERIOD 60000 // power/heap totals ride along with one uplink a minute
+#define UPLINK_QUEUE_MAX 120 // samples/windows held while the server is unreachable, oldest dropped first
+#define UPLINK_BATCH_MAX 10 // queued entries per request, so catching up is gradual
+#define UPLINK_RAW_MAX 3600 // s, longest raw burst the server can ask for
+
+// Fills the document and returns its serialized length, or 0 if it overflowed
+// the pool or would be longer than UPLINK_BODY_MAX. Either of send_val and
+// window may be null.
+size_t uplink_build(const char *send_val, const WindowStats *window, uint32_t now);
+const JsonDocument &uplink_document(); // as uplink_build() left it
+void uplink_delivered(); // server answered 200: the boot report and the batch are done
+
+// Holds on to a sample or a closed window that couldn't be sent
+void uplink_queue(const SensorData &s, uint32_t now, uint8_t plant = 0);
+void uplink_queue_window(const WindowStats &w, uint32_t now);
+size_t uplink_queued();
+uint32_t uplink_queue_dropped(); // pushed out of a full queue, since boot
+
+enum UplinkResponse {
+    UPLINK_RESP_NONE, // plain "Data received", or nothing we understand
+    UPLINK_RESP_APPLIED, // config delta applied
+    UPLINK_RESP_REJECTED, // config delta failed validation
+};
+
+// {"config_rev": n, "config": {...}} when the server has newer settings for
+// us, {"raw_s": n} when it wants raw samples for the next n seconds
+UplinkResponse uplink_handle_response(const char *body, size_t len, uint32_t now);
+bool uplink_raw(uint32_t now); // a raw burst is running
+uint8_t uplink_raw_plant(); // ... of this plant
+
+size_t uplink_pool_peak();
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+
+// WiFi connection manager
+// Credentials come from NVS (written by wifisetup/set_ssid.cpp). After every
+// successful association the AP's BSSID/channel and the DHCP lease are cached
+// next to them, so the following boots/reconnects can skip the scan and DHCP.
+// The cached IP is only a head start: nothing tells us how long the board
+// was off, so WIFI_LEASE_CHECK_DELAY after a fast connect DHCP is run on the
+// live link, and from then on the DHCP client keeps the lease current.
+
+enum WifiState {
+    WIFI_STATE_IDLE,
+    WIFI_STATE_FAST_CONNECT, // cached BSSID + channel + static IP
+    WIFI_STATE_SCAN_CONNECT, // full scan + DHCP
+    WIFI_STATE_CONNECTED,
+    WIFI_STATE_DHCP, // fast connected, replacing the cached lease with a fresh one
+    WIFI_STATE_BACKOFF
+};
+
+#define WIFI_FAST_CONNECT_TIMEOUT 1500 // ms to wait on the cached AP before scanning
+#define WIFI_SCAN_CONNECT_TIMEOUT 15000 // ms to wait on a full scan connect
+#define WIFI_LEASE_CHECK_DELAY 10000 // ms on the cached IP before DHCP confirms it
+#define WIFI_DHCP_TIMEOUT 10000 // ms to wait on that DHCP before scanning
+#define WIFI_BACKOFF_MIN 1000 // ms
+#define WIFI_BACKOFF_MAX 60000 // ms
+
+void nvs_access();
+void wifi_setup();
+void wifi_loop(); // non-blocking, call every loop() iteration
+bool wifi_connected();
+WifiState wifi_state();
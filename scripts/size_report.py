@@ -0,0 +1,94 @@
+# PlatformIO post script: link with a map file and print where flash and RAM go.
+#
+#   pio run -e esp32dev          # report printed after every link
+#   pio run -e esp32dev_static   # same, with SS_STATIC_HEAP buffers counted
+
+import os
+import re
+
+Import("env")  # noqa: F821
+
+MAP = os.path.join(env.subst("$BUILD_DIR"), "firmware.map")  # noqa: F821
+TOP_SYMBOLS = 15
+
+env.Append(LINKFLAGS=["-Wl,-Map," + MAP])  # noqa: F821
+
+# output sections we care about, grouped the way the ESP32 memory map is
+GROUPS = {
+    "flash code": (".flash.text",),
+    "flash rodata": (".flash.rodata", ".flash.appdesc"),
+    "iram": (".iram0.text", ".iram0.vectors"),
+    "dram data": (".dram0.data",),
+    "dram bss": (".dram0.bss",),
+}
+
+SECTION_RE = re.compile(r"^(\.\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)")
+INPUT_RE = re.compile(r"^ (\.\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S+)")
+INPUT_NAME_RE = re.compile(r"^ (\.\S+)$")
+INPUT_CONT_RE = re.compile(r"^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S+)")
+
+
+def parse_map(path):
+    sections = {}
+    symbols = []  # (size, output section, input section, object)
+    current = None
+    pending = None
+    with open(path, errors="replace") as f:
+        for line in f:
+            m = SECTION_RE.match(line)
+            if m:
+                current = m.group(1)
+                sections[current] = int(m.group(3), 16)
+                pending = None
+                continue
+            if current is None:
+                continue
+            m = INPUT_RE.match(line)
+            if m:
+                size = int(m.group(3), 16)
+                if size:
+                    symbols.append((size, current, m.group(1), m.group(4)))
+                pending = None
+                continue
+            # long input section names wrap onto the next line
+            m = INPUT_NAME_RE.match(line)
+            if m:
+                pending = m.group(1)
+                continue
+            if pending:
+                m = INPUT_CONT_RE.match(line)
+                if m:
+                    size = int(m.group(2), 16)
+                    if size:
+                        symbols.append((size, current, pending, m.group(3)))
+                pending = None
+    return sections, symbols
+
+
+def short_object(path):
+    # libfoo.a(bar.o) -> libfoo.a(bar.o), .../src/main.cpp.o -> main.cpp.o
+    return os.path.basename(path)
+
+
+def size_report(source, target, env):
+    if not os.path.exists(MAP):
+        print("size_report: no map file at %s" % MAP)
+        return
+    sections, symbols = parse_map(MAP)
+
+    print("\n=== Size report (%s) ===" % env.subst("$PIOENV"))
+    for group, names in GROUPS.items():
+        total = sum(sections.get(n, 0) for n in names)
+        print("  %-14s %8d" % (group, total))
+
+    wanted = {n for names in GROUPS.values() for n in names}
+    ram = {".dram0.data", ".dram0.bss"}
+    for title, filt in (("RAM", lambda s: s[1] in ram),
+                        ("flash", lambda s: s[1] in wanted and s[1] not in ram)):
+        print("  top %d %s:" % (TOP_SYMBOLS, title))
+        for size, _, name, obj in sorted(filter(filt, symbols), reverse=True)[:TOP_SYMBOLS]:
+            print("    %7d  %-40s %s" % (size, name[-40:], short_object(obj)))
+    print()
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", size_report)  # noqa: F821
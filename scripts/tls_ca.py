@@ -0,0 +1,48 @@
+# PlatformIO pre script: compiles the deployment's CA into the firmware.
+#
+#   sh flask/make_certs.sh 3.149.230.7   # once, makes flask/certs/ca.pem
+#   pio run -e esp32dev                  # writes src/tls_ca.cpp from it
+#
+# The CA belongs to whoever runs the server, not to the repo: src/tls_ca.cpp
+# is ignored by git, and without flask/certs/ca.pem the build stops here
+# rather than ship a board that trusts someone else's CA.
+
+import os
+import sys
+
+Import("env")  # noqa: F821
+
+PEM = os.path.join(env.subst("$PROJECT_DIR"), "flask", "certs", "ca.pem")  # noqa: F821
+OUT = os.path.join(env.subst("$PROJECT_SRC_DIR"), "tls_ca.cpp")  # noqa: F821
+
+if not os.path.isfile(PEM):
+    sys.stderr.write(
+        "Error: %s not found. The HTTPS uplink trusts only the CA that\n"
+        "flask/make_certs.sh makes; run  sh flask/make_certs.sh <server address>\n"
+        "first (flask/setup.txt, HTTPS step 1), then build again.\n" % PEM
+    )
+    env.Exit(1)  # noqa: F821
+
+with open(PEM) as f:
+    pem = [line.strip() for line in f if line.strip()]
+
+text = "\n".join(
+    [
+        '#include "tls_client.h"',
+        "",
+        "// Written by scripts/tls_ca.py from flask/certs/ca.pem, the only CA the uplink trusts",
+        "const char TLS_CA_PEM[] =",
+    ]
+    + ['    "%s\\n"' % line for line in pem]
+    + ["    ;", ""]
+)
+
+# only rewritten when the CA changes, so builds stay incremental
+old = None
+if os.path.isfile(OUT):
+    with open(OUT) as f:
+        old = f.read()
+if old != text:
+    with open(OUT, "w") as f:
+        f.write(text)
+    print("tls_ca.py: %s written from %s" % (OUT, PEM))
@@ -0,0 +1,821 @@
+// Whole-device simulator: the real setup()/loop() from src/main.cpp against
+// the fakes in test/fakes, a plant that dries out and gets watered, a WiFi
+// link with optional outages and an in-process stand-in for flask/server.py.
+// Everything runs on the virtual clock, so weeks take seconds.
+//
+//   pio run -e sim && .pio/build/sim/program --days 30
+//   .pio/build/sim/program --days 30 --config '{"uplink_period": 60000}'
+//   .pio/build/sim/program --days 1 --fault drip
+//   .pio/build/sim/program --days 1 --bench     (every fault profile, one row each)
+//   .pio/build/sim/program --days 1 --transport mqtt1
+//   .pio/build/sim/program --days 1 --bench-transport   (http / mqtt QoS 0 / QoS 1 / https)
+
+#include <fakes.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "breaker.h"
+#include "config.h"
+#include "deadband.h"
+#include "i2c_bus.h"
+#include "latency.h"
+#include "local_server.h"
+#include "mqtt.h"
+#include "ota.h"
+#include "plants.h"
+#include "power_stats.h"
+#include "prediction.h"
+#include "scheduler.h"
+#include "tls_client.h"
+#include "transport.h"
+#include "uplink.h"
+
+// firmware entry points and state, from main.cpp
+void setup();
+void loop();
+extern Scheduler scheduler;
+extern Breaker uplink_breaker;
+extern int sensor_job_id, uplink_job_id;
+
+#define HOUR_US (3600ULL * 1000000)
+#define DAY_US (24 * HOUR_US)
+
+// env:sim links with --wrap for malloc, calloc and realloc, which catches the
+// calls made from src/ and from ArduinoJson's default allocator but not the
+// fakes' containers (operator new, inside libstdc++). Once setup() is done
+// the firmware is meant to allocate nothing.
+extern "C" void *__real_malloc(size_t size);
+extern "C" void *__real_calloc(size_t n, size_t size);
+extern "C" void *__real_realloc(void *ptr, size_t size);
+
+static bool heap_counting;
+static uint64_t heap_allocs;
+
+extern "C" void *__wrap_malloc(size_t size)
+{
+    heap_allocs += heap_counting;
+    return __real_malloc(size);
+}
+
+extern "C" void *__wrap_calloc(size_t n, size_t size)
+{
+    heap_allocs += heap_counting;
+    return __real_calloc(n, size);
+}
+
+extern "C" void *__wrap_realloc(void *ptr, size_t size)
+{
+    heap_allocs += heap_counting;
+    return __real_realloc(ptr, size);
+}
+
+struct Options {
+    double days = 30;
+    uint32_t seed = 1;
+    double drying_days = 4; // mean, each cycle is +-20%
+    double saturated_h = 6; // RH reads saturated (the DHT20's top code) this long after watering
+    double water_delay_h = 12; // owner waters this long after the plant is dry
+    double outage_every_h = 0; // 0 = the link never drops
+    double outage_min = 10;
+    uint32_t latency_ms = 5; // server response time
+    uint32_t plants = 1; // more than one sit behind muxes, 8 a shelf, all watered together
+    double local_every_s = 10; // a LAN dashboard reads /recent.json this often, 0 = none
+    const char *config = nullptr; // fleet config the server pushes
+    const char *fault = "none"; // fault profile on /submit, see below
+    const char *transport = "http"; // http, mqtt0 or mqtt1 (QoS), https, https-full (no resumption)
+    bool bench = false; // run every fault profile and tabulate
+    bool bench_transport = false; // run every transport and tabulate
+    bool verbose = false;
+};
+
+static Options opt;
+
+// ---- fault profiles -----------------------------------------------------
+
+// Same names and numbers as flask/fault_server.py, so a bench run here and
+// one against real hardware can be compared row for row
+struct FaultProfile {
+    const char *name;
+    uint32_t latency_ms; // request sent -> first response byte
+    double loss; // request lost on the way, never answered
+    double reset; // connection reset instead of an answer
+    uint32_t drip_ms; // response trickles out a byte at a time
+    uint32_t burst_every_s, burst_s; // 503 for burst_s of every burst_every_s
+    uint32_t down_every_s, down_s; // server refuses connections down_s of every down_every_s
+};
+
+static const FaultProfile fault_profiles[] = {
+    {"none", 5, 0, 0, 0, 0, 0, 0, 0},
+    {"latency", 2000, 0, 0, 0, 0, 0, 0, 0},
+    {"loss", 5, 0.2, 0, 0, 0, 0, 0, 0},
+    {"reset", 5, 0, 0.2, 0, 0, 0, 0, 0},
+    {"drip", 5, 0, 0, 200, 0, 0, 0, 0},
+    {"5xx", 5, 0, 0, 0, 100, 20, 0, 0},
+    {"down", 5, 0, 0, 0, 0, 0, 1800, 300},
+    {"flaky", 500, 0.05, 0.05, 20, 600, 30, 0, 0},
+};
+
+#define FAULT_PROFILES (sizeof(fault_profiles) / sizeof(fault_profiles[0]))
+
+static const FaultProfile *fault = &fault_profiles[0];
+static uint32_t fault_rng;
+
+// ---- plant --------------------------------------------------------------
+
+struct SimPlant {
+    uint64_t watered_at;
+    uint64_t dry_at; // when RH crosses config.dry
+    double cycle_us; // watering -> dry_at
+};
+
+static SimPlant plant;
+static uint32_t plant_rng, noise_rng; // separate, so cycle lengths don't depend on how often we sample
+static uint32_t local_rng;
+
+static double rnd(uint32_t &state) // [0, 1)
+{
+    state = state * 1664525u + 1013904223u;
+    return (state >> 8) / 16777216.0;
+}
+
+static void water(uint64_t now)
+{
+    plant.watered_at = now;
+    plant.cycle_us = opt.drying_days * DAY_US * (0.8 + 0.4 * rnd(plant_rng));
+    plant.dry_at = now + (uint64_t)plant.cycle_us;
+}
+
+// RH the DHT20 sees: saturated for a while, then a straight line through
+// config.dry at dry_at, bottoming out at 20%
+static float plant_moisture(uint64_t now)
+{
+    double sat = opt.saturated_h * HOUR_US;
+    double t = (double)(now - plant.watered_at);
+    if (t < sat)
+        return 100.0f;
+    double m = 99.0 - (99.0 - config.dry) * (t - sat) / (plant.cycle_us - sat);
+    return (float)(m < 20 ? 20 : m);
+}
+
+static void update_environment(uint64_t now)
+{
+    // nothing the device can see changes faster than its 1s sensor period
+    static uint64_t last_second = UINT64_MAX;
+    if (now / 1000000 == last_second)
+        return;
+    last_second = now / 1000000;
+
+    double day_frac = fmod((double)now / DAY_US, 1.0);
+    fake_dht.temperature = 22.0f + 4.0f * (float)sin(2 * M_PI * (day_frac - 0.25));
+    fake_dht.humidity = plant_moisture(now);
+    fake_analog[33] = (day_frac > 0.25 && day_frac < 0.75) ? 3000 + (int)(500 * rnd(noise_rng)) : 150;
+    // the other shelves (see kShelfLightPins) see the same sky
+    fake_analog[32] = fake_analog[34] = fake_analog[36] = fake_analog[39] = fake_analog[33];
+    for (uint32_t i = 0; opt.plants > 1 && i < opt.plants; i++) {
+        FakeDht &d = fake_dht_mux[i / 8][i % 8];
+        d.temperature = fake_dht.temperature;
+        d.humidity = fake_dht.humidity;
+    }
+
+    if (opt.outage_every_h > 0) {
+        uint64_t period = (uint64_t)(opt.outage_every_h * HOUR_US);
+        bool down = (now % period) < (uint64_t)(opt.outage_min * 60e6);
+        fake_net.ap_up = !down;
+    }
+    if (fault->down_every_s)
+        fake_net.server_up = (now / 1000000) % fault->down_every_s >= fault->down_s;
+}
+
+// ---- stand-in server ----------------------------------------------------
+
+struct Server {
+    uint32_t submits; // reached the server
+    uint32_t stored; // samples/windows kept, i.e. not lost
+    uint32_t lost, resets, errors; // injected faults
+    uint32_t configs_sent;
+    uint64_t body_bytes;
+    uint32_t rev; // fleet config revision, 1 once --config is given
+};
+
+static Server server;
+
+// What the server keeps of one uplink body; returns the fleet config if the
+// device is behind, else ""
+static std::string accept(const std::string &body)
+{
+    // the sample or window itself plus any backlog the device had queued
+    for (const char *p = body.c_str(); (p = strstr(p, "\"send_val\":")) != nullptr; p++)
+        server.stored++;
+    for (const char *p = body.c_str(); (p = strstr(p, "\"window\":")) != nullptr; p++)
+        server.stored++;
+
+    // same rule as flask/server.py: answer with the fleet config if the device is behind
+    const char *rev = strstr(body.c_str(), "\"config_rev\":");
+    uint32_t device_rev = rev ? strtoul(rev + 13, nullptr, 10) : 0;
+    if (!opt.config || device_rev >= server.rev)
+        return "";
+    char reply[512];
+    snprintf(reply, sizeof(reply), "{\"config_rev\": %" PRIu32 ", \"config\": %s}", server.rev, opt.config);
+    server.configs_sent++;
+    return reply;
+}
+
+static FakeHttpResponse serve(const FakeHttpRequest &req)
+{
+    FakeHttpResponse resp;
+    resp.latency_ms = opt.latency_ms;
+    if (req.method != "POST" || req.path != "/submit") {
+        resp.status = 404;
+        resp.body = "Not Found";
+        return resp;
+    }
+    if (fault->loss > 0 && rnd(fault_rng) < fault->loss) {
+        server.lost++;
+        resp.drop = true;
+        return resp;
+    }
+    server.submits++;
+    server.body_bytes += req.body.size();
+    if (fault->latency_ms > resp.latency_ms)
+        resp.latency_ms = fault->latency_ms;
+    resp.drip_ms = fault->drip_ms;
+    if (fault->reset > 0 && rnd(fault_rng) < fault->reset) {
+        server.resets++;
+        resp.reset = true;
+        return resp;
+    }
+    if (fault->burst_every_s && (fake_now_us / 1000000) % fault->burst_every_s < fault->burst_s) {
+        server.errors++;
+        resp.status = 503;
+        resp.body = "Service Unavailable";
+        return resp;
+    }
+    resp.body = accept(req.body);
+    if (!resp.body.empty())
+        resp.content_type = "application/json";
+    return resp;
+}
+
+// The broker with flask/mqtt_bridge.py behind it. Loss, latency and resets
+// hit it as they hit /submit; a 5xx burst has no MQTT equivalent (the
+// broker acks whatever the bridge does with it), and "down" only refuses
+// new sessions, as a broker restart would.
+static FakeMqttAck broker(const FakeMqttPublish &pub)
+{
+    FakeMqttAck ack;
+    ack.latency_ms = fault->latency_ms > opt.latency_ms ? fault->latency_ms : opt.latency_ms;
+    if (fault->loss > 0 && rnd(fault_rng) < fault->loss) {
+        server.lost++;
+        ack.drop = true;
+        return ack;
+    }
+    server.submits++;
+    server.body_bytes += pub.payload.size();
+    if (fault->reset > 0 && rnd(fault_rng) < fault->reset) {
+        server.resets++;
+        ack.reset = true;
+        return ack;
+    }
+    // plant/<id>/up -> plant/<id>/down
+    ack.reply_topic = pub.topic.substr(0, pub.topic.rfind('/')) + "/down";
+    ack.reply = accept(pub.payload);
+    return ack;
+}
+
+// ---- measurements -------------------------------------------------------
+
+struct Stats {
+    uint64_t loops;
+    uint32_t busy_buckets[LATENCY_BUCKETS]; // per loop(), excluding its idle delay
+    uint64_t busy_max_us;
+    uint64_t busy_total_us;
+
+    uint32_t cycles; // plant dried out
+    uint32_t predicted_cycles; // ... with a countdown running
+    double abs_error_h;
+    double error_h; // signed, + = countdown said later than it was
+    uint64_t predicted_dry_at; // 0 = no countdown
+    uint32_t last_watered_seen;
+
+    uint64_t local_next_us; // next dashboard read
+    size_t local_seen; // fake_net.inbound entries already measured
+    uint32_t local_ok, local_failed;
+    uint64_t local_total_us, local_max_us; // connection made -> response complete
+    uint64_t local_bytes;
+};
+
+static Stats st;
+
+static void track_prediction(uint64_t now)
+{
+    const Prediction &prediction = plant_at(0).prediction;
+    // the device restarts its countdown on every saturated sample after watering
+    if (prediction.predicted && prediction.last_watered != st.last_watered_seen) {
+        st.last_watered_seen = prediction.last_watered;
+        st.predicted_dry_at = prediction.millis_left ? (uint64_t)prediction.last_watered * 1000 + (uint64_t)prediction.millis_left * 1000 : 0;
+    }
+    // the plant just crossed config.dry
+    if (plant.dry_at != 0 && now >= plant.dry_at) {
+        st.cycles++;
+        if (st.predicted_dry_at) {
+            double err = ((double)st.predicted_dry_at - (double)plant.dry_at) / HOUR_US;
+            st.predicted_cycles++;
+            st.error_h += err;
+            st.abs_error_h += fabs(err);
+        }
+        plant.dry_at = 0; // counted, until the next watering
+    }
+    if (plant.dry_at == 0 && now >= plant.watered_at + (uint64_t)plant.cycle_us + (uint64_t)(opt.water_delay_h * HOUR_US)) {
+        water(now);
+        st.predicted_dry_at = 0;
+    }
+}
+
+// the dashboard connects every --local-every seconds, give or take 20% so it
+// doesn't keep step with the board's own periods. Its next read is queued
+// ahead, at the time it connects, for the board to be woken by; each
+// finished response is measured and dropped so a long run doesn't hold them
+// all
+static void track_local()
+{
+    if (opt.local_every_s > 0 && fake_net.inbound_next == fake_net.inbound.size()) {
+        FakeInbound in;
+        in.request = "GET /recent.json?n=60 HTTP/1.1\r\nHost: plant.local\r\nAccept: */*\r\n\r\n";
+        in.latency_ms = 1;
+        in.connected_us = st.local_next_us;
+        fake_net.inbound.push_back(in);
+        st.local_next_us += (uint64_t)(opt.local_every_s * 1000000 * (0.8 + 0.4 * rnd(local_rng)));
+    }
+    while (st.local_seen < fake_net.inbound_next && fake_net.inbound[st.local_seen].closed) {
+        FakeInbound &in = fake_net.inbound[st.local_seen++];
+        if (in.response.compare(0, 15, "HTTP/1.1 200 OK") == 0) {
+            uint64_t us = in.closed_us - in.connected_us;
+            st.local_ok++;
+            st.local_total_us += us;
+            if (us > st.local_max_us)
+                st.local_max_us = us;
+        } else {
+            st.local_failed++;
+        }
+        st.local_bytes += in.response.size();
+        std::string().swap(in.response);
+    }
+}
+
+// stands in for the local server's accept task blocked in select(): it has
+// a connection once the dashboard's next read connects, while there's WiFi
+// for it to arrive over
+static uint64_t local_connects_at()
+{
+    if (WiFi.status() != WL_CONNECTED || fake_net.inbound_next >= fake_net.inbound.size())
+        return UINT64_MAX;
+    return fake_net.inbound[fake_net.inbound_next].connected_us;
+}
+
+static void record_loop(uint64_t busy)
+{
+    st.loops++;
+    st.busy_total_us += busy;
+    st.busy_buckets[latency_bucket(busy > UINT32_MAX ? UINT32_MAX : (uint32_t)busy)]++;
+    if (busy > st.busy_max_us)
+        st.busy_max_us = busy;
+}
+
+static uint32_t bucket_upper_us(int b)
+{
+    return b + 1 < 32 ? (1u << (b + 1)) : UINT32_MAX;
+}
+
+static uint32_t busy_percentile(double p)
+{
+    uint64_t target = (uint64_t)(p * st.loops), seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += st.busy_buckets[i];
+        if (seen > target)
+            return bucket_upper_us(i) < st.busy_max_us ? bucket_upper_us(i) : st.busy_max_us;
+    }
+    return st.busy_max_us;
+}
+
+// the device sends one window summary per aggregate_window, or with
+// aggregation off one sample per uplink_period
+static uint32_t sensor_reads()
+{
+    uint32_t n = 0;
+    for (size_t i = 0; i < plants_count(); i++)
+        n += plant_at(i).reads;
+    return n;
+}
+
+static uint64_t sensor_expected(uint64_t start_us) // per plant, every sensor_period
+{
+    return (fake_now_us - start_us) / 1000 / config.sensor_period * plants_count();
+}
+
+// windows (or samples) due from all plants
+static uint64_t uplink_periods(uint64_t start_us)
+{
+    uint32_t period = config.aggregate_window ? config.aggregate_window : config.uplink_period;
+    return (fake_now_us - start_us) / 1000 / period * plants_count();
+}
+
+static uint32_t deadband_skipped()
+{
+    uint32_t n = 0;
+    for (size_t i = 0; i < plants_count(); i++)
+        n += plant_at(i).deadband.skipped;
+    return n;
+}
+
+static double loss_percent(uint64_t start_us)
+{
+    // windows the deadband held back were never meant to arrive
+    uint64_t expected = uplink_periods(start_us), arrived = server.stored + deadband_skipped();
+    return expected > arrived ? 100.0 * (expected - arrived) / expected : 0.0;
+}
+
+static void report(uint64_t start_us)
+{
+    double days = (fake_now_us - start_us) / (double)DAY_US;
+    const Job &sensor = scheduler.job(sensor_job_id);
+    const Job &uplink = scheduler.job(uplink_job_id);
+    uint64_t expected = sensor_expected(start_us);
+    uint32_t reads = sensor_reads();
+
+    printf("simulated %.2f days, config rev %" PRIu32 ", fault profile %s\n\n", days, config.rev, fault->name);
+
+    printf("uplink\n");
+    printf("  requests          %" PRIu32 " (%.1f/day), %" PRIu32 " reached the server\n", fake_net.requests,
+           fake_net.requests / days, server.submits);
+    printf("  connects          %" PRIu32 ", %" PRIu32 " failed\n", fake_net.connects, fake_net.connect_failures);
+    printf("  bytes out         %" PRIu64 " (%.1f KB/day), body %" PRIu64 ", %.1f writes/request\n",
+           fake_net.bytes_out, fake_net.bytes_out / 1024.0 / days, server.body_bytes,
+           fake_net.requests ? (double)fake_net.writes / fake_net.requests : 0.0);
+    printf("  bytes in          %" PRIu64 "\n", fake_net.bytes_in);
+    printf("  uplink job        %" PRIu32 " runs, %" PRIu32 " periods skipped\n", uplink.runs, uplink.skipped);
+    printf("  %s stored    %" PRIu32 " of %" PRIu64 " due, %" PRIu32 " held by the deadband (%.1f%% lost)\n",
+           config.aggregate_window ? "windows" : "samples", server.stored, uplink_periods(start_us),
+           deadband_skipped(), loss_percent(start_us));
+    printf("  faults injected   %" PRIu32 " lost, %" PRIu32 " reset, %" PRIu32 " 5xx\n", server.lost, server.resets,
+           server.errors);
+    printf("  breaker trips     %" PRIu32 ", %zu queued at the end, %" PRIu32 " dropped from the queue\n",
+           uplink_breaker.trips, uplink_queued(), uplink_queue_dropped());
+    printf("  configs pushed    %" PRIu32 "\n", server.configs_sent);
+    printf("  associations      %" PRIu32 "\n\n", fake_net.associations);
+
+    const TransportStats &ts = transport_stats();
+    const MqttStats &ms = mqtt_stats();
+    printf("transport (%s", transport_name(config.transport));
+    if (config.transport == TRANSPORT_MQTT)
+        printf(" QoS %u", config.mqtt_qos);
+    printf(")\n");
+    printf("  sends             %" PRIu32 ", %" PRIu32 " delivered, %" PRIu32 " replies\n", ts.sends, ts.delivered,
+           ts.replies);
+    printf("  per delivered     %.0f bytes out, %.0f bytes in\n",
+           ts.delivered ? (double)fake_net.bytes_out / ts.delivered : 0.0,
+           ts.delivered ? (double)fake_net.bytes_in / ts.delivered : 0.0);
+    printf("  send time         mean %.1f ms, max %.1f ms\n", ts.sends ? ts.busy_us / 1000.0 / ts.sends : 0.0,
+           ts.busy_max_us / 1000.0);
+    if (config.transport == TRANSPORT_MQTT)
+        printf("  mqtt sessions     %" PRIu32 ", %" PRIu32 " failed, %" PRIu32 " dropped, %" PRIu32 " pings, %" PRIu32
+               " pushes\n",
+               ms.connects, ms.connect_failures, ms.drops, ms.pings, ms.pushes);
+    if (config.transport == TRANSPORT_HTTPS)
+        printf("  tls               %" PRIu32 " full handshakes, %" PRIu32 " resumed, %" PRIu32
+               " closed idle by the server, crypto %.2f ms/delivered\n",
+               fake_tls.full_handshakes, fake_tls.resumed_handshakes, fake_tls.idle_closes,
+               ts.delivered ? fake_tls.cpu_us / 1000.0 / ts.delivered : 0.0);
+    printf("\n");
+
+    printf("sampling (every %" PRIu32 " ms, %zu plants)\n", config.sensor_period, plants_count());
+    printf("  samples           %" PRIu32 " of %" PRIu64 " expected, %" PRIu64 " missed\n", reads, expected,
+           expected > reads ? expected - reads : 0);
+    printf("  sensor job        %" PRIu32 " runs, %" PRIu32 " periods skipped\n", sensor.runs, sensor.skipped);
+    const I2cStats &is = i2c_stats();
+    uint32_t i2c_failed = 0;
+    for (int r = I2C_OK + 1; r < I2C_RESULTS; r++)
+        i2c_failed += is.count[r];
+    printf("  i2c               %" PRIu32 " transfers, %.0f ms/day on the wire, %" PRIu32 " failed, %" PRIu32
+           " recoveries\n\n",
+           fake_i2c.transactions, fake_i2c.bus_us / 1000.0 / ((fake_now_us - start_us) / (double)DAY_US), i2c_failed,
+           is.recoveries);
+
+    const LocalServerStats &ls = local_server_stats();
+    printf("local endpoint (/recent.json?n=60 every %.0f s, +-20%%)\n", opt.local_every_s);
+    printf("  reads             %" PRIu32 " answered, %" PRIu32 " failed, %" PRIu32 " timed out\n", st.local_ok,
+           st.local_failed, ls.timeouts);
+    printf("  response time     mean %.1f ms, max %.1f ms (connect to last byte)\n",
+           st.local_ok ? st.local_total_us / 1000.0 / st.local_ok : 0.0, st.local_max_us / 1000.0);
+    printf("  sent              %.1f KB/read, %.1f segments/read\n\n",
+           st.local_ok ? st.local_bytes / 1024.0 / st.local_ok : 0.0,
+           ls.requests ? (double)ls.segments / ls.requests : 0.0);
+
+    printf("loop() busy time (%" PRIu64 " loops)\n", st.loops);
+    printf("  mean %.0f us  p50 <%" PRIu32 " us  p90 <%" PRIu32 " us  p99 <%" PRIu32 " us  max %" PRIu64 " us\n",
+           st.loops ? (double)st.busy_total_us / st.loops : 0.0, busy_percentile(0.5), busy_percentile(0.9),
+           busy_percentile(0.99), st.busy_max_us);
+    printf("  busy %.2f%% of the time\n\n", 100.0 * st.busy_total_us / (fake_now_us - start_us));
+
+    printf("heap\n");
+    printf("  after setup()     %" PRIu64 " allocations (malloc/calloc/realloc from src/ and ArduinoJson)\n\n",
+           heap_allocs);
+
+    printf("watering countdown\n");
+    printf("  drying cycles     %" PRIu32 ", %" PRIu32 " with a countdown\n", st.cycles, st.predicted_cycles);
+    if (st.predicted_cycles)
+        printf("  error             mean %+.1f h, mean abs %.1f h\n", st.error_h / st.predicted_cycles,
+               st.abs_error_h / st.predicted_cycles);
+    printf("  history           %zu periods, NVS writes %" PRIu32 "\n", plant_at(0).prediction.count, fake_nvs_writes);
+}
+
+// one line per profile for --bench; stall = loop() busy time
+static void bench_header()
+{
+    printf("%-8s %9s %9s %7s %11s %11s %11s %9s\n", "profile", "requests", "stored", "lost", "stall mean",
+           "stall p99", "stall max", "samples");
+}
+
+static void bench_row(uint64_t start_us)
+{
+    uint64_t expected = sensor_expected(start_us);
+    uint32_t reads = sensor_reads();
+    printf("%-8s %9" PRIu32 " %9" PRIu32 " %6.1f%% %9.0fus %9" PRIu32 "us %9" PRIu64 "us %8.1f%%\n", fault->name,
+           fake_net.requests, server.stored, loss_percent(start_us),
+           st.loops ? (double)st.busy_total_us / st.loops : 0.0, busy_percentile(0.99), st.busy_max_us,
+           expected ? 100.0 * reads / expected : 0.0);
+}
+
+// one line per transport for --bench-transport; bytes both ways (protocol
+// overhead included) and TLS CPU per message that reached the server
+static void transport_header()
+{
+    printf("%-10s %9s %9s %7s %9s %9s %9s %10s %10s %10s\n", "transport", "messages", "stored", "lost", "out/msg",
+           "in/msg", "connects", "send mean", "send max", "crypto/msg");
+}
+
+static void transport_row(uint64_t start_us)
+{
+    const TransportStats &ts = transport_stats();
+    char name[16];
+    snprintf(name, sizeof(name), "%s%s", transport_name(config.transport),
+             config.transport == TRANSPORT_MQTT ? (config.mqtt_qos ? " qos1" : " qos0") : "");
+    if (config.transport == TRANSPORT_HTTPS && !fake_tls.resumption)
+        snprintf(name, sizeof(name), "https full");
+    printf("%-10s %9" PRIu32 " %9" PRIu32 " %6.1f%% %8.0fB %8.0fB %9" PRIu32 " %8.1fms %8.1fms %8.2fms\n", name,
+           server.submits, server.stored, loss_percent(start_us),
+           server.submits ? (double)fake_net.bytes_out / server.submits : 0.0,
+           server.submits ? (double)fake_net.bytes_in / server.submits : 0.0, fake_net.connects,
+           ts.sends ? ts.busy_us / 1000.0 / ts.sends : 0.0, ts.busy_max_us / 1000.0,
+           server.submits ? fake_tls.cpu_us / 1000.0 / server.submits : 0.0);
+}
+
+// ---- OTA is not simulated -----------------------------------------------
+
+bool ota_check()
+{
+    return false;
+}
+
+const char *ota_running_sha256()
+{
+    return "";
+}
+
+// ---- main ---------------------------------------------------------------
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: program [--days N] [--seed N] [--drying-days D] [--saturated-h H]\n"
+            "               [--water-delay-h H] [--outage-every-h H] [--outage-min M]\n"
+            "               [--latency-ms MS] [--plants N] [--local-every S] [--config JSON]\n"
+            "               [--fault PROFILE] [--transport T] [--bench]\n"
+            "               [--bench-transport] [--verbose]\n"
+            "transports: http mqtt0 mqtt1 https https-full\n"
+            "fault profiles:");
+    for (size_t i = 0; i < FAULT_PROFILES; i++)
+        fprintf(stderr, " %s", fault_profiles[i].name);
+    fprintf(stderr, "\n");
+    exit(2);
+}
+
+static void parse_args(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        if (!strcmp(a, "--verbose")) {
+            opt.verbose = true;
+            continue;
+        }
+        if (!strcmp(a, "--bench")) {
+            opt.bench = true;
+            continue;
+        }
+        if (!strcmp(a, "--bench-transport")) {
+            opt.bench_transport = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+            usage();
+        const char *v = argv[++i];
+        if (!strcmp(a, "--days"))
+            opt.days = atof(v);
+        else if (!strcmp(a, "--seed"))
+            opt.seed = strtoul(v, nullptr, 10);
+        else if (!strcmp(a, "--drying-days"))
+            opt.drying_days = atof(v);
+        else if (!strcmp(a, "--saturated-h"))
+            opt.saturated_h = atof(v);
+        else if (!strcmp(a, "--water-delay-h"))
+            opt.water_delay_h = atof(v);
+        else if (!strcmp(a, "--outage-every-h"))
+            opt.outage_every_h = atof(v);
+        else if (!strcmp(a, "--outage-min"))
+            opt.outage_min = atof(v);
+        else if (!strcmp(a, "--latency-ms"))
+            opt.latency_ms = strtoul(v, nullptr, 10);
+        else if (!strcmp(a, "--local-every"))
+            opt.local_every_s = atof(v);
+        else if (!strcmp(a, "--plants"))
+            opt.plants = strtoul(v, nullptr, 10);
+        else if (!strcmp(a, "--config"))
+            opt.config = v;
+        else if (!strcmp(a, "--fault"))
+            opt.fault = v;
+        else if (!strcmp(a, "--transport"))
+            opt.transport = v;
+        else
+            usage();
+    }
+}
+
+static const char *const transports[] = {"http", "mqtt0", "mqtt1", "https", "https-full"};
+
+static bool known_transport(const char *name)
+{
+    for (const char *t : transports)
+        if (!strcmp(t, name))
+            return true;
+    return false;
+}
+
+// as if the device had been configured that way before this boot
+static void use_transport(const char *name)
+{
+    config.transport = TRANSPORT_HTTP;
+    if (!strncmp(name, "mqtt", 4))
+        config.transport = TRANSPORT_MQTT;
+    if (!strncmp(name, "https", 5))
+        config.transport = TRANSPORT_HTTPS;
+    config.mqtt_qos = name[4] == '1';
+    config.mqtt_port = MQTT_DEFAULT_PORT;
+    config.tls_port = TLS_DEFAULT_PORT;
+    // the proxy in front of serve(), with the certificate make_certs.sh made
+    fake_tls.ca_pem = TLS_CA_PEM;
+    fake_tls.server_name = config.server_address;
+    fake_tls.latency_ms = opt.latency_ms;
+    fake_tls.resumption = strcmp(name, "https-full") != 0;
+}
+
+static const FaultProfile *find_fault(const char *name)
+{
+    for (size_t i = 0; i < FAULT_PROFILES; i++)
+        if (!strcmp(fault_profiles[i].name, name))
+            return &fault_profiles[i];
+    return nullptr;
+}
+
+// boots the device and runs it for --days; returns when the run started
+static uint64_t simulate()
+{
+    fakes_reset();
+    Serial.echo = opt.verbose;
+    plant_rng = opt.seed;
+    noise_rng = opt.seed ^ 0x5bd1e995;
+    fault_rng = opt.seed ^ 0x27d4eb2f;
+    local_rng = opt.seed ^ 0x165667b1;
+    fake_net.handler = serve;
+    fake_mqtt.handler = broker;
+    server.rev = opt.config ? 1 : 0;
+
+    // provisioned device, as wifisetup/set_ssid.cpp leaves it
+    nvs_handle_t h;
+    nvs_open("storage", NVS_READWRITE, &h);
+    nvs_set_str(h, "ssid", "greenhouse");
+    nvs_set_str(h, "pass", "succulent");
+    nvs_close(h);
+    fake_nvs_writes = 0;
+
+    if (opt.plants > 1) {
+        fake_dht.connected = false;
+        for (uint32_t i = 0; i < opt.plants; i++) {
+            fake_i2c.mux_present[i / 8] = true;
+            fake_dht_mux[i / 8][i % 8].connected = true;
+        }
+    }
+
+    config_defaults(config); // the plant model needs config.dry before setup() runs
+    water(0);
+    update_environment(0);
+    setup();
+    use_transport(opt.transport);
+    for (FakeTask *t : fake_tasks)
+        if (!strcmp(t->name, "local"))
+            t->gives_at = local_connects_at;
+    heap_allocs = 0;
+    heap_counting = true;
+
+    uint64_t start = fake_now_us;
+    st.local_next_us = start + (uint64_t)(opt.local_every_s * 1000000);
+    uint64_t end = start + (uint64_t)(opt.days * DAY_US);
+    uint64_t prev_elapsed = 0, prev_idle = 0;
+    bool have_prev = false;
+    while (fake_now_us < end) {
+        update_environment(fake_now_us);
+        uint64_t before = fake_now_us;
+        uint32_t cpu_edges = power_residency(POWER_CPU, millis()).transitions;
+        fake_last_sleep_end_us = 0;
+        loop();
+        // loop() switches the CPU "on" first thing; an off->on edge means the
+        // previous loop() ended idling in its wait, which isn't busy time
+        if (have_prev) {
+            bool idled = power_residency(POWER_CPU, millis()).transitions != cpu_edges;
+            record_loop(idled ? prev_elapsed - prev_idle : prev_elapsed);
+        }
+        prev_elapsed = fake_now_us - before;
+        prev_idle = (fake_last_sleep_end_us == fake_now_us) ? fake_last_sleep_us : 0;
+        have_prev = true;
+        track_prediction(fake_now_us);
+        track_local();
+    }
+    return start;
+}
+
+int main(int argc, char **argv)
+{
+    parse_args(argc, argv);
+    fault = find_fault(opt.fault);
+    if (fault == nullptr || opt.plants < 1 || opt.plants > PLANTS_MAX || !known_transport(opt.transport))
+        usage();
+
+    if (opt.bench_transport) {
+        printf("%.2f simulated days per transport, fault profile %s\n", opt.days, fault->name);
+        transport_header();
+        fflush(stdout);
+        for (const char *t : transports) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                opt.transport = t;
+                transport_row(simulate());
+                fflush(stdout);
+                _exit(0);
+            }
+            int status;
+            if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                fprintf(stderr, "transport %s failed\n", t);
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    if (!opt.bench) {
+        report(simulate());
+        // every cycle after the first has a history to count down from
+        if (st.cycles > 1 && st.predicted_cycles == 0) {
+            fprintf(stderr, "no watering countdown in %" PRIu32 " drying cycles\n", st.cycles);
+            return 1;
+        }
+        if (heap_allocs > 0) {
+            fprintf(stderr, "%" PRIu64 " heap allocations after setup()\n", heap_allocs);
+            return 1;
+        }
+        return 0;
+    }
+
+    // main.cpp's globals only survive one setup(), so each profile gets a
+    // fresh process
+    printf("%.2f simulated days per profile\n", opt.days);
+    bench_header();
+    fflush(stdout);
+    for (size_t i = 0; i < FAULT_PROFILES; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            fault = &fault_profiles[i];
+            bench_row(simulate());
+            fflush(stdout);
+            _exit(0);
+        }
+        int status;
+        if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            fprintf(stderr, "profile %s failed\n", fault_profiles[i].name);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,49 @@
+#include <math.h>
+#include <string.h>
+#include "aggregate.h"
+#include "lux.h"
+
+void window_start(WindowStats &w, uint32_t now)
+{
+    memset(&w, 0, sizeof(w));
+    w.start = now;
+}
+
+void window_add(WindowStats &w, const SensorData &s)
+{
+    if (!s.valid || w.n == UINT16_MAX)
+        return;
+    w.n++;
+    welford_add(w.temp, w.n, s.temp);
+    welford_add(w.moisture, w.n, s.moisture);
+    welford_add(w.light, w.n, (float)light_percent(s.light));
+    welford_add(w.lux, w.n, light_lux(s.light));
+}
+
+void window_close(WindowStats &w, uint32_t now)
+{
+    w.ms = now - w.start;
+}
+
+void welford_add(Welford &c, uint16_t n, float x)
+{
+    if (n == 1) {
+        c.min = c.max = c.mean = x;
+        c.m2 = 0;
+        return;
+    }
+    if (x < c.min)
+        c.min = x;
+    if (x > c.max)
+        c.max = x;
+    float delta = x - c.mean;
+    c.mean += delta / n;
+    c.m2 += delta * (x - c.mean);
+}
+
+float welford_stddev(const Welford &c, uint16_t n)
+{
+    if (n < 2)
+        return 0;
+    return sqrtf(c.m2 / (n - 1));
+}
@@ -0,0 +1,44 @@
+#include <string.h>
+#include "boot_profile.h"
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+static BootMark marks[BOOT_MAX_MARKS];
+static size_t mark_count = 0;
+
+void boot_mark(const char *phase, uint32_t now_us)
+{
+    if (mark_count >= BOOT_MAX_MARKS || boot_marked(phase))
+        return;
+    marks[mark_count].phase = phase;
+    marks[mark_count].us = now_us;
+    mark_count++;
+}
+
+bool boot_marked(const char *phase)
+{
+    for (size_t i = 0; i < mark_count; i++)
+        if (strcmp(marks[i].phase, phase) == 0)
+            return true;
+    return false;
+}
+
+size_t boot_mark_count()
+{
+    return mark_count;
+}
+
+const BootMark &boot_mark_at(size_t i)
+{
+    return marks[i];
+}
+
+void boot_print()
+{
+#ifdef ARDUINO
+    Serial.println("Boot profile:");
+    for (size_t i = 0; i < mark_count; i++)
+        Serial.printf("  %-14s %8.1f ms\n", marks[i].phase, marks[i].us / 1000.0);
+#endif
+}
@@ -0,0 +1,62 @@
+#include "breaker.h"
+
+void breaker_init(Breaker &b)
+{
+    b.state = BREAKER_CLOSED;
+    b.failures = 0;
+    b.backoff = BREAKER_BACKOFF_MIN;
+    b.opened_at = 0;
+    b.open_for = 0;
+    b.trips = 0;
+}
+
+bool breaker_allow(Breaker &b, uint32_t now)
+{
+    switch (b.state) {
+    case BREAKER_CLOSED:
+        return true;
+    case BREAKER_OPEN:
+        if (now - b.opened_at < b.open_for)
+            return false;
+        b.state = BREAKER_HALF_OPEN;
+        return true;
+    case BREAKER_HALF_OPEN:
+    default:
+        return false; // the probe hasn't come back yet
+    }
+}
+
+void breaker_success(Breaker &b)
+{
+    b.state = BREAKER_CLOSED;
+    b.failures = 0;
+    b.backoff = BREAKER_BACKOFF_MIN;
+}
+
+void breaker_failure(Breaker &b, uint32_t now, uint32_t rnd)
+{
+    b.failures++;
+    if (b.state == BREAKER_HALF_OPEN) {
+        // the probe failed, wait longer this time
+        b.backoff = b.backoff >= BREAKER_BACKOFF_MAX / 2 ? BREAKER_BACKOFF_MAX : b.backoff * 2;
+    } else if (b.state != BREAKER_CLOSED || b.failures < BREAKER_THRESHOLD) {
+        return;
+    }
+    // "equal jitter": somewhere in [backoff/2, backoff), never zero
+    b.state = BREAKER_OPEN;
+    b.opened_at = now;
+    b.open_for = b.backoff / 2 + rnd % (b.backoff / 2);
+    b.trips++;
+}
+
+const char *breaker_name(BreakerState s)
+{
+    switch (s) {
+    case BREAKER_CLOSED:
+        return "closed";
+    case BREAKER_OPEN:
+        return "open";
+    default:
+        return "half-open";
+    }
+}
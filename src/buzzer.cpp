@@ -0,0 +1,114 @@
+#include <Arduino.h>
+#include "esp_timer.h"
+#include "buzzer.h"
+#include "power_stats.h"
+
+static const BuzzerStep continuous_steps[] = {
+    {10, 10000, 0}, // 10s * 1000ms/s = 10000ms, same tone the buzzer always used
+};
+const BuzzerPattern BUZZER_PATTERN_CONTINUOUS = {continuous_steps, 1, 1};
+
+static const BuzzerStep chirp_steps[] = {
+    {3000, 80, 60},
+    {3600, 80, 60},
+    {4200, 120, 700},
+};
+const BuzzerPattern BUZZER_PATTERN_CHIRP = {chirp_steps, 3, 8};
+
+static esp_timer_handle_t buzzer_timer_handle;
+static const BuzzerPattern *pattern = &BUZZER_PATTERN_CONTINUOUS;
+
+// Playback position, only touched from the esp_timer task once started
+static volatile bool playing = false;
+static size_t step_index;
+static uint8_t repeats_left;
+static bool tone_on; // true while inside the on_ms part of a step
+
+static void buzzer_silence()
+{
+    ledcWrite(BUZZER_LEDC_CHANNEL, 0);
+}
+
+static void buzzer_tone(uint16_t freq)
+{
+    ledcChangeFrequency(BUZZER_LEDC_CHANNEL, freq, BUZZER_LEDC_RESOLUTION);
+    ledcWrite(BUZZER_LEDC_CHANNEL, BUZZER_LEDC_DUTY);
+}
+
+static void buzzer_advance(void *)
+{
+    const BuzzerStep *step = &pattern->steps[step_index];
+
+    if (!tone_on) {
+        // start of a step: tone for on_ms
+        tone_on = true;
+        if (step->freq != 0)
+            buzzer_tone(step->freq);
+        esp_timer_start_once(buzzer_timer_handle, (uint64_t)step->on_ms * 1000);
+        return;
+    }
+
+    // end of the tone: silence for off_ms, then the next step
+    tone_on = false;
+    buzzer_silence();
+
+    step_index++;
+    if (step_index >= pattern->len) {
+        step_index = 0;
+        if (--repeats_left == 0) {
+            playing = false;
+            power_set(POWER_BUZZER, false, millis());
+            return;
+        }
+    }
+
+    if (step->off_ms == 0)
+        buzzer_advance(nullptr);
+    else
+        esp_timer_start_once(buzzer_timer_handle, (uint64_t)step->off_ms * 1000);
+}
+
+void buzzer_hw_setup()
+{
+    ledcSetup(BUZZER_LEDC_CHANNEL, 1000, BUZZER_LEDC_RESOLUTION);
+    ledcAttachPin(BUZZER_PIN, BUZZER_LEDC_CHANNEL);
+    buzzer_silence();
+
+    esp_timer_create_args_t args = {};
+    args.callback = buzzer_advance;
+    args.name = "buzzer";
+    esp_timer_create(&args, &buzzer_timer_handle);
+}
+
+void buzzer_set_pattern(const BuzzerPattern *p)
+{
+    if (p == nullptr || p->len == 0 || p->repeat == 0)
+        return;
+    buzzer_stop();
+    pattern = p;
+}
+
+void buzzer_play()
+{
+    if (playing)
+        return;
+    step_index = 0;
+    repeats_left = pattern->repeat;
+    tone_on = false;
+    playing = true;
+    power_set(POWER_BUZZER, true, millis());
+    buzzer_advance(nullptr);
+}
+
+void buzzer_stop()
+{
+    esp_timer_stop(buzzer_timer_handle);
+    buzzer_silence();
+    playing = false;
+    power_set(POWER_BUZZER, false, millis());
+}
+
+bool buzzer_busy()
+{
+    return playing;
+}
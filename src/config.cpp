@@ -0,0 +1,194 @@
+#include <stddef.h>
+#include <string.h>
+#include <type_traits>
+#include "nvs.h"
+#include "aggregate.h"
+#include "config.h"
+#include "transport.h"
+
+DeviceConfig config;
+
+static void (*change_callback)() = nullptr;
+
+// Where each version's fields end. A blob is its whole struct, tail padding
+// included, so a field appended later can fall inside an older blob (the v6
+// and v7 blobs are both 100 bytes): only the version says what was written.
+static constexpr size_t version_end[CONFIG_VERSION + 1] = {
+    0,
+    offsetof(DeviceConfig, ota_period), // 1
+    offsetof(DeviceConfig, aggregate_window), // 2
+    offsetof(DeviceConfig, heartbeat_period), // 3
+    offsetof(DeviceConfig, lux_gain), // 4
+    offsetof(DeviceConfig, transport), // 5
+    offsetof(DeviceConfig, tls_port), // 6
+    sizeof(DeviceConfig), // 7
+};
+
+// Blobs with these layouts are already out in NVS, so they can't move. An
+// appended field changes the size below: bump CONFIG_VERSION, give it an
+// entry above and a default, and update these.
+static_assert(version_end[1] == 72 && version_end[2] == 76 && version_end[3] == 80 && version_end[4] == 90 &&
+                  version_end[5] == 94 && version_end[6] == 98,
+              "a field of a released config version moved");
+static_assert(sizeof(DeviceConfig) == 100 && offsetof(DeviceConfig, tls_port) + sizeof(uint16_t) == 100,
+              "DeviceConfig changed without a new CONFIG_VERSION");
+
+void config_defaults(DeviceConfig &c)
+{
+    memset(&c, 0, sizeof(c));
+    c.version = CONFIG_VERSION;
+    c.rev = 0;
+    strcpy(c.server_address, "3.149.230.7"); // adjust with instance
+    c.server_port = 5000;
+    c.periods_stored = 5;
+    c.dry = 60;
+    c.shade = 2500;
+    c.buzzer_off_time = 1800000; // 30min * 60s/min = 1800s * 1000ms/s = 1800000ms
+    c.sensor_period = 1000;
+    c.display_period = 1000;
+    c.uplink_period = 1000;
+    c.ota_period = 21600000; // 6h
+    c.aggregate_window = 60000; // 1min
+    c.heartbeat_period = 900000; // 15min
+    c.temp_deadband = 3; // 0.3 °C
+    c.moisture_deadband = 10; // 1 %RH
+    c.light_deadband = 5; // %
+    c.lux_gain = 1000;
+    c.adc_offset = 0;
+    c.transport = TRANSPORT_HTTP;
+    c.mqtt_qos = 1;
+    c.mqtt_port = MQTT_DEFAULT_PORT;
+    c.tls_port = TLS_DEFAULT_PORT;
+}
+
+bool config_validate(const DeviceConfig &c)
+{
+    if (c.server_address[0] == '\0' || c.server_port == 0)
+        return false;
+    if (c.periods_stored == 0 || c.periods_stored > CONFIG_PERIODS_MAX)
+        return false;
+    if (c.dry < 0 || c.dry > 100 || c.shade < 0 || c.shade > 4095)
+        return false;
+    if (c.sensor_period < 1000) // DHT20 can't be read faster than once a second
+        return false;
+    if (c.display_period < 100 || c.uplink_period < 1000 || c.buzzer_off_time < 60000)
+        return false;
+    if (c.ota_period != 0 && c.ota_period < 60000)
+        return false;
+    if (c.aggregate_window != 0 && (c.aggregate_window < 1000 || c.aggregate_window > AGGREGATE_WINDOW_MAX))
+        return false;
+    if (c.heartbeat_period != 0 && c.heartbeat_period < 60000)
+        return false;
+    if (c.temp_deadband > 1000 || c.moisture_deadband > 1000 || c.light_deadband > 100)
+        return false;
+    if (c.lux_gain < 100 || c.lux_gain > 10000 || c.adc_offset < -400 || c.adc_offset > 400)
+        return false;
+    if (!transport_available(c.transport) || c.mqtt_qos > 1 || c.mqtt_port == 0 || c.tls_port == 0)
+        return false;
+    return true;
+}
+
+static bool config_save(const DeviceConfig &c)
+{
+    nvs_handle_t my_handle;
+    if (nvs_open("storage", NVS_READWRITE, &my_handle) != ESP_OK)
+        return false;
+    esp_err_t err = nvs_set_blob(my_handle, "config", &c, sizeof(c));
+    if (err == ESP_OK)
+        err = nvs_commit(my_handle);
+    nvs_close(my_handle);
+    return err == ESP_OK;
+}
+
+void config_setup()
+{
+    config_defaults(config);
+
+    nvs_handle_t my_handle;
+    if (nvs_open("storage", NVS_READONLY, &my_handle) != ESP_OK)
+        return;
+    DeviceConfig stored;
+    config_defaults(stored);
+    size_t len = sizeof(stored);
+    esp_err_t err = nvs_get_blob(my_handle, "config", &stored, &len);
+    nvs_close(my_handle);
+
+    if (err != ESP_OK || stored.version == 0 || stored.version > CONFIG_VERSION)
+        return;
+    size_t end = version_end[stored.version];
+    if (len < end)
+        return;
+    // the fields its version didn't have get their defaults, whatever
+    // padding the blob had there
+    DeviceConfig defaults;
+    config_defaults(defaults);
+    memcpy((uint8_t *)&stored + end, (const uint8_t *)&defaults + end, sizeof(stored) - end);
+    stored.version = CONFIG_VERSION;
+    if (config_validate(stored))
+        config = stored;
+}
+
+template <typename T>
+static bool take(JsonObjectConst delta, const char *key, T &field)
+{
+    JsonVariantConst v = delta[key];
+    if (v.isNull())
+        return true;
+    if (!v.is<long>() || (std::is_unsigned<T>::value && v.as<long>() < 0))
+        return false; // present but not a usable number, reject the whole delta
+    field = (T)v.as<long>();
+    return (long)field == v.as<long>(); // didn't fit the field
+}
+
+bool config_apply(JsonObjectConst delta, uint32_t rev)
+{
+    DeviceConfig next = config;
+    bool ok = true;
+
+    JsonVariantConst address = delta["server_address"];
+    if (!address.isNull()) {
+        const char *s = address.as<const char *>();
+        if (s == nullptr || strlen(s) >= sizeof(next.server_address))
+            ok = false;
+        else
+            strcpy(next.server_address, s);
+    }
+    ok = ok && take(delta, "server_port", next.server_port);
+    ok = ok && take(delta, "periods_stored", next.periods_stored);
+    ok = ok && take(delta, "dry", next.dry);
+    ok = ok && take(delta, "shade", next.shade);
+    ok = ok && take(delta, "buzzer_off_time", next.buzzer_off_time);
+    ok = ok && take(delta, "sensor_period", next.sensor_period);
+    ok = ok && take(delta, "display_period", next.display_period);
+    ok = ok && take(delta, "uplink_period", next.uplink_period);
+    ok = ok && take(delta, "ota_period", next.ota_period);
+    ok = ok && take(delta, "aggregate_window", next.aggregate_window);
+    ok = ok && take(delta, "heartbeat_period", next.heartbeat_period);
+    ok = ok && take(delta, "temp_deadband", next.temp_deadband);
+    ok = ok && take(delta, "moisture_deadband", next.moisture_deadband);
+    ok = ok && take(delta, "light_deadband", next.light_deadband);
+    ok = ok && take(delta, "lux_gain", next.lux_gain);
+    ok = ok && take(delta, "adc_offset", next.adc_offset);
+    ok = ok && take(delta, "transport", next.transport);
+    ok = ok && take(delta, "mqtt_qos", next.mqtt_qos);
+    ok = ok && take(delta, "mqtt_port", next.mqtt_port);
+    ok = ok && take(delta, "tls_port", next.tls_port);
+    next.rev = rev;
+
+    if (!ok || !config_validate(next))
+        return false;
+    if (memcmp(&next, &config, sizeof(next)) == 0)
+        return false;
+
+    // swap in one assignment, nothing reads config between the jobs
+    config = next;
+    config_save(config);
+    if (change_callback)
+        change_callback();
+    return true;
+}
+
+void config_on_change(void (*callback)())
+{
+    change_callback = callback;
+}
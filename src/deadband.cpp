@@ -0,0 +1,42 @@
+#include <math.h>
+#include "config.h"
+#include "deadband.h"
+
+void deadband_init(Deadband &d)
+{
+    d.primed = false;
+    d.temp = d.moisture = d.light = 0;
+    d.reported_at = 0;
+    d.sent = d.skipped = 0;
+}
+
+static bool report(Deadband &d, float temp, float moisture, float light, uint32_t now)
+{
+    bool due = config.heartbeat_period == 0 || !d.primed || now - d.reported_at >= config.heartbeat_period ||
+               fabsf(temp - d.temp) * 10 > config.temp_deadband ||
+               fabsf(moisture - d.moisture) * 10 > config.moisture_deadband ||
+               fabsf(light - d.light) > config.light_deadband;
+    if (!due) {
+        d.skipped++;
+        return false;
+    }
+    d.primed = true;
+    d.temp = temp;
+    d.moisture = moisture;
+    d.light = light;
+    d.reported_at = now;
+    d.sent++;
+    return true;
+}
+
+bool deadband_window(Deadband &d, const WindowStats &w, uint32_t now)
+{
+    return report(d, w.temp.mean, w.moisture.mean, w.light.mean, now);
+}
+
+bool deadband_sample(Deadband &d, const SensorData &s, uint32_t now)
+{
+    if (!s.valid)
+        return false;
+    return report(d, s.temp, s.moisture, (float)light_percent(s.light), now);
+}
@@ -0,0 +1,36 @@
+#include <Arduino.h>
+#include "esp_heap_caps.h"
+#include "heap_monitor.h"
+
+static uint32_t baseline_free;
+static uint32_t last_warned_block = UINT32_MAX;
+
+void heap_monitor_setup()
+{
+    baseline_free = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    Serial.printf("Heap after setup: %u free, %u largest block\n", (unsigned)baseline_free,
+                  (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+}
+
+HeapStats heap_monitor_sample()
+{
+    HeapStats s;
+    s.free = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    s.min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    s.largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    s.baseline_free = baseline_free;
+    s.fragmentation = s.free ? 100 - (uint8_t)((uint64_t)s.largest_block * 100 / s.free) : 0;
+    return s;
+}
+
+void heap_monitor_job()
+{
+    HeapStats s = heap_monitor_sample();
+    // only shout when it gets worse, not every period
+    if (s.largest_block < HEAP_LOW_BLOCK && s.largest_block < last_warned_block) {
+        Serial.printf("Heap low: %u free, %u largest block (%u%% fragmented), %u at boot\n",
+                      (unsigned)s.free, (unsigned)s.largest_block, s.fragmentation,
+                      (unsigned)s.baseline_free);
+        last_warned_block = s.largest_block;
+    }
+}
@@ -0,0 +1,104 @@
+#include <Arduino.h>
+#include <WiFi.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "http_response.h"
+#ifdef ARDUINO_ARCH_ESP32
+#include <lwip/sockets.h>
+#endif
+
+void wait_readable(WiFiClient &c, uint32_t ms)
+{
+#ifdef ARDUINO_ARCH_ESP32
+    int fd = c.fd();
+    if (fd >= 0) {
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(fd, &readable);
+        struct timeval tv;
+        tv.tv_sec = ms / 1000;
+        tv.tv_usec = (ms % 1000) * 1000;
+        select(fd + 1, &readable, nullptr, nullptr, &tv);
+        return;
+    }
+#endif
+    unsigned long start = millis();
+    while (c.available() <= 0 && c.connected() && millis() - start < ms)
+        delay(HTTP_POLL_MS);
+}
+
+// Status line and headers, once buf holds all of them. Returns the header
+// length including the blank line, 0 if they're not all in yet, or an error.
+static int parse_head(const char *buf, HttpResponse &resp)
+{
+    const char *end = strstr(buf, "\r\n\r\n");
+    if (end == nullptr)
+        return 0;
+    // HTTP/1.1 200 OK
+    const char *sp = strchr(buf, ' ');
+    if (strncmp(buf, "HTTP/", 5) != 0 || sp == nullptr || sp > end)
+        return HTTP_RESP_INVALID;
+    resp.status = atoi(sp + 1);
+    if (resp.status < 100 || resp.status > 599)
+        return HTTP_RESP_INVALID;
+
+    static const char key[] = "content-length:";
+    for (const char *line = strstr(buf, "\r\n") + 2; line < end; line = strstr(line, "\r\n") + 2) {
+        if (strncasecmp(line, key, sizeof(key) - 1) == 0)
+            resp.content_length = atoi(line + sizeof(key) - 1);
+    }
+    return end + 4 - buf;
+}
+
+int http_read_response(WiFiClient &c, char *buf, size_t len, uint32_t timeout_ms, HttpResponse &resp)
+{
+    unsigned long start = millis();
+    size_t n = 0, head_len = 0;
+    resp.status = 0;
+    resp.content_length = -1;
+    resp.body = nullptr;
+    resp.body_len = 0;
+    if (len < 2)
+        return HTTP_RESP_OVERFLOW;
+    buf[0] = '\0';
+
+    for (;;) {
+        if (c.available() > 0) {
+            if (n + 1 >= len)
+                return HTTP_RESP_OVERFLOW;
+            int got = c.read((uint8_t *)buf + n, len - 1 - n);
+            if (got > 0) {
+                n += got;
+                buf[n] = '\0';
+                if (head_len == 0) {
+                    int h = parse_head(buf, resp);
+                    if (h < 0)
+                        return h;
+                    head_len = h;
+                    if (head_len && resp.content_length >= 0 && head_len + resp.content_length >= len)
+                        return HTTP_RESP_OVERFLOW;
+                }
+                if (head_len && resp.content_length >= 0 && n - head_len >= (size_t)resp.content_length)
+                    break;
+                continue; // drain whatever else is already buffered before waiting
+            }
+        }
+        if (!c.connected()) {
+            if (head_len && resp.content_length < 0)
+                break; // no Content-Length, the body ran to the close
+            return HTTP_RESP_CLOSED;
+        }
+        uint32_t elapsed = millis() - start;
+        if (elapsed >= timeout_ms)
+            return HTTP_RESP_TIMEOUT;
+        wait_readable(c, timeout_ms - elapsed);
+    }
+
+    resp.body = buf + head_len;
+    resp.body_len = n - head_len;
+    if (resp.content_length >= 0 && resp.body_len > (size_t)resp.content_length)
+        resp.body_len = resp.content_length;
+    buf[head_len + resp.body_len] = '\0';
+    return resp.status;
+}
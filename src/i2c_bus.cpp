@@ -0,0 +1,127 @@
+#include <Arduino.h>
+#include <Wire.h>
+#include "i2c_bus.h"
+
+static I2cStats stats;
+static uint8_t failing; // timeouts/bus errors in a row
+
+static const char *const names[I2C_RESULTS] = {
+    "ok", "nack_addr", "nack_data", "short_read", "timeout", "bus_error", "crc", "not_ready",
+};
+
+static void start_controller()
+{
+    Wire.begin(I2C_SDA_PIN, I2C_SCL_PIN, I2C_CLOCK_HZ);
+    Wire.setTimeOut(I2C_TIMEOUT_MS);
+}
+
+static bool sda_held()
+{
+    // the bus is idle between transfers, so SDA low means a slave has it
+    return digitalRead(I2C_SDA_PIN) == LOW;
+}
+
+static I2cResult done(I2cResult r)
+{
+    stats.count[r]++;
+    if (r == I2C_TIMEOUT || r == I2C_BUS_ERROR) {
+        if (sda_held() || ++failing >= I2C_RECOVER_AFTER)
+            i2c_recover();
+    } else {
+        failing = 0;
+    }
+    return r;
+}
+
+void i2c_setup()
+{
+    stats = I2cStats();
+    failing = 0;
+    start_controller();
+    // a reset mid-transfer leaves the slave where it was, SDA included
+    if (sda_held())
+        i2c_recover();
+}
+
+I2cResult i2c_write(uint8_t addr, const uint8_t *data, size_t len)
+{
+    Wire.beginTransmission(addr);
+    if (len > 0 && Wire.write(data, len) != len) {
+        Wire.endTransmission();
+        return done(I2C_BUS_ERROR);
+    }
+    switch (Wire.endTransmission()) {
+    case 0:
+        return done(I2C_OK);
+    case 2:
+        return done(I2C_NACK_ADDR);
+    case 3:
+        return done(I2C_NACK_DATA);
+    case 5:
+        return done(I2C_TIMEOUT);
+    default:
+        return done(I2C_BUS_ERROR);
+    }
+}
+
+I2cResult i2c_read(uint8_t addr, uint8_t *buf, size_t len)
+{
+    size_t got = Wire.requestFrom(addr, (uint8_t)len);
+    for (size_t i = 0; i < got && i < len; i++)
+        buf[i] = Wire.read();
+    if (got == len)
+        return done(I2C_OK);
+    // the controller reports a NACK and a hung bus alike, as nothing read
+    if (got == 0)
+        return done(sda_held() ? I2C_BUS_ERROR : I2C_NACK_ADDR);
+    return done(I2C_SHORT_READ);
+}
+
+void i2c_count(I2cResult r)
+{
+    stats.count[r]++;
+}
+
+bool i2c_recover()
+{
+    failing = 0;
+    Wire.end();
+    pinMode(I2C_SDA_PIN, INPUT_PULLUP);
+    pinMode(I2C_SCL_PIN, OUTPUT_OPEN_DRAIN);
+    digitalWrite(I2C_SCL_PIN, HIGH);
+    // every clock shifts the stuck slave one bit further through its byte;
+    // once that byte and its ACK slot are done it lets go of SDA
+    for (int i = 0; i < I2C_RECOVER_CLOCKS && sda_held(); i++) {
+        digitalWrite(I2C_SCL_PIN, LOW);
+        delayMicroseconds(I2C_RECOVER_HALF_US);
+        digitalWrite(I2C_SCL_PIN, HIGH);
+        delayMicroseconds(I2C_RECOVER_HALF_US);
+    }
+    bool released = !sda_held();
+    if (released) {
+        // STOP (SDA rising while SCL is high) so every slave resyncs
+        digitalWrite(I2C_SCL_PIN, LOW);
+        pinMode(I2C_SDA_PIN, OUTPUT_OPEN_DRAIN);
+        digitalWrite(I2C_SDA_PIN, LOW);
+        delayMicroseconds(I2C_RECOVER_HALF_US);
+        digitalWrite(I2C_SCL_PIN, HIGH);
+        delayMicroseconds(I2C_RECOVER_HALF_US);
+        digitalWrite(I2C_SDA_PIN, HIGH);
+        delayMicroseconds(I2C_RECOVER_HALF_US);
+        stats.recoveries++;
+    } else {
+        stats.recover_failed++;
+    }
+    start_controller();
+    return released;
+}
+
+const I2cStats &i2c_stats()
+{
+    return stats;
+}
+
+const char *i2c_result_name(I2cResult r)
+{
+    return names[r];
+}
@@ -0,0 +1,66 @@
+#include <Arduino.h>
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "input.h"
+
+struct Button {
+    uint8_t pin;
+    uint8_t event;
+    uint32_t last_us; // last accepted edge
+};
+
+static Button buttons[] = {
+    {BUTTON_LEFT_PIN, INPUT_BUTTON_LEFT, 0},
+    {BUTTON_RIGHT_PIN, INPUT_BUTTON_RIGHT, 0},
+};
+
+static StaticQueue_t queue_buf;
+static uint8_t queue_storage[INPUT_QUEUE_LEN * sizeof(InputEvent)];
+static QueueHandle_t queue;
+static volatile uint32_t dropped;
+
+static void IRAM_ATTR button_isr(void *arg)
+{
+    Button *b = (Button *)arg;
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    if (now - b->last_us < BUTTON_DEBOUNCE_US)
+        return; // still bouncing from the last edge
+    b->last_us = now;
+
+    InputEvent ev = {b->event, now};
+    BaseType_t woken = pdFALSE;
+    if (xQueueSendFromISR(queue, &ev, &woken) != pdPASS)
+        dropped++;
+    if (woken)
+        portYIELD_FROM_ISR(); // the UI task outranks whatever we interrupted
+}
+
+void input_setup()
+{
+    queue = xQueueCreateStatic(INPUT_QUEUE_LEN, sizeof(InputEvent), queue_storage, &queue_buf);
+    for (Button &b : buttons) {
+        b.last_us = (uint32_t)esp_timer_get_time() - BUTTON_DEBOUNCE_US;
+        pinMode(b.pin, INPUT); // both have pull-ups on the board, 35 has no internal one
+        attachInterruptArg(digitalPinToInterrupt(b.pin), button_isr, &b, FALLING);
+    }
+}
+
+bool input_post(uint8_t type)
+{
+    if (type == INPUT_REFRESH && uxQueueMessagesWaiting(queue) > 0)
+        return true;
+    InputEvent ev = {type, (uint32_t)esp_timer_get_time()};
+    return xQueueSend(queue, &ev, 0) == pdPASS;
+}
+
+bool input_wait(InputEvent &ev, uint32_t timeout_ms)
+{
+    TickType_t ticks = timeout_ms == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    return xQueueReceive(queue, &ev, ticks) == pdTRUE;
+}
+
+uint32_t input_dropped()
+{
+    return dropped;
+}
@@ -0,0 +1,102 @@
+#include <Arduino.h>
+#include <string.h>
+#include "latency.h"
+
+static LatencyHistogram histograms[LAT_STAGES];
+
+static const char *const names[LAT_STAGES] = {
+    "loop", "sensor", "display", "json", "http_connect", "http_response", "local"
+};
+
+int latency_bucket(uint32_t us)
+{
+    if (us == 0)
+        return 0;
+    int b = 31 - __builtin_clz(us); // floor(log2(us))
+    return b < LATENCY_BUCKETS ? b : LATENCY_BUCKETS - 1;
+}
+
+LatencyTimer latency_start()
+{
+    LatencyTimer t;
+#ifdef ARDUINO_ARCH_ESP32
+    t.cycles = ESP.getCycleCount();
+#else
+    t.cycles = 0;
+#endif
+    t.us = micros();
+    return t;
+}
+
+void latency_stop(LatencyStage stage, const LatencyTimer &t)
+{
+    uint32_t us = micros() - t.us;
+#ifdef ARDUINO_ARCH_ESP32
+    // cycle counter for the short stages, it resolves well below a microsecond
+    if (us < 10000000)
+        us = (ESP.getCycleCount() - t.cycles) / ESP.getCpuFreqMHz();
+#endif
+    latency_record(stage, us);
+}
+
+void latency_record(LatencyStage stage, uint32_t us)
+{
+    LatencyHistogram &h = histograms[stage];
+    h.buckets[latency_bucket(us)]++;
+    h.count++;
+    h.sum_us += us;
+    if (us > h.max_us)
+        h.max_us = us;
+}
+
+const LatencyHistogram &latency_histogram(LatencyStage stage)
+{
+    return histograms[stage];
+}
+
+uint32_t latency_percentile(const LatencyHistogram &h, float p)
+{
+    if (h.count == 0)
+        return 0;
+    uint32_t target = (uint32_t)(p * h.count);
+    if (target >= h.count)
+        target = h.count - 1;
+    uint32_t seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += h.buckets[i];
+        if (seen > target) {
+            uint32_t upper = (i + 1 < 32) ? (1u << (i + 1)) : UINT32_MAX;
+            return upper < h.max_us ? upper : h.max_us;
+        }
+    }
+    return h.max_us;
+}
+
+void latency_reset()
+{
+    memset(histograms, 0, sizeof(histograms));
+}
+
+void latency_take(LatencyHistogram out[LAT_STAGES])
+{
+    memcpy(out, histograms, sizeof(histograms));
+    latency_reset();
+}
+
+void latency_merge(const LatencyHistogram in[LAT_STAGES])
+{
+    for (int i = 0; i < LAT_STAGES; i++) {
+        LatencyHistogram &h = histograms[i];
+        for (int j = 0; j < LATENCY_BUCKETS; j++)
+            h.buckets[j] += in[i].buckets[j];
+        h.count += in[i].count;
+        h.sum_us += in[i].sum_us;
+        if (in[i].max_us > h.max_us)
+            h.max_us = in[i].max_us;
+    }
+}
+
+const char *latency_name(LatencyStage stage)
+{
+    return names[stage];
+}
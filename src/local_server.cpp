@@ -0,0 +1,359 @@
+#include <Arduino.h>
+#include <WiFi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "latency.h"
+#include "local_server.h"
+#include "lux.h"
+#include "recent.h"
+#include "scheduler.h"
+#include "segment_writer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "wifi_manager.h"
+#ifdef ARDUINO_ARCH_ESP32
+#include <lwip/sockets.h>
+#endif
+
+static bool listening;
+static TaskHandle_t loop_task, accept_task;
+static StaticTask_t accept_task_buf;
+static StackType_t accept_task_stack[LOCAL_ACCEPT_TASK_STACK];
+
+// the connection being read, at most one
+static WiFiClient client;
+static bool pending;
+static uint32_t accepted_at;
+static char line[LOCAL_LINE_MAX]; // request line, the headers are only skipped
+static size_t line_len;
+static bool line_done, line_long;
+static uint32_t tail; // last four bytes, "\r\n\r\n" ends the headers
+
+static LocalServerStats stats;
+
+struct Query {
+    bool csv;
+    int plant; // -1 = every plant
+    uint32_t n;
+    bool since_set;
+    uint32_t since;
+};
+
+#ifdef ARDUINO_ARCH_ESP32
+// WiFiServer keeps its socket to itself, and the accept task needs one to
+// select() on
+static int listen_fd = -1;
+
+static bool listen_begin()
+{
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (fd < 0)
+        return false;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(LOCAL_SERVER_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 2) < 0) {
+        close(fd);
+        return false;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK); // loop() only accepts what select() saw
+    listen_fd = fd;
+    return true;
+}
+
+static WiFiClient listen_accept()
+{
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0)
+        return WiFiClient();
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return WiFiClient(fd);
+}
+
+static void listen_wait()
+{
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(listen_fd, &readable);
+    select(listen_fd + 1, &readable, nullptr, nullptr, nullptr);
+}
+#else
+// The accept task isn't run on the host: tests and the sim stand in for
+// listen_wait() with its FakeTask's gives_at
+static WiFiServer server(LOCAL_SERVER_PORT);
+
+static bool listen_begin()
+{
+    server.begin();
+    server.setNoDelay(true);
+    return true;
+}
+
+static WiFiClient listen_accept()
+{
+    return server.available();
+}
+
+static void listen_wait() {}
+#endif
+
+// Parked until loop() has no connection open, then blocked on the listening
+// socket until a client connects, when it wakes loop() to accept it
+static void accept_task_fn(void *)
+{
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        listen_wait();
+        xTaskNotifyGive(loop_task);
+    }
+}
+
+void local_server_setup()
+{
+    listening = false;
+    pending = false;
+    memset(&stats, 0, sizeof(stats));
+    loop_task = xTaskGetCurrentTaskHandle();
+    accept_task = xTaskCreateStaticPinnedToCore(accept_task_fn, "local", LOCAL_ACCEPT_TASK_STACK, nullptr,
+                                                LOCAL_ACCEPT_TASK_PRIORITY, accept_task_stack, &accept_task_buf,
+                                                LOCAL_ACCEPT_TASK_CORE);
+}
+
+bool local_server_busy()
+{
+    return pending;
+}
+
+bool local_server_listening()
+{
+    return listening;
+}
+
+const LocalServerStats &local_server_stats()
+{
+    return stats;
+}
+
+static void close_client()
+{
+    client.stop();
+    pending = false;
+}
+
+static void reply_error(int status, const char *reason)
+{
+    char head[160];
+    int n = snprintf(head, sizeof(head),
+                     "HTTP/1.1 %d %s\r\nContent-Type: text/plain\r\nContent-Length: %u\r\nConnection: close\r\n\r\n%s\n",
+                     status, reason, (unsigned)strlen(reason) + 1, reason);
+    client.write((const uint8_t *)head, n);
+    stats.errors++;
+    close_client();
+}
+
+static bool parse_uint(const char *s, size_t len, uint32_t &out)
+{
+    if (len == 0 || len > 10)
+        return false;
+    uint64_t v = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] < '0' || s[i] > '9')
+            return false;
+        v = v * 10 + (s[i] - '0');
+    }
+    if (v > UINT32_MAX)
+        return false;
+    out = (uint32_t)v;
+    return true;
+}
+
+// "plant=2&n=60", unknown keys are ignored
+static bool parse_query(const char *q, size_t len, Query &out)
+{
+    const char *end = q + len;
+    while (q < end) {
+        const char *amp = (const char *)memchr(q, '&', end - q);
+        const char *stop = amp ? amp : end;
+        const char *eq = (const char *)memchr(q, '=', stop - q);
+        if (eq) {
+            size_t key = eq - q;
+            uint32_t v = 0;
+            bool ok = parse_uint(eq + 1, stop - eq - 1, v);
+            if (key == 5 && !strncmp(q, "plant", 5)) {
+                if (!ok || v > 255)
+                    return false;
+                out.plant = v;
+            } else if (key == 1 && q[0] == 'n') {
+                if (!ok)
+                    return false;
+                out.n = v;
+            } else if (key == 5 && !strncmp(q, "since", 5)) {
+                if (!ok)
+                    return false;
+                out.since = v;
+                out.since_set = true;
+            }
+        }
+        q = stop + 1;
+    }
+    return true;
+}
+
+static bool wanted(const RecentSample &r, const Query &q)
+{
+    if (q.plant >= 0 && r.plant != q.plant)
+        return false;
+    return !q.since_set || sched_before(q.since, r.ms);
+}
+
+static void serve(const Query &q)
+{
+    // oldest of the newest n that match, so rows go out oldest first
+    size_t count = recent_count(), first = count, matched = 0;
+    while (first > 0 && matched < q.n) {
+        const RecentSample &r = recent_at(first - 1);
+        if (q.since_set && !sched_before(q.since, r.ms))
+            break; // older ones are older still
+        first--;
+        if (wanted(r, q))
+            matched++;
+    }
+
+    ChunkedWriter out(client);
+    out.head("HTTP/1.1 200 OK\r\n");
+    out.head(q.csv ? "Content-Type: text/csv\r\n" : "Content-Type: application/json\r\n");
+    out.head("Transfer-Encoding: chunked\r\nCache-Control: no-store\r\n"
+             "Access-Control-Allow-Origin: *\r\nConnection: close\r\n\r\n");
+    char row[96]; // the longest JSON row is ~90
+    if (q.csv) {
+        out.print("ms,plant,temp,moisture,light,lux\n");
+    } else {
+        snprintf(row, sizeof(row), "{\"now\":%lu,\"samples\":[", (unsigned long)millis());
+        out.print(row);
+    }
+    bool comma = false;
+    for (size_t i = first; i < count && out.ok(); i++) {
+        const RecentSample &r = recent_at(i);
+        if (!wanted(r, q))
+            continue;
+        if (q.csv)
+            snprintf(row, sizeof(row), "%lu,%u,%.2f,%.2f,%d,%.1f\n", (unsigned long)r.ms, r.plant,
+                     recent_temp(r), recent_moisture(r), light_percent(r.light), light_lux(r.light));
+        else
+            snprintf(row, sizeof(row),
+                     "%s{\"ms\":%lu,\"plant\":%u,\"temp\":%.2f,\"moisture\":%.2f,\"light\":%d,\"lux\":%.1f}",
+                     comma ? "," : "", (unsigned long)r.ms, r.plant, recent_temp(r), recent_moisture(r),
+                     light_percent(r.light), light_lux(r.light));
+        out.print(row);
+        comma = true;
+        stats.rows++;
+    }
+    if (!q.csv)
+        out.print("]}\n");
+    out.finish();
+    stats.requests++;
+    stats.bytes += out.written();
+    stats.segments += out.sent_segments();
+    close_client();
+}
+
+static void handle_request()
+{
+    if (line_long) {
+        reply_error(414, "URI Too Long");
+        return;
+    }
+    line[line_len] = '\0';
+    if (strncmp(line, "GET ", 4) != 0) {
+        reply_error(405, "Method Not Allowed");
+        return;
+    }
+    const char *target = line + 4;
+    const char *space = strchr(target, ' ');
+    size_t target_len = space ? (size_t)(space - target) : strlen(target);
+    const char *qmark = (const char *)memchr(target, '?', target_len);
+    size_t path_len = qmark ? (size_t)(qmark - target) : target_len;
+
+    Query q = {false, -1, LOCAL_ROWS_DEFAULT, false, 0};
+    if (path_len == 12 && !strncmp(target, "/recent.json", 12))
+        q.csv = false;
+    else if (path_len == 11 && !strncmp(target, "/recent.csv", 11))
+        q.csv = true;
+    else {
+        reply_error(404, "Not Found");
+        return;
+    }
+    if (qmark && !parse_query(qmark + 1, target + target_len - qmark - 1, q)) {
+        reply_error(400, "Bad Request");
+        return;
+    }
+    LatencyTimer lat = latency_start();
+    serve(q);
+    latency_stop(LAT_LOCAL, lat);
+}
+
+// Takes whatever of the request has arrived; true once the headers are in
+static bool read_request()
+{
+    uint8_t buf[64];
+    int n;
+    while ((n = client.read(buf, sizeof(buf))) > 0) {
+        for (int i = 0; i < n; i++) {
+            uint8_t b = buf[i];
+            tail = (tail << 8) | b;
+            if (!line_done) {
+                if (b == '\n')
+                    line_done = true;
+                else if (b != '\r' && line_len < sizeof(line) - 1)
+                    line[line_len++] = b;
+                else if (b != '\r')
+                    line_long = true;
+            }
+            if (tail == 0x0D0A0D0A)
+                return true; // anything after is a body no route takes
+        }
+    }
+    return false;
+}
+
+static void poll_client()
+{
+    if (read_request()) {
+        handle_request();
+        return;
+    }
+    if (!client.connected() || millis() - accepted_at >= LOCAL_REQUEST_TIMEOUT) {
+        stats.timeouts++;
+        close_client();
+    }
+}
+
+void local_server_loop()
+{
+    if (!listening) {
+        if (!wifi_connected() || !listen_begin())
+            return;
+        listening = true;
+    }
+    if (!pending) {
+        client = listen_accept();
+        if (client) {
+            pending = true;
+            accepted_at = millis();
+            line_len = 0;
+            line_done = line_long = false;
+            tail = 0;
+        }
+    }
+    if (pending)
+        poll_client();
+    // nothing open now: the accept task waits for the next connection
+    if (!pending)
+        xTaskNotifyGive(accept_task);
+}
@@ -0,0 +1,23 @@
+#include "config.h"
+#include "lux.h"
+
+// computed at compile time, lives in flash
+static constexpr lux_detail::Table table = lux_detail::make_table();
+
+static_assert(table.deci_lux[0] == 0, "dark reads as 0 lux");
+static_assert(table.deci_lux[4095] > table.deci_lux[2048], "brighter is more lux");
+
+static int clamp_raw(int raw)
+{
+    return raw < 0 ? 0 : raw > 4095 ? 4095 : raw;
+}
+
+float light_lux_uncalibrated(int raw)
+{
+    return table.deci_lux[clamp_raw(raw)] * 0.1f;
+}
+
+float light_lux(int raw)
+{
+    return table.deci_lux[clamp_raw(raw + config.adc_offset)] * 0.1f * config.lux_gain / 1000.0f;
+}
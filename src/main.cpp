@@ -1,56 +1,55 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
-#include <HttpClient.h>
 #include <WiFi.h>
 #include <inttypes.h>
 #include <stdio.h>
+#include <string.h>
 #include "esp_system.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "nvs.h"
-#include "nvs_flash.h"
-#include "DHT20.h"
 #include <TFT_eSPI.h>
-#include <vector>
+#include "nvs.h"
+#include "aggregate.h"
+#include "boot_profile.h"
+#include "breaker.h"
+#include "buzzer.h"
+#include "config.h"
+#include "deadband.h"
+#include "heap_monitor.h"
+#include "i2c_bus.h"
+#include "input.h"
+#include "latency.h"
+#include "local_server.h"
+#include "ota.h"
+#include "plants.h"
+#include "power_stats.h"
+#include "prediction.h"
+#include "recent.h"
+#include "sample.h"
+#include "scheduler.h"
+#include "transport.h"
+#include "ui.h"
+#include "uplink.h"
+#include "wifi_manager.h"
 
-#define BUZZER_PIN 15
 #define PHOTORESISTOR_PIN 33
 
-// DEFINING BUZZER VALUES
-#define BUZZER_OFF_STATE 0
-#define BUZZER_ON_STATE 1
-#define BUZZER_OFF_TIME 1800000 // 30min * 60s/min = 1800s * 1000ms/s = 1800000ms
-#define BUZZER_ON_TIME 10000 // 10s * 1000ms/s = 10000ms
-
-std::vector<unsigned long> dryingPeriods;
-size_t PERIODS_STORED; // 5 for demo, 20 for real application (enought to calibrate drying times)
-float days_till_watering;
-unsigned long millis_till_watering;
-unsigned long last_time_watered;
-unsigned long loop_begin_time;
-unsigned long loop_end_time;
-bool calculating_loop_time;
-bool predicted;
-
-struct SensorData {
-    String temp;
-    String moisture;
-    String light;
-};
-
-int buzzer_state; // Buzzer state
-unsigned long buzzer_timer; // Buzzer timer
+// light sensor per shelf, shelf m being the pots behind the mux at 0x70 + m;
+// ADC1 pins only, ADC2 is unusable while WiFi is on (35 is the right button)
+const uint8_t kShelfLightPins[] = {PHOTORESISTOR_PIN, 32, 34, 36, 39};
 
-TFT_eSPI ttg = TFT_eSPI(); 
-void display_loop(SensorData sensor_val);
+// JOB PERIODS (ms), the sensor/display/uplink/buzzer ones live in config
+#define WIFI_PERIOD 100
+#define PERSIST_PERIOD 600000 // 10min
 
-// Server details
-const char serverAddress[] = "3.149.230.7"; // adjust with instance
-const int serverPort = 5000;
+SensorData sensor_val; // latest sample of plant 0, shared by the display and uplink jobs
+Scheduler scheduler;
+int sensor_job_id, display_job_id, uplink_job_id, buzzer_job_id, ota_job_id, local_job_id;
+Breaker uplink_breaker; // skips the uplink while the server is unreachable
+
+TFT_eSPI ttg = TFT_eSPI(); 
 
-// This example downloads the URL "http://arduino.cc/"
-char ssid[50]; // your network SSID (name)
-char pass[50]; // your network password (use for WPA, or use as key for WEP)
+// Server details are in config.server_address / config.server_port
 
 const char kHostname[] = "worldtimeapi.org"; // Name of the server we want to connect to
 const char kPath[] = "/api/timezone/Europe/London.txt"; // Path to download (this is the bit after the hostname in the URL that you want to download
@@ -58,237 +57,145 @@ const char kPath[] = "/api/timezone/Europe/London.txt"; // Path to download (thi
 const int kNetworkTimeout = 30 * 1000; // num of ms to wait without receiving any data before we give up
 const int kNetworkDelay = 1000; // num of ms to wait if no data is available before trying again
 
-// Photoresistor mapping
-const int lightMin = 0;
-const int lightMax = 4095;
+// Photoresistor mapping is in sample.h
 
-const int desiredMin = 0;
-const int desiredMax = 100;
-
-// DHT initialization
-DHT20 DHT;
-uint8_t count_var = 0;
-const int dry = 60; // this number and below indicates a dry plant
-const int shade = 2500; // this number and below indicates not in a sunny spot
+// DHT20s are in the plant registry (plants.h)
+// dry/shade thresholds are in config.dry / config.shade
 
 // Function declarations
-void nvs_access();
 void aws_setup();
-void aws_loop(const String & send_val);
-String aws_loop_msg(SensorData sensor_val);
+bool aws_loop(const char *send_val, const WindowStats *window);
+size_t aws_loop_msg(const SensorData &sensor_val, char *buf, size_t len);
 
-SensorData temp_moisture_light();
 void sensor_data_setup();
-SensorData sensor_data_loop();
+int sensor_data_loop();
 
-void nvs_access() 
+void aws_setup()
 {
-    // Initialize NVS
-    esp_err_t err = nvs_flash_init();
-    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        // NVS partition was truncated and needs to be erased
-        // Retry nvs_flash_init
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        err = nvs_flash_init();
-    }
-    ESP_ERROR_CHECK(err);
-    
-    // Open
-    Serial.printf("\n");
-    Serial.printf("Opening Non-Volatile Storage (NVS) handle... ");
-    nvs_handle_t my_handle;
-    err = nvs_open("storage", NVS_READWRITE, &my_handle);
-    if (err != ESP_OK) {
-        Serial.printf("Error (%s) opening NVS handle!\n", esp_err_to_name(err));
-    } else {
-        Serial.printf("Done\n");
-        Serial.printf("Retrieving SSID/PASSWD\n");
-        size_t ssid_len;
-        size_t pass_len;
-        err = nvs_get_str(my_handle, "ssid", ssid, &ssid_len);
-        err |= nvs_get_str(my_handle, "pass", pass, &pass_len);
-        switch (err) {
-            case ESP_OK:
-                Serial.printf("Done\n");
-                //Serial.printf("SSID = %s\n", ssid);
-                //Serial.printf("PASSWD = %s\n", pass);
-                break;
-            case ESP_ERR_NVS_NOT_FOUND:
-                Serial.printf("The value is not initialized yet!\n");
-                break;
-            default:
-                Serial.printf("Error (%s) reading!\n", esp_err_to_name(err));
-        }
-    }
-    // Close
-    nvs_close(my_handle);
+    // Kicks off the connection; wifi_loop() finishes it without blocking
+    wifi_setup();
 }
 
-void aws_setup()
+size_t aws_loop_msg(const SensorData &sensor_val, char *buf, size_t len)
 {
-    // Retrieve SSID/PASSWD from flash before anything else
-    nvs_access();
-    
-    // We start by connecting to a WiFi network
-    Serial.println();
-    Serial.println();
-    Serial.print("Connecting to ");
-    Serial.println(ssid);
-    WiFi.begin(ssid, pass);
-    while (WiFi.status() != WL_CONNECTED) {
-        delay(500);
-        Serial.print(".");
-    }
-    Serial.println("");
-    Serial.println("WiFi connected");
-    Serial.println("IP address: ");
-    Serial.println(WiFi.localIP());
-    Serial.println("MAC address: ");
-    Serial.println(WiFi.macAddress());
+  return sample_message(sensor_val, config.dry, config.shade, buf, len);
 }
 
-String aws_loop_msg(SensorData sensor_val)
+void aws_handle_response(const char *body, size_t len)
 {
-  float f = (sensor_val.temp.toFloat() * 1.8) + 32;
-  int mappedValue = map(sensor_val.light.toFloat(), lightMin, lightMax, desiredMin, desiredMax);
-
-  if (sensor_val.moisture.toFloat() >= dry && sensor_val.light.toFloat() >= shade)
-    return "Temperature: " + sensor_val.temp + "°C / " + f + "°F, Moisture: " + sensor_val.moisture + "%, Light: " + String(mappedValue) + "%";
-  else if (sensor_val.moisture.toFloat() < dry && sensor_val.light.toFloat() < shade)
-    return "Temperature: " + sensor_val.temp + "°C / " + f + "°F, Low Moisture: " + sensor_val.moisture + "%, Low Light: " + String(mappedValue) + "%";
-  else if (sensor_val.moisture.toFloat() < dry)
-    return "Temperature: " + sensor_val.temp + "°C / " + f + "°F, Low Moisture: " + sensor_val.moisture + "%, Light: " + String(mappedValue) + "%";
-  else if (sensor_val.light.toFloat() < shade)
-    return "Temperature: " + sensor_val.temp + "°C / " + f + "°F, Moisture: " + sensor_val.moisture + "%, Low Light: " + String(mappedValue) + "%";
-  return "";
+    bool was_raw = uplink_raw(millis());
+    switch (uplink_handle_response(body, len, millis())) {
+    case UPLINK_RESP_APPLIED:
+        Serial.printf("Config updated to rev %" PRIu32 "\n", config.rev);
+        break;
+    case UPLINK_RESP_REJECTED:
+        Serial.println("Config delta rejected");
+        break;
+    default:
+        break;
+    }
+    if (uplink_raw(millis()) != was_raw)
+        Serial.println(was_raw ? "Raw samples off" : "Raw samples on");
 }
 
-void aws_loop(const String & send_val)
+// True once the server has the sample/window (and any queued ones sent with it)
+bool aws_loop(const char *send_val, const WindowStats *window)
 {
-    int err = 0;
-    WiFiClient c;
-    HttpClient http(c);
-    //err = http.get(kHostname, kPath); // UNCOMMENT WHEN TESTING, COMMENT BELOW LINE
-
-    JsonDocument doc;
-    doc["send_val"] = send_val;
-    
-    String jsonStr;
-    serializeJson(doc, jsonStr);
-
-    String path = "/submit";
-    http.beginRequest();
-    http.post(serverAddress, serverPort, path.c_str());
-    http.sendHeader("Content-Type", "application/json");
-    http.sendHeader("Content-Length", jsonStr.length());
-
-    http.print(jsonStr);
-    http.endRequest();
-
-    // Handle the response from the server
-    err = http.responseStatusCode();
-    if (err != 200) 
-    {
-        Serial.print("Got status code: ");
-        Serial.println(err);
+    LatencyTimer lat = latency_start();
+    size_t body_len = uplink_build(send_val, window, millis());
+    latency_stop(LAT_JSON, lat);
+    if (body_len == 0) {
+        Serial.println("Uplink document too large for its buffers");
+        return false;
     }
+    // HTTP POST or MQTT publish, whichever config.transport says; the
+    // server's answer comes back through aws_handle_response()
+    return transport_send(body_len);
+}
 
-    http.stop();
+void sensor_data_setup()
+{
+  i2c_setup(); // 400 kHz, unsticks the bus if a reset left a slave holding SDA
+  // every plant's first conversion (~80ms) runs while the display initializes
+  size_t n = plants_discover(kShelfLightPins, sizeof(kShelfLightPins), millis());
+  Serial.printf("%u plant(s)\n", (unsigned)n);
 }
 
-SensorData temp_moisture_light() 
+SensorData sensor_first_read()
 {
-    float t = DHT.getTemperature();
-    float h = DHT.getHumidity();
-    int l = analogRead(PHOTORESISTOR_PIN);
+  // collect the conversions started in sensor_data_setup(), and start the next
+  delay(100);
+  for (size_t i = 0; i < plants_count(); i++) {
+    int id = plants_sample_next();
+    if (id >= 0) {
+      window_add(plant_at(id).window, plant_at(id).last);
+      recent_add(plant_at(id).last, id, millis());
+    }
+  }
+  return plant_at(0).last;
+}
 
-    SensorData data;
-    data.temp = String(t, 2);
-    data.moisture = String(h, 2);
-    data.light = String(l);
+int sensor_data_loop()
+{
+  // one plant per call, called every sensor_period / plant count by the scheduler
+  power_set(POWER_SENSOR, true, millis());
+  LatencyTimer lat = latency_start();
+  int id = plants_sample_next();
+  latency_stop(LAT_SENSOR, lat);
+  power_set(POWER_SENSOR, false, millis());
+  return id;
+}
 
-    return data;
+void buzzer_setup()
+{
+    // INITIALIZING BUZZER VALUES
+    buzzer_hw_setup(); // LEDC channel on BUZZER_PIN + pattern timer
+    buzzer_set_pattern(&BUZZER_PATTERN_CONTINUOUS);
 }
 
-void sensor_data_setup()
+void config_changed()
 {
-  Wire.begin();
-  DHT.begin(); // ESP32 default pins 21 22
+  uint32_t now = millis();
+  scheduler.set_period(sensor_job_id, plants_tick(config.sensor_period), now);
+  scheduler.set_period(display_job_id, config.display_period, now);
+  scheduler.set_period(uplink_job_id, config.uplink_period, now);
+  scheduler.set_period(buzzer_job_id, config.buzzer_off_time, now);
+  if (config.ota_period == 0)
+    scheduler.cancel(ota_job_id);
+  else if (!scheduler.job(ota_job_id).active)
+    scheduler.run_at(ota_job_id, now + config.ota_period);
+  scheduler.set_period(ota_job_id, config.ota_period, now);
+
+  for (size_t i = 0; i < plants_count(); i++)
+    prediction_set_capacity(plant_at(i).prediction, config.periods_stored);
 }
 
-SensorData sensor_data_loop()
+void transport_job()
 {
-    SensorData data = temp_moisture_light();
-    if (millis() - DHT.lastRead() >= 1000)
-    {
-      //  READ DATA
-      uint32_t start = micros();
-      int status = DHT.read();
-      uint32_t stop = micros();
-
-      if ((count_var % 10) == 0)
-        count_var = 0;
-      count_var++;
-
-      switch (status)
-      {
-        case DHT20_OK:
-          break;
-        case DHT20_ERROR_CHECKSUM:
-          Serial.println("Checksum error");
-          break;
-        case DHT20_ERROR_CONNECT:
-          Serial.println("Connect error");
-          break;
-        case DHT20_MISSING_BYTES:
-          Serial.println("Missing bytes");
-          break;
-        case DHT20_ERROR_BYTES_ALL_ZERO:
-          Serial.println("All bytes read zero");
-          break;
-        case DHT20_ERROR_READ_TIMEOUT:
-          Serial.println("Read time out");
-          break;
-        case DHT20_ERROR_LASTREAD:
-          Serial.println("Error read too fast");
-          break;
-        default:
-          Serial.println("Unknown error");
-          break;
-      }
-  }
-  return data;
+  transport_poll(millis()); // MQTT keep-alive and pushes, nothing for HTTP
 }
 
-void buzzer_setup()
+void local_job()
 {
-    // INITIALIZING BUZZER VALUES
-    pinMode(BUZZER_PIN, OUTPUT); // Configure buzzer pin
-    buzzer_timer = millis() + BUZZER_OFF_TIME;
-    buzzer_state = BUZZER_OFF_STATE;
+  local_server_loop();
+  // quick polls only while a request is coming in; once it listens, the
+  // accept task wakes loop() for the next connection and runs this again
+  if (local_server_busy())
+    scheduler.set_period(local_job_id, LOCAL_SERVER_PERIOD, millis());
+  else if (local_server_listening())
+    scheduler.cancel(local_job_id);
+  else
+    scheduler.set_period(local_job_id, LOCAL_SERVER_IDLE_PERIOD, millis());
 }
 
-void buzz(unsigned long on)
+void ota_job()
 {
-    tone(BUZZER_PIN, 10);
-    delay(on);
-    noTone(BUZZER_PIN);
+  ota_check(); // only returns if there was nothing to install
 }
 
-void buzzerSwitch() 
+void buzzer_job()
 {
-    switch(buzzer_state)
-    {
-      case BUZZER_OFF_STATE:
-        if (millis() >= buzzer_timer)
-            buzzer_state = BUZZER_ON_STATE;
-        break;
-      case BUZZER_ON_STATE:
-        buzz(BUZZER_ON_TIME);
-        buzzer_timer = millis() + BUZZER_OFF_TIME;
-        buzzer_state = BUZZER_OFF_STATE;
-        break;
-    }
+    buzzer_play(); // plays in the background, loop() keeps running
 }
 
 void display_setup() 
@@ -298,129 +205,237 @@ void display_setup()
   ttg.setTextSize(1);
   ttg.setTextColor(TFT_WHITE);
   ttg.fillScreen(TFT_BLACK);
+  power_set(POWER_DISPLAY, true, millis()); // backlight comes on with init()
 }
 
-void display_loop(SensorData sensor_val, bool predicted)
+// everything the UI task draws from, copied out of the globals in one go
+void ui_snapshot(UiSnapshot &s)
 {
-  if (sensor_val.temp == "0" && sensor_val.moisture == "0" && sensor_val.light == "0")
-    return;
-
-  ttg.setTextSize(2);
-  ttg.setTextColor(TFT_WHITE);
-  ttg.fillScreen(TFT_BLACK);
+  uint32_t now = millis();
+  s.sensor = sensor_val;
+  s.dry = config.dry;
+  s.shade = config.shade;
+
+  const Prediction &prediction = plant_at(0).prediction;
+  s.predicted = prediction.predicted;
+  s.days_left = prediction.days_left;
+  s.since_watered_ms = now - prediction.last_watered;
+  memcpy(s.periods, prediction.periods, prediction.count * sizeof(uint32_t));
+  s.period_count = prediction.count;
+  s.plant_count = plants_count();
+  for (size_t i = 0; i < plants_count(); i++) {
+    s.plant_predicted[i] = plant_at(i).prediction.predicted;
+    s.plant_days_left[i] = plant_at(i).prediction.days_left;
+  }
 
-  ttg.drawString("Temp.: " + sensor_val.temp + " C", 0, 0, 1);
-  
-  // checking moisture levels
-  if (sensor_val.moisture.toFloat() < dry) 
-    ttg.drawString("Low Moist.: " + sensor_val.moisture + "%", 0, 32, 1);
-  else
-    ttg.drawString("Moist.: " + sensor_val.moisture + "%", 0, 32, 1);
-  
-  int mappedValue = map(sensor_val.light.toFloat(), lightMin, lightMax, desiredMin, desiredMax);
+  s.wifi_up = wifi_connected();
+  s.rssi = s.wifi_up ? WiFi.RSSI() : 0;
+  s.ip = s.wifi_up ? (uint32_t)WiFi.localIP() : 0;
+  s.breaker = uplink_breaker.state;
+  s.queued = uplink_queued();
+  s.queue_dropped = uplink_queue_dropped();
+  HeapStats hs = heap_monitor_sample();
+  s.heap_free = hs.free;
+  s.heap_largest = hs.largest_block;
+  s.uptime_s = now / 1000;
+  s.config_rev = config.rev;
+}
 
-  if (sensor_val.light.toFloat() < shade)
-    ttg.drawString("Low Light: " + String(mappedValue) + "%", 0, 64, 1);
-  else
-    ttg.drawString("Light: " +  String(mappedValue) + "%", 0, 64, 1);
-  
-  ttg.setTextColor(TFT_RED);
-  if (predicted) 
-    ttg.drawString("Countdown: " + String(days_till_watering), 0, 96, 1);
-  else
-    ttg.drawString("Getting water data...", 0, 96, 1);
+void predictMillisTillWateringSetup(){
+  // plants_add() started each countdown; drying periods survive reboots,
+  // the times they were measured at don't matter
+  nvs_handle_t my_handle;
+  if (nvs_open("storage", NVS_READONLY, &my_handle) == ESP_OK) {
+    for (size_t i = 0; i < plants_count(); i++) {
+      char key[16];
+      plant_nvs_key(plant_at(i), key, sizeof(key));
+      uint32_t stored[CONFIG_PERIODS_MAX];
+      size_t len = sizeof(stored);
+      if (nvs_get_blob(my_handle, key, stored, &len) == ESP_OK)
+        prediction_load(plant_at(i).prediction, stored, len / sizeof(uint32_t));
+    }
+    nvs_close(my_handle);
+  }
+}
 
+void persist_job()
+{
+  nvs_handle_t my_handle;
+  bool opened = false;
+  for (size_t i = 0; i < plants_count(); i++) {
+    Prediction &prediction = plant_at(i).prediction;
+    if (!prediction.dirty)
+      continue;
+    if (!opened && nvs_open("storage", NVS_READWRITE, &my_handle) != ESP_OK)
+      return;
+    opened = true;
+    char key[16];
+    plant_nvs_key(plant_at(i), key, sizeof(key));
+    if (nvs_set_blob(my_handle, key, prediction.periods, prediction.count * sizeof(uint32_t)) == ESP_OK &&
+        nvs_commit(my_handle) == ESP_OK)
+      prediction.dirty = false;
+  }
+  if (opened)
+    nvs_close(my_handle);
 }
 
-unsigned long avg(std::vector<unsigned long> time_periods){
-  unsigned long sum = 0;
-  int len = (int)time_periods.size();
-  for (int i=0; i < len; i++)
-    sum += time_periods[i];
-  return sum / (unsigned long)len;
+void sensor_job()
+{
+  int id = sensor_data_loop();
+  if (id < 0)
+    return; // nothing new from this plant on this visit
+  Plant &p = plant_at(id);
+  //Serial.printf("Plant %d Temperature: %.2f Moisture: %.2f Light: %d\n", id, p.last.temp, p.last.moisture, p.last.light); // Uncomment for testing sensor data, comment AWS out
+  prediction_sample(p.prediction, p.last.moisture, config.dry, millis());
+  window_add(p.window, p.last);
+  recent_add(p.last, id, millis()); // for the local endpoint
+  if (id == 0)
+    sensor_val = p.last;
 }
 
-float millisToDays(unsigned long mills) {
-  return mills * (1/8.64e+7);
+void display_job()
+{
+  // the UI task does the drawing, at its own priority
+  LatencyTimer lat = latency_start();
+  UiSnapshot snap;
+  ui_snapshot(snap);
+  ui_publish(snap);
+  input_post(INPUT_REFRESH);
+  latency_stop(LAT_DISPLAY, lat);
 }
 
-unsigned long predictMillisTillWateringLoop(SensorData sensor_vals){
-  // returns average periods of time it takes for the plant to need watering
-  if (sensor_vals.moisture.toFloat() < dry) {
-    if (dryingPeriods.size() >= PERIODS_STORED)
-      dryingPeriods.erase(dryingPeriods.begin()); // remove least recent drying period
-    dryingPeriods.push_back(millis()-last_time_watered); // add most recent drying period
-    // last time watered will be initialized as the time at setup (assuming plant starts "watered" for countown)
+void uplink_job()
+{
+  uint32_t now = millis();
+  // per plant: a summary once per aggregate_window, if it differs from the
+  // last one sent or the heartbeat is due; every sample only with
+  // aggregation off (same deadband rule) or while the server has asked for
+  // a raw burst of that plant. Plant 0's go in the request itself, the
+  // others' through the queue, a batch of which rides along with every
+  // request until it is empty.
+  SensorData sample;
+  WindowStats closed;
+  bool send_sample = false, send_window = false;
+  for (size_t i = 0; i < plants_count(); i++) {
+    Plant &p = plant_at(i);
+    bool raw = (uplink_raw(now) && uplink_raw_plant() == i) ||
+               (config.aggregate_window == 0 && deadband_sample(p.deadband, p.last, now));
+    if (raw && i == 0) {
+      sample = p.last;
+      send_sample = true;
+    } else if (raw) {
+      uplink_queue(p.last, now, i);
+    }
+    if (config.aggregate_window == 0 || now - p.window.start < config.aggregate_window)
+      continue;
+    WindowStats w = p.window;
+    window_close(w, now);
+    w.plant = i;
+    window_start(p.window, now);
+    // n == 0: the sensor had nothing valid all window
+    if (w.n == 0 || !deadband_window(p.deadband, w, now))
+      continue;
+    if (i == 0) {
+      closed = w;
+      send_window = true;
+    } else {
+      uplink_queue_window(w, now);
+    }
   }
-  if (!dryingPeriods.empty()){
-    // if there are values, we can find an average
-    return avg(dryingPeriods); // average current drying periods in millis() 
-  } else return 0.0;
-  // if there are no values yet, we will keep predicted time 0.0
-}
+  if (!send_sample && !send_window && uplink_queued() == 0)
+    return;
 
-void predictMillisTillWateringSetup(){
-  PERIODS_STORED = 5; // 5 for demo, 20 for real application (enought to calibrate drying times)
-  days_till_watering = 0.0;
-  millis_till_watering = 0.0;
-  last_time_watered = millis();
-  calculating_loop_time = true;
-  predicted = false;
+  // while wifi_loop() is (re)connecting or the server is out, the sample just
+  // waits in the queue; that costs a copy, not a connect timeout
+  if (!wifi_connected() || !breaker_allow(uplink_breaker, now)) {
+    if (send_window)
+      uplink_queue_window(closed, now);
+    if (send_sample)
+      uplink_queue(sample, now, 0);
+    return;
+  }
+
+  char msg[SAMPLE_MSG_MAX];
+  if (send_sample)
+    aws_loop_msg(sample, msg, sizeof(msg));
+  BreakerState was = uplink_breaker.state;
+  if (aws_loop(send_sample ? msg : nullptr, send_window ? &closed : nullptr)) {
+    if (was != BREAKER_CLOSED)
+      Serial.printf("Uplink: server back, %u samples queued\n", (unsigned)uplink_queued());
+    breaker_success(uplink_breaker);
+    return;
+  }
+  if (send_window)
+    uplink_queue_window(closed, now);
+  if (send_sample)
+    uplink_queue(sample, now, 0);
+  breaker_failure(uplink_breaker, millis(), esp_random());
+  if (uplink_breaker.state == BREAKER_OPEN)
+    Serial.printf("Uplink: breaker open, next try in %" PRIu32 " ms\n", uplink_breaker.open_for);
 }
 
 void setup() 
 {
-  pinMode(PHOTORESISTOR_PIN, INPUT);
+  boot_mark("reset", 0);
   Serial.begin(9600);
-  delay(1000);
+  power_stats_setup(millis());
 
+  // independent init is overlapped: WiFi associates in the background from here on,
+  // and the first DHT20 conversions run while the display is brought up
+  aws_setup(); // Uncomment for testing AWS
+  boot_mark("wifi_started", micros());
+  config_setup(); // NVS is up now, wifi_setup() initialized it
+  sensor_data_setup();
+  boot_mark("sensor_started", micros());
   display_setup();
+  boot_mark("display", micros());
   buzzer_setup();
-  sensor_data_setup();
-  aws_setup(); // Uncomment for testing AWS
   predictMillisTillWateringSetup();
-}
-
-bool watered(float moisture){
-  if (moisture == 100){
-    // 100% is the RH of a watered/well hydrated plant
-    // because it will be at 100% for some time, the coundown will continue changing until the rh finally goes below 100%
-    last_time_watered = millis(); // set last time watered to millis()
-    return true; // return true
-  } 
-  return false;
+  boot_mark("setup", micros());
+
+  sensor_val = sensor_first_read();
+  input_setup();
+  ui_setup(ttg);
+  display_job(); // first frame, drawn by the UI task as soon as it's queued
+  boot_mark("first_reading", micros());
+  boot_print();
+
+  uint32_t now = millis();
+  scheduler.add("wifi", wifi_loop, WIFI_PERIOD, 0, now);
+  transport_on_reply(aws_handle_response);
+  transport_setup();
+  scheduler.add("transport", transport_job, TRANSPORT_POLL_PERIOD, 0, now);
+  local_server_setup();
+  local_job_id = scheduler.add("local", local_job, LOCAL_SERVER_IDLE_PERIOD, 0, now); // listens once WiFi is up
+  // first sample is already on screen, the regular ones start a period later
+  uint32_t tick = plants_tick(config.sensor_period);
+  sensor_job_id = scheduler.add("sensor", sensor_job, tick, tick, now);
+  // display/uplink trail the sensor job slightly so they always see a fresh sample
+  display_job_id = scheduler.add("display", display_job, config.display_period, config.sensor_period + 10, now);
+  uplink_job_id = scheduler.add("uplink", uplink_job, config.uplink_period, 20, now);
+  buzzer_job_id = scheduler.add("buzzer", buzzer_job, config.buzzer_off_time, config.buzzer_off_time, now);
+  scheduler.add("persist", persist_job, PERSIST_PERIOD, PERSIST_PERIOD, now);
+  // first check a minute in, once WiFi has had time to come up
+  ota_job_id = scheduler.add("ota", ota_job, config.ota_period, 60000, now);
+  if (config.ota_period == 0)
+    scheduler.cancel(ota_job_id);
+  scheduler.add("heap", heap_monitor_job, HEAP_MONITOR_PERIOD, HEAP_MONITOR_PERIOD, now);
+  config_on_change(config_changed);
+  breaker_init(uplink_breaker);
+  heap_monitor_setup(); // everything after this point should be allocation-free
 }
 
 void loop() 
 {
-  if ((calculating_loop_time) && (predicted)){
-    loop_begin_time = millis(); // should only do this once
-  }
-  buzzerSwitch(); // switch case between buzzer's on and off states
-  SensorData sensor_val = sensor_data_loop();
-  //Serial.println("Temperature: " + sensor_val.temp + " Moisture: " + sensor_val.moisture + " Light: " + sensor_val.light); // Uncomment for testing sensor data, comment AWS out
-  if (watered(sensor_val.moisture.toFloat())){
-    // watered function updates last_time_watered which is used in predicting function
-    millis_till_watering = predictMillisTillWateringLoop(sensor_val);
-    days_till_watering = millisToDays(millis_till_watering);
-    predicted = true;
-  }
-
-  display_loop(sensor_val, predicted);
-
-  // DECREMENTING COUNTDOWN
-  if ((predicted) && (days_till_watering != 0) && (!calculating_loop_time)){
-    // if we have a predicted value, the countdown isn't done yet, and the duration of the loop has been calculated
-    millis_till_watering = millis_till_watering - (loop_end_time - loop_begin_time); // decrement count_down by loop_time
-    days_till_watering = millisToDays(millis_till_watering);
-  }
-
-  aws_loop(aws_loop_msg(sensor_val)); // Uncomment for testing AWS
-  delay(1000);
-
-  // CALCULATING DURATION OF LOOP, SO EACH ITERATION CAN DECREMENT TIMER
-  if ((calculating_loop_time) && (predicted)){
-    loop_end_time = millis(); // should only do this once
-    calculating_loop_time = false;
+  power_set(POWER_CPU, true, millis());
+  LatencyTimer lat = latency_start();
+  uint32_t wait = scheduler.run_due(millis());
+  latency_stop(LAT_LOOP, lat);
+  // blocks like delay(), so the CPU sits in the idle task until the next job
+  // is due, unless the local server's accept task has a connection first
+  if (wait > 0) {
+    power_set(POWER_CPU, false, millis());
+    if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait)) > 0)
+      scheduler.run_at(local_job_id, millis());
   }
 }
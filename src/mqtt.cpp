@@ -0,0 +1,311 @@
+#include <Arduino.h>
+#include <WiFi.h>
+#include <string.h>
+#include "http_response.h"
+#include "mqtt.h"
+#include "segment_writer.h"
+
+static WiFiClient sock;
+static bool up;
+static uint8_t rx[MQTT_RX_MAX]; // the front of it is always the start of a packet
+static size_t rx_len;
+static uint16_t next_id = 1;
+static uint32_t last_sent; // millis(), the keep-alive counts from our side
+static bool ping_out;
+static uint32_t ping_at;
+static bool connack_seen;
+static uint8_t connack_code;
+static bool acked;
+static uint16_t acked_id;
+static MqttMessageFn on_message;
+static MqttStats stats;
+
+size_t mqtt_encode_length(uint8_t *out, uint32_t n)
+{
+    size_t i = 0;
+    do {
+        uint8_t b = n % 128;
+        n /= 128;
+        if (n)
+            b |= 0x80;
+        out[i++] = b;
+    } while (n && i < 4);
+    return i;
+}
+
+int mqtt_decode_length(const uint8_t *p, size_t len, uint32_t &n)
+{
+    uint32_t mul = 1;
+    n = 0;
+    for (size_t i = 0; i < 4; i++) {
+        if (i >= len)
+            return 0;
+        n += (p[i] & 0x7F) * mul;
+        if (!(p[i] & 0x80))
+            return i + 1;
+        mul *= 128;
+    }
+    return -1;
+}
+
+void mqtt_on_message(MqttMessageFn fn)
+{
+    on_message = fn;
+}
+
+static void drop()
+{
+    if (up)
+        stats.drops++;
+    sock.stop();
+    up = false;
+    rx_len = 0;
+}
+
+static bool send_raw(const uint8_t *p, size_t n)
+{
+    if (sock.write(p, n) != n) {
+        drop();
+        return false;
+    }
+    last_sent = millis();
+    return true;
+}
+
+static void put_string(uint8_t *&p, const char *s, size_t n)
+{
+    *p++ = n >> 8;
+    *p++ = n & 0xFF;
+    memcpy(p, s, n);
+    p += n;
+}
+
+// one whole packet: the first byte, and what follows the remaining length
+static void handle(uint8_t first, const uint8_t *body, uint32_t len)
+{
+    switch (first >> 4) {
+    case MQTT_CONNACK:
+        connack_seen = true;
+        connack_code = len >= 2 ? body[1] : 0xFF;
+        break;
+    case MQTT_PUBACK:
+        if (len >= 2) {
+            acked_id = body[0] << 8 | body[1];
+            acked = true;
+            stats.acked++;
+        }
+        break;
+    case MQTT_PUBLISH: {
+        uint8_t qos = (first >> 1) & 3;
+        uint32_t topic_len = len >= 2 ? (body[0] << 8 | body[1]) : UINT32_MAX;
+        uint32_t off = 2 + topic_len + (qos ? 2 : 0);
+        if (topic_len == UINT32_MAX || off > len) {
+            drop();
+            return;
+        }
+        if (qos) {
+            // the broker shouldn't send above our subscription's QoS 0, but ack if it does
+            uint8_t ack[] = {MQTT_PUBACK << 4, 2, body[2 + topic_len], body[3 + topic_len]};
+            if (!send_raw(ack, sizeof(ack)))
+                return;
+        }
+        char topic[MQTT_TOPIC_MAX];
+        size_t n = topic_len < sizeof(topic) - 1 ? topic_len : sizeof(topic) - 1;
+        memcpy(topic, body + 2, n);
+        topic[n] = '\0';
+        stats.pushes++;
+        if (on_message)
+            on_message(topic, body + off, len - off);
+        break;
+    }
+    case MQTT_PINGRESP:
+        ping_out = false;
+        break;
+    default:
+        break; // SUBACK: the subscription is QoS 0, nothing to check
+    }
+}
+
+// Reads whatever has arrived and handles every whole packet in it
+static void pump()
+{
+    while (up && sock.available() > 0) {
+        if (rx_len == sizeof(rx)) {
+            drop(); // a packet bigger than we take
+            return;
+        }
+        int n = sock.read(rx + rx_len, sizeof(rx) - rx_len);
+        if (n <= 0)
+            break;
+        rx_len += n;
+        while (rx_len >= 2) {
+            uint32_t len;
+            int lb = mqtt_decode_length(rx + 1, rx_len - 1, len);
+            if (lb < 0 || 1 + lb + len > sizeof(rx)) {
+                drop();
+                return;
+            }
+            size_t total = 1 + lb + len;
+            if (lb == 0 || rx_len < total)
+                break;
+            handle(rx[0], rx + 1 + lb, len);
+            if (!up)
+                return;
+            memmove(rx, rx + total, rx_len - total);
+            rx_len -= total;
+        }
+    }
+    if (up && !sock.connected())
+        drop();
+}
+
+static bool wait_for(const bool &flag, uint32_t timeout_ms)
+{
+    uint32_t start = millis();
+    for (;;) {
+        pump();
+        if (flag)
+            return true;
+        uint32_t elapsed = millis() - start;
+        if (!up || elapsed >= timeout_ms)
+            return false;
+        wait_readable(sock, timeout_ms - elapsed);
+    }
+}
+
+bool mqtt_connect(const char *host, uint16_t port, const char *client_id, const char *sub_topic)
+{
+    if (up)
+        return true;
+    rx_len = 0;
+    connack_seen = false;
+    ping_out = false;
+    if (!sock.connect(host, port)) {
+        stats.connect_failures++;
+        return false;
+    }
+    up = true;
+
+    // CONNECT: protocol "MQTT" level 4, clean session, keep-alive; then the client id
+    size_t id_len = strnlen(client_id, MQTT_CLIENT_ID_MAX);
+    uint8_t pkt[16 + MQTT_CLIENT_ID_MAX];
+    uint8_t *p = pkt;
+    *p++ = MQTT_CONNECT << 4;
+    p += mqtt_encode_length(p, 10 + 2 + id_len);
+    put_string(p, "MQTT", 4);
+    *p++ = 4;
+    *p++ = 0x02;
+    *p++ = MQTT_KEEPALIVE_S >> 8;
+    *p++ = MQTT_KEEPALIVE_S & 0xFF;
+    put_string(p, client_id, id_len);
+    if (!send_raw(pkt, p - pkt) || !wait_for(connack_seen, MQTT_TIMEOUT_MS) || connack_code != 0) {
+        stats.connect_failures++;
+        sock.stop();
+        up = false;
+        return false;
+    }
+    stats.connects++;
+
+    // SUBSCRIBE, packet id 1, the one topic at QoS 0
+    size_t topic_len = strnlen(sub_topic, MQTT_TOPIC_MAX);
+    uint8_t sub[8 + MQTT_TOPIC_MAX];
+    p = sub;
+    *p++ = MQTT_SUBSCRIBE << 4 | 0x02;
+    p += mqtt_encode_length(p, 2 + 2 + topic_len + 1);
+    *p++ = 0;
+    *p++ = 1;
+    put_string(p, sub_topic, topic_len);
+    *p++ = 0;
+    return send_raw(sub, p - sub);
+}
+
+bool mqtt_connected()
+{
+    return up;
+}
+
+void mqtt_disconnect()
+{
+    if (!up)
+        return;
+    static const uint8_t bye[] = {MQTT_DISCONNECT << 4, 0};
+    sock.write(bye, sizeof(bye));
+    sock.stop();
+    up = false;
+    rx_len = 0;
+}
+
+uint16_t mqtt_publish_begin(SegmentWriter &out, const char *topic, size_t len, uint8_t qos)
+{
+    size_t topic_len = strnlen(topic, MQTT_TOPIC_MAX);
+    uint8_t head[8 + MQTT_TOPIC_MAX];
+    uint8_t *p = head;
+    *p++ = MQTT_PUBLISH << 4 | (qos ? 0x02 : 0);
+    p += mqtt_encode_length(p, 2 + topic_len + (qos ? 2 : 0) + len);
+    put_string(p, topic, topic_len);
+    uint16_t id = 0;
+    if (qos) {
+        id = next_id++;
+        if (next_id == 0)
+            next_id = 1; // 0 isn't a valid packet id
+        *p++ = id >> 8;
+        *p++ = id & 0xFF;
+    }
+    acked = false;
+    out.write(head, p - head);
+    return id;
+}
+
+void mqtt_publish_end(bool written)
+{
+    if (!written) {
+        drop();
+        return;
+    }
+    stats.published++;
+    last_sent = millis();
+}
+
+bool mqtt_wait_puback(uint16_t id, uint32_t timeout_ms)
+{
+    uint32_t start = millis(), elapsed;
+    while ((elapsed = millis() - start) < timeout_ms && wait_for(acked, timeout_ms - elapsed)) {
+        if (acked_id == id)
+            return true;
+        acked = false; // a late one for an earlier publish
+    }
+    drop(); // whatever happened to it, the next publish starts a fresh session
+    return false;
+}
+
+void mqtt_loop(uint32_t now)
+{
+    if (!up)
+        return;
+    pump();
+    if (!up)
+        return;
+    if (ping_out) {
+        if (now - ping_at >= MQTT_TIMEOUT_MS)
+            drop(); // broker or path gone quiet
+        return;
+    }
+    if (now - last_sent >= MQTT_KEEPALIVE_S * 500) {
+        static const uint8_t ping[] = {MQTT_PINGREQ << 4, 0};
+        if (send_raw(ping, sizeof(ping))) {
+            ping_out = true;
+            ping_at = now;
+            stats.pings++;
+        }
+    }
+}
+
+WiFiClient &mqtt_socket()
+{
+    return sock;
+}
+
+const MqttStats &mqtt_stats()
+{
+    return stats;
+}
@@ -0,0 +1,274 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <HttpClient.h>
+#include <WiFi.h>
+#include <inttypes.h>
+#include "esp_image_format.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp32/rom/miniz.h"
+#include "mbedtls/sha256.h"
+#include "config.h"
+#include "ota.h"
+#include "ota_patch.h"
+#include "static_pool.h"
+#include "wifi_manager.h"
+
+#define OTA_OUT_BUFFER 1024
+#define OTA_MANIFEST_POOL 1024 // JsonDocument storage for a manifest of up to 255 bytes
+
+static char running_sha[65];
+static uint8_t running_digest[32];
+static uint32_t running_size;
+
+#ifdef SS_STATIC_HEAP
+// ~45KB reserved for the life of the firmware, in exchange for an update that
+// can't fail on a fragmented heap
+static tinfl_decompressor static_inflator;
+static uint8_t static_dict[TINFL_LZ_DICT_SIZE];
+static StaticPool<OTA_MANIFEST_POOL> manifest_pool;
+#endif
+
+struct OtaWriter {
+    const esp_partition_t *running;
+    const esp_partition_t *target;
+    esp_ota_handle_t handle;
+    bool begun;
+    OtaPatcher *patcher;
+    mbedtls_sha256_context sha;
+    uint8_t buf[OTA_OUT_BUFFER];
+    size_t buf_len;
+};
+
+static void to_hex(const uint8_t *digest, char *out)
+{
+    for (int i = 0; i < 32; i++)
+        sprintf(out + 2 * i, "%02x", digest[i]);
+}
+
+const char *ota_running_sha256()
+{
+    if (running_sha[0] != '\0')
+        return running_sha;
+
+    // hash exactly the bytes of the image (what firmware.bin was), not the whole partition
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    esp_partition_pos_t pos = {running->address, running->size};
+    esp_image_metadata_t meta;
+    if (esp_image_get_metadata(&pos, &meta) != ESP_OK)
+        return running_sha;
+    running_size = meta.image_len;
+
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts_ret(&sha, 0);
+    uint8_t buf[512];
+    for (uint32_t off = 0; off < running_size; off += sizeof(buf)) {
+        size_t n = min((uint32_t)sizeof(buf), running_size - off);
+        esp_partition_read(running, off, buf, n);
+        mbedtls_sha256_update_ret(&sha, buf, n);
+    }
+    mbedtls_sha256_finish_ret(&sha, running_digest);
+    mbedtls_sha256_free(&sha);
+    to_hex(running_digest, running_sha);
+    return running_sha;
+}
+
+static bool read_old(uint32_t offset, uint8_t *buf, size_t len, void *ctx)
+{
+    OtaWriter *w = (OtaWriter *)ctx;
+    return esp_partition_read(w->running, offset, buf, len) == ESP_OK;
+}
+
+static bool flush_new(OtaWriter *w)
+{
+    if (w->buf_len == 0)
+        return true;
+    if (!w->begun) {
+        if (esp_ota_begin(w->target, w->patcher->new_size(), &w->handle) != ESP_OK)
+            return false;
+        w->begun = true;
+    }
+    mbedtls_sha256_update_ret(&w->sha, w->buf, w->buf_len);
+    esp_err_t err = esp_ota_write(w->handle, w->buf, w->buf_len);
+    w->buf_len = 0;
+    return err == ESP_OK;
+}
+
+static bool write_new(const uint8_t *data, size_t len, void *ctx)
+{
+    OtaWriter *w = (OtaWriter *)ctx;
+    while (len > 0) {
+        size_t n = min(len, sizeof(w->buf) - w->buf_len);
+        memcpy(w->buf + w->buf_len, data, n);
+        w->buf_len += n;
+        data += n;
+        len -= n;
+        if (w->buf_len == sizeof(w->buf) && !flush_new(w))
+            return false;
+    }
+    return true;
+}
+
+// Status line + headers, leaves the body ready to read. Returns content length or -1
+static int ota_get(HttpClient &http, const char *path)
+{
+    if (http.get(config.server_address, config.server_port, path) != 0)
+        return -1;
+    if (http.responseStatusCode() != 200 || http.skipResponseHeaders() != HTTP_SUCCESS)
+        return -1;
+    return http.contentLength();
+}
+
+// Inflates the patch body into the patcher as it arrives
+static OtaPatchStatus ota_stream(HttpClient &http, int remaining, OtaPatcher &patcher)
+{
+#ifdef SS_STATIC_HEAP
+    tinfl_decompressor *inflator = &static_inflator;
+    uint8_t *dict = static_dict;
+#else
+    tinfl_decompressor *inflator = (tinfl_decompressor *)malloc(sizeof(tinfl_decompressor));
+    uint8_t *dict = (uint8_t *)malloc(TINFL_LZ_DICT_SIZE);
+#endif
+    OtaPatchStatus status = OTA_PATCH_IO_ERROR;
+    if (inflator == nullptr || dict == nullptr)
+        goto done;
+
+    {
+        tinfl_init(inflator);
+        uint8_t in[512];
+        size_t in_len = 0, in_ofs = 0, dict_ofs = 0;
+        unsigned long last_data = millis();
+        for (;;) {
+            if (in_ofs == in_len && remaining > 0) {
+                int n = http.read(in, min((int)sizeof(in), remaining));
+                if (n <= 0) {
+                    if (millis() - last_data >= OTA_NETWORK_TIMEOUT || !http.connected())
+                        break;
+                    delay(1);
+                    continue;
+                }
+                last_data = millis();
+                in_len = n;
+                in_ofs = 0;
+                remaining -= n;
+            }
+
+            size_t in_bytes = in_len - in_ofs;
+            size_t out_bytes = TINFL_LZ_DICT_SIZE - dict_ofs;
+            int flags = TINFL_FLAG_PARSE_ZLIB_HEADER | (remaining > 0 ? TINFL_FLAG_HAS_MORE_INPUT : 0);
+            tinfl_status st = tinfl_decompress(inflator, in + in_ofs, &in_bytes, dict, dict + dict_ofs,
+                                               &out_bytes, flags);
+            in_ofs += in_bytes;
+            if (out_bytes > 0) {
+                status = patcher.feed(dict + dict_ofs, out_bytes);
+                if (status != OTA_PATCH_OK && status != OTA_PATCH_DONE)
+                    break;
+                dict_ofs = (dict_ofs + out_bytes) & (TINFL_LZ_DICT_SIZE - 1);
+            }
+            if (st == TINFL_STATUS_DONE)
+                break;
+            if (st < TINFL_STATUS_DONE || (remaining == 0 && in_ofs == in_len && st == TINFL_STATUS_NEEDS_MORE_INPUT)) {
+                status = OTA_PATCH_IO_ERROR;
+                break;
+            }
+        }
+    }
+
+done:
+#ifndef SS_STATIC_HEAP
+    free(inflator);
+    free(dict);
+#endif
+    return status;
+}
+
+bool ota_check()
+{
+    if (!wifi_connected())
+        return false;
+    const char *sha = ota_running_sha256();
+    if (sha[0] == '\0')
+        return false;
+
+    char path[160];
+    snprintf(path, sizeof(path), "/firmware/manifest?sha=%s&size=%" PRIu32, sha, running_size);
+
+    WiFiClient c;
+    HttpClient http(c);
+    int len = ota_get(http, path);
+    char body[256];
+    if (len <= 0 || len >= (int)sizeof(body)) {
+        http.stop();
+        return false;
+    }
+    size_t got = http.readBytes(body, len);
+    http.stop();
+
+#ifdef SS_STATIC_HEAP
+    manifest_pool.reset();
+    JsonDocument manifest(&manifest_pool);
+#else
+    JsonDocument manifest;
+#endif
+    if (deserializeJson(manifest, body, got) != DeserializationError::Ok)
+        return false;
+    const char *patch_path = manifest["patch"];
+    const char *new_sha = manifest["sha256"];
+    if (patch_path == nullptr || new_sha == nullptr)
+        return false; // up to date
+    Serial.printf("OTA: %s -> %.12s\n", sha, new_sha);
+
+    len = ota_get(http, patch_path);
+    if (len <= 0) {
+        http.stop();
+        return false;
+    }
+
+#ifdef SS_STATIC_HEAP
+    static OtaWriter writer;
+    OtaWriter *w = &writer;
+    memset(w, 0, sizeof(*w));
+#else
+    OtaWriter *w = new OtaWriter();
+#endif
+    OtaPatcher patcher;
+    w->running = esp_ota_get_running_partition();
+    w->target = esp_ota_get_next_update_partition(nullptr);
+    w->patcher = &patcher;
+    mbedtls_sha256_init(&w->sha);
+    mbedtls_sha256_starts_ret(&w->sha, 0);
+    patcher.begin(running_size, running_digest, read_old, write_new, w);
+
+    OtaPatchStatus status = ota_stream(http, len, patcher);
+    http.stop();
+
+    bool ok = (status == OTA_PATCH_DONE) && flush_new(w);
+    uint8_t digest[32];
+    mbedtls_sha256_finish_ret(&w->sha, digest);
+    mbedtls_sha256_free(&w->sha);
+    char digest_hex[65];
+    to_hex(digest, digest_hex);
+
+    // the rebuilt image must be the one the manifest announced, byte for byte
+    ok = ok && memcmp(digest, patcher.new_sha256(), 32) == 0 && strcmp(digest_hex, new_sha) == 0;
+    if (w->begun) {
+        if (ok)
+            ok = esp_ota_end(w->handle) == ESP_OK; // also checks the image header/checksum
+        else
+            esp_ota_abort(w->handle);
+    }
+    ok = ok && esp_ota_set_boot_partition(w->target) == ESP_OK;
+    const esp_partition_t *target = w->target;
+#ifndef SS_STATIC_HEAP
+    delete w;
+#endif
+
+    if (!ok) {
+        Serial.printf("OTA failed (patch status %d)\n", (int)status);
+        return false;
+    }
+    Serial.printf("OTA: %u bytes written to %s, restarting\n", (unsigned)patcher.written(), target->label);
+    esp_restart();
+    return true;
+}
@@ -0,0 +1,158 @@
+#include <string.h>
+#include "ota_patch.h"
+
+#define OTA_CHUNK 256
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void OtaPatcher::begin(uint32_t old_size, const uint8_t old_sha256[32], OtaReadOld read, OtaWriteNew write,
+                       void *context)
+{
+    read_old = read;
+    write_new = write;
+    ctx = context;
+    stage = HEADER;
+    state_status = OTA_PATCH_OK;
+    base_size = old_size;
+    memcpy(base_sha, old_sha256, sizeof(base_sha));
+    target_size = 0;
+    out_pos = 0;
+    scratch_len = 0;
+    scratch_need = OTA_PATCH_HEADER_LEN;
+}
+
+OtaPatchStatus OtaPatcher::fail(OtaPatchStatus s)
+{
+    state_status = s;
+    return s;
+}
+
+OtaPatchStatus OtaPatcher::copy_old(uint32_t off, uint32_t len)
+{
+    uint8_t buf[OTA_CHUNK];
+    while (len > 0) {
+        size_t n = len < OTA_CHUNK ? len : OTA_CHUNK;
+        if (!read_old(off, buf, n, ctx) || !write_new(buf, n, ctx))
+            return fail(OTA_PATCH_IO_ERROR);
+        off += n;
+        len -= n;
+        out_pos += n;
+    }
+    return OTA_PATCH_OK;
+}
+
+// Called once the op byte and its arguments are in scratch
+OtaPatchStatus OtaPatcher::start_op()
+{
+    uint32_t len = (op == 'A') ? get_u32(scratch) : get_u32(scratch + 4);
+    op_off = (op == 'A') ? 0 : get_u32(scratch);
+    if (len > target_size - out_pos)
+        return fail(OTA_PATCH_OUT_OF_RANGE);
+    if (op != 'A' && (op_off > base_size || len > base_size - op_off))
+        return fail(OTA_PATCH_OUT_OF_RANGE);
+
+    op_left = len;
+    switch (op) {
+        case 'C':
+            stage = OP;
+            return copy_old(op_off, len);
+        case 'D':
+            stage = len ? DIFF_BODY : OP;
+            break;
+        case 'A':
+            stage = len ? ADD_BODY : OP;
+            break;
+    }
+    return OTA_PATCH_OK;
+}
+
+OtaPatchStatus OtaPatcher::feed(const uint8_t *data, size_t len)
+{
+    while (len > 0 && state_status == OTA_PATCH_OK) {
+        switch (stage) {
+            case HEADER:
+            case ARGS: {
+                size_t n = scratch_need - scratch_len;
+                if (n > len)
+                    n = len;
+                memcpy(scratch + scratch_len, data, n);
+                scratch_len += n;
+                data += n;
+                len -= n;
+                if (scratch_len < scratch_need)
+                    break;
+                if (stage == HEADER) {
+                    if (memcmp(scratch, OTA_PATCH_MAGIC, 4) != 0)
+                        return fail(OTA_PATCH_BAD_HEADER);
+                    if (get_u32(scratch + 4) != base_size || memcmp(scratch + 12, base_sha, sizeof(base_sha)) != 0)
+                        return fail(OTA_PATCH_WRONG_BASE);
+                    target_size = get_u32(scratch + 8);
+                    memcpy(target_sha, scratch + 44, sizeof(target_sha));
+                    stage = OP;
+                } else {
+                    start_op();
+                }
+                break;
+            }
+            case OP:
+                op = *data++;
+                len--;
+                scratch_len = 0;
+                if (op == 'E') {
+                    if (out_pos != target_size)
+                        return fail(OTA_PATCH_OUT_OF_RANGE);
+                    stage = END;
+                    state_status = OTA_PATCH_DONE;
+                } else if (op == 'C' || op == 'D') {
+                    scratch_need = 8;
+                    stage = ARGS;
+                } else if (op == 'A') {
+                    scratch_need = 4;
+                    stage = ARGS;
+                } else {
+                    return fail(OTA_PATCH_BAD_OP);
+                }
+                break;
+            case DIFF_BODY: {
+                uint8_t buf[OTA_CHUNK];
+                size_t n = op_left < OTA_CHUNK ? op_left : OTA_CHUNK;
+                if (n > len)
+                    n = len;
+                if (!read_old(op_off, buf, n, ctx))
+                    return fail(OTA_PATCH_IO_ERROR);
+                for (size_t i = 0; i < n; i++)
+                    buf[i] += data[i];
+                if (!write_new(buf, n, ctx))
+                    return fail(OTA_PATCH_IO_ERROR);
+                data += n;
+                len -= n;
+                op_off += n;
+                op_left -= n;
+                out_pos += n;
+                if (op_left == 0)
+                    stage = OP;
+                break;
+            }
+            case ADD_BODY: {
+                size_t n = op_left < len ? op_left : len;
+                if (!write_new(data, n, ctx))
+                    return fail(OTA_PATCH_IO_ERROR);
+                data += n;
+                len -= n;
+                op_left -= n;
+                out_pos += n;
+                if (op_left == 0)
+                    stage = OP;
+                break;
+            }
+            case END:
+                break;
+        }
+    }
+    if (state_status == OTA_PATCH_DONE && len > 0)
+        return fail(OTA_PATCH_TRAILING_DATA);
+    return state_status;
+}
@@ -0,0 +1,142 @@
+#include <Arduino.h>
+#include <stdio.h>
+#include <string.h>
+#include "config.h"
+#include "i2c_bus.h"
+#include "plants.h"
+#include "sensor_drivers.h"
+
+// what every plant is read through; another part is a different driver here
+typedef SensorPipeline<Dht20Climate, AdcLight> PlantSensors;
+
+static Plant plants[PLANTS_MAX];
+static PlantSensors sensors[PLANTS_MAX]; // drivers keep per-sensor timing, one each
+static size_t count, cursor;
+static uint8_t selected_mux = PLANT_NO_MUX, selected_channel;
+
+static bool mux_write(uint8_t mux, uint8_t mask)
+{
+    return i2c_write(mux, &mask, 1) == I2C_OK;
+}
+
+// Points the bus at w's sensor. Every DHT20 answers at 0x38, so a channel
+// left open on another mux has to be closed first.
+static bool select(const PlantWiring &w)
+{
+    if (w.mux == selected_mux && w.channel == selected_channel)
+        return true;
+    if (selected_mux != PLANT_NO_MUX && selected_mux != w.mux)
+        mux_write(selected_mux, 0);
+    selected_mux = PLANT_NO_MUX;
+    if (w.mux != PLANT_NO_MUX) {
+        if (!mux_write(w.mux, 1 << w.channel))
+            return false;
+        selected_mux = w.mux;
+        selected_channel = w.channel;
+    }
+    return true;
+}
+
+void plants_clear()
+{
+    if (selected_mux != PLANT_NO_MUX)
+        mux_write(selected_mux, 0);
+    selected_mux = PLANT_NO_MUX;
+    count = cursor = 0;
+}
+
+int plants_add(const PlantWiring &w, uint32_t now)
+{
+    if (count == PLANTS_MAX)
+        return -1;
+    Plant &p = plants[count];
+    PlantSensors &s = sensors[count];
+    memset(&p, 0, sizeof(p));
+    p.wiring = w;
+    prediction_init(p.prediction, config.periods_stored, now);
+    window_start(p.window, now);
+    deadband_init(p.deadband);
+
+    s = PlantSensors();
+    s.light.pin = w.light_pin;
+    p.present = select(w) && s.begin();
+    if (p.present)
+        s.poll(p.last); // starts the first conversion, ready by the first visit
+    return count++;
+}
+
+size_t plants_discover(const uint8_t *light_pins, size_t n_pins, uint32_t now)
+{
+    plants_clear();
+    bool any_mux = false;
+    Dht20Climate probe;
+    for (uint8_t m = 0; m < PLANT_MUXES; m++) {
+        uint8_t mux = PLANT_MUX_BASE + m;
+        if (!mux_write(mux, 0))
+            continue; // not fitted
+        any_mux = true;
+        for (uint8_t c = 0; c < PLANT_MUX_CHANNELS; c++) {
+            PlantWiring w = {mux, c, light_pins[m % n_pins]};
+            if (select(w) && probe.begin())
+                plants_add(w, now);
+        }
+        mux_write(mux, 0);
+        selected_mux = PLANT_NO_MUX;
+    }
+    if (!any_mux) {
+        PlantWiring w = {PLANT_NO_MUX, 0, light_pins[0]};
+        plants_add(w, now);
+    }
+    return count;
+}
+
+size_t plants_count()
+{
+    return count;
+}
+
+Plant &plant_at(size_t i)
+{
+    return plants[i];
+}
+
+int plants_sample_next()
+{
+    if (count == 0)
+        return -1;
+    size_t i = cursor;
+    cursor = (cursor + 1) % count;
+    Plant &p = plants[i];
+    PlantSensors &s = sensors[i];
+
+    if (!select(p.wiring)) {
+        p.errors++;
+        s.climate.abandon();
+        return -1;
+    }
+    // the next conversion runs until this plant's turn comes round again
+    SensorPoll r = s.poll(p.last);
+    if (r == SENSOR_ERROR)
+        p.errors++;
+    p.present = p.present || s.climate.converting(); // plugged in after boot
+    if (r != SENSOR_FRESH)
+        return -1;
+    p.reads++;
+    return (int)i;
+}
+
+uint32_t plants_tick(uint32_t sensor_period)
+{
+    uint32_t tick = count > 1 ? sensor_period / count : sensor_period;
+    return tick > PLANT_TICK_MIN ? tick : PLANT_TICK_MIN;
+}
+
+void plant_nvs_key(const Plant &p, char *buf, size_t len)
+{
+    // tied to where the sensor is plugged in, not to discovery order; the
+    // single-pot board keeps the key it always had
+    if (p.wiring.mux == PLANT_NO_MUX)
+        snprintf(buf, len, "periods");
+    else
+        snprintf(buf, len, "periods_%02x_%u", p.wiring.mux, p.wiring.channel);
+}
@@ -0,0 +1,105 @@
+#include "power_stats.h"
+
+#ifdef ARDUINO
+#include "freertos/FreeRTOS.h"
+// the buzzer reports from the esp_timer task, everything else from loop()
+static portMUX_TYPE power_mux = portMUX_INITIALIZER_UNLOCKED;
+#define POWER_LOCK() portENTER_CRITICAL(&power_mux)
+#define POWER_UNLOCK() portEXIT_CRITICAL(&power_mux)
+#else
+#define POWER_LOCK()
+#define POWER_UNLOCK()
+#endif
+
+struct PowerChannel {
+    bool on;
+    uint32_t since; // time of the last update
+    uint64_t on_ms;
+    uint64_t off_ms;
+    uint32_t transitions;
+    float on_ma;
+    float off_ma;
+};
+
+static PowerChannel channels[POWER_SUBSYSTEMS];
+
+static const char *const names[POWER_SUBSYSTEMS] = {
+    "radio", "display", "sensor", "buzzer", "cpu"
+};
+
+static void accumulate(PowerChannel &c, uint32_t now)
+{
+    uint32_t dt = now - c.since;
+    if (c.on)
+        c.on_ms += dt;
+    else
+        c.off_ms += dt;
+    c.since = now;
+}
+
+void power_stats_setup(uint32_t now)
+{
+    const float defaults[POWER_SUBSYSTEMS][2] = {
+        {POWER_RADIO_ON_MA, POWER_RADIO_OFF_MA},
+        {POWER_DISPLAY_ON_MA, POWER_DISPLAY_OFF_MA},
+        {POWER_SENSOR_ON_MA, POWER_SENSOR_OFF_MA},
+        {POWER_BUZZER_ON_MA, POWER_BUZZER_OFF_MA},
+        {POWER_CPU_ON_MA, POWER_CPU_OFF_MA},
+    };
+    for (int i = 0; i < POWER_SUBSYSTEMS; i++) {
+        channels[i] = PowerChannel();
+        channels[i].since = now;
+        channels[i].on_ma = defaults[i][0];
+        channels[i].off_ma = defaults[i][1];
+    }
+    channels[POWER_CPU].on = true; // we're running setup()
+}
+
+void power_set(PowerSubsystem sub, bool on, uint32_t now)
+{
+    POWER_LOCK();
+    PowerChannel &c = channels[sub];
+    if (c.on != on) {
+        accumulate(c, now);
+        c.on = on;
+        if (on)
+            c.transitions++;
+    }
+    POWER_UNLOCK();
+}
+
+void power_set_current(PowerSubsystem sub, float on_ma, float off_ma)
+{
+    POWER_LOCK();
+    channels[sub].on_ma = on_ma;
+    channels[sub].off_ma = off_ma;
+    POWER_UNLOCK();
+}
+
+PowerResidency power_residency(PowerSubsystem sub, uint32_t now)
+{
+    POWER_LOCK();
+    PowerChannel &c = channels[sub];
+    accumulate(c, now);
+    PowerResidency r;
+    r.on_ms = c.on_ms;
+    r.off_ms = c.off_ms;
+    r.transitions = c.transitions;
+    // mA * ms -> mAh
+    r.mah = (float)((c.on_ma * (double)c.on_ms + c.off_ma * (double)c.off_ms) / 3.6e6);
+    POWER_UNLOCK();
+    return r;
+}
+
+float power_total_mah(uint32_t now)
+{
+    float total = 0;
+    for (int i = 0; i < POWER_SUBSYSTEMS; i++)
+        total += power_residency((PowerSubsystem)i, now).mah;
+    return total;
+}
+
+const char *power_name(PowerSubsystem sub)
+{
+    return names[sub];
+}
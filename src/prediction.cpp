@@ -0,0 +1,76 @@
+#include <string.h>
+#include "prediction.h"
+
+static void drop_oldest(Prediction &p)
+{
+    memmove(p.periods, p.periods + 1, (p.count - 1) * sizeof(p.periods[0]));
+    p.count--;
+}
+
+void prediction_init(Prediction &p, size_t capacity, uint32_t now)
+{
+    memset(&p, 0, sizeof(p));
+    p.capacity = capacity < CONFIG_PERIODS_MAX ? capacity : CONFIG_PERIODS_MAX;
+    // assume the plant starts out watered
+    p.last_watered = now;
+    p.last_update = now;
+}
+
+void prediction_load(Prediction &p, const uint32_t *periods, size_t n)
+{
+    for (size_t i = 0; i < n && p.count < p.capacity; i++)
+        p.periods[p.count++] = periods[i];
+}
+
+void prediction_set_capacity(Prediction &p, size_t capacity)
+{
+    p.capacity = capacity < CONFIG_PERIODS_MAX ? capacity : CONFIG_PERIODS_MAX;
+    while (p.count > p.capacity) {
+        drop_oldest(p);
+        p.dirty = true;
+    }
+}
+
+uint32_t prediction_average(const Prediction &p)
+{
+    if (p.count == 0)
+        return 0;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < p.count; i++)
+        sum += p.periods[i];
+    return (uint32_t)(sum / p.count);
+}
+
+float millis_to_days(uint32_t ms)
+{
+    return ms * (1 / 8.64e+7);
+}
+
+void prediction_sample(Prediction &p, float moisture, int dry, uint32_t now)
+{
+    if (moisture >= WATERED_RH) {
+        // a saturated reading is the RH of a watered/well hydrated plant
+        // because it will stay saturated for some time, the countdown restarts until the rh finally drops
+        p.last_watered = now;
+        p.dry_recorded = false;
+        p.millis_left = prediction_average(p);
+        p.days_left = millis_to_days(p.millis_left);
+        p.predicted = true;
+    } else {
+        if (moisture < dry && !p.dry_recorded && p.capacity > 0) {
+            // first dry sample since the last watering, that's how long this cycle took
+            if (p.count >= p.capacity)
+                drop_oldest(p); // remove least recent drying period
+            p.periods[p.count++] = now - p.last_watered;
+            p.dry_recorded = true;
+            p.dirty = true;
+        }
+        if (p.predicted && p.millis_left != 0) {
+            // count down by the real time since the last sample
+            uint32_t elapsed = now - p.last_update;
+            p.millis_left = (elapsed >= p.millis_left) ? 0 : p.millis_left - elapsed;
+            p.days_left = millis_to_days(p.millis_left);
+        }
+    }
+    p.last_update = now;
+}
@@ -0,0 +1,42 @@
+#include <math.h>
+#include "recent.h"
+
+static RecentSample ring[RECENT_MAX];
+static size_t head; // next slot written
+static size_t count;
+
+static_assert(sizeof(RecentSample) == 12, "keep the ring at 12 bytes a reading");
+
+void recent_clear()
+{
+    head = 0;
+    count = 0;
+}
+
+void recent_add(const SensorData &s, uint8_t plant, uint32_t now)
+{
+    if (!s.valid)
+        return;
+    float t = roundf(s.temp * 100);
+    float m = roundf(s.moisture * 100);
+    RecentSample &r = ring[head];
+    r.ms = now;
+    r.temp = t < -32768 ? -32768 : t > 32767 ? 32767 : (int16_t)t;
+    r.moisture = m < 0 ? 0 : m > 65535 ? 65535 : (uint16_t)m;
+    r.light = s.light < 0 ? 0 : (uint16_t)s.light;
+    r.plant = plant;
+    r.pad = 0;
+    head = (head + 1) % RECENT_MAX;
+    if (count < RECENT_MAX)
+        count++;
+}
+
+size_t recent_count()
+{
+    return count;
+}
+
+const RecentSample &recent_at(size_t i)
+{
+    return ring[(head + RECENT_MAX - count + i) % RECENT_MAX];
+}
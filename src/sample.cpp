@@ -0,0 +1,25 @@
+#include <stdio.h>
+#include "lux.h"
+#include "sample.h"
+
+int light_percent(int raw)
+{
+    // same integer math as Arduino's map()
+    return (raw - lightMin) * (desiredMax - desiredMin) / (lightMax - lightMin) + desiredMin;
+}
+
+float celsius_to_fahrenheit(float c)
+{
+    return (c * 1.8) + 32;
+}
+
+size_t sample_message(const SensorData &s, int dry, int shade, char *buf, size_t len)
+{
+    int n = snprintf(buf, len, "Temperature: %.2f°C / %.2f°F, %sMoisture: %.2f%%, %sLight: %d%% (%.0f lx)",
+                     s.temp, celsius_to_fahrenheit(s.temp),
+                     s.moisture < dry ? "Low " : "", s.moisture,
+                     s.light < shade ? "Low " : "", light_percent(s.light), light_lux(s.light));
+    if (n < 0)
+        return 0;
+    return (size_t)n < len ? (size_t)n : len - 1;
+}
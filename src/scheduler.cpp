@@ -0,0 +1,158 @@
+#include "scheduler.h"
+
+#define NOT_QUEUED 0xFF
+
+Scheduler::Scheduler() : job_count(0), heap_count(0)
+{
+    for (size_t i = 0; i < SCHED_MAX_JOBS; i++)
+        heap_pos[i] = NOT_QUEUED;
+}
+
+bool Scheduler::heap_less(size_t i, size_t j) const
+{
+    return sched_before(jobs[heap[i]].deadline, jobs[heap[j]].deadline);
+}
+
+void Scheduler::heap_swap(size_t i, size_t j)
+{
+    uint8_t tmp = heap[i];
+    heap[i] = heap[j];
+    heap[j] = tmp;
+    heap_pos[heap[i]] = i;
+    heap_pos[heap[j]] = j;
+}
+
+void Scheduler::sift_up(size_t i)
+{
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!heap_less(i, parent))
+            break;
+        heap_swap(i, parent);
+        i = parent;
+    }
+}
+
+void Scheduler::sift_down(size_t i)
+{
+    for (;;) {
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        size_t smallest = i;
+        if (left < heap_count && heap_less(left, smallest))
+            smallest = left;
+        if (right < heap_count && heap_less(right, smallest))
+            smallest = right;
+        if (smallest == i)
+            break;
+        heap_swap(i, smallest);
+        i = smallest;
+    }
+}
+
+void Scheduler::heap_push(uint8_t id)
+{
+    heap[heap_count] = id;
+    heap_pos[id] = heap_count;
+    heap_count++;
+    sift_up(heap_count - 1);
+}
+
+void Scheduler::heap_remove(uint8_t id)
+{
+    size_t i = heap_pos[id];
+    if (i == NOT_QUEUED)
+        return;
+    heap_count--;
+    if (i != heap_count) {
+        heap_swap(i, heap_count);
+        sift_down(i);
+        sift_up(i);
+    }
+    heap_pos[id] = NOT_QUEUED;
+}
+
+int Scheduler::add(const char *name, JobFn fn, uint32_t period, uint32_t first_delay, uint32_t now)
+{
+    if (job_count >= SCHED_MAX_JOBS || fn == nullptr)
+        return -1;
+    uint8_t id = job_count++;
+    Job &j = jobs[id];
+    j.name = name;
+    j.fn = fn;
+    j.period = period;
+    j.deadline = now + first_delay;
+    j.runs = 0;
+    j.skipped = 0;
+    j.active = true;
+    heap_push(id);
+    return id;
+}
+
+void Scheduler::set_period(int id, uint32_t period, uint32_t now)
+{
+    if (id < 0 || (size_t)id >= job_count)
+        return;
+    jobs[id].period = period;
+    // pull the next run in if the new period is shorter than what is left
+    if (jobs[id].active && sched_before(now + period, jobs[id].deadline))
+        run_at(id, now + period);
+}
+
+void Scheduler::run_at(int id, uint32_t deadline)
+{
+    if (id < 0 || (size_t)id >= job_count)
+        return;
+    heap_remove(id);
+    jobs[id].deadline = deadline;
+    jobs[id].active = true;
+    heap_push(id);
+}
+
+void Scheduler::cancel(int id)
+{
+    if (id < 0 || (size_t)id >= job_count)
+        return;
+    heap_remove(id);
+    jobs[id].active = false;
+}
+
+uint32_t Scheduler::run_due(uint32_t now)
+{
+    // Bounded so a zero-period job can never starve the caller
+    for (size_t n = 0; n < SCHED_MAX_JOBS && heap_count > 0; n++) {
+        uint8_t id = heap[0];
+        Job &j = jobs[id];
+        if (sched_before(now, j.deadline))
+            break;
+
+        heap_remove(id);
+        if (j.period == 0) {
+            j.active = false;
+        } else {
+            // fixed rate; if we fell a whole period behind, drop the backlog
+            // instead of running the job back to back to catch up
+            j.deadline += j.period;
+            if (!sched_before(now, j.deadline)) {
+                uint32_t behind = now - j.deadline;
+                uint32_t missed = behind / j.period + 1;
+                j.skipped += missed;
+                j.deadline += missed * j.period;
+            }
+            heap_push(id);
+        }
+        j.runs++;
+        j.fn();
+    }
+    return time_until_next(now);
+}
+
+uint32_t Scheduler::time_until_next(uint32_t now) const
+{
+    if (heap_count == 0)
+        return UINT32_MAX;
+    uint32_t deadline = jobs[heap[0]].deadline;
+    if (!sched_before(now, deadline))
+        return 0;
+    return deadline - now;
+}
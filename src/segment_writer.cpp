@@ -0,0 +1,120 @@
+#include <Arduino.h>
+#include <WiFi.h>
+#include <string.h>
+#include "segment_writer.h"
+
+bool SegmentWriter::send(const uint8_t *data, size_t n)
+{
+    if (failed)
+        return false;
+    if (client.write(data, n) != n)
+        failed = true; // peer gone; the rest is pointless
+    segments++;
+    return !failed;
+}
+
+size_t SegmentWriter::write(const uint8_t *data, size_t n)
+{
+    size_t left = n;
+    while (left > 0 && !failed) {
+        if (used == 0 && left >= TCP_SEGMENT) {
+            // a whole segment's worth, skip the copy
+            send(data, TCP_SEGMENT);
+            data += TCP_SEGMENT;
+            left -= TCP_SEGMENT;
+            continue;
+        }
+        size_t take = TCP_SEGMENT - used < left ? TCP_SEGMENT - used : left;
+        memcpy(buf + used, data, take);
+        used += take;
+        data += take;
+        left -= take;
+        if (used == TCP_SEGMENT) {
+            send(buf, used);
+            used = 0;
+        }
+    }
+    total += n - left;
+    return n - left;
+}
+
+size_t SegmentWriter::print(const char *s)
+{
+    return write((const uint8_t *)s, strlen(s));
+}
+
+bool SegmentWriter::flush()
+{
+    if (used > 0) {
+        send(buf, used);
+        used = 0;
+    }
+    return !failed;
+}
+
+bool ChunkedWriter::head(const char *s)
+{
+    size_t n = strlen(s);
+    if (total > 0 || chunk_at + n + CHUNK_SIZE_LINE + CHUNK_TAIL >= TCP_SEGMENT)
+        return false;
+    memcpy(buf + chunk_at, s, n);
+    chunk_at += n;
+    used = chunk_at + CHUNK_SIZE_LINE;
+    return true;
+}
+
+bool ChunkedWriter::send(bool last)
+{
+    if (failed)
+        return false;
+    size_t payload = used - chunk_at - CHUNK_SIZE_LINE;
+    size_t end = used;
+    if (payload > 0 || !last) {
+        static const char hex[] = "0123456789ABCDEF";
+        for (int i = 3; i >= 0; i--)
+            buf[chunk_at + 3 - i] = hex[(payload >> (4 * i)) & 0xF];
+        buf[chunk_at + 4] = '\r';
+        buf[chunk_at + 5] = '\n';
+        memcpy(buf + end, "\r\n", 2);
+        end += 2;
+    } else {
+        end = chunk_at; // nothing since the last chunk, just the terminator
+    }
+    if (last) {
+        memcpy(buf + end, "0\r\n\r\n", 5);
+        end += 5;
+    }
+    if (client.write(buf, end) != end)
+        failed = true;
+    segments++;
+    chunk_at = 0;
+    used = CHUNK_SIZE_LINE;
+    return !failed;
+}
+
+size_t ChunkedWriter::write(const uint8_t *data, size_t n)
+{
+    size_t left = n;
+    while (left > 0 && !failed) {
+        size_t room = TCP_SEGMENT - CHUNK_TAIL - used;
+        size_t take = room < left ? room : left;
+        memcpy(buf + used, data, take);
+        used += take;
+        data += take;
+        left -= take;
+        if (used == TCP_SEGMENT - CHUNK_TAIL)
+            send(false);
+    }
+    total += n - left;
+    return n - left;
+}
+
+size_t ChunkedWriter::print(const char *s)
+{
+    return write((const uint8_t *)s, strlen(s));
+}
+
+bool ChunkedWriter::finish()
+{
+    return send(true);
+}
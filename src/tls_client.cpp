@@ -0,0 +1,240 @@
+#include <Arduino.h>
+#include <string.h>
+#include "http_response.h"
+#include "mbedtls/net_sockets.h"
+#include "tls_client.h"
+
+TlsClient::TlsClient()
+{
+    mbedtls_ssl_init(&ssl);
+    mbedtls_ssl_config_init(&conf);
+    mbedtls_x509_crt_init(&ca);
+    mbedtls_entropy_init(&entropy);
+    mbedtls_ctr_drbg_init(&drbg);
+    mbedtls_ssl_session_init(&session);
+}
+
+TlsClient::~TlsClient()
+{
+    stop();
+    mbedtls_ssl_session_free(&session);
+    mbedtls_ssl_free(&ssl);
+    mbedtls_ssl_config_free(&conf);
+    mbedtls_x509_crt_free(&ca);
+    mbedtls_ctr_drbg_free(&drbg);
+    mbedtls_entropy_free(&entropy);
+}
+
+bool TlsClient::begin(const char *ca_pem)
+{
+    if (ready)
+        return true;
+    static const unsigned char personal[] = "plant-uplink";
+    int err = mbedtls_x509_crt_parse(&ca, (const unsigned char *)ca_pem, strlen(ca_pem) + 1);
+    if (err == 0)
+        err = mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy, personal, sizeof(personal) - 1);
+    if (err == 0)
+        err = mbedtls_ssl_config_defaults(&conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                          MBEDTLS_SSL_PRESET_DEFAULT);
+    if (err == 0) {
+        mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+        mbedtls_ssl_conf_ca_chain(&conf, &ca, nullptr);
+        mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &drbg);
+        mbedtls_ssl_conf_session_tickets(&conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+        err = mbedtls_ssl_setup(&ssl, &conf);
+    }
+    if (err != 0) {
+        st.last_error = err;
+        return false;
+    }
+    mbedtls_ssl_set_bio(&ssl, this, bio_send, bio_recv, nullptr);
+    ready = true;
+    return true;
+}
+
+// mbedTLS's side of the socket: the plain WiFiClient underneath, never
+// blocking on a read so the handshake and available() can poll
+int TlsClient::bio_send(void *ctx, const unsigned char *buf, size_t len)
+{
+    TlsClient *c = (TlsClient *)ctx;
+    size_t n = c->WiFiClient::write(buf, len);
+    if (n == 0)
+        return c->WiFiClient::connected() ? MBEDTLS_ERR_NET_SEND_FAILED : MBEDTLS_ERR_NET_CONN_RESET;
+    return n;
+}
+
+int TlsClient::bio_recv(void *ctx, unsigned char *buf, size_t len)
+{
+    TlsClient *c = (TlsClient *)ctx;
+    if (c->WiFiClient::available() <= 0)
+        return c->WiFiClient::connected() ? MBEDTLS_ERR_SSL_WANT_READ : 0;
+    int n = c->WiFiClient::read(buf, len);
+    return n > 0 ? n : MBEDTLS_ERR_SSL_WANT_READ;
+}
+
+// Until up, available()/connected() are the raw socket's, which is what
+// wait_readable() needs to see while the server's flight is on its way
+int TlsClient::handshake()
+{
+    uint32_t start = millis();
+    for (;;) {
+        int err = mbedtls_ssl_handshake(&ssl);
+        if (err != MBEDTLS_ERR_SSL_WANT_READ && err != MBEDTLS_ERR_SSL_WANT_WRITE)
+            return err;
+        uint32_t elapsed = millis() - start;
+        if (elapsed >= TLS_HANDSHAKE_TIMEOUT)
+            return MBEDTLS_ERR_SSL_TIMEOUT;
+        if (!WiFiClient::connected())
+            return MBEDTLS_ERR_NET_CONN_RESET;
+        wait_readable(*this, TLS_HANDSHAKE_TIMEOUT - elapsed);
+    }
+}
+
+int TlsClient::connect(const char *host, uint16_t port)
+{
+    if (!ready)
+        return 0;
+    stop();
+    uint32_t start = micros();
+    mbedtls_ssl_session_reset(&ssl);
+    was_resumed = false;
+    if (!WiFiClient::connect(host, port)) {
+        st.failures++;
+        st.last_error = MBEDTLS_ERR_NET_CONN_RESET;
+        return 0;
+    }
+    mbedtls_ssl_set_hostname(&ssl, host);
+    if (have_session)
+        mbedtls_ssl_set_session(&ssl, &session);
+    int err = handshake();
+    if (err != 0) {
+        st.failures++;
+        drop(err);
+        forget_session(); // whatever went wrong, start the next one clean
+        return 0;
+    }
+
+    // the server echoes the offered session's ID when it takes it up
+    was_resumed = have_session && ssl.session->id_len == session.id_len &&
+                  memcmp(ssl.session->id, session.id, session.id_len) == 0;
+    if (was_resumed)
+        st.resumed++;
+    else
+        st.handshakes++;
+    mbedtls_ssl_session_free(&session);
+    mbedtls_ssl_session_init(&session);
+    have_session = mbedtls_ssl_get_session(&ssl, &session) == 0;
+    up = true;
+
+    uint32_t us = micros() - start;
+    st.handshake_us += us;
+    if (us > st.handshake_max_us)
+        st.handshake_max_us = us;
+    return 1;
+}
+
+// The connection is done for; a clean close keeps the session resumable
+void TlsClient::drop(int err)
+{
+    if (err != MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY && err != MBEDTLS_ERR_SSL_CONN_EOF)
+        st.last_error = err;
+    up = false;
+    peeked = -1;
+    WiFiClient::stop();
+}
+
+size_t TlsClient::write(const uint8_t *buf, size_t size)
+{
+    size_t done = 0;
+    uint32_t start = millis();
+    while (up && done < size) {
+        int n = mbedtls_ssl_write(&ssl, buf + done, size - done);
+        if (n > 0)
+            done += n;
+        else if ((n != MBEDTLS_ERR_SSL_WANT_WRITE && n != MBEDTLS_ERR_SSL_WANT_READ) ||
+                 millis() - start >= HTTP_RESPONSE_TIMEOUT)
+            drop(n);
+    }
+    return done;
+}
+
+int TlsClient::available()
+{
+    if (!up)
+        return WiFiClient::available();
+    int n = mbedtls_ssl_get_bytes_avail(&ssl) + (peeked >= 0);
+    if (n > 0 || WiFiClient::available() <= 0)
+        return n;
+    // raw bytes in: decrypt a record to see whether there's data in it
+    uint8_t b;
+    int got = mbedtls_ssl_read(&ssl, &b, 1);
+    if (got == 1) {
+        peeked = b;
+        return 1 + mbedtls_ssl_get_bytes_avail(&ssl);
+    }
+    if (got != MBEDTLS_ERR_SSL_WANT_READ)
+        drop(got); // close_notify, or the record didn't check out
+    return 0;
+}
+
+int TlsClient::read(uint8_t *buf, size_t size)
+{
+    if (!up || size == 0 || available() <= 0)
+        return -1;
+    size_t got = 0;
+    if (peeked >= 0) {
+        buf[got++] = peeked;
+        peeked = -1;
+    }
+    size_t more = mbedtls_ssl_get_bytes_avail(&ssl);
+    if (more > size - got)
+        more = size - got;
+    if (more > 0) {
+        int n = mbedtls_ssl_read(&ssl, buf + got, more);
+        if (n > 0)
+            got += n;
+    }
+    return got;
+}
+
+int TlsClient::read()
+{
+    uint8_t b;
+    return read(&b, 1) == 1 ? b : -1;
+}
+
+int TlsClient::peek()
+{
+    if (!up || available() <= 0)
+        return -1;
+    if (peeked < 0) {
+        uint8_t b;
+        if (mbedtls_ssl_read(&ssl, &b, 1) != 1)
+            return -1;
+        peeked = b;
+    }
+    return peeked;
+}
+
+uint8_t TlsClient::connected()
+{
+    if (!up)
+        return WiFiClient::connected(); // mid-handshake, or stopped
+    return available() > 0 || (up && WiFiClient::connected());
+}
+
+void TlsClient::stop()
+{
+    if (up)
+        mbedtls_ssl_close_notify(&ssl);
+    up = false;
+    peeked = -1;
+    WiFiClient::stop();
+}
+
+void TlsClient::forget_session()
+{
+    mbedtls_ssl_session_free(&session);
+    mbedtls_ssl_session_init(&session);
+    have_session = false;
+}
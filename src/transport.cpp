@@ -0,0 +1,312 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <WiFi.h>
+#include <stdio.h>
+#include <string.h>
+#include "config.h"
+#include "http_response.h"
+#include "latency.h"
+#include "mqtt.h"
+#include "segment_writer.h"
+#include "tls_client.h"
+#include "transport.h"
+#include "uplink.h"
+
+static TransportReplyFn on_reply;
+static TransportStats stats;
+static uint8_t current = TRANSPORT_HTTP; // the one that may hold a connection
+
+void transport_on_reply(TransportReplyFn fn)
+{
+    on_reply = fn;
+}
+
+static void reply(const char *body, size_t len)
+{
+    if (len == 0 || on_reply == nullptr)
+        return;
+    stats.replies++;
+    on_reply(body, len);
+}
+
+// ---- HTTP ----------------------------------------------------------------
+
+static char http_response[UPLINK_RESPONSE_MAX]; // the request itself is streamed, never buffered whole
+
+// Request line, headers and JSON go through one segment buffer, so a
+// typical request is a single TCP segment (or TLS record)
+static bool http_post(WiFiClient &c, size_t body_len, const char *connection)
+{
+    SegmentWriter out(c);
+    char head[160];
+    snprintf(head, sizeof(head),
+             "POST /submit HTTP/1.1\r\nHost: %s\r\nContent-Type: application/json\r\n"
+             "Content-Length: %u\r\nConnection: %s\r\n\r\n",
+             config.server_address, (unsigned)body_len, connection);
+    out.print(head);
+    serializeJson(uplink_document(), out);
+    return out.flush();
+}
+
+static bool http_send(size_t body_len)
+{
+    WiFiClient c;
+    LatencyTimer lat = latency_start();
+    if (!c.connect(config.server_address, config.server_port)) {
+        latency_stop(LAT_HTTP_CONNECT, lat);
+        Serial.println("Connect failed");
+        return false;
+    }
+    bool sent = http_post(c, body_len, "close");
+    latency_stop(LAT_HTTP_CONNECT, lat);
+    if (!sent) {
+        Serial.println("Connection lost while sending");
+        c.stop();
+        return false;
+    }
+
+    HttpResponse resp;
+    lat = latency_start();
+    int err = http_read_response(c, http_response, sizeof(http_response), HTTP_RESPONSE_TIMEOUT, resp);
+    latency_stop(LAT_HTTP_RESPONSE, lat);
+    c.stop();
+    if (err != 200) {
+        Serial.print("Got status code: ");
+        Serial.println(err);
+        return false;
+    }
+    // delivered first: handling the reply reuses the request's document
+    uplink_delivered();
+    reply(resp.body, resp.body_len);
+    return true;
+}
+
+static void http_poll(uint32_t) {}
+static void http_stop() {}
+
+// ---- MQTT ----------------------------------------------------------------
+
+static char client_id[MQTT_CLIENT_ID_MAX]; // plant-<MAC>
+static char up_topic[MQTT_TOPIC_MAX]; // plant/<client id>/up
+static char down_topic[MQTT_TOPIC_MAX];
+// A push waits here until no publish is in flight: handling it reuses the
+// uplink document, and it may arrive while we wait for the PUBACK
+static char pushed[UPLINK_RESPONSE_MAX];
+static size_t pushed_len;
+
+static void mqtt_message(const char *topic, const uint8_t *payload, size_t len)
+{
+    if (strcmp(topic, down_topic) != 0 || len >= sizeof(pushed))
+        return;
+    memcpy(pushed, payload, len);
+    pushed[len] = '\0';
+    pushed_len = len;
+}
+
+static void mqtt_replies()
+{
+    size_t len = pushed_len;
+    pushed_len = 0;
+    reply(pushed, len);
+}
+
+static bool mqtt_session()
+{
+    if (mqtt_connected())
+        return true;
+    if (client_id[0] == '\0') {
+        uint8_t mac[6];
+        WiFi.macAddress(mac);
+        snprintf(client_id, sizeof(client_id), "plant-%02x%02x%02x%02x%02x%02x", mac[0], mac[1], mac[2], mac[3],
+                 mac[4], mac[5]);
+        snprintf(up_topic, sizeof(up_topic), "plant/%s/up", client_id);
+        snprintf(down_topic, sizeof(down_topic), "plant/%s/down", client_id);
+        mqtt_on_message(mqtt_message);
+    }
+    if (mqtt_connect(config.server_address, config.mqtt_port, client_id, down_topic))
+        return true;
+    Serial.println("MQTT connect failed");
+    return false;
+}
+
+static bool mqtt_send(size_t body_len)
+{
+    LatencyTimer lat = latency_start();
+    if (!mqtt_session()) {
+        latency_stop(LAT_HTTP_CONNECT, lat);
+        return false;
+    }
+    SegmentWriter out(mqtt_socket());
+    uint16_t id = mqtt_publish_begin(out, up_topic, body_len, config.mqtt_qos);
+    serializeJson(uplink_document(), out);
+    bool sent = out.flush();
+    mqtt_publish_end(sent);
+    latency_stop(LAT_HTTP_CONNECT, lat);
+    if (!sent) {
+        Serial.println("MQTT session lost while publishing");
+        return false;
+    }
+    if (config.mqtt_qos == 0) {
+        uplink_delivered();
+        mqtt_replies();
+        return true;
+    }
+    lat = latency_start();
+    bool acked = mqtt_wait_puback(id, MQTT_TIMEOUT_MS);
+    latency_stop(LAT_HTTP_RESPONSE, lat);
+    if (!acked) {
+        Serial.println("No PUBACK");
+        return false;
+    }
+    uplink_delivered();
+    mqtt_replies();
+    return true;
+}
+
+static void mqtt_poll(uint32_t now)
+{
+    mqtt_loop(now);
+    mqtt_replies();
+}
+
+static void mqtt_stop()
+{
+    mqtt_disconnect();
+}
+
+// ---- HTTPS ---------------------------------------------------------------
+
+static TlsClient tls; // kept open between uplinks, its session kept between connections
+static uint32_t tls_last_used; // ms
+
+static bool https_send(size_t body_len)
+{
+    if (!tls.begin(TLS_CA_PEM)) {
+        Serial.println("TLS CA certificate unusable");
+        return false;
+    }
+    HttpResponse resp;
+    int err = HTTP_RESP_CLOSED;
+    // The server may have closed a kept-alive connection just as we used it.
+    // If it did so without answering, the request goes once more on a fresh
+    // (resumed) connection; a fresh one failing is a real failure.
+    for (bool reused = tls.connected(); err == HTTP_RESP_CLOSED; reused = false) {
+        LatencyTimer lat = latency_start();
+        if (!reused && !tls.connect(config.server_address, config.tls_port)) {
+            latency_stop(LAT_HTTP_CONNECT, lat);
+            Serial.print("TLS connect failed: ");
+            Serial.println(tls.stats().last_error);
+            return false;
+        }
+        bool sent = http_post(tls, body_len, "keep-alive");
+        latency_stop(LAT_HTTP_CONNECT, lat);
+        if (!sent) {
+            tls.stop();
+            if (reused)
+                continue;
+            Serial.println("Connection lost while sending");
+            return false;
+        }
+        lat = latency_start();
+        err = http_read_response(tls, http_response, sizeof(http_response), HTTP_RESPONSE_TIMEOUT, resp);
+        latency_stop(LAT_HTTP_RESPONSE, lat);
+        if (err < 0)
+            tls.stop(); // whatever is still coming would be read as the next response
+        if (!reused || http_response[0] != '\0')
+            break;
+    }
+    tls_last_used = millis();
+    if (err != 200) {
+        Serial.print("Got status code: ");
+        Serial.println(err);
+        return false;
+    }
+    uplink_delivered();
+    reply(resp.body, resp.body_len);
+    return true;
+}
+
+// Closing first, before the server's keep-alive timeout does, keeps its
+// close from landing in the middle of the next request
+static void https_poll(uint32_t now)
+{
+    if (tls.connected() && now - tls_last_used >= TLS_IDLE_CLOSE_MS)
+        tls.stop();
+}
+
+static void https_stop()
+{
+    tls.stop();
+}
+
+// ---- selection -----------------------------------------------------------
+
+static const Transport transports[TRANSPORTS] = {
+    {"http", http_send, http_poll, http_stop},
+    {"mqtt", mqtt_send, mqtt_poll, mqtt_stop},
+    {"https", https_send, https_poll, https_stop},
+};
+
+void transport_setup()
+{
+#ifndef SS_STATIC_HEAP
+    // the CA and the record buffers, off the heap once at boot rather than on
+    // the first HTTPS uplink; https_send() tries again if this fails
+    if (!tls.begin(TLS_CA_PEM))
+        Serial.println("TLS CA certificate unusable");
+#endif
+}
+
+bool transport_available(uint8_t kind)
+{
+#ifdef SS_STATIC_HEAP
+    if (kind == TRANSPORT_HTTPS)
+        return false; // its handshakes allocate, see transport.h
+#endif
+    return kind < TRANSPORTS;
+}
+
+const Transport &transport_current()
+{
+    uint8_t kind = config.transport;
+    if (!transport_available(kind))
+        kind = TRANSPORT_HTTP;
+    if (kind != current) {
+        transports[current].stop();
+        current = kind;
+    }
+    return transports[current];
+}
+
+const char *transport_name(uint8_t kind)
+{
+    return kind < TRANSPORTS ? transports[kind].name : "?";
+}
+
+bool transport_send(size_t body_len)
+{
+    uint32_t start = micros();
+    bool ok = transport_current().send(body_len);
+    uint32_t us = micros() - start;
+    stats.sends++;
+    stats.delivered += ok;
+    stats.busy_us += us;
+    if (us > stats.busy_max_us)
+        stats.busy_max_us = us;
+    return ok;
+}
+
+void transport_poll(uint32_t now)
+{
+    transport_current().poll(now);
+}
+
+const TransportStats &transport_stats()
+{
+    return stats;
+}
+
+void transport_stats_reset()
+{
+    memset(&stats, 0, sizeof(stats));
+}
@@ -0,0 +1,224 @@
+#include <Arduino.h>
+#include <TFT_eSPI.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include "breaker.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lux.h"
+#include "prediction.h"
+#include "ui.h"
+
+#define LINE_H 17 // text size 2 is 16 px tall
+#define FOOTER_Y 125 // text size 1 line under the page
+
+static TFT_eSPI *tft;
+static portMUX_TYPE ui_mux = portMUX_INITIALIZER_UNLOCKED;
+static UiSnapshot latest; // written by loop(), under ui_mux
+static UiSnapshot shown; // the UI task's copy, what the frame is drawn from
+static uint8_t page = UI_PAGE_LIVE;
+static UiStats stats;
+
+static StaticTask_t task_buf;
+static StackType_t task_stack[UI_TASK_STACK];
+
+static void text(int y, const char *fmt, ...)
+{
+    char line[32];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    tft->drawString(line, 0, y, 1);
+}
+
+static void title(const char *name)
+{
+    tft->setTextColor(TFT_GREEN);
+    text(0, "%s", name);
+    tft->setTextColor(TFT_WHITE);
+}
+
+static void draw_live(const UiSnapshot &s)
+{
+    if (!s.sensor.valid) {
+        text(0, "Reading sensors...");
+        return;
+    }
+    text(0, "Temp.: %.2f C", s.sensor.temp);
+    text(32, "%s: %.2f%%", s.sensor.moisture < s.dry ? "Low Moist." : "Moist.", s.sensor.moisture);
+    text(64, "%s: %.0f lx", s.sensor.light < s.shade ? "Low Light" : "Light", light_lux(s.sensor.light));
+    tft->setTextColor(TFT_RED);
+    if (s.predicted)
+        text(96, "Countdown: %.2f", s.days_left);
+    else
+        text(96, "Getting water data...");
+}
+
+static uint32_t average(const UiSnapshot &s)
+{
+    uint64_t sum = 0;
+    for (size_t i = 0; i < s.period_count; i++)
+        sum += s.periods[i];
+    return s.period_count ? (uint32_t)(sum / s.period_count) : 0;
+}
+
+static void draw_history(const UiSnapshot &s)
+{
+    title("Drying history");
+    if (s.period_count == 0) {
+        text(LINE_H, "No cycles yet");
+        return;
+    }
+    text(LINE_H, "%u cycles, avg %.1fd", (unsigned)s.period_count, millis_to_days(average(s)));
+    // newest first, three to a line
+    int y = 2 * LINE_H;
+    for (size_t shown_n = 0; shown_n < s.period_count && y <= 5 * LINE_H; y += LINE_H) {
+        char line[32];
+        int len = 0;
+        for (int col = 0; col < 3 && shown_n < s.period_count; col++, shown_n++) {
+            float d = millis_to_days(s.periods[s.period_count - 1 - shown_n]);
+            len += snprintf(line + len, sizeof(line) - len, "%s%.1f", col ? " " : "", d);
+        }
+        tft->drawString(line, 0, y, 1);
+    }
+}
+
+static void draw_plants(const UiSnapshot &s)
+{
+    // two to a line, as many as fit
+    title("Countdowns");
+    size_t i = 0;
+    for (int y = LINE_H; i < s.plant_count && y <= 6 * LINE_H; y += LINE_H) {
+        char line[32], cell[16];
+        int len = 0;
+        for (int col = 0; col < 2 && i < s.plant_count; col++, i++) {
+            if (s.plant_predicted[i])
+                snprintf(cell, sizeof(cell), "%u:%.1fd", (unsigned)i + 1, s.plant_days_left[i]);
+            else
+                snprintf(cell, sizeof(cell), "%u:--", (unsigned)i + 1);
+            len += snprintf(line + len, sizeof(line) - len, col ? "%s" : "%-10s", cell);
+        }
+        tft->drawString(line, 0, y, 1);
+    }
+}
+
+static void draw_countdown(const UiSnapshot &s)
+{
+    if (s.plant_count > 1) {
+        draw_plants(s);
+        return;
+    }
+    title("Countdown");
+    if (s.predicted)
+        text(LINE_H, "Left: %.2f days", s.days_left);
+    else
+        text(LINE_H, "Left: learning");
+    text(2 * LINE_H, "Watered %.1fd ago", millis_to_days(s.since_watered_ms));
+    text(3 * LINE_H, "Avg cycle %.2fd", millis_to_days(average(s)));
+    text(4 * LINE_H, "Dry below %d%%", s.dry);
+    if (s.sensor.valid)
+        text(5 * LINE_H, "Moisture %.1f%%", s.sensor.moisture);
+}
+
+static void draw_status(const UiSnapshot &s)
+{
+    title("Status");
+    if (s.wifi_up)
+        text(LINE_H, "WiFi %d dBm", s.rssi);
+    else
+        text(LINE_H, "WiFi down");
+    text(2 * LINE_H, "%u.%u.%u.%u", (unsigned)(s.ip & 0xff), (unsigned)(s.ip >> 8 & 0xff),
+         (unsigned)(s.ip >> 16 & 0xff), (unsigned)(s.ip >> 24));
+    text(3 * LINE_H, "Uplink %s", breaker_name((BreakerState)s.breaker));
+    text(4 * LINE_H, "Queue %u lost %u", (unsigned)s.queued, (unsigned)s.queue_dropped);
+    text(5 * LINE_H, "Heap %uk blk %uk", (unsigned)(s.heap_free / 1024), (unsigned)(s.heap_largest / 1024));
+    text(6 * LINE_H, "Up %ud %02u:%02u rev %u", (unsigned)(s.uptime_s / 86400), (unsigned)(s.uptime_s / 3600 % 24),
+         (unsigned)(s.uptime_s / 60 % 60), (unsigned)s.config_rev);
+}
+
+static void render()
+{
+    portENTER_CRITICAL(&ui_mux);
+    shown = latest;
+    portEXIT_CRITICAL(&ui_mux);
+
+    tft->setTextSize(2);
+    tft->setTextColor(TFT_WHITE);
+    tft->fillScreen(TFT_BLACK);
+    switch (page) {
+    case UI_PAGE_LIVE:
+        draw_live(shown);
+        break;
+    case UI_PAGE_HISTORY:
+        draw_history(shown);
+        break;
+    case UI_PAGE_COUNTDOWN:
+        draw_countdown(shown);
+        break;
+    default:
+        draw_status(shown);
+        break;
+    }
+
+    tft->setTextSize(1);
+    tft->setTextColor(TFT_DARKGREY);
+    if (page == UI_PAGE_STATUS)
+        text(FOOTER_Y, "%d/%d  frame %ums  input %ums", page + 1, UI_PAGES, (unsigned)(stats.last_frame_us / 1000),
+             (unsigned)(stats.max_input_us / 1000));
+    else
+        text(FOOTER_Y, "%d/%d", page + 1, UI_PAGES);
+}
+
+static void ui_task(void *)
+{
+    InputEvent ev;
+    for (;;) {
+        if (input_wait(ev, UINT32_MAX))
+            ui_handle(ev);
+    }
+}
+
+void ui_setup(TFT_eSPI &t)
+{
+    tft = &t;
+    page = UI_PAGE_LIVE;
+    stats = UiStats();
+    xTaskCreateStaticPinnedToCore(ui_task, "ui", UI_TASK_STACK, nullptr, UI_TASK_PRIORITY, task_stack, &task_buf,
+                                  UI_TASK_CORE);
+}
+
+void ui_publish(const UiSnapshot &s)
+{
+    portENTER_CRITICAL(&ui_mux);
+    latest = s;
+    portEXIT_CRITICAL(&ui_mux);
+}
+
+void ui_handle(const InputEvent &ev)
+{
+    if (ev.type == INPUT_BUTTON_LEFT)
+        page = (page + UI_PAGES - 1) % UI_PAGES;
+    else if (ev.type == INPUT_BUTTON_RIGHT)
+        page = (page + 1) % UI_PAGES;
+
+    uint32_t start = micros();
+    render();
+    uint32_t end = micros();
+    stats.frames++;
+    stats.last_frame_us = end - start;
+    if (stats.last_frame_us > stats.max_frame_us)
+        stats.max_frame_us = stats.last_frame_us;
+    if (ev.type != INPUT_REFRESH && end - ev.at_us > stats.max_input_us)
+        stats.max_input_us = end - ev.at_us;
+}
+
+UiPage ui_page()
+{
+    return (UiPage)page;
+}
+
+const UiStats &ui_stats()
+{
+    return stats;
+}
@@ -0,0 +1,288 @@
+#include <ArduinoJson.h>
+#include <math.h>
+#include "boot_profile.h"
+#include "config.h"
+#include "heap_monitor.h"
+#include "i2c_bus.h"
+#include "latency.h"
+#include "power_stats.h"
+#include "sample.h"
+#include "static_pool.h"
+#include "uplink.h"
+
+static StaticPool<UPLINK_POOL_SIZE> pool;
+static JsonDocument doc(&pool);
+
+static uint32_t last_power_report;
+static uint32_t raw_from, raw_for; // raw burst: millis() it was asked for, ms
+static uint8_t raw_plant;
+static uint32_t last_latency_report;
+static LatencyHistogram latency_sent[LAT_STAGES]; // the snapshot in the last request built
+static bool latency_in_batch;
+static bool boot_reported;
+
+enum QueuedKind { QUEUED_SAMPLE, QUEUED_WINDOW };
+
+struct Queued {
+    uint8_t kind;
+    uint8_t plant; // samples; a window knows its own
+    uint32_t at; // millis() when it was taken, or the window closed
+    union {
+        SensorData sample;
+        WindowStats window;
+    };
+};
+
+static Queued queue[UPLINK_QUEUE_MAX];
+static size_t queue_head, queue_count;
+static size_t batch; // queued samples in the last request built
+static uint32_t dropped, dropped_unreported, dropped_in_batch;
+
+static JsonDocument &fresh_doc()
+{
+    doc.clear();
+    pool.reset();
+    return doc;
+}
+
+static void add_power(JsonDocument &d, uint32_t now)
+{
+    JsonObject power = d["power"].to<JsonObject>();
+    for (int i = 0; i < POWER_SUBSYSTEMS; i++) {
+        PowerResidency r = power_residency((PowerSubsystem)i, now);
+        JsonObject sub = power[power_name((PowerSubsystem)i)].to<JsonObject>();
+        sub["on_ms"] = r.on_ms;
+        sub["off_ms"] = r.off_ms;
+        sub["mah"] = r.mah;
+    }
+    power["total_mah"] = power_total_mah(now);
+
+    HeapStats hs = heap_monitor_sample();
+    JsonObject heap = d["heap"].to<JsonObject>();
+    heap["free"] = hs.free;
+    heap["min_free"] = hs.min_free;
+    heap["largest_block"] = hs.largest_block;
+    heap["baseline_free"] = hs.baseline_free;
+    heap["pool_peak"] = pool.peak();
+
+    // since boot, by outcome; only the ones that happened
+    const I2cStats &is = i2c_stats();
+    JsonObject i2c = d["i2c"].to<JsonObject>();
+    for (int r = 0; r < I2C_RESULTS; r++)
+        if (is.count[r])
+            i2c[i2c_result_name((I2cResult)r)] = is.count[r];
+    if (is.recoveries)
+        i2c["recoveries"] = is.recoveries;
+    if (is.recover_failed)
+        i2c["recover_failed"] = is.recover_failed;
+}
+
+static void add_boot(JsonDocument &d)
+{
+    // boot phases go up once, with the first request that gets through
+    JsonObject boot = d["boot"].to<JsonObject>();
+    for (size_t i = 0; i < boot_mark_count(); i++)
+        boot[boot_mark_at(i).phase] = boot_mark_at(i).us / 1000.0;
+}
+
+static void add_latency(JsonDocument &d)
+{
+    // per-stage histograms since the last delivered snapshot
+    latency_take(latency_sent);
+    latency_in_batch = true;
+    JsonObject latency = d["latency"].to<JsonObject>();
+    for (int i = 0; i < LAT_STAGES; i++) {
+        const LatencyHistogram &h = latency_sent[i];
+        if (h.count == 0)
+            continue;
+        JsonObject stage = latency[latency_name((LatencyStage)i)].to<JsonObject>();
+        stage["n"] = h.count;
+        stage["max_us"] = h.max_us;
+        stage["mean_us"] = (uint32_t)(h.sum_us / h.count);
+        stage["p50_us"] = latency_percentile(h, 0.5);
+        stage["p99_us"] = latency_percentile(h, 0.99);
+        JsonArray b = stage["b"].to<JsonArray>();
+        for (int j = 0; j < LATENCY_BUCKETS; j++)
+            b.add(h.buckets[j]);
+    }
+}
+
+static float round2(float x)
+{
+    return roundf(x * 100) / 100; // shorter JSON, the sensors aren't better than that
+}
+
+static void add_channel(JsonObject w, const char *name, const Welford &c, uint16_t n)
+{
+    // [min, max, mean, stddev]
+    JsonArray a = w[name].to<JsonArray>();
+    a.add(round2(c.min));
+    a.add(round2(c.max));
+    a.add(round2(c.mean));
+    a.add(round2(welford_stddev(c, n)));
+}
+
+static void add_window(JsonObject w, const WindowStats &s)
+{
+    if (s.plant)
+        w["plant"] = s.plant;
+    w["ms"] = s.ms;
+    w["n"] = s.n;
+    add_channel(w, "temp", s.temp, s.n);
+    add_channel(w, "moisture", s.moisture, s.n);
+    add_channel(w, "light", s.light, s.n);
+    add_channel(w, "lux", s.lux, s.n);
+}
+
+static void add_backlog(JsonDocument &d, uint32_t now)
+{
+    // the server timestamps each one as now - age
+    JsonArray backlog = d["backlog"].to<JsonArray>();
+    char msg[SAMPLE_MSG_MAX];
+    for (size_t i = 0; i < batch; i++) {
+        const Queued &q = queue[(queue_head + i) % UPLINK_QUEUE_MAX];
+        JsonObject entry = backlog.add<JsonObject>();
+        entry["age"] = now - q.at;
+        if (q.kind == QUEUED_WINDOW) {
+            add_window(entry["window"].to<JsonObject>(), q.window);
+        } else {
+            sample_message(q.sample, config.dry, config.shade, msg, sizeof(msg));
+            entry["send_val"] = msg;
+            if (q.plant)
+                entry["plant"] = q.plant;
+        }
+    }
+}
+
+size_t uplink_build(const char *send_val, const WindowStats *window, uint32_t now)
+{
+    JsonDocument &d = fresh_doc();
+    if (latency_in_batch) {
+        // the last snapshot never got through: it goes out with the next one
+        latency_merge(latency_sent);
+        latency_in_batch = false;
+    }
+    if (send_val)
+        d["send_val"] = send_val;
+    if (window)
+        add_window(d["window"].to<JsonObject>(), *window);
+    d["config_rev"] = config.rev; // server answers with a delta if we're behind
+
+    batch = queue_count < UPLINK_BATCH_MAX ? queue_count : UPLINK_BATCH_MAX;
+    if (batch)
+        add_backlog(d, now);
+    dropped_in_batch = dropped_unreported;
+    if (dropped_in_batch)
+        d["dropped"] = dropped_in_batch;
+
+    if (now - last_power_report >= POWER_REPORT_PERIOD) {
+        add_power(d, now);
+        last_power_report = now;
+    }
+    if (!boot_reported)
+        add_boot(d);
+    if (now - last_latency_report >= LATENCY_REPORT_PERIOD) {
+        add_latency(d);
+        last_latency_report = now;
+    }
+
+    if (d.overflowed())
+        return 0; // a truncated body is no use to the server
+    size_t len = measureJson(d);
+    return len <= UPLINK_BODY_MAX ? len : 0;
+}
+
+const JsonDocument &uplink_document()
+{
+    return doc;
+}
+
+void uplink_delivered()
+{
+    boot_reported = true;
+    queue_head = (queue_head + batch) % UPLINK_QUEUE_MAX;
+    queue_count -= batch;
+    batch = 0;
+    dropped_unreported -= dropped_in_batch;
+    dropped_in_batch = 0;
+    latency_in_batch = false;
+}
+
+static Queued &queue_push(uint8_t kind, uint32_t now)
+{
+    if (queue_count == UPLINK_QUEUE_MAX) {
+        // full: the oldest sample goes, the server is told how many
+        queue_head = (queue_head + 1) % UPLINK_QUEUE_MAX;
+        queue_count--;
+        dropped++;
+        dropped_unreported++;
+    }
+    Queued &q = queue[(queue_head + queue_count) % UPLINK_QUEUE_MAX];
+    q.kind = kind;
+    q.plant = 0;
+    q.at = now;
+    queue_count++;
+    batch = 0; // whatever was built last didn't go out
+    return q;
+}
+
+void uplink_queue(const SensorData &s, uint32_t now, uint8_t plant)
+{
+    Queued &q = queue_push(QUEUED_SAMPLE, now);
+    q.sample = s;
+    q.plant = plant;
+}
+
+void uplink_queue_window(const WindowStats &w, uint32_t now)
+{
+    queue_push(QUEUED_WINDOW, now).window = w;
+}
+
+size_t uplink_queued()
+{
+    return queue_count;
+}
+
+uint32_t uplink_queue_dropped()
+{
+    return dropped;
+}
+
+UplinkResponse uplink_handle_response(const char *body, size_t len, uint32_t now)
+{
+    // the request document is done with, reuse its pool for the response
+    JsonDocument &resp = fresh_doc();
+    if (deserializeJson(resp, body, len) != DeserializationError::Ok)
+        return UPLINK_RESP_NONE; // older servers answer with plain text
+
+    JsonVariantConst raw = resp["raw_s"];
+    if (raw.is<uint32_t>()) {
+        // a new request replaces the running one, 0 ends it
+        uint32_t s = raw.as<uint32_t>();
+        raw_from = now;
+        raw_for = (s < UPLINK_RAW_MAX ? s : UPLINK_RAW_MAX) * 1000;
+        raw_plant = resp["raw_plant"] | 0;
+    }
+
+    JsonObjectConst delta = resp["config"];
+    if (delta.isNull())
+        return UPLINK_RESP_NONE;
+    if (!config_apply(delta, resp["config_rev"] | config.rev))
+        return UPLINK_RESP_REJECTED;
+    return UPLINK_RESP_APPLIED;
+}
+
+bool uplink_raw(uint32_t now)
+{
+    return now - raw_from < raw_for;
+}
+
+uint8_t uplink_raw_plant()
+{
+    return raw_plant;
+}
+
+size_t uplink_pool_peak()
+{
+    return pool.peak();
+}
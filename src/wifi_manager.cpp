@@ -0,0 +1,239 @@
+#include <Arduino.h>
+#include <WiFi.h>
+#include <string.h>
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "boot_profile.h"
+#include "power_stats.h"
+#include "wifi_manager.h"
+
+char ssid[50]; // your network SSID (name)
+char pass[50]; // your network password (use for WPA, or use as key for WEP)
+
+// Last good association, stored as one blob next to ssid/pass
+struct WifiCache {
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint32_t ip;
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+};
+
+static WifiCache wifi_cache;
+static bool wifi_cache_valid = false;
+static bool on_cached_lease = false; // connected with the cached IP, not one from DHCP
+static bool wifi_have_credentials = false;
+
+static WifiState state = WIFI_STATE_IDLE;
+static WifiState state_after_backoff = WIFI_STATE_FAST_CONNECT;
+static unsigned long state_timer; // when the current state was entered
+static unsigned long backoff_time = WIFI_BACKOFF_MIN;
+
+void nvs_access()
+{
+    // Initialize NVS
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        // NVS partition was truncated and needs to be erased
+        // Retry nvs_flash_init
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        err = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(err);
+
+    // Open
+    Serial.printf("\n");
+    Serial.printf("Opening Non-Volatile Storage (NVS) handle... ");
+    nvs_handle_t my_handle;
+    err = nvs_open("storage", NVS_READWRITE, &my_handle);
+    if (err != ESP_OK) {
+        Serial.printf("Error (%s) opening NVS handle!\n", esp_err_to_name(err));
+        return;
+    }
+    Serial.printf("Done\n");
+    Serial.printf("Retrieving SSID/PASSWD\n");
+    size_t ssid_len = sizeof(ssid);
+    size_t pass_len = sizeof(pass);
+    err = nvs_get_str(my_handle, "ssid", ssid, &ssid_len);
+    err |= nvs_get_str(my_handle, "pass", pass, &pass_len);
+    switch (err) {
+        case ESP_OK:
+            Serial.printf("Done\n");
+            //Serial.printf("SSID = %s\n", ssid);
+            //Serial.printf("PASSWD = %s\n", pass);
+            wifi_have_credentials = true;
+            break;
+        case ESP_ERR_NVS_NOT_FOUND:
+            Serial.printf("The value is not initialized yet!\n");
+            break;
+        default:
+            Serial.printf("Error (%s) reading!\n", esp_err_to_name(err));
+    }
+
+    // Cached AP/lease from the last successful connection (absent on first boot)
+    size_t cache_len = sizeof(wifi_cache);
+    err = nvs_get_blob(my_handle, "ap_cache", &wifi_cache, &cache_len);
+    wifi_cache_valid = (err == ESP_OK && cache_len == sizeof(wifi_cache) && wifi_cache.channel != 0);
+    Serial.printf(wifi_cache_valid ? "Found cached AP\n" : "No cached AP\n");
+
+    // Close
+    nvs_close(my_handle);
+}
+
+static void wifi_cache_store()
+{
+    WifiCache fresh;
+    memcpy(fresh.bssid, WiFi.BSSID(), sizeof(fresh.bssid));
+    fresh.channel = WiFi.channel();
+    fresh.ip = (uint32_t)WiFi.localIP();
+    fresh.gateway = (uint32_t)WiFi.gatewayIP();
+    fresh.subnet = (uint32_t)WiFi.subnetMask();
+    fresh.dns = (uint32_t)WiFi.dnsIP();
+
+    // only touch flash when something actually changed
+    if (wifi_cache_valid && memcmp(&fresh, &wifi_cache, sizeof(fresh)) == 0)
+        return;
+
+    nvs_handle_t my_handle;
+    if (nvs_open("storage", NVS_READWRITE, &my_handle) != ESP_OK)
+        return;
+    esp_err_t err = nvs_set_blob(my_handle, "ap_cache", &fresh, sizeof(fresh));
+    if (err == ESP_OK)
+        err = nvs_commit(my_handle);
+    nvs_close(my_handle);
+
+    if (err == ESP_OK) {
+        wifi_cache = fresh;
+        wifi_cache_valid = true;
+    }
+}
+
+static void enter_state(WifiState next)
+{
+    state = next;
+    state_timer = millis();
+    power_set(POWER_RADIO, next != WIFI_STATE_IDLE && next != WIFI_STATE_BACKOFF, state_timer);
+
+    switch (next) {
+        case WIFI_STATE_FAST_CONNECT:
+            Serial.printf("WiFi: fast connect to cached AP on channel %u\n", wifi_cache.channel);
+            WiFi.config(IPAddress(wifi_cache.ip), IPAddress(wifi_cache.gateway),
+                        IPAddress(wifi_cache.subnet), IPAddress(wifi_cache.dns));
+            WiFi.begin(ssid, pass, wifi_cache.channel, wifi_cache.bssid);
+            on_cached_lease = true;
+            break;
+        case WIFI_STATE_SCAN_CONNECT:
+            Serial.print("WiFi: scanning for ");
+            Serial.println(ssid);
+            // back to DHCP, the cached lease may be the reason the fast path failed
+            WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));
+            WiFi.begin(ssid, pass);
+            on_cached_lease = false;
+            break;
+        case WIFI_STATE_DHCP:
+            // the cached lease may have expired or been handed to someone else;
+            // a DHCP client on the live link gets a current one (or the same)
+            Serial.println("WiFi: renewing the cached lease");
+            WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));
+            on_cached_lease = false;
+            break;
+        case WIFI_STATE_CONNECTED:
+            backoff_time = WIFI_BACKOFF_MIN;
+            Serial.println("WiFi connected");
+            Serial.println("IP address: ");
+            Serial.println(WiFi.localIP());
+            Serial.println("MAC address: ");
+            Serial.println(WiFi.macAddress());
+            boot_mark("wifi_connected", micros());
+            wifi_cache_store();
+            break;
+        case WIFI_STATE_BACKOFF:
+            WiFi.disconnect(true); // radio off while we wait, begin() turns it back on
+            Serial.printf("WiFi: retrying in %lu ms\n", backoff_time);
+            break;
+        case WIFI_STATE_IDLE:
+            break;
+    }
+}
+
+static void backoff(WifiState retry)
+{
+    state_after_backoff = retry;
+    enter_state(WIFI_STATE_BACKOFF);
+}
+
+void wifi_setup()
+{
+    // Retrieve SSID/PASSWD and cached AP from flash before anything else
+    nvs_access();
+
+    WiFi.persistent(false); // we keep our own copy in NVS
+    WiFi.setAutoReconnect(false); // reconnects are driven by wifi_loop()
+    WiFi.mode(WIFI_STA);
+
+    if (!wifi_have_credentials)
+        return;
+    enter_state(wifi_cache_valid ? WIFI_STATE_FAST_CONNECT : WIFI_STATE_SCAN_CONNECT);
+}
+
+void wifi_loop()
+{
+    bool up = (WiFi.status() == WL_CONNECTED);
+    unsigned long elapsed = millis() - state_timer;
+
+    switch (state) {
+        case WIFI_STATE_IDLE:
+            break;
+        case WIFI_STATE_FAST_CONNECT:
+            if (up)
+                enter_state(WIFI_STATE_CONNECTED);
+            else if (elapsed >= WIFI_FAST_CONNECT_TIMEOUT) {
+                WiFi.disconnect();
+                enter_state(WIFI_STATE_SCAN_CONNECT);
+            }
+            break;
+        case WIFI_STATE_SCAN_CONNECT:
+            if (up)
+                enter_state(WIFI_STATE_CONNECTED);
+            else if (elapsed >= WIFI_SCAN_CONNECT_TIMEOUT)
+                backoff(wifi_cache_valid ? WIFI_STATE_FAST_CONNECT : WIFI_STATE_SCAN_CONNECT);
+            break;
+        case WIFI_STATE_CONNECTED:
+            if (!up) {
+                Serial.println("WiFi: link lost");
+                WiFi.disconnect();
+                enter_state(wifi_cache_valid ? WIFI_STATE_FAST_CONNECT : WIFI_STATE_SCAN_CONNECT);
+            } else if (on_cached_lease && elapsed >= WIFI_LEASE_CHECK_DELAY)
+                enter_state(WIFI_STATE_DHCP);
+            break;
+        case WIFI_STATE_DHCP:
+            if (!up) {
+                Serial.println("WiFi: link lost");
+                WiFi.disconnect();
+                enter_state(WIFI_STATE_FAST_CONNECT);
+            } else if ((uint32_t)WiFi.localIP() != 0)
+                enter_state(WIFI_STATE_CONNECTED); // caches the new lease
+            else if (elapsed >= WIFI_DHCP_TIMEOUT) {
+                WiFi.disconnect();
+                enter_state(WIFI_STATE_SCAN_CONNECT);
+            }
+            break;
+        case WIFI_STATE_BACKOFF:
+            if (elapsed >= backoff_time) {
+                backoff_time = min(backoff_time * 2, (unsigned long)WIFI_BACKOFF_MAX);
+                enter_state(state_after_backoff);
+            }
+            break;
+    }
+}
+
+bool wifi_connected()
+{
+    return state == WIFI_STATE_CONNECTED;
+}
+
+WifiState wifi_state()
+{
+    return state;
+}
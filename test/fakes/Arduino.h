@@ -0,0 +1,176 @@
+#pragma once
+
+// Host stand-in for the parts of the Arduino core the firmware uses
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include "esp_system.h"
+#include "fake_clock.h"
+
+using std::max;
+using std::min;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define OUTPUT_OPEN_DRAIN 0x12
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+#define IRAM_ATTR
+
+inline unsigned long millis()
+{
+    return (uint32_t)(fake_now_us / 1000); // wraps like the real 32-bit counter
+}
+
+inline unsigned long micros()
+{
+    return (uint32_t)fake_now_us;
+}
+
+inline void delay(uint32_t ms)
+{
+    fake_sleep_us((uint64_t)ms * 1000);
+}
+
+inline void delayMicroseconds(uint32_t us)
+{
+    fake_advance_us(us);
+}
+
+inline void yield()
+{
+    fake_advance_us(1000); // busy-wait loops have to make progress, 1ms is fine-grained enough
+}
+
+// Pins: tests set analog values, firmware writes are recorded
+inline int fake_analog[40];
+inline int fake_digital[40];
+inline int fake_pin_mode[40];
+
+// A fake peripheral that owns a pin (Wire.h's bus) can watch writes and
+// answer reads; the read hook returns -1 for pins it doesn't own
+inline void (*fake_pin_write_hook)(uint8_t pin, uint8_t val);
+inline int (*fake_pin_read_hook)(uint8_t pin);
+
+inline void pinMode(uint8_t pin, uint8_t mode) { fake_pin_mode[pin] = mode; }
+
+inline void digitalWrite(uint8_t pin, uint8_t val)
+{
+    fake_digital[pin] = val;
+    if (fake_pin_write_hook)
+        fake_pin_write_hook(pin, val);
+}
+
+inline int digitalRead(uint8_t pin)
+{
+    int v = fake_pin_read_hook ? fake_pin_read_hook(pin) : -1;
+    return v >= 0 ? v : fake_digital[pin];
+}
+inline uint16_t analogRead(uint8_t pin) { return fake_analog[pin]; }
+
+// GPIO interrupts: tests fire one with fake_interrupt(pin)
+struct FakeIsr {
+    void (*fn)(void *);
+    void *arg;
+    int mode;
+};
+
+inline FakeIsr fake_isr[40];
+
+inline int digitalPinToInterrupt(uint8_t pin) { return pin; }
+inline void attachInterruptArg(uint8_t pin, void (*fn)(void *), void *arg, int mode) { fake_isr[pin] = {fn, arg, mode}; }
+inline void detachInterrupt(uint8_t pin) { fake_isr[pin] = {nullptr, nullptr, 0}; }
+
+inline void fake_interrupt(uint8_t pin)
+{
+    if (fake_isr[pin].fn)
+        fake_isr[pin].fn(fake_isr[pin].arg);
+}
+
+// LEDC (buzzer)
+inline uint32_t fake_ledc_freq[16];
+inline uint32_t fake_ledc_duty[16];
+
+inline double ledcSetup(uint8_t chan, double freq, uint8_t) { fake_ledc_freq[chan] = freq; return freq; }
+inline void ledcAttachPin(uint8_t, uint8_t) {}
+inline double ledcChangeFrequency(uint8_t chan, double freq, uint8_t) { fake_ledc_freq[chan] = freq; return freq; }
+inline void ledcWrite(uint8_t chan, uint32_t duty) { fake_ledc_duty[chan] = duty; }
+
+// Just enough of String for the few APIs that still return one
+class String {
+public:
+    String(const char *s = "") : str(s) {}
+    const char *c_str() const { return str.c_str(); }
+    size_t length() const { return str.size(); }
+
+private:
+    std::string str;
+};
+
+class IPAddress {
+public:
+    IPAddress(uint32_t addr = 0) : addr(addr) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : addr(a | (b << 8) | (c << 16) | ((uint32_t)d << 24)) {}
+    operator uint32_t() const { return addr; }
+    bool operator==(const IPAddress &o) const { return addr == o.addr; }
+
+private:
+    uint32_t addr; // network order, like the real one
+};
+
+// Serial prints to stdout when echo is set, tests usually keep it quiet
+class FakeSerial {
+public:
+    bool echo = false;
+
+    void begin(unsigned long) {}
+    size_t print(const char *s) { return out("%s", s); }
+    size_t print(const String &s) { return out("%s", s.c_str()); }
+    size_t print(int v) { return out("%d", v); }
+    size_t print(unsigned v) { return out("%u", v); }
+    size_t print(long v) { return out("%ld", v); }
+    size_t print(unsigned long v) { return out("%lu", v); }
+    size_t print(double v) { return out("%.2f", v); }
+    size_t print(const IPAddress &ip)
+    {
+        uint32_t a = ip;
+        return out("%u.%u.%u.%u", a & 0xff, (a >> 8) & 0xff, (a >> 16) & 0xff, a >> 24);
+    }
+    template <typename T>
+    size_t println(const T &v) { return print(v) + out("\n"); }
+    size_t println() { return out("\n"); }
+
+    size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)))
+    {
+        if (!echo)
+            return 0;
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vprintf(fmt, ap);
+        va_end(ap);
+        return n > 0 ? n : 0;
+    }
+
+private:
+    size_t out(const char *fmt, ...) __attribute__((format(printf, 2, 3)))
+    {
+        if (!echo)
+            return 0;
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vprintf(fmt, ap);
+        va_end(ap);
+        return n > 0 ? n : 0;
+    }
+};
+
+inline FakeSerial Serial;
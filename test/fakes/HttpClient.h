@@ -0,0 +1,205 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ctype.h>
+#include <WiFi.h>
+
+// Same API and waiting behaviour as amcewen/HttpClient 2.2: status line and
+// headers are read a byte at a time and an empty socket costs a
+// kHttpWaitForDataDelay delay(), so virtual-time stalls match the device.
+
+static const int HTTP_SUCCESS = 0;
+static const int HTTP_ERROR_CONNECTION_FAILED = -1;
+static const int HTTP_ERROR_API = -2;
+static const int HTTP_ERROR_TIMED_OUT = -3;
+static const int HTTP_ERROR_INVALID_RESPONSE = -4;
+
+class HttpClient {
+public:
+    static const int kNoContentLengthHeader = -1;
+    static const int kHttpPort = 80;
+    static const int kHttpWaitForDataDelay = 1000;
+    static const int kHttpResponseTimeout = 30 * 1000;
+
+    HttpClient(WiFiClient &client) : client(&client) {}
+
+    void beginRequest() { state = REQUEST_STARTED; }
+    void endRequest()
+    {
+        if (state < REQUEST_SENT)
+            finishHeaders();
+    }
+
+    int get(const char *host, uint16_t port, const char *path) { return startRequest(host, port, path, "GET"); }
+    int get(const char *host, const char *path) { return get(host, kHttpPort, path); }
+    int post(const char *host, uint16_t port, const char *path) { return startRequest(host, port, path, "POST"); }
+    int post(const char *host, const char *path) { return post(host, kHttpPort, path); }
+
+    int startRequest(const char *host, uint16_t port, const char *path, const char *method)
+    {
+        bool began = (state == REQUEST_STARTED);
+        reset();
+        if (!client->connect(host, port))
+            return HTTP_ERROR_CONNECTION_FAILED;
+        char line[256];
+        snprintf(line, sizeof(line), "%s %s HTTP/1.1\r\nHost: %s:%u\r\nUser-Agent: Arduino/2.2.0\r\nConnection: close\r\n",
+                 method, path, host, (unsigned)port);
+        send(line);
+        state = REQUEST_STARTED;
+        if (!began)
+            finishHeaders();
+        return HTTP_SUCCESS;
+    }
+
+    void sendHeader(const char *name, const char *value)
+    {
+        char line[160];
+        snprintf(line, sizeof(line), "%s: %s\r\n", name, value);
+        send(line);
+    }
+    void sendHeader(const char *name, const int value)
+    {
+        char v[16];
+        snprintf(v, sizeof(v), "%d", value);
+        sendHeader(name, v);
+    }
+
+    size_t write(uint8_t b) { return write(&b, 1); }
+    size_t write(const uint8_t *buf, size_t size)
+    {
+        if (state < REQUEST_SENT)
+            finishHeaders();
+        return client->write(buf, size);
+    }
+    size_t print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+
+    int responseStatusCode()
+    {
+        if (state < REQUEST_SENT)
+            return HTTP_ERROR_API;
+        const char *prefix = "HTTP/*.* ";
+        const char *p = prefix;
+        int c = 0;
+        status = 0;
+        bool in_code = false, code_done = false;
+        unsigned long start = millis();
+        while (c != '\n' && millis() - start < kHttpResponseTimeout) {
+            if (client->available()) {
+                c = client->read();
+                if (!in_code) {
+                    if (*p != '*' && *p != c)
+                        return HTTP_ERROR_INVALID_RESPONSE;
+                    if (*++p == '\0')
+                        in_code = true;
+                } else if (!code_done) {
+                    if (isdigit(c))
+                        status = status * 10 + (c - '0');
+                    else
+                        code_done = true;
+                }
+                start = millis();
+            } else {
+                delay(kHttpWaitForDataDelay);
+            }
+        }
+        if (c != '\n')
+            return HTTP_ERROR_TIMED_OUT;
+        if (!code_done)
+            return HTTP_ERROR_INVALID_RESPONSE;
+        state = READING_HEADERS;
+        return status;
+    }
+
+    int skipResponseHeaders()
+    {
+        char line[128];
+        size_t len = 0;
+        unsigned long start = millis();
+        while (state != READING_BODY && millis() - start < kHttpResponseTimeout) {
+            if (client->available()) {
+                int c = client->read();
+                if (c == '\n') {
+                    line[len] = '\0';
+                    if (len == 0 || (len == 1 && line[0] == '\r'))
+                        state = READING_BODY;
+                    else if (strncasecmp(line, "Content-Length: ", 16) == 0)
+                        content_length = atoi(line + 16);
+                    len = 0;
+                } else if (len < sizeof(line) - 1) {
+                    line[len++] = c;
+                }
+                start = millis();
+            } else {
+                delay(kHttpWaitForDataDelay);
+            }
+        }
+        return state == READING_BODY ? HTTP_SUCCESS : HTTP_ERROR_TIMED_OUT;
+    }
+
+    int contentLength() { return content_length; }
+    bool endOfHeadersReached() { return state == READING_BODY; }
+    bool endOfBodyReached() { return state == READING_BODY && content_length >= 0 && consumed >= content_length; }
+
+    int available() { return client->available(); }
+    int read()
+    {
+        int c = client->read();
+        if (c >= 0 && state == READING_BODY)
+            consumed++;
+        return c;
+    }
+    int read(uint8_t *buf, size_t size)
+    {
+        int n = client->read(buf, size);
+        if (n > 0 && state == READING_BODY)
+            consumed += n;
+        return n;
+    }
+
+    // Stream::readBytes, gives up after a second without data
+    size_t readBytes(char *buf, size_t len)
+    {
+        size_t got = 0;
+        unsigned long start = millis();
+        while (got < len && millis() - start < 1000) {
+            int c = read();
+            if (c < 0) {
+                yield();
+                continue;
+            }
+            buf[got++] = c;
+            start = millis();
+        }
+        return got;
+    }
+
+    uint8_t connected() { return client->connected(); }
+    void stop()
+    {
+        client->stop();
+        reset();
+    }
+
+private:
+    enum State { IDLE, REQUEST_STARTED, REQUEST_SENT, READING_HEADERS, READING_BODY };
+
+    void reset()
+    {
+        state = IDLE;
+        status = 0;
+        content_length = kNoContentLengthHeader;
+        consumed = 0;
+    }
+    void send(const char *s) { client->write((const uint8_t *)s, strlen(s)); }
+    void finishHeaders()
+    {
+        send("\r\n");
+        state = REQUEST_SENT;
+    }
+
+    WiFiClient *client;
+    State state = IDLE;
+    int status = 0;
+    int content_length = kNoContentLengthHeader;
+    int consumed = 0;
+};
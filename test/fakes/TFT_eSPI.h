@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <iterator>
+#include <map>
+#include <string>
+
+// Records what would be on screen: the last string drawn at each y, and how
+// much drawing happened (fills are what cost SPI time on the real panel).
+
+#define TFT_BLACK 0x0000
+#define TFT_WHITE 0xFFFF
+#define TFT_RED 0xF800
+#define TFT_GREEN 0x07E0
+#define TFT_BLUE 0x001F
+#define TFT_YELLOW 0xFFE0
+#define TFT_DARKGREY 0x7BEF
+
+struct FakeTft {
+    std::map<int, std::string> lines; // y -> text
+    uint32_t fills = 0;
+    uint32_t strings = 0;
+    uint16_t text_color = TFT_WHITE;
+};
+
+inline FakeTft fake_tft;
+
+class TFT_eSPI {
+public:
+    TFT_eSPI(int16_t w = 135, int16_t h = 240) : w(w), h(h) {}
+
+    void init() { fake_tft = FakeTft(); }
+    void setRotation(uint8_t r) { rotation = r; }
+    void setTextSize(uint8_t s) { text_size = s; }
+    void setTextColor(uint16_t c) { fake_tft.text_color = c; }
+    void setTextColor(uint16_t c, uint16_t) { fake_tft.text_color = c; }
+    void fillScreen(uint32_t)
+    {
+        fake_tft.lines.clear();
+        fake_tft.fills++;
+    }
+    void fillRect(int32_t, int32_t y, int32_t, int32_t hh, uint32_t)
+    {
+        for (auto it = fake_tft.lines.begin(); it != fake_tft.lines.end();)
+            it = (it->first >= y && it->first < y + hh) ? fake_tft.lines.erase(it) : std::next(it);
+        fake_tft.fills++;
+    }
+    int16_t drawString(const char *s, int32_t, int32_t y, uint8_t = 1)
+    {
+        fake_tft.lines[y] = s;
+        fake_tft.strings++;
+        return (int16_t)(strlen(s) * 6 * text_size);
+    }
+    int16_t width() { return rotation & 1 ? h : w; }
+    int16_t height() { return rotation & 1 ? w : h; }
+
+private:
+    int16_t w, h;
+    uint8_t rotation = 0;
+    uint8_t text_size = 1;
+};
@@ -0,0 +1,385 @@
+#pragma once
+
+#include <Arduino.h>
+#include <string>
+#include "fake_mqtt.h"
+#include "fake_net.h"
+#include "fake_tls.h"
+
+// WiFi station on the virtual clock: begin() associates after
+// fake_net.associate_ms if fake_net.ap_up, and drops when ap_up goes false.
+// Without a static IP it isn't connected until DHCP has taken
+// fake_net.dhcp_ms more; config() back to 0.0.0.0 on a live link runs DHCP
+// again, with the link up but no address meanwhile.
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum {
+    WIFI_OFF = 0,
+    WIFI_STA = 1,
+    WIFI_AP = 2,
+    WIFI_AP_STA = 3
+} wifi_mode_t;
+
+class FakeWiFi {
+public:
+    wl_status_t begin(const char *, const char *, int32_t channel = 0, const uint8_t *bssid = nullptr,
+                      bool = true)
+    {
+        begun = true;
+        begun_at = millis();
+        renewing = false;
+        if (!static_ip)
+            dhcp_start(begun_at + fake_net.associate_ms);
+        chan = channel ? channel : 6;
+        if (bssid)
+            memcpy(ap_bssid, bssid, sizeof(ap_bssid));
+        fake_net.associations++;
+        return WL_DISCONNECTED;
+    }
+    bool config(IPAddress local, IPAddress gateway, IPAddress subnet, IPAddress dns = (uint32_t)0)
+    {
+        bool up = status() == WL_CONNECTED;
+        static_ip = local;
+        (void)gateway, (void)subnet, (void)dns;
+        if (!static_ip && up) {
+            renewing = true; // the link stays up while the DHCP client runs
+            dhcp_start(millis());
+        }
+        return true;
+    }
+    bool disconnect(bool = false, bool = false)
+    {
+        begun = false;
+        renewing = false;
+        return true;
+    }
+    bool mode(wifi_mode_t) { return true; }
+    void persistent(bool) {}
+    bool setAutoReconnect(bool) { return true; }
+
+    wl_status_t status()
+    {
+        if (!begun || !fake_net.ap_up || millis() - begun_at < fake_net.associate_ms)
+            return WL_DISCONNECTED;
+        // as on the ESP32, not connected with DHCP until there's a lease
+        if (!static_ip && !renewing && !leased())
+            return WL_DISCONNECTED;
+        return WL_CONNECTED;
+    }
+
+    IPAddress localIP()
+    {
+        if (static_ip)
+            return IPAddress(static_ip);
+        if (status() != WL_CONNECTED || !leased())
+            return IPAddress((uint32_t)0);
+        return IPAddress(192, 168, 1, 50);
+    }
+    IPAddress gatewayIP() { return IPAddress(192, 168, 1, 1); }
+    IPAddress subnetMask() { return IPAddress(255, 255, 255, 0); }
+    IPAddress dnsIP(uint8_t = 0) { return IPAddress(192, 168, 1, 1); }
+    uint8_t *BSSID() { return ap_bssid; }
+    int32_t channel() { return chan; }
+    int8_t RSSI() { return status() == WL_CONNECTED ? fake_net.rssi : 0; }
+    String macAddress() { return String("24:0A:C4:00:00:01"); }
+    uint8_t *macAddress(uint8_t *mac)
+    {
+        static const uint8_t m[6] = {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01};
+        memcpy(mac, m, sizeof(m));
+        return mac;
+    }
+
+private:
+    void dhcp_start(unsigned long at)
+    {
+        dhcp_at = at;
+        fake_net.dhcp_requests++;
+    }
+    bool leased() { return millis() - dhcp_at >= fake_net.dhcp_ms; }
+
+    bool begun = false;
+    unsigned long begun_at = 0;
+    int32_t chan = 0;
+    uint32_t static_ip = 0;
+    bool renewing = false; // DHCP restarted on a live link
+    unsigned long dhcp_at = 0; // DHCP client started, with the link up
+    uint8_t ap_bssid[6] = {0x10, 0x20, 0x30, 0x40, 0x50, 0x60};
+};
+
+inline FakeWiFi WiFi;
+
+// TCP client with an in-memory peer: bytes written are parsed as an HTTP
+// request, handed to fake_http_handler(), and the response becomes readable
+// once its latency has passed on the virtual clock. Connected to
+// fake_mqtt.port, the peer is the MQTT broker (fake_mqtt.h) instead; to
+// fake_tls.port, the same HTTP server behind TLS records (fake_tls.h).
+// The I/O calls are virtual, as they are on the ESP32 (Client), so a TLS
+// client can sit on top; among themselves they call this class's own, as
+// the ESP32's do, or the TLS client's bio would end up back in itself.
+class WiFiClient {
+public:
+    virtual ~WiFiClient() {}
+    virtual int connect(const char *, uint16_t port)
+    {
+        fake_net.connects++;
+        delay(fake_net.connect_ms);
+        if (WiFi.status() != WL_CONNECTED || !fake_net.server_up) {
+            fake_net.connect_failures++;
+            return 0;
+        }
+        open = true;
+        mqtt = port == fake_mqtt.port;
+        if (mqtt)
+            fake_mqtt_open();
+        tls = port == fake_tls.port;
+        tls_server = FakeTlsServer();
+        tls_server.last_io_us = fake_now_us;
+        tx.clear();
+        rx.clear();
+        rx_pos = 0;
+        drip_us = 0;
+        return 1;
+    }
+    virtual int connect(IPAddress, uint16_t port) { return connect("", port); }
+
+    // the server side of fake_net.inbound[index], what WiFiServer hands out
+    static WiFiClient accepted(size_t index)
+    {
+        WiFiClient c;
+        FakeInbound &in = fake_net.inbound[index];
+        c.open = true;
+        c.inbound = index + 1;
+        c.rx = in.request;
+        c.ready_at_us = fake_now_us + (uint64_t)in.latency_ms * 1000;
+        in.accepted_us = fake_now_us;
+        return c;
+    }
+
+    virtual size_t write(uint8_t b) { return WiFiClient::write(&b, 1); }
+    virtual size_t write(const uint8_t *buf, size_t size)
+    {
+        if (!open || tls_idle())
+            return 0;
+        if (inbound) {
+            fake_net.inbound[inbound - 1].response.append((const char *)buf, size);
+            fake_net.inbound_writes++;
+            return size;
+        }
+        if (mqtt) {
+            if (!fake_mqtt.tcp_open)
+                return 0;
+            fake_net.writes++;
+            fake_net.bytes_out += size;
+            fake_mqtt_receive(buf, size);
+            return size;
+        }
+        if (tls) {
+            fake_net.writes++;
+            fake_net.bytes_out += size;
+            tls_receive(buf, size);
+            return size;
+        }
+        tx.append((const char *)buf, size);
+        fake_net.writes++;
+        fake_net.bytes_out += size;
+        dispatch();
+        return size;
+    }
+
+    virtual int available()
+    {
+        tls_idle();
+        if (mqtt)
+            return open ? (int)fake_mqtt_available() : 0;
+        if (fake_now_us < ready_at_us)
+            return 0;
+        size_t have = rx.size();
+        if (drip_us) {
+            // bytes trickle in, one per drip interval since the first one
+            uint64_t released = (fake_now_us - ready_at_us) / drip_us + 1;
+            if (released < have)
+                have = released;
+        }
+        return have > rx_pos ? (int)(have - rx_pos) : 0;
+    }
+    virtual int read()
+    {
+        uint8_t b;
+        if (mqtt)
+            return WiFiClient::read(&b, 1) == 1 ? b : -1;
+        if (WiFiClient::available() <= 0)
+            return -1;
+        return (uint8_t)rx[rx_pos++];
+    }
+    virtual int read(uint8_t *buf, size_t size)
+    {
+        int n = WiFiClient::available();
+        if (n <= 0)
+            return -1;
+        if (mqtt)
+            return fake_mqtt_read(buf, size);
+        if ((size_t)n > size)
+            n = size;
+        memcpy(buf, rx.data() + rx_pos, n);
+        rx_pos += n;
+        return n;
+    }
+    virtual int peek()
+    {
+        if (mqtt)
+            return WiFiClient::available() > 0 ? (uint8_t)fake_mqtt.to_client.front().second[fake_mqtt.to_client_pos] : -1;
+        return WiFiClient::available() > 0 ? (uint8_t)rx[rx_pos] : -1;
+    }
+    virtual void flush() {}
+    virtual uint8_t connected()
+    {
+        if (mqtt)
+            return (open && fake_mqtt.tcp_open) || WiFiClient::available() > 0;
+        return open || WiFiClient::available() > 0;
+    }
+    virtual void stop()
+    {
+        if (mqtt && open)
+            fake_mqtt.tcp_open = fake_mqtt.connected = false;
+        if (inbound && open) {
+            fake_net.inbound[inbound - 1].closed = true;
+            fake_net.inbound[inbound - 1].closed_us = fake_now_us;
+        }
+        open = false;
+        rx.clear();
+        rx_pos = 0;
+    }
+    operator bool() { return open; }
+    int fd() const { return -1; } // no socket to select() on, readers poll
+
+private:
+    // Once a whole request (headers + Content-Length body) is in, answer it
+    void dispatch()
+    {
+        size_t end = tx.find("\r\n\r\n");
+        if (end == std::string::npos)
+            return;
+        FakeHttpRequest req;
+        size_t line_end = tx.find("\r\n");
+        std::string line = tx.substr(0, line_end);
+        size_t sp1 = line.find(' '), sp2 = line.rfind(' ');
+        req.method = line.substr(0, sp1);
+        req.path = line.substr(sp1 + 1, sp2 - sp1 - 1);
+        size_t pos = line_end + 2;
+        while (pos < end) {
+            size_t eol = tx.find("\r\n", pos);
+            std::string h = tx.substr(pos, eol - pos);
+            size_t colon = h.find(':');
+            if (colon != std::string::npos)
+                req.headers[h.substr(0, colon)] = h.substr(colon + 2);
+            pos = eol + 2;
+        }
+        size_t body_len = 0;
+        auto cl = req.headers.find("Content-Length");
+        if (cl != req.headers.end())
+            body_len = strtoul(cl->second.c_str(), nullptr, 10);
+        if (tx.size() < end + 4 + body_len)
+            return;
+        req.body = tx.substr(end + 4, body_len);
+        tx.erase(0, end + 4 + body_len);
+
+        fake_net.requests++;
+        FakeHttpResponse resp = fake_http_handler(req);
+        if (resp.drop)
+            return;
+        if (resp.reset) {
+            open = false; // peer sent RST, reads just come back empty
+            return;
+        }
+        char head[160];
+        snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n\r\n",
+                 resp.status, resp.status == 200 ? "OK" : "ERROR", resp.content_type.c_str(), resp.body.size());
+        std::string out = head + resp.body;
+        if (tls)
+            out = fake_tls_record(FAKE_TLS_APP_DATA, std::string(8, '\0') + out + std::string(16, '\0'));
+        rx.append(out);
+        fake_net.bytes_in += out.size();
+        ready_at_us = fake_now_us + (uint64_t)resp.latency_ms * 1000;
+        drip_us = (uint64_t)resp.drip_ms * 1000;
+    }
+
+    // Records from the client: handshake flights answered after a
+    // latency, application data into tx for dispatch()
+    void tls_receive(const uint8_t *buf, size_t size)
+    {
+        tls_server.in.append((const char *)buf, size);
+        tls_server.last_io_us = fake_now_us;
+        uint8_t type;
+        std::string body, reply, plain;
+        while (fake_tls_take_record(tls_server.in, type, body)) {
+            if (!tls_server.receive(type, body, reply, plain)) {
+                open = false;
+                break;
+            }
+        }
+        if (!reply.empty()) {
+            rx.append(reply);
+            fake_net.bytes_in += reply.size();
+            ready_at_us = fake_now_us + (uint64_t)fake_tls.latency_ms * 1000;
+            drip_us = 0;
+        }
+        if (!plain.empty()) {
+            tx.append(plain);
+            dispatch();
+            if (ready_at_us > tls_server.last_io_us)
+                tls_server.last_io_us = ready_at_us;
+        }
+    }
+
+    // The server closes a keep-alive connection left quiet too long:
+    // close_notify, then FIN
+    bool tls_idle()
+    {
+        if (!tls || !open || fake_now_us < tls_server.last_io_us + (uint64_t)fake_tls.idle_timeout_s * 1000000)
+            return false;
+        rx.append(fake_tls_record(FAKE_TLS_ALERT, std::string(2 + FAKE_TLS_GCM_OVERHEAD, '\0')));
+        fake_tls.idle_closes++;
+        open = false;
+        return true;
+    }
+
+    bool open = false;
+    bool mqtt = false; // talking to fake_mqtt
+    bool tls = false; // to fake_tls
+    FakeTlsServer tls_server;
+    size_t inbound = 0; // 1 + index into fake_net.inbound if accepted by WiFiServer
+    std::string tx, rx;
+    size_t rx_pos = 0;
+    uint64_t ready_at_us = 0;
+    uint64_t drip_us = 0;
+};
+
+// Listens only while associated; available() accepts the next of
+// fake_net.inbound once it has connected, or returns a client that tests
+// false
+class WiFiServer {
+public:
+    explicit WiFiServer(uint16_t port) : port(port) {}
+    void begin() { listening = true; }
+    void end() { listening = false; }
+    void setNoDelay(bool) {}
+    WiFiClient available()
+    {
+        if (!listening || WiFi.status() != WL_CONNECTED || fake_net.inbound_next >= fake_net.inbound.size() ||
+            fake_net.inbound[fake_net.inbound_next].connected_us > fake_now_us)
+            return WiFiClient();
+        return WiFiClient::accepted(fake_net.inbound_next++);
+    }
+    WiFiClient accept() { return available(); }
+
+    uint16_t port;
+    bool listening = false;
+};
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stdint.h>
+
+// I2C bus at the wire level, as far as the firmware can tell: transfers
+// take virtual time at the configured clock, TCA9548A muxes sit at
+// 0x70..0x77 and DHT20s answer at 0x38 with real status bytes and CRCs.
+//
+// fake_dht is the DHT20 wired straight to the bus. fake_dht_mux[m][c] sits
+// behind channel c of the mux at 0x70 + m and is only reachable while that
+// channel is selected. Every sensor the bus reaches answers at once, and
+// since the bus is open drain what the controller reads is the AND of them,
+// which fails the CRC; that is what leaving two muxes open looks like.
+//
+// sda_stuck models a slave holding SDA low: every transfer times out until
+// the firmware clocks SCL by hand (stuck_clocks rising edges).
+
+#define FAKE_MUX_BASE 0x70
+#define FAKE_MUXES 8
+#define FAKE_DHT_ADDR 0x38
+#define FAKE_SDA_PIN 21
+#define FAKE_SCL_PIN 22
+
+struct FakeDht {
+    float temperature = 21.5f; // °C
+    float humidity = 55.0f; // % RH
+    bool connected = true;
+    bool calibrated = true; // status bits 0x18, set at the factory
+    uint32_t conversion_ms = 80;
+    bool triggered = false;
+    uint64_t started_us = 0; // last 0xAC trigger
+    bool measured = false; // a conversion has finished since power-up
+    uint32_t reads = 0; // 7-byte reads of a finished conversion
+};
+
+struct FakeI2c {
+    bool mux_present[FAKE_MUXES] = {};
+    uint8_t mux_select[FAKE_MUXES] = {}; // channel mask last written to each
+    uint32_t transactions = 0;
+    uint64_t bus_us = 0; // time spent on transfers
+    uint32_t timeouts = 0; // the next this many transfers time out
+    bool sda_stuck = false;
+    uint32_t stuck_clocks = 5; // SCL pulses until the slave lets go
+    uint32_t scl_pulses = 0; // hand-clocked while stuck
+    bool scl_high = true; // idle bus
+};
+
+inline FakeI2c fake_i2c;
+inline FakeDht fake_dht;
+inline FakeDht fake_dht_mux[FAKE_MUXES][8];
+
+// Every DHT20 the bus reaches right now; returns how many
+inline int fake_dht_reachable(FakeDht **out, int max)
+{
+    int n = 0;
+    if (fake_dht.connected && n < max)
+        out[n++] = &fake_dht;
+    for (int m = 0; m < FAKE_MUXES; m++) {
+        if (!fake_i2c.mux_present[m])
+            continue;
+        for (int c = 0; c < 8; c++)
+            if ((fake_i2c.mux_select[m] & (1 << c)) && fake_dht_mux[m][c].connected && n < max)
+                out[n++] = &fake_dht_mux[m][c];
+    }
+    return n;
+}
+
+inline uint8_t fake_dht_crc(const uint8_t *p, int len)
+{
+    uint8_t crc = 0xFF;
+    while (len--) {
+        crc ^= *p++;
+        for (int i = 0; i < 8; i++)
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+// status, 20-bit RH, 20-bit temperature, CRC: datasheet section 7.4
+inline void fake_dht_bytes(FakeDht &d, uint8_t *b)
+{
+    bool busy = d.triggered && fake_now_us - d.started_us < (uint64_t)d.conversion_ms * 1000;
+    if (!busy && d.triggered)
+        d.measured = true;
+    uint32_t h = d.measured ? (uint32_t)(d.humidity / 100.0f * 1048576.0f) : 0;
+    uint32_t t = d.measured ? (uint32_t)((d.temperature + 50.0f) / 200.0f * 1048576.0f) : 0;
+    if (h > 0xFFFFF)
+        h = 0xFFFFF;
+    b[0] = (d.calibrated ? 0x18 : 0x00) | (busy ? 0x80 : 0x00);
+    b[1] = h >> 12;
+    b[2] = h >> 4;
+    b[3] = ((h & 0x0F) << 4) | ((t >> 16) & 0x0F);
+    b[4] = t >> 8;
+    b[5] = t;
+    b[6] = fake_dht_crc(b, 6);
+}
+
+inline void fake_i2c_pin_write(uint8_t pin, uint8_t val)
+{
+    // rising edges on a hand-driven SCL walk the stuck slave through its byte
+    if (pin != FAKE_SCL_PIN || fake_pin_mode[pin] != OUTPUT_OPEN_DRAIN)
+        return;
+    bool rising = val == HIGH && !fake_i2c.scl_high;
+    fake_i2c.scl_high = val == HIGH;
+    if (rising && fake_i2c.sda_stuck && ++fake_i2c.scl_pulses >= fake_i2c.stuck_clocks)
+        fake_i2c.sda_stuck = false;
+}
+
+inline int fake_i2c_pin_read(uint8_t pin)
+{
+    if (pin == FAKE_SDA_PIN)
+        return fake_i2c.sda_stuck ? LOW : HIGH;
+    return -1;
+}
+
+class TwoWire {
+public:
+    bool begin(int = -1, int = -1, uint32_t hz = 100000)
+    {
+        clock = hz;
+        return true;
+    }
+    void end() {}
+    void setClock(uint32_t hz) { clock = hz; }
+    uint32_t getClock() { return clock; }
+    void setTimeOut(uint16_t ms) { timeout_ms = ms; }
+
+    void beginTransmission(uint8_t address)
+    {
+        tx_address = address;
+        tx_len = 0;
+    }
+    size_t write(uint8_t b)
+    {
+        if (tx_len == sizeof(tx))
+            return 0;
+        tx[tx_len++] = b;
+        return 1;
+    }
+    size_t write(const uint8_t *data, size_t len)
+    {
+        size_t n = 0;
+        while (n < len && write(data[n]))
+            n++;
+        return n;
+    }
+
+    uint8_t endTransmission(bool = true)
+    {
+        if (stalled())
+            return 5;
+        transfer(tx_len);
+        if (tx_address >= FAKE_MUX_BASE && tx_address < FAKE_MUX_BASE + FAKE_MUXES) {
+            int m = tx_address - FAKE_MUX_BASE;
+            if (!fake_i2c.mux_present[m])
+                return 2; // address NACK
+            if (tx_len > 0)
+                fake_i2c.mux_select[m] = tx[0];
+            return 0;
+        }
+        if (tx_address == FAKE_DHT_ADDR) {
+            FakeDht *d[FAKE_MUXES * 8 + 1];
+            int n = fake_dht_reachable(d, sizeof(d) / sizeof(d[0]));
+            if (n == 0)
+                return 2;
+            bool trigger = tx_len == 3 && tx[0] == 0xAC && tx[1] == 0x33 && tx[2] == 0x00;
+            bool reinit = tx_len == 3 && (tx[0] & 0xF0) == 0xB0; // writing back 0x1B/0x1C/0x1E
+            for (int i = 0; i < n; i++) {
+                if (trigger) {
+                    d[i]->triggered = true;
+                    d[i]->started_us = fake_now_us;
+                }
+                if (reinit)
+                    d[i]->calibrated = true;
+            }
+            return 0;
+        }
+        return 2;
+    }
+
+    uint8_t requestFrom(uint8_t address, uint8_t len)
+    {
+        rx_len = rx_pos = 0;
+        if (stalled())
+            return 0;
+        transfer(len);
+        if (address != FAKE_DHT_ADDR || len > sizeof(rx))
+            return 0;
+        FakeDht *d[FAKE_MUXES * 8 + 1];
+        int n = fake_dht_reachable(d, sizeof(d) / sizeof(d[0]));
+        if (n == 0)
+            return 0;
+        uint8_t bytes[7];
+        memset(rx, 0xFF, sizeof(rx));
+        for (int i = 0; i < n; i++) {
+            fake_dht_bytes(*d[i], bytes);
+            if (len == 7 && !(bytes[0] & 0x80) && d[i]->measured)
+                d[i]->reads++;
+            for (int j = 0; j < 7; j++)
+                rx[j] &= bytes[j]; // open drain: any 0 wins
+        }
+        rx_len = len < 7 ? len : 7;
+        return rx_len;
+    }
+    int available() { return rx_len - rx_pos; }
+    int read() { return rx_pos < rx_len ? rx[rx_pos++] : -1; }
+
+private:
+    // address byte plus len, 9 clocks each, plus START and STOP
+    void transfer(size_t len)
+    {
+        fake_i2c.transactions++;
+        uint64_t us = ((len + 1) * 9 + 2) * 1000000ULL / clock;
+        fake_i2c.bus_us += us;
+        fake_advance_us(us);
+    }
+
+    bool stalled()
+    {
+        if (!fake_i2c.sda_stuck && fake_i2c.timeouts == 0)
+            return false;
+        if (fake_i2c.timeouts > 0)
+            fake_i2c.timeouts--;
+        fake_i2c.transactions++;
+        fake_advance_us(timeout_ms * 1000ULL);
+        return true;
+    }
+
+    uint32_t clock = 100000;
+    uint16_t timeout_ms = 50;
+    uint8_t tx_address = 0;
+    uint8_t tx[8];
+    size_t tx_len = 0;
+    uint8_t rx[8];
+    uint8_t rx_len = 0, rx_pos = 0;
+};
+
+inline TwoWire Wire;
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Heap figures are whatever the test sets, defaults look like a healthy ESP32
+
+#define MALLOC_CAP_8BIT (1 << 2)
+
+inline size_t fake_heap_free = 200000;
+inline size_t fake_heap_min_free = 180000;
+inline size_t fake_heap_largest_block = 110000;
+
+inline size_t heap_caps_get_free_size(uint32_t) { return fake_heap_free; }
+inline size_t heap_caps_get_minimum_free_size(uint32_t) { return fake_heap_min_free; }
+inline size_t heap_caps_get_largest_free_block(uint32_t) { return fake_heap_largest_block; }
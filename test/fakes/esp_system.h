@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_INVALID_SIZE 0x104
+#define ESP_ERR_NOT_FOUND 0x105
+
+#define ESP_ERROR_CHECK(x)                                             \
+    do {                                                               \
+        esp_err_t err_rc_ = (x);                                       \
+        if (err_rc_ != ESP_OK) {                                       \
+            fprintf(stderr, "ESP_ERROR_CHECK failed: %s\n", #x);       \
+            abort();                                                   \
+        }                                                              \
+    } while (0)
+
+inline const char *esp_err_to_name(esp_err_t err)
+{
+    return err == ESP_OK ? "ESP_OK" : "ESP_ERR";
+}
+
+inline uint32_t fake_random_state = 1;
+
+inline uint32_t esp_random()
+{
+    fake_random_state = fake_random_state * 1664525u + 1013904223u;
+    return fake_random_state;
+}
+
+inline void esp_restart()
+{
+    fprintf(stderr, "esp_restart() on the host\n");
+    exit(0);
+}
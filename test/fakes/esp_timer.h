@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_system.h"
+#include "fake_clock.h"
+
+// esp_timer one-shots on the virtual clock, see fake_clock.h
+
+typedef FakeTimer *esp_timer_handle_t;
+
+typedef struct {
+    void (*callback)(void *arg);
+    void *arg;
+    int dispatch_method;
+    const char *name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+inline esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out)
+{
+    FakeTimer *t = new FakeTimer{args->callback, args->arg, 0, false};
+    fake_timers.push_back(t);
+    *out = t;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_timer_start_once(esp_timer_handle_t t, uint64_t timeout_us)
+{
+    t->deadline_us = fake_now_us + timeout_us;
+    t->armed = true;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_timer_stop(esp_timer_handle_t t)
+{
+    if (!t->armed)
+        return ESP_ERR_INVALID_STATE;
+    t->armed = false;
+    return ESP_OK;
+}
+
+inline int64_t esp_timer_get_time()
+{
+    return (int64_t)fake_now_us;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// Virtual time for the native build. Nothing moves unless delay() is called
+// or a test calls fake_advance_us(); esp_timer callbacks fire in deadline
+// order as time passes them.
+
+struct FakeTimer {
+    void (*callback)(void *);
+    void *arg;
+    uint64_t deadline_us;
+    bool armed;
+};
+
+inline uint64_t fake_now_us = 0;
+inline std::vector<FakeTimer *> fake_timers;
+
+inline void fake_advance_us(uint64_t us)
+{
+    uint64_t end = fake_now_us + us;
+    for (;;) {
+        FakeTimer *next = nullptr;
+        for (FakeTimer *t : fake_timers)
+            if (t->armed && t->deadline_us <= end && (next == nullptr || t->deadline_us < next->deadline_us))
+                next = t;
+        if (next == nullptr)
+            break;
+        if (next->deadline_us > fake_now_us)
+            fake_now_us = next->deadline_us;
+        next->armed = false;
+        next->callback(next->arg);
+    }
+    fake_now_us = end;
+}
+
+inline void fake_advance_ms(uint32_t ms)
+{
+    fake_advance_us((uint64_t)ms * 1000);
+}
+
+// The thread blocking: delay(), or a timed wait in freertos/task.h. The most
+// recent one is kept, so a caller can tell idle time from busy time.
+inline uint64_t fake_last_sleep_us;
+inline uint64_t fake_last_sleep_end_us;
+
+inline void fake_sleep_us(uint64_t us)
+{
+    fake_advance_us(us);
+    fake_last_sleep_us = us;
+    fake_last_sleep_end_us = fake_now_us;
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <stdint.h>
+#include <deque>
+#include <functional>
+#include <string>
+#include <utility>
+#include "fake_clock.h"
+#include "fake_net.h"
+
+// MQTT broker stand-in. A WiFiClient connected to fake_mqtt.port talks
+// MQTT 3.1.1 bytes to it instead of HTTP: CONNECT, SUBSCRIBE, PUBLISH at
+// QoS 0/1, PINGREQ and DISCONNECT are answered the way mosquitto would, one
+// session at a time. Every PUBLISH from the device goes to
+// fake_mqtt.handler, which says how the broker acks it and what the server
+// behind it publishes back; fake_mqtt_push() publishes to the device any
+// time. Bytes count in fake_net.bytes_out/bytes_in and a PUBLISH in
+// fake_net.requests, like HTTP ones do.
+
+struct FakeMqttPublish {
+    std::string topic;
+    std::string payload;
+    uint8_t qos;
+};
+
+struct FakeMqttAck {
+    uint32_t latency_ms = 5; // PUBLISH in -> PUBACK (and any reply) out
+    bool drop = false; // never PUBACK
+    bool reset = false; // close the connection instead
+    std::string reply_topic, reply; // published to the device after the PUBACK, if non-empty
+};
+
+struct FakeMqtt {
+    uint16_t port = 1883;
+    uint32_t latency_ms = 5; // CONNACK, SUBACK, PINGRESP
+    std::function<FakeMqttAck(const FakeMqttPublish &)> handler;
+
+    // the session
+    bool tcp_open = false;
+    bool connected = false; // CONNECT accepted
+    std::string client_id;
+    uint16_t keepalive_s = 0;
+    std::string subscription;
+    std::string from_client; // bytes not yet a whole packet
+    std::deque<std::pair<uint64_t, std::string>> to_client; // readable from, bytes
+    size_t to_client_pos = 0; // into the front entry
+
+    // what happened
+    uint32_t connects = 0;
+    uint32_t publishes = 0;
+    uint32_t pubacks = 0;
+    uint32_t pushes = 0;
+    uint32_t pings = 0;
+    uint32_t disconnects = 0;
+};
+
+inline FakeMqtt fake_mqtt;
+
+inline void fake_mqtt_send(const std::string &pkt, uint32_t latency_ms)
+{
+    uint64_t at = fake_now_us + (uint64_t)latency_ms * 1000;
+    if (!fake_mqtt.to_client.empty() && fake_mqtt.to_client.back().first > at)
+        at = fake_mqtt.to_client.back().first; // in order, like TCP
+    fake_mqtt.to_client.emplace_back(at, pkt);
+    fake_net.bytes_in += pkt.size();
+}
+
+inline std::string fake_mqtt_length(size_t n)
+{
+    std::string out;
+    do {
+        uint8_t b = n % 128;
+        n /= 128;
+        out += (char)(n ? b | 0x80 : b);
+    } while (n);
+    return out;
+}
+
+inline std::string fake_mqtt_string(const std::string &s)
+{
+    return std::string(1, (char)(s.size() >> 8)) + (char)(s.size() & 0xFF) + s;
+}
+
+// A QoS 0 PUBLISH to the device, if it is subscribed to topic
+inline bool fake_mqtt_push(const std::string &topic, const std::string &payload, uint32_t latency_ms = 0)
+{
+    if (!fake_mqtt.tcp_open || fake_mqtt.subscription != topic)
+        return false;
+    std::string body = fake_mqtt_string(topic) + payload;
+    fake_mqtt_send(std::string(1, (char)0x30) + fake_mqtt_length(body.size()) + body, latency_ms);
+    fake_mqtt.pushes++;
+    return true;
+}
+
+inline size_t fake_mqtt_available()
+{
+    size_t n = 0;
+    for (auto &chunk : fake_mqtt.to_client) {
+        if (chunk.first > fake_now_us)
+            break;
+        n += chunk.second.size();
+    }
+    return n - fake_mqtt.to_client_pos;
+}
+
+inline size_t fake_mqtt_read(uint8_t *buf, size_t size)
+{
+    size_t got = 0;
+    while (got < size && !fake_mqtt.to_client.empty() && fake_mqtt.to_client.front().first <= fake_now_us) {
+        std::string &chunk = fake_mqtt.to_client.front().second;
+        size_t n = chunk.size() - fake_mqtt.to_client_pos;
+        if (n > size - got)
+            n = size - got;
+        memcpy(buf + got, chunk.data() + fake_mqtt.to_client_pos, n);
+        got += n;
+        fake_mqtt.to_client_pos += n;
+        if (fake_mqtt.to_client_pos == chunk.size()) {
+            fake_mqtt.to_client.pop_front();
+            fake_mqtt.to_client_pos = 0;
+        }
+    }
+    return got;
+}
+
+inline void fake_mqtt_open()
+{
+    fake_mqtt.tcp_open = true;
+    fake_mqtt.connected = false;
+    fake_mqtt.subscription.clear();
+    fake_mqtt.from_client.clear();
+    fake_mqtt.to_client.clear();
+    fake_mqtt.to_client_pos = 0;
+}
+
+// Takes the device's bytes, answers every whole packet among them
+inline void fake_mqtt_receive(const uint8_t *data, size_t n)
+{
+    FakeMqtt &m = fake_mqtt;
+    m.from_client.append((const char *)data, n);
+    while (m.tcp_open && m.from_client.size() >= 2) {
+        size_t len = 0, mul = 1, i = 1;
+        for (; i < m.from_client.size() && i <= 4; i++) {
+            len += ((uint8_t)m.from_client[i] & 0x7F) * mul;
+            mul *= 128;
+            if (!((uint8_t)m.from_client[i] & 0x80))
+                break;
+        }
+        if (i >= m.from_client.size() || m.from_client.size() < i + 1 + len)
+            return;
+        uint8_t first = m.from_client[0];
+        std::string body = m.from_client.substr(i + 1, len);
+        m.from_client.erase(0, i + 1 + len);
+        auto str_at = [&body](size_t at) {
+            size_t n = ((uint8_t)body[at] << 8) | (uint8_t)body[at + 1];
+            return body.substr(at + 2, n);
+        };
+
+        switch (first >> 4) {
+        case 1: // CONNECT: "MQTT", level, flags, keep-alive, client id
+            m.keepalive_s = ((uint8_t)body[8] << 8) | (uint8_t)body[9];
+            m.client_id = str_at(10);
+            m.connected = true;
+            m.connects++;
+            fake_mqtt_send(std::string("\x20\x02\x00\x00", 4), m.latency_ms);
+            break;
+        case 8: // SUBSCRIBE: packet id, one topic + QoS
+            m.subscription = str_at(2);
+            fake_mqtt_send(std::string("\x90\x03", 2) + body.substr(0, 2) + '\0', m.latency_ms);
+            break;
+        case 3: { // PUBLISH
+            FakeMqttPublish pub;
+            pub.qos = (first >> 1) & 3;
+            pub.topic = str_at(0);
+            size_t off = 2 + pub.topic.size();
+            std::string id = pub.qos ? body.substr(off, 2) : "";
+            pub.payload = body.substr(off + id.size());
+            m.publishes++;
+            fake_net.requests++;
+            FakeMqttAck ack = m.handler ? m.handler(pub) : FakeMqttAck();
+            if (ack.reset) {
+                m.tcp_open = false;
+                m.connected = false;
+                return;
+            }
+            if (ack.drop)
+                break;
+            if (pub.qos) {
+                fake_mqtt_send(std::string("\x40\x02", 2) + id, ack.latency_ms);
+                m.pubacks++;
+            }
+            if (!ack.reply.empty())
+                fake_mqtt_push(ack.reply_topic, ack.reply, ack.latency_ms);
+            break;
+        }
+        case 12: // PINGREQ
+            m.pings++;
+            fake_mqtt_send(std::string("\xD0\x00", 2), m.latency_ms);
+            break;
+        case 14: // DISCONNECT
+            m.disconnects++;
+            m.tcp_open = false;
+            m.connected = false;
+            return;
+        default:
+            break;
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdint.h>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+
+// The network as the fakes see it: whether the AP is reachable, how the
+// stand-in server answers, and what went over the air. WiFiClient talks plain
+// HTTP/1.1 bytes to fake_http_handler, so the firmware's real request and
+// response handling is exercised; one to fake_mqtt.port reaches the MQTT
+// broker in fake_mqtt.h instead. Connections the other way, to the board's
+// WiFiServer, are queued in fake_net.inbound.
+
+struct FakeHttpRequest {
+    std::string method;
+    std::string path;
+    std::map<std::string, std::string> headers;
+    std::string body;
+};
+
+struct FakeHttpResponse {
+    int status = 200;
+    std::string body = "Data received";
+    std::string content_type = "text/html; charset=utf-8";
+    uint32_t latency_ms = 5; // request sent -> first response byte
+    uint32_t drip_ms = 0; // then one byte every drip_ms, 0 = all at once
+    bool drop = false; // never answer, the client has to time out
+    bool reset = false; // close the connection instead of answering
+};
+
+// A connection to the board's own WiFiServer, from some LAN client
+struct FakeInbound {
+    std::string request; // what it sends once accepted
+    uint32_t latency_ms = 0; // accept -> request readable
+    std::string response; // everything the board wrote, set when it closes
+    uint64_t connected_us = 0; // when the client connects, not accepted before; 0 = already has
+    uint64_t accepted_us = 0, closed_us = 0;
+    bool closed = false;
+};
+
+struct FakeNet {
+    bool ap_up = true; // association succeeds
+    uint32_t associate_ms = 300; // WiFi.begin() -> WL_CONNECTED
+    uint32_t dhcp_ms = 0; // DHCP client started -> lease bound, after associate_ms
+    bool server_up = true; // TCP connect succeeds
+    uint32_t connect_ms = 10;
+    int8_t rssi = -60; // dBm while associated
+    std::function<FakeHttpResponse(const FakeHttpRequest &)> handler;
+
+    // what happened
+    uint32_t associations = 0;
+    uint32_t dhcp_requests = 0; // DHCP client runs, at association or on a live link
+    uint32_t connects = 0;
+    uint32_t connect_failures = 0;
+    uint32_t requests = 0;
+    uint32_t writes = 0; // WiFiClient::write() calls, roughly TCP segments
+    uint64_t bytes_out = 0;
+    uint64_t bytes_in = 0;
+
+    // LAN clients of WiFiServer, accepted in order
+    std::deque<FakeInbound> inbound;
+    size_t inbound_next = 0; // first not yet accepted
+    uint32_t inbound_writes = 0; // WiFiClient::write() calls on accepted connections
+};
+
+inline FakeNet fake_net;
+
+inline FakeHttpResponse fake_http_handler(const FakeHttpRequest &req)
+{
+    if (fake_net.handler)
+        return fake_net.handler(req);
+    return FakeHttpResponse(); // what flask/server.py says to a /submit
+}
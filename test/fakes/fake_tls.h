@@ -0,0 +1,197 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <initializer_list>
+#include <map>
+#include <string>
+#include "fake_clock.h"
+#include "fake_net.h"
+
+// TLS 1.2 as the fakes see it. Nothing is encrypted, but the records, the
+// handshake's round trips and its sizes follow an ECDHE-ECDSA P-256 session
+// with a one-certificate chain, and the client's CPU time for it (the
+// certificate verify, ECDHE, AES-GCM per record) is charged to the virtual
+// clock. A WiFiClient connected to fake_tls.port is the server end
+// (WiFi.h); the client end is the mbedtls stand-in in mbedtls/ssl.h.
+//
+// Full handshake: ClientHello -> certificate flight, ClientKeyExchange ->
+// NewSessionTicket + Finished, two round trips. A ClientHello carrying a
+// ticket the server still knows gets the abbreviated one: ServerHello +
+// Finished back, the client's Finished out, one round trip and no public
+// key operations. Application data decrypted at the server is plain HTTP
+// for fake_net.handler.
+//
+// CPU figures are for an ESP32 at 240 MHz with the hardware MPI/AES/SHA;
+// flask/tls_proxy.py logs what a real board takes, to check them against.
+
+#define FAKE_TLS_HANDSHAKE 22
+#define FAKE_TLS_ALERT 21
+#define FAKE_TLS_APP_DATA 23
+#define FAKE_TLS_RECORD_HEADER 5
+#define FAKE_TLS_GCM_OVERHEAD 24 // explicit nonce + tag per application record
+
+struct FakeTls {
+    uint16_t port = 8443;
+    std::string ca_pem; // what the server's certificate chains to
+    std::string server_name = "3.149.230.7"; // its CN
+    uint32_t latency_ms = 5; // per flight, like FakeHttpResponse::latency_ms
+    bool resumption = true; // honours tickets
+    uint32_t ticket_lifetime_s = 7200;
+    uint32_t idle_timeout_s = 75; // keep-alive connections closed after this long quiet
+
+    // client CPU
+    uint32_t full_cpu_us = 180000; // chain verify + ECDHE
+    uint32_t resume_cpu_us = 2500; // PRF + Finished
+    uint32_t record_us_per_kb = 70; // AES-GCM, either way
+
+    // wire sizes of the flights, bytes of handshake body
+    uint32_t client_hello = 200;
+    uint32_t ticket_size = 160;
+    uint32_t certificate_flight = 950; // ServerHello, Certificate, ServerKeyExchange, ServerHelloDone
+    uint32_t client_finish = 126; // ClientKeyExchange, ChangeCipherSpec, Finished
+    uint32_t server_finish = 250; // NewSessionTicket, ChangeCipherSpec, Finished
+    uint32_t resumed_hello = 141; // ServerHello, ChangeCipherSpec, Finished
+    uint32_t resumed_finish = 51; // ChangeCipherSpec, Finished
+
+    std::map<std::string, uint64_t> sessions; // tickets and session IDs issued, -> when
+    uint32_t next_ticket = 1;
+
+    // what happened
+    uint32_t full_handshakes = 0;
+    uint32_t resumed_handshakes = 0;
+    uint32_t idle_closes = 0;
+    uint64_t cpu_us = 0; // charged to the client
+};
+
+inline FakeTls fake_tls;
+
+// TLS_CA_PEM (tls_client.h) on the host. The board's is written from the
+// deployment's CA at build time (scripts/tls_ca.py); this one only has to be
+// shaped like a PEM, the fakes just fingerprint it.
+inline const char TLS_CA_PEM[] = "-----BEGIN CERTIFICATE-----\n"
+                                 "ZmFrZSBDQSBmb3IgdGhlIGhvc3QgdGVzdHMgYW5kIHRoZSBzaW0=\n"
+                                 "-----END CERTIFICATE-----\n";
+
+inline std::string fake_tls_record(uint8_t type, const std::string &body)
+{
+    std::string r(FAKE_TLS_RECORD_HEADER, '\0');
+    r[0] = (char)type;
+    r[1] = 3;
+    r[2] = 3;
+    r[3] = (char)(body.size() >> 8);
+    r[4] = (char)(body.size() & 0xFF);
+    return r + body;
+}
+
+// A whole record off the front of buf, or false if it isn't all there yet
+inline bool fake_tls_take_record(std::string &buf, uint8_t &type, std::string &body)
+{
+    if (buf.size() < FAKE_TLS_RECORD_HEADER)
+        return false;
+    size_t len = ((uint8_t)buf[3] << 8) | (uint8_t)buf[4];
+    if (buf.size() < FAKE_TLS_RECORD_HEADER + len)
+        return false;
+    type = buf[0];
+    body = buf.substr(FAKE_TLS_RECORD_HEADER, len);
+    buf.erase(0, FAKE_TLS_RECORD_HEADER + len);
+    return true;
+}
+
+// Handshake bodies are a tag byte, length-prefixed fields, then padding to
+// the flight's real size
+inline std::string fake_tls_flight(char tag, std::initializer_list<std::string> fields, size_t size)
+{
+    std::string b(1, tag);
+    for (const std::string &f : fields)
+        b += (char)f.size() + f;
+    if (b.size() < size)
+        b.append(size - b.size(), '\0');
+    return b;
+}
+
+inline std::string fake_tls_field(const std::string &body, size_t index)
+{
+    size_t pos = 1;
+    for (size_t i = 0; pos < body.size(); i++) {
+        size_t n = (uint8_t)body[pos];
+        if (i == index)
+            return body.substr(pos + 1, n);
+        pos += 1 + n;
+    }
+    return "";
+}
+
+// What mbedtls_x509_crt_parse() keeps of a PEM: enough to tell two apart
+inline std::string fake_tls_fingerprint(const std::string &pem)
+{
+    uint32_t h = 2166136261u;
+    for (char c : pem)
+        h = (h ^ (uint8_t)c) * 16777619u;
+    char out[9];
+    snprintf(out, sizeof(out), "%08x", (unsigned)h);
+    return out;
+}
+
+inline void fake_tls_cpu(uint64_t us)
+{
+    fake_tls.cpu_us += us;
+    fake_advance_us(us);
+}
+
+// The server's side of one connection
+struct FakeTlsServer {
+    bool established = false;
+    std::string session_id; // given out in this full handshake
+    std::string in; // client bytes not yet a whole record
+    uint64_t last_io_us = 0;
+
+    // A client record in; what the server sends back goes on reply, decrypted
+    // application data on plain. False for a fatal alert / close_notify.
+    bool receive(uint8_t type, const std::string &body, std::string &reply, std::string &plain)
+    {
+        if (type == FAKE_TLS_ALERT)
+            return false;
+        if (type == FAKE_TLS_APP_DATA) {
+            if (!established || body.size() < FAKE_TLS_GCM_OVERHEAD)
+                return false;
+            plain += body.substr(8, body.size() - FAKE_TLS_GCM_OVERHEAD);
+            return true;
+        }
+        switch (body.empty() ? 0 : body[0]) {
+        case 'H': { // ClientHello: session id, ticket; either can resume
+            std::string id = fake_tls_field(body, 0), ticket = fake_tls_field(body, 1);
+            auto known = fake_tls.sessions.find(ticket.empty() ? id : ticket);
+            if (fake_tls.resumption && !id.empty() && known != fake_tls.sessions.end() &&
+                fake_now_us - known->second < (uint64_t)fake_tls.ticket_lifetime_s * 1000000) {
+                fake_tls.resumed_handshakes++;
+                reply += fake_tls_record(FAKE_TLS_HANDSHAKE, fake_tls_flight('R', {id}, fake_tls.resumed_hello));
+                return true;
+            }
+            char new_id[16];
+            snprintf(new_id, sizeof(new_id), "s%06u", (unsigned)fake_tls.next_ticket);
+            session_id = new_id;
+            reply += fake_tls_record(FAKE_TLS_HANDSHAKE,
+                                     fake_tls_flight('F', {session_id, fake_tls_fingerprint(fake_tls.ca_pem),
+                                                           fake_tls.server_name},
+                                                     fake_tls.certificate_flight));
+            return true;
+        }
+        case 'K': { // the client's half of the key exchange: a ticket for next time
+            char ticket[16];
+            snprintf(ticket, sizeof(ticket), "t%06u", (unsigned)fake_tls.next_ticket++);
+            fake_tls.sessions[ticket] = fake_now_us;
+            fake_tls.sessions[session_id] = fake_now_us;
+            fake_tls.full_handshakes++;
+            reply += fake_tls_record(FAKE_TLS_HANDSHAKE, fake_tls_flight('D', {ticket}, fake_tls.server_finish));
+            established = true;
+            return true;
+        }
+        case 'D': // the client's Finished after an abbreviated handshake
+            established = true;
+            return true;
+        default:
+            return false;
+        }
+    }
+};
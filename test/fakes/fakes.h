@@ -0,0 +1,48 @@
+#pragma once
+
+// Everything the fakes keep, for tests to start from a clean device
+
+#include <Arduino.h>
+#include <TFT_eSPI.h>
+#include <WiFi.h>
+#include <Wire.h>
+#include "esp_heap_caps.h"
+#include "fake_clock.h"
+#include "fake_mqtt.h"
+#include "fake_net.h"
+#include "fake_tls.h"
+#include "freertos/task.h"
+#include "nvs.h"
+
+inline void fakes_reset()
+{
+    fake_now_us = 0;
+    for (FakeTimer *t : fake_timers)
+        t->armed = false;
+    memset(fake_analog, 0, sizeof(fake_analog));
+    memset(fake_digital, 0, sizeof(fake_digital));
+    memset(fake_isr, 0, sizeof(fake_isr));
+    fake_tasks.clear();
+    fake_notified = 0;
+    fake_nvs.clear();
+    fake_nvs_handles.clear();
+    fake_nvs_writes = 0;
+    fake_net = FakeNet();
+    WiFi = FakeWiFi();
+    fake_mqtt = FakeMqtt();
+    fake_tls = FakeTls();
+    fake_dht = FakeDht();
+    fake_i2c = FakeI2c();
+    fake_pin_write_hook = fake_i2c_pin_write;
+    fake_pin_read_hook = fake_i2c_pin_read;
+    for (auto &mux : fake_dht_mux) {
+        for (FakeDht &d : mux) {
+            d = FakeDht();
+            d.connected = false; // tests fit the ones they want
+        }
+    }
+    fake_tft = FakeTft();
+    fake_heap_free = 200000;
+    fake_heap_min_free = 180000;
+    fake_heap_largest_block = 110000;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+// Single-threaded on the host, critical sections are no-ops
+
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+#define portENTER_CRITICAL_ISR(mux) ((void)(mux))
+#define portEXIT_CRITICAL_ISR(mux) ((void)(mux))
+#define portTICK_PERIOD_MS 1
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint8_t StackType_t; // ESP-IDF sizes stacks in bytes
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS 1
+#define errQUEUE_FULL 0
+#define portMAX_DELAY 0xffffffffu
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms) / portTICK_PERIOD_MS)
+#define portYIELD_FROM_ISR(...) ((void)0)
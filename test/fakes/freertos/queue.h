@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string.h>
+#include <deque>
+#include <vector>
+#include "fake_clock.h"
+#include "freertos/FreeRTOS.h"
+
+// FreeRTOS queues without a second task: sends append, a receive on an empty
+// queue lets the timeout pass on the virtual clock and fails.
+
+struct FakeQueue {
+    size_t item_size;
+    size_t length;
+    std::deque<std::vector<uint8_t>> items;
+};
+
+typedef FakeQueue *QueueHandle_t;
+typedef FakeQueue StaticQueue_t;
+
+inline QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t item_size, uint8_t *, StaticQueue_t *q)
+{
+    q->item_size = item_size;
+    q->length = length;
+    q->items.clear();
+    return q;
+}
+
+inline BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t)
+{
+    if (q->items.size() >= q->length)
+        return errQUEUE_FULL;
+    const uint8_t *p = (const uint8_t *)item;
+    q->items.emplace_back(p, p + q->item_size);
+    return pdPASS;
+}
+
+inline BaseType_t xQueueSendFromISR(QueueHandle_t q, const void *item, BaseType_t *woken)
+{
+    BaseType_t ok = xQueueSend(q, item, 0);
+    if (woken && ok)
+        *woken = pdTRUE;
+    return ok;
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    if (q->items.empty()) {
+        if (ticks != portMAX_DELAY)
+            fake_advance_ms(ticks * portTICK_PERIOD_MS);
+        return pdFALSE;
+    }
+    memcpy(item, q->items.front().data(), q->item_size);
+    q->items.pop_front();
+    return pdTRUE;
+}
+
+inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    return q->items.size();
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+#include "fake_clock.h"
+#include "freertos/FreeRTOS.h"
+
+// Tasks are recorded, not run: there is only the one thread on the host.
+// Tests drive a task's work by calling the function it loops on directly.
+
+typedef void (*TaskFunction_t)(void *);
+
+struct FakeTask {
+    TaskFunction_t fn;
+    const char *name;
+    UBaseType_t priority;
+    BaseType_t core;
+    uint32_t notified; // given, not yet taken
+    // For a task that takes a notification, then blocks on something the
+    // host has no thread for (a socket) until it gives the running thread
+    // one: when, on the virtual clock, it next would, UINT64_MAX for not
+    // yet. The test or sim standing in for that something sets it.
+    uint64_t (*gives_at)();
+};
+
+typedef FakeTask *TaskHandle_t;
+typedef FakeTask StaticTask_t;
+
+inline std::vector<FakeTask *> fake_tasks;
+
+inline TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char *name, uint32_t, void *,
+                                                  UBaseType_t priority, StackType_t *, StaticTask_t *tcb,
+                                                  BaseType_t core)
+{
+    *tcb = FakeTask{fn, name, priority, core, 0, nullptr};
+    fake_tasks.push_back(tcb);
+    return tcb;
+}
+
+inline uint32_t fake_notified; // given to the running thread
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+    return nullptr; // the one thread
+}
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    if (task == nullptr)
+        fake_notified++;
+    else
+        task->notified++;
+    return pdPASS;
+}
+
+// Sleeps on the virtual clock like delay() until a notification comes: one
+// already given, or the first a task with gives_at would give before the
+// timeout (taking its own as it does). Returns at once, 0, if it would wait
+// forever.
+inline uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+    if (fake_notified == 0) {
+        uint64_t end = ticks == portMAX_DELAY ? UINT64_MAX : fake_now_us + (uint64_t)ticks * portTICK_PERIOD_MS * 1000;
+        FakeTask *giver = nullptr;
+        for (FakeTask *t : fake_tasks) {
+            if (t->notified > 0 && t->gives_at != nullptr) {
+                uint64_t at = t->gives_at();
+                if (at < end) {
+                    end = at;
+                    giver = t;
+                }
+            }
+        }
+        if (end == UINT64_MAX)
+            return 0;
+        fake_sleep_us(end > fake_now_us ? end - fake_now_us : 0);
+        if (giver == nullptr)
+            return 0;
+        giver->notified--;
+        fake_notified++;
+    }
+    uint32_t n = fake_notified;
+    fake_notified = clear ? 0 : n - 1;
+    return n;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+// The error codes a TLS client's bio callbacks return
+
+#define MBEDTLS_ERR_NET_SEND_FAILED -0x004E
+#define MBEDTLS_ERR_NET_RECV_FAILED -0x004C
+#define MBEDTLS_ERR_NET_CONN_RESET -0x0050
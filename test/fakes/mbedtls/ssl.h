@@ -0,0 +1,303 @@
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+#include <string>
+#include "ctr_drbg.h"
+#include "fake_tls.h"
+#include "net_sockets.h"
+#include "x509_crt.h"
+
+// The client half of the fake TLS in fake_tls.h, behind the mbedTLS 2.x
+// calls a TLS client makes: the same non-blocking handshake/read/write
+// contract (MBEDTLS_ERR_SSL_WANT_READ until the bio has bytes), sessions
+// that can be saved after one handshake and offered in the next, and
+// certificate and hostname checks against what the server presents.
+
+#define MBEDTLS_SSL_IS_CLIENT 0
+#define MBEDTLS_SSL_TRANSPORT_STREAM 0
+#define MBEDTLS_SSL_PRESET_DEFAULT 0
+#define MBEDTLS_SSL_VERIFY_NONE 0
+#define MBEDTLS_SSL_VERIFY_REQUIRED 2
+#define MBEDTLS_SSL_SESSION_TICKETS_DISABLED 0
+#define MBEDTLS_SSL_SESSION_TICKETS_ENABLED 1
+#define MBEDTLS_SSL_MAX_CONTENT_LEN 16384
+
+#define MBEDTLS_ERR_SSL_TIMEOUT -0x6800
+#define MBEDTLS_ERR_SSL_WANT_READ -0x6900
+#define MBEDTLS_ERR_SSL_WANT_WRITE -0x6880
+#define MBEDTLS_ERR_SSL_BAD_INPUT_DATA -0x7100
+#define MBEDTLS_ERR_SSL_CONN_EOF -0x7280
+#define MBEDTLS_ERR_SSL_FATAL_ALERT_MESSAGE -0x7780
+#define MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY -0x7880
+
+typedef int mbedtls_ssl_send_t(void *ctx, const unsigned char *buf, size_t len);
+typedef int mbedtls_ssl_recv_t(void *ctx, unsigned char *buf, size_t len);
+typedef int mbedtls_ssl_recv_timeout_t(void *ctx, unsigned char *buf, size_t len, uint32_t timeout);
+
+struct mbedtls_ssl_session {
+    unsigned char id[32];
+    size_t id_len;
+    std::string ticket;
+};
+
+struct mbedtls_ssl_config {
+    int authmode;
+    int tickets;
+    const mbedtls_x509_crt *ca_chain;
+};
+
+enum FakeSslState {
+    FAKE_SSL_HELLO,
+    FAKE_SSL_SERVER_HELLO,
+    FAKE_SSL_SERVER_FINISHED,
+    FAKE_SSL_DONE,
+};
+
+struct mbedtls_ssl_context {
+    const mbedtls_ssl_config *conf;
+    mbedtls_ssl_session *session; // the current one, once the handshake has made it
+    mbedtls_ssl_session session_data;
+    mbedtls_ssl_session offered;
+    bool offering;
+    int state;
+    std::string hostname;
+    void *p_bio;
+    mbedtls_ssl_send_t *f_send;
+    mbedtls_ssl_recv_t *f_recv;
+    std::string in; // raw bytes, not yet a whole record
+    std::string plain; // a decrypted record
+    size_t plain_pos;
+};
+
+inline void mbedtls_ssl_session_init(mbedtls_ssl_session *s)
+{
+    s->id_len = 0;
+    s->ticket.clear();
+}
+inline void mbedtls_ssl_session_free(mbedtls_ssl_session *s)
+{
+    mbedtls_ssl_session_init(s);
+}
+
+inline void mbedtls_ssl_config_init(mbedtls_ssl_config *conf)
+{
+    conf->authmode = MBEDTLS_SSL_VERIFY_REQUIRED;
+    conf->tickets = MBEDTLS_SSL_SESSION_TICKETS_ENABLED;
+    conf->ca_chain = nullptr;
+}
+inline void mbedtls_ssl_config_free(mbedtls_ssl_config *) {}
+inline int mbedtls_ssl_config_defaults(mbedtls_ssl_config *, int, int, int)
+{
+    return 0;
+}
+inline void mbedtls_ssl_conf_authmode(mbedtls_ssl_config *conf, int mode)
+{
+    conf->authmode = mode;
+}
+inline void mbedtls_ssl_conf_ca_chain(mbedtls_ssl_config *conf, mbedtls_x509_crt *ca, void *)
+{
+    conf->ca_chain = ca;
+}
+inline void mbedtls_ssl_conf_rng(mbedtls_ssl_config *, int (*)(void *, unsigned char *, size_t), void *) {}
+inline void mbedtls_ssl_conf_session_tickets(mbedtls_ssl_config *conf, int use)
+{
+    conf->tickets = use;
+}
+
+inline int mbedtls_ssl_session_reset(mbedtls_ssl_context *ssl)
+{
+    ssl->session = nullptr;
+    mbedtls_ssl_session_init(&ssl->session_data);
+    mbedtls_ssl_session_init(&ssl->offered);
+    ssl->offering = false;
+    ssl->state = FAKE_SSL_HELLO;
+    ssl->in.clear();
+    ssl->plain.clear();
+    ssl->plain_pos = 0;
+    return 0;
+}
+inline void mbedtls_ssl_init(mbedtls_ssl_context *ssl)
+{
+    ssl->conf = nullptr;
+    ssl->p_bio = nullptr;
+    ssl->f_send = nullptr;
+    ssl->f_recv = nullptr;
+    ssl->hostname.clear();
+    mbedtls_ssl_session_reset(ssl);
+}
+inline void mbedtls_ssl_free(mbedtls_ssl_context *ssl)
+{
+    mbedtls_ssl_init(ssl);
+}
+inline int mbedtls_ssl_setup(mbedtls_ssl_context *ssl, const mbedtls_ssl_config *conf)
+{
+    ssl->conf = conf;
+    return 0;
+}
+inline int mbedtls_ssl_set_hostname(mbedtls_ssl_context *ssl, const char *hostname)
+{
+    ssl->hostname = hostname ? hostname : "";
+    return 0;
+}
+inline void mbedtls_ssl_set_bio(mbedtls_ssl_context *ssl, void *p_bio, mbedtls_ssl_send_t *f_send,
+                                mbedtls_ssl_recv_t *f_recv, mbedtls_ssl_recv_timeout_t *)
+{
+    ssl->p_bio = p_bio;
+    ssl->f_send = f_send;
+    ssl->f_recv = f_recv;
+}
+inline int mbedtls_ssl_set_session(mbedtls_ssl_context *ssl, const mbedtls_ssl_session *session)
+{
+    ssl->offered = *session;
+    ssl->offering = true;
+    return 0;
+}
+inline int mbedtls_ssl_get_session(const mbedtls_ssl_context *ssl, mbedtls_ssl_session *dst)
+{
+    if (ssl->state != FAKE_SSL_DONE)
+        return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    *dst = ssl->session_data;
+    return 0;
+}
+
+inline int fake_ssl_send(mbedtls_ssl_context *ssl, uint8_t type, const std::string &body)
+{
+    std::string r = fake_tls_record(type, body);
+    int n = ssl->f_send(ssl->p_bio, (const unsigned char *)r.data(), r.size());
+    return n == (int)r.size() ? 0 : (n < 0 ? n : MBEDTLS_ERR_NET_SEND_FAILED);
+}
+
+// 0 once a whole record is in, else WANT_READ / EOF / the bio's error
+inline int fake_ssl_record(mbedtls_ssl_context *ssl, uint8_t &type, std::string &body)
+{
+    for (;;) {
+        if (fake_tls_take_record(ssl->in, type, body))
+            return 0;
+        unsigned char buf[2048];
+        int n = ssl->f_recv(ssl->p_bio, buf, sizeof(buf));
+        if (n == 0)
+            return MBEDTLS_ERR_SSL_CONN_EOF;
+        if (n < 0)
+            return n;
+        ssl->in.append((const char *)buf, n);
+    }
+}
+
+inline void fake_ssl_set_id(mbedtls_ssl_session &s, const std::string &id)
+{
+    s.id_len = id.size() < sizeof(s.id) ? id.size() : sizeof(s.id);
+    memcpy(s.id, id.data(), s.id_len);
+}
+
+inline int mbedtls_ssl_handshake(mbedtls_ssl_context *ssl)
+{
+    const FakeTls &t = fake_tls;
+    for (;;) {
+        uint8_t type;
+        std::string body;
+        int err;
+        switch (ssl->state) {
+        case FAKE_SSL_HELLO: {
+            std::string id, ticket;
+            if (ssl->offering) {
+                id.assign((const char *)ssl->offered.id, ssl->offered.id_len);
+                if (ssl->conf->tickets)
+                    ticket = ssl->offered.ticket;
+            }
+            err = fake_ssl_send(ssl, FAKE_TLS_HANDSHAKE,
+                                fake_tls_flight('H', {id, ticket}, t.client_hello + (ticket.empty() ? 0 : t.ticket_size)));
+            if (err)
+                return err;
+            ssl->state = FAKE_SSL_SERVER_HELLO;
+            break;
+        }
+        case FAKE_SSL_SERVER_HELLO:
+            if ((err = fake_ssl_record(ssl, type, body)) != 0)
+                return err;
+            if (type != FAKE_TLS_HANDSHAKE)
+                return MBEDTLS_ERR_SSL_FATAL_ALERT_MESSAGE;
+            if (body[0] == 'R') { // abbreviated: the offered session goes on
+                fake_tls_cpu(t.resume_cpu_us);
+                ssl->session_data = ssl->offered;
+                if ((err = fake_ssl_send(ssl, FAKE_TLS_HANDSHAKE, fake_tls_flight('D', {}, t.resumed_finish))) != 0)
+                    return err;
+                ssl->state = FAKE_SSL_DONE;
+                ssl->session = &ssl->session_data;
+                return 0;
+            }
+            if (ssl->conf->authmode == MBEDTLS_SSL_VERIFY_REQUIRED &&
+                (ssl->conf->ca_chain == nullptr || ssl->conf->ca_chain->fingerprint != fake_tls_field(body, 1) ||
+                 ssl->hostname != fake_tls_field(body, 2)))
+                return MBEDTLS_ERR_X509_CERT_VERIFY_FAILED;
+            fake_tls_cpu(t.full_cpu_us);
+            mbedtls_ssl_session_init(&ssl->session_data);
+            fake_ssl_set_id(ssl->session_data, fake_tls_field(body, 0));
+            if ((err = fake_ssl_send(ssl, FAKE_TLS_HANDSHAKE, fake_tls_flight('K', {}, t.client_finish))) != 0)
+                return err;
+            ssl->state = FAKE_SSL_SERVER_FINISHED;
+            break;
+        case FAKE_SSL_SERVER_FINISHED:
+            if ((err = fake_ssl_record(ssl, type, body)) != 0)
+                return err;
+            if (type != FAKE_TLS_HANDSHAKE || body[0] != 'D')
+                return MBEDTLS_ERR_SSL_FATAL_ALERT_MESSAGE;
+            ssl->session_data.ticket = fake_tls_field(body, 0);
+            ssl->state = FAKE_SSL_DONE;
+            ssl->session = &ssl->session_data;
+            return 0;
+        default:
+            return 0;
+        }
+    }
+}
+
+inline int mbedtls_ssl_write(mbedtls_ssl_context *ssl, const unsigned char *buf, size_t len)
+{
+    if (ssl->state != FAKE_SSL_DONE)
+        return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    if (len > MBEDTLS_SSL_MAX_CONTENT_LEN)
+        len = MBEDTLS_SSL_MAX_CONTENT_LEN;
+    fake_tls_cpu((uint64_t)len * fake_tls.record_us_per_kb / 1024);
+    int err = fake_ssl_send(ssl, FAKE_TLS_APP_DATA,
+                            std::string(8, '\0') + std::string((const char *)buf, len) + std::string(16, '\0'));
+    return err ? err : (int)len;
+}
+
+inline size_t mbedtls_ssl_get_bytes_avail(const mbedtls_ssl_context *ssl)
+{
+    return ssl->plain.size() - ssl->plain_pos;
+}
+
+inline int mbedtls_ssl_read(mbedtls_ssl_context *ssl, unsigned char *buf, size_t len)
+{
+    if (ssl->state != FAKE_SSL_DONE)
+        return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    while (mbedtls_ssl_get_bytes_avail(ssl) == 0) {
+        uint8_t type;
+        std::string body;
+        int err = fake_ssl_record(ssl, type, body);
+        if (err)
+            return err;
+        if (type == FAKE_TLS_ALERT)
+            return MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY;
+        if (type != FAKE_TLS_APP_DATA || body.size() < FAKE_TLS_GCM_OVERHEAD)
+            return MBEDTLS_ERR_SSL_FATAL_ALERT_MESSAGE;
+        fake_tls_cpu((uint64_t)body.size() * fake_tls.record_us_per_kb / 1024);
+        ssl->plain = body.substr(8, body.size() - FAKE_TLS_GCM_OVERHEAD);
+        ssl->plain_pos = 0;
+    }
+    size_t n = mbedtls_ssl_get_bytes_avail(ssl);
+    if (n > len)
+        n = len;
+    memcpy(buf, ssl->plain.data() + ssl->plain_pos, n);
+    ssl->plain_pos += n;
+    return (int)n;
+}
+
+inline int mbedtls_ssl_close_notify(mbedtls_ssl_context *ssl)
+{
+    if (ssl->state != FAKE_SSL_DONE)
+        return 0;
+    return fake_ssl_send(ssl, FAKE_TLS_ALERT, std::string(2 + FAKE_TLS_GCM_OVERHEAD, '\0'));
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+#include <string>
+#include "fake_tls.h"
+
+// Certificate chain stand-in: a parsed PEM is its fingerprint, which the
+// fake handshake compares with what the server's chain claims (fake_tls.h)
+
+#define MBEDTLS_ERR_X509_INVALID_FORMAT -0x2180
+#define MBEDTLS_ERR_X509_CERT_VERIFY_FAILED -0x2700
+
+struct mbedtls_x509_crt {
+    std::string fingerprint;
+};
+
+inline void mbedtls_x509_crt_init(mbedtls_x509_crt *crt)
+{
+    crt->fingerprint.clear();
+}
+inline void mbedtls_x509_crt_free(mbedtls_x509_crt *crt)
+{
+    crt->fingerprint.clear();
+}
+// buflen counts the terminating NUL for PEM, as in mbedTLS
+inline int mbedtls_x509_crt_parse(mbedtls_x509_crt *crt, const unsigned char *buf, size_t buflen)
+{
+    static const char begin[] = "-----BEGIN CERTIFICATE-----";
+    if (buflen == 0 || buf[buflen - 1] != '\0' || strncmp((const char *)buf, begin, sizeof(begin) - 1) != 0)
+        return MBEDTLS_ERR_X509_INVALID_FORMAT;
+    crt->fingerprint = fake_tls_fingerprint((const char *)buf);
+    return 0;
+}
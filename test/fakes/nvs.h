@@ -0,0 +1,117 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "esp_err.h"
+
+// In-memory NVS: one map of "namespace/key" -> bytes, which tests can seed,
+// inspect or clear between cases. Writes land immediately, commit is a no-op.
+
+#define ESP_ERR_NVS_BASE 0x1100
+#define ESP_ERR_NVS_NOT_INITIALIZED (ESP_ERR_NVS_BASE + 0x01)
+#define ESP_ERR_NVS_NOT_FOUND (ESP_ERR_NVS_BASE + 0x02)
+#define ESP_ERR_NVS_READ_ONLY (ESP_ERR_NVS_BASE + 0x04)
+#define ESP_ERR_NVS_INVALID_HANDLE (ESP_ERR_NVS_BASE + 0x07)
+#define ESP_ERR_NVS_INVALID_LENGTH (ESP_ERR_NVS_BASE + 0x0c)
+#define ESP_ERR_NVS_NO_FREE_PAGES (ESP_ERR_NVS_BASE + 0x0d)
+#define ESP_ERR_NVS_NEW_VERSION_FOUND (ESP_ERR_NVS_BASE + 0x10)
+
+typedef uint32_t nvs_handle_t;
+
+typedef enum {
+    NVS_READONLY,
+    NVS_READWRITE
+} nvs_open_mode_t;
+
+struct FakeNvsHandle {
+    std::string ns;
+    bool writable;
+};
+
+inline std::map<std::string, std::vector<uint8_t>> fake_nvs;
+inline std::vector<FakeNvsHandle> fake_nvs_handles;
+inline uint32_t fake_nvs_writes; // set_blob/set_str calls, flash wear in the simulator
+
+inline std::string fake_nvs_key(nvs_handle_t h, const char *key)
+{
+    return fake_nvs_handles[h - 1].ns + "/" + key;
+}
+
+inline bool fake_nvs_valid(nvs_handle_t h)
+{
+    return h >= 1 && h <= fake_nvs_handles.size();
+}
+
+inline esp_err_t nvs_open(const char *ns, nvs_open_mode_t mode, nvs_handle_t *out)
+{
+    if (mode == NVS_READONLY) {
+        // like the real thing, a namespace that was never written doesn't exist
+        std::string prefix = std::string(ns) + "/";
+        bool found = false;
+        for (auto &kv : fake_nvs)
+            found = found || kv.first.compare(0, prefix.size(), prefix) == 0;
+        if (!found)
+            return ESP_ERR_NVS_NOT_FOUND;
+    }
+    fake_nvs_handles.push_back({ns, mode == NVS_READWRITE});
+    *out = fake_nvs_handles.size();
+    return ESP_OK;
+}
+
+inline void nvs_close(nvs_handle_t) {}
+
+inline esp_err_t nvs_commit(nvs_handle_t h)
+{
+    return fake_nvs_valid(h) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+}
+
+inline esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *value, size_t len)
+{
+    if (!fake_nvs_valid(h))
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!fake_nvs_handles[h - 1].writable)
+        return ESP_ERR_NVS_READ_ONLY;
+    const uint8_t *p = (const uint8_t *)value;
+    fake_nvs[fake_nvs_key(h, key)].assign(p, p + len);
+    fake_nvs_writes++;
+    return ESP_OK;
+}
+
+inline esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out, size_t *len)
+{
+    if (!fake_nvs_valid(h))
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    auto it = fake_nvs.find(fake_nvs_key(h, key));
+    if (it == fake_nvs.end())
+        return ESP_ERR_NVS_NOT_FOUND;
+    if (out == nullptr) {
+        *len = it->second.size();
+        return ESP_OK;
+    }
+    if (*len < it->second.size())
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    memcpy(out, it->second.data(), it->second.size());
+    *len = it->second.size();
+    return ESP_OK;
+}
+
+inline esp_err_t nvs_set_str(nvs_handle_t h, const char *key, const char *value)
+{
+    return nvs_set_blob(h, key, value, strlen(value) + 1);
+}
+
+inline esp_err_t nvs_get_str(nvs_handle_t h, const char *key, char *out, size_t *len)
+{
+    return nvs_get_blob(h, key, out, len);
+}
+
+inline esp_err_t nvs_erase_key(nvs_handle_t h, const char *key)
+{
+    if (!fake_nvs_valid(h))
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    return fake_nvs.erase(fake_nvs_key(h, key)) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "nvs.h"
+
+inline esp_err_t nvs_flash_init()
+{
+    return ESP_OK;
+}
+
+inline esp_err_t nvs_flash_erase()
+{
+    fake_nvs.clear();
+    return ESP_OK;
+}
@@ -0,0 +1,94 @@
+#include <math.h>
+#include <unity.h>
+#include "aggregate.h"
+
+void setUp() {}
+void tearDown() {}
+
+static SensorData reading(float temp, float moisture, int light)
+{
+    SensorData s = {temp, moisture, light, true};
+    return s;
+}
+
+void test_single_sample()
+{
+    WindowStats w;
+    window_start(w, 1000);
+    window_add(w, reading(21.5f, 60.0f, 4095));
+    TEST_ASSERT_EQUAL_UINT16(1, w.n);
+    TEST_ASSERT_EQUAL_FLOAT(21.5f, w.temp.min);
+    TEST_ASSERT_EQUAL_FLOAT(21.5f, w.temp.max);
+    TEST_ASSERT_EQUAL_FLOAT(21.5f, w.temp.mean);
+    TEST_ASSERT_EQUAL_FLOAT(100.0f, w.light.mean);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, welford_stddev(w.temp, w.n));
+}
+
+void test_matches_two_pass()
+{
+    const float xs[] = {2, 4, 4, 4, 5, 5, 7, 9};
+    WindowStats w;
+    window_start(w, 0);
+    for (float x : xs)
+        window_add(w, reading(x, 50.0f, 0));
+    window_close(w, 8000);
+    TEST_ASSERT_EQUAL_UINT32(8000, w.ms);
+    TEST_ASSERT_EQUAL_UINT16(8, w.n);
+    TEST_ASSERT_EQUAL_FLOAT(2.0f, w.temp.min);
+    TEST_ASSERT_EQUAL_FLOAT(9.0f, w.temp.max);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, 5.0f, w.temp.mean);
+    // sum of squared deviations is 32, sample variance 32/7
+    TEST_ASSERT_FLOAT_WITHIN(1e-5, sqrtf(32.0f / 7), welford_stddev(w.temp, w.n));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, welford_stddev(w.moisture, w.n));
+}
+
+void test_invalid_samples_skipped()
+{
+    WindowStats w;
+    window_start(w, 0);
+    SensorData bad = reading(-999.0f, 0.0f, 0);
+    bad.valid = false;
+    window_add(w, bad);
+    TEST_ASSERT_EQUAL_UINT16(0, w.n);
+    window_add(w, reading(20.0f, 40.0f, 0));
+    window_add(w, bad);
+    TEST_ASSERT_EQUAL_UINT16(1, w.n);
+    TEST_ASSERT_EQUAL_FLOAT(20.0f, w.temp.min);
+}
+
+void test_stable_with_large_offset()
+{
+    // an hour of 1 Hz readings that barely move around a large value: the
+    // naive sum-of-squares formula loses every significant digit in float
+    WindowStats w;
+    window_start(w, 0);
+    for (int i = 0; i < 3600; i++)
+        window_add(w, reading(1000.0f + ((i & 1) ? 0.1f : -0.1f), 50.0f, 2000));
+    TEST_ASSERT_EQUAL_UINT16(3600, w.n);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 1000.0f, w.temp.mean);
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, 0.1f, welford_stddev(w.temp, w.n));
+}
+
+void test_start_clears()
+{
+    WindowStats w;
+    window_start(w, 0);
+    window_add(w, reading(30.0f, 90.0f, 4095));
+    window_start(w, 60000);
+    TEST_ASSERT_EQUAL_UINT32(60000, w.start);
+    TEST_ASSERT_EQUAL_UINT16(0, w.n);
+    window_add(w, reading(10.0f, 20.0f, 0));
+    TEST_ASSERT_EQUAL_FLOAT(10.0f, w.temp.max);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, w.light.max);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_single_sample);
+    RUN_TEST(test_matches_two_pass);
+    RUN_TEST(test_invalid_samples_skipped);
+    RUN_TEST(test_stable_with_large_offset);
+    RUN_TEST(test_start_clears);
+    return UNITY_END();
+}
@@ -0,0 +1,154 @@
+#include <ArduinoJson.h>
+#include <chrono>
+#include <fakes.h>
+#include <stdio.h>
+#include <unity.h>
+#include "aggregate.h"
+#include "config.h"
+#include "latency.h"
+#include "power_stats.h"
+#include "prediction.h"
+#include "sample.h"
+#include "uplink.h"
+
+// Micro-benchmarks of the per-sample hot paths, on the host CPU. Absolute
+// numbers only mean something relative to each other and to earlier runs
+// on the same machine:  pio test -e native -f test_bench -v
+
+#define BENCH_ITERATIONS 20000
+
+static volatile size_t sink; // keeps the compiler from dropping the work
+
+template <typename F>
+static double bench(const char *name, F fn)
+{
+    for (int i = 0; i < BENCH_ITERATIONS / 10; i++)
+        fn(i); // warm up
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCH_ITERATIONS; i++)
+        fn(i);
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / BENCH_ITERATIONS;
+    printf("bench %-24s %10.1f ns/op\n", name, ns);
+    return ns;
+}
+
+void setUp()
+{
+    fakes_reset();
+    config_defaults(config);
+    power_stats_setup(0);
+    latency_reset();
+}
+
+void tearDown() {}
+
+void test_bench_sample_message()
+{
+    SensorData s = {21.5f, 55.0f, 3000, true};
+    char buf[SAMPLE_MSG_MAX];
+    double ns = bench("sample_message", [&](int i) {
+        s.light = i & 4095;
+        sink = sample_message(s, config.dry, config.shade, buf, sizeof(buf));
+    });
+    TEST_ASSERT_TRUE(ns > 0);
+}
+
+void test_bench_window_add()
+{
+    SensorData s = {21.5f, 55.0f, 3000, true};
+    WindowStats w;
+    window_start(w, 0);
+    double ns = bench("window_add", [&](int i) {
+        if ((i & 63) == 0)
+            window_start(w, i);
+        s.light = i & 4095;
+        window_add(w, s);
+        sink = w.n;
+    });
+    TEST_ASSERT_TRUE(ns > 0);
+}
+
+void test_bench_prediction()
+{
+    // full history, a dry/water cycle every 100 samples
+    Prediction p;
+    prediction_init(p, CONFIG_PERIODS_MAX, 0);
+    uint32_t stored[CONFIG_PERIODS_MAX];
+    for (int i = 0; i < CONFIG_PERIODS_MAX; i++)
+        stored[i] = 50000;
+    prediction_load(p, stored, CONFIG_PERIODS_MAX);
+    double ns = bench("prediction_sample", [&](int i) {
+        float moisture = (i % 100 == 0) ? 100.0f : (i % 100 == 50) ? 40.0f : 70.0f;
+        prediction_sample(p, moisture, config.dry, i * 1000);
+        sink = p.millis_left;
+    });
+    TEST_ASSERT_EQUAL_size_t(CONFIG_PERIODS_MAX, p.count);
+    TEST_ASSERT_TRUE(ns > 0);
+}
+
+// stands in for the connection: takes what serializeJson() streams into it
+struct NullWriter {
+    size_t n = 0;
+    size_t write(uint8_t)
+    {
+        n++;
+        return 1;
+    }
+    size_t write(const uint8_t *, size_t len)
+    {
+        n += len;
+        return len;
+    }
+};
+
+void test_bench_uplink_build()
+{
+    NullWriter out;
+    const char *msg = "Temperature: 21.50°C / 70.70°F, Low Moisture: 55.00%, Light: 73%";
+    uplink_delivered(); // plain sample requests, no boot report
+    double ns = bench("uplink_build + stream (sample)", [&](int i) {
+        uplink_build(msg, nullptr, 1000 + (i & 0xff));
+        sink = serializeJson(uplink_document(), out);
+    });
+    TEST_ASSERT_TRUE(ns > 0);
+}
+
+void test_bench_uplink_build_full()
+{
+    // every request carries power, heap and latency reports
+    NullWriter out;
+    const char *msg = "Temperature: 21.50°C / 70.70°F, Low Moisture: 55.00%, Light: 73%";
+    uint32_t now = 0;
+    double ns = bench("uplink_build + stream (reports)", [&](int) {
+        for (int s = 0; s < LAT_STAGES; s++)
+            latency_record((LatencyStage)s, 1000);
+        now += LATENCY_REPORT_PERIOD;
+        uplink_build(msg, nullptr, now);
+        sink = serializeJson(uplink_document(), out);
+    });
+    TEST_ASSERT_TRUE(sink > 0);
+    TEST_ASSERT_TRUE(ns > 0);
+}
+
+void test_bench_response_parse()
+{
+    const char *resp = "{\"config_rev\": 0, \"config\": {\"uplink_period\": 1000}}";
+    size_t len = strlen(resp);
+    double ns = bench("uplink_handle_response", [&](int) {
+        sink = uplink_handle_response(resp, len, 0);
+    });
+    TEST_ASSERT_TRUE(ns > 0);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_bench_sample_message);
+    RUN_TEST(test_bench_window_add);
+    RUN_TEST(test_bench_prediction);
+    RUN_TEST(test_bench_uplink_build);
+    RUN_TEST(test_bench_uplink_build_full);
+    RUN_TEST(test_bench_response_parse);
+    return UNITY_END();
+}
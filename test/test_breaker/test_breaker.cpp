@@ -0,0 +1,106 @@
+#include <unity.h>
+#include "breaker.h"
+
+static Breaker b;
+
+void setUp()
+{
+    breaker_init(b);
+}
+
+void tearDown() {}
+
+static void fail_times(int n, uint32_t now, uint32_t rnd = 0)
+{
+    for (int i = 0; i < n; i++)
+        breaker_failure(b, now, rnd);
+}
+
+void test_stays_closed_below_threshold()
+{
+    fail_times(BREAKER_THRESHOLD - 1, 1000);
+    TEST_ASSERT_EQUAL(BREAKER_CLOSED, b.state);
+    TEST_ASSERT_TRUE(breaker_allow(b, 1000));
+    breaker_success(b);
+    fail_times(BREAKER_THRESHOLD - 1, 2000);
+    TEST_ASSERT_EQUAL(BREAKER_CLOSED, b.state); // the count started over
+}
+
+void test_opens_and_skips()
+{
+    fail_times(BREAKER_THRESHOLD, 1000);
+    TEST_ASSERT_EQUAL(BREAKER_OPEN, b.state);
+    TEST_ASSERT_EQUAL_UINT32(1, b.trips);
+    TEST_ASSERT_FALSE(breaker_allow(b, 1000 + b.open_for - 1));
+}
+
+void test_half_open_allows_one_probe()
+{
+    fail_times(BREAKER_THRESHOLD, 1000);
+    uint32_t probe_at = 1000 + b.open_for;
+    TEST_ASSERT_TRUE(breaker_allow(b, probe_at));
+    TEST_ASSERT_EQUAL(BREAKER_HALF_OPEN, b.state);
+    TEST_ASSERT_FALSE(breaker_allow(b, probe_at));
+    breaker_success(b);
+    TEST_ASSERT_EQUAL(BREAKER_CLOSED, b.state);
+    TEST_ASSERT_EQUAL_UINT32(BREAKER_BACKOFF_MIN, b.backoff);
+}
+
+void test_failed_probe_doubles_backoff_up_to_max()
+{
+    uint32_t now = 1000;
+    fail_times(BREAKER_THRESHOLD, now);
+    uint32_t expect = BREAKER_BACKOFF_MIN;
+    for (int i = 0; i < 12; i++) {
+        now += b.open_for;
+        TEST_ASSERT_TRUE(breaker_allow(b, now));
+        breaker_failure(b, now, 0);
+        expect = expect * 2 > BREAKER_BACKOFF_MAX ? BREAKER_BACKOFF_MAX : expect * 2;
+        TEST_ASSERT_EQUAL(BREAKER_OPEN, b.state);
+        TEST_ASSERT_EQUAL_UINT32(expect, b.backoff);
+    }
+    TEST_ASSERT_EQUAL_UINT32(BREAKER_BACKOFF_MAX, b.backoff);
+}
+
+void test_jitter_stays_in_upper_half()
+{
+    static const uint32_t rnds[] = {0, 1, 999, 12345678, 0xffffffff};
+    for (uint32_t rnd : rnds) {
+        breaker_init(b);
+        fail_times(BREAKER_THRESHOLD, 0, rnd);
+        TEST_ASSERT_TRUE(b.open_for >= BREAKER_BACKOFF_MIN / 2);
+        TEST_ASSERT_TRUE(b.open_for < BREAKER_BACKOFF_MIN);
+    }
+}
+
+void test_jitter_spreads_devices()
+{
+    // two devices that lost the server together don't probe together
+    Breaker other;
+    breaker_init(other);
+    fail_times(BREAKER_THRESHOLD, 0, 17);
+    for (int i = 0; i < BREAKER_THRESHOLD; i++)
+        breaker_failure(other, 0, 523);
+    TEST_ASSERT_TRUE(b.open_for != other.open_for);
+}
+
+void test_wraps_with_millis()
+{
+    uint32_t now = 0xffffffffu - 100;
+    fail_times(BREAKER_THRESHOLD, now);
+    TEST_ASSERT_FALSE(breaker_allow(b, now + 200)); // wrapped, still inside the window
+    TEST_ASSERT_TRUE(breaker_allow(b, now + b.open_for));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_stays_closed_below_threshold);
+    RUN_TEST(test_opens_and_skips);
+    RUN_TEST(test_half_open_allows_one_probe);
+    RUN_TEST(test_failed_probe_doubles_backoff_up_to_max);
+    RUN_TEST(test_jitter_stays_in_upper_half);
+    RUN_TEST(test_jitter_spreads_devices);
+    RUN_TEST(test_wraps_with_millis);
+    return UNITY_END();
+}
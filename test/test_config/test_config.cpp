@@ -0,0 +1,210 @@
+#include <fakes.h>
+#include <stddef.h>
+#include <string.h>
+#include <unity.h>
+#include "config.h"
+#include "transport.h"
+
+// Blobs as older firmware left them in NVS: its struct, tail padding and
+// all, so fields appended since can fall inside the blob
+#define V1_BLOB 72
+#define V2_BLOB 76
+#define V3_BLOB 80
+#define V4_BLOB 92 // ends in 2 bytes of padding, where lux_gain is now
+#define V5_BLOB 96 // transport and mqtt_qos are in its 2 bytes of padding
+#define V6_BLOB 100 // ends in 2 bytes of padding, where tls_port is now
+
+void setUp()
+{
+    fakes_reset();
+}
+
+void tearDown() {}
+
+// every field off its default
+static DeviceConfig custom()
+{
+    DeviceConfig c;
+    config_defaults(c);
+    c.rev = 42;
+    strcpy(c.server_address, "10.0.0.9");
+    c.server_port = 8080;
+    c.periods_stored = 7;
+    c.dry = 55;
+    c.shade = 2000;
+    c.buzzer_off_time = 900000;
+    c.sensor_period = 2000;
+    c.display_period = 500;
+    c.uplink_period = 5000;
+    c.ota_period = 3600000;
+    c.aggregate_window = 30000;
+    c.heartbeat_period = 600000;
+    c.temp_deadband = 5;
+    c.moisture_deadband = 20;
+    c.light_deadband = 10;
+    c.lux_gain = 1234;
+    c.adc_offset = -12;
+    c.transport = TRANSPORT_MQTT;
+    c.mqtt_qos = 0;
+    c.mqtt_port = 1884;
+    c.tls_port = 9443;
+    return c;
+}
+
+static void store(const void *blob, size_t len)
+{
+    nvs_handle_t h;
+    nvs_open("storage", NVS_READWRITE, &h);
+    nvs_set_blob(h, "config", blob, len);
+    nvs_close(h);
+}
+
+// what a version-`version` firmware saved: its fields, zeros after them
+static void store_old(uint16_t version, size_t fields_end, size_t blob_len)
+{
+    DeviceConfig c = custom();
+    c.version = version;
+    memset((uint8_t *)&c + fields_end, 0, sizeof(c) - fields_end);
+    store(&c, blob_len);
+}
+
+// each field is the stored one if the blob's version had it, else the default
+static void expect_loaded(int version)
+{
+    DeviceConfig c = custom(), d;
+    config_defaults(d);
+#define FIELD(f, since) \
+    TEST_ASSERT_EQUAL_INT_MESSAGE((version >= since ? c : d).f, config.f, #f)
+    TEST_ASSERT_EQUAL_INT(CONFIG_VERSION, config.version);
+    TEST_ASSERT_EQUAL_STRING((version >= 1 ? c : d).server_address, config.server_address);
+    FIELD(rev, 1);
+    FIELD(server_port, 1);
+    FIELD(periods_stored, 1);
+    FIELD(dry, 1);
+    FIELD(shade, 1);
+    FIELD(buzzer_off_time, 1);
+    FIELD(sensor_period, 1);
+    FIELD(display_period, 1);
+    FIELD(uplink_period, 1);
+    FIELD(ota_period, 2);
+    FIELD(aggregate_window, 3);
+    FIELD(heartbeat_period, 4);
+    FIELD(temp_deadband, 4);
+    FIELD(moisture_deadband, 4);
+    FIELD(light_deadband, 4);
+    FIELD(lux_gain, 5);
+    FIELD(adc_offset, 5);
+    FIELD(transport, 6);
+    FIELD(mqtt_qos, 6);
+    FIELD(mqtt_port, 6);
+    FIELD(tls_port, 7);
+#undef FIELD
+}
+
+void test_no_blob_gives_defaults()
+{
+    config_setup();
+    expect_loaded(0);
+}
+
+void test_newer_blob_ignored()
+{
+    // a downgrade: it may mean something else by any of its fields
+    store_old(CONFIG_VERSION + 1, sizeof(DeviceConfig), sizeof(DeviceConfig));
+    config_setup();
+    expect_loaded(0);
+
+    uint8_t longer[sizeof(DeviceConfig) + 8];
+    DeviceConfig c = custom();
+    c.version = CONFIG_VERSION + 1;
+    memset(longer, 0, sizeof(longer));
+    memcpy(longer, &c, sizeof(c));
+    store(longer, sizeof(longer));
+    config_setup();
+    expect_loaded(0);
+}
+
+void test_invalid_blob_ignored()
+{
+    DeviceConfig c = custom();
+    c.sensor_period = 10; // faster than the DHT20 can go
+    store(&c, sizeof(c));
+    config_setup();
+    expect_loaded(0);
+
+    c = custom();
+    c.version = 0;
+    store(&c, sizeof(c));
+    config_setup();
+    expect_loaded(0);
+}
+
+void test_short_blob_ignored()
+{
+    // says v4 but stops inside its deadbands
+    store_old(4, offsetof(DeviceConfig, lux_gain), 84);
+    config_setup();
+    expect_loaded(0);
+}
+
+void test_v1_to_v3_blobs()
+{
+    static const size_t ends[] = {0, offsetof(DeviceConfig, ota_period), offsetof(DeviceConfig, aggregate_window),
+                                  offsetof(DeviceConfig, heartbeat_period)};
+    static const size_t blobs[] = {0, V1_BLOB, V2_BLOB, V3_BLOB};
+    for (int v = 1; v <= 3; v++) {
+        fakes_reset();
+        store_old(v, ends[v], blobs[v]);
+        config_setup();
+        expect_loaded(v);
+    }
+}
+
+void test_current_blob_round_trips()
+{
+    store_old(CONFIG_VERSION, sizeof(DeviceConfig), sizeof(DeviceConfig));
+    config_setup();
+    expect_loaded(CONFIG_VERSION);
+}
+
+void test_v4_blob_keeps_its_fields()
+{
+    // lux_gain = 0 from the padding would fail validation and reset it all
+    store_old(4, offsetof(DeviceConfig, lux_gain), V4_BLOB);
+    config_setup();
+    expect_loaded(4);
+    TEST_ASSERT_EQUAL_UINT16(1000, config.lux_gain);
+}
+
+void test_v5_blob_gets_mqtt_defaults()
+{
+    // mqtt_qos = 0 from the padding would pass validation, silently
+    store_old(5, offsetof(DeviceConfig, transport), V5_BLOB);
+    config_setup();
+    expect_loaded(5);
+    TEST_ASSERT_EQUAL_UINT8(TRANSPORT_HTTP, config.transport);
+    TEST_ASSERT_EQUAL_UINT8(1, config.mqtt_qos);
+}
+
+void test_v6_blob_keeps_its_fields()
+{
+    // same length as a v7 blob: the padding must not become tls_port = 0
+    store_old(6, offsetof(DeviceConfig, tls_port), V6_BLOB);
+    config_setup();
+    expect_loaded(6);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_no_blob_gives_defaults);
+    RUN_TEST(test_newer_blob_ignored);
+    RUN_TEST(test_invalid_blob_ignored);
+    RUN_TEST(test_short_blob_ignored);
+    RUN_TEST(test_v1_to_v3_blobs);
+    RUN_TEST(test_current_blob_round_trips);
+    RUN_TEST(test_v4_blob_keeps_its_fields);
+    RUN_TEST(test_v5_blob_gets_mqtt_defaults);
+    RUN_TEST(test_v6_blob_keeps_its_fields);
+    return UNITY_END();
+}
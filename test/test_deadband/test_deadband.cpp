@@ -0,0 +1,121 @@
+#include <unity.h>
+#include "config.h"
+#include "deadband.h"
+
+static Deadband d;
+
+void setUp()
+{
+    config_defaults(config);
+    deadband_init(d);
+}
+
+void tearDown() {}
+
+static WindowStats window(float temp, float moisture, int light)
+{
+    WindowStats w;
+    window_start(w, 0);
+    SensorData s = {temp, moisture, light, true};
+    window_add(w, s);
+    window_close(w, 60000);
+    return w;
+}
+
+void test_first_window_always_sent()
+{
+    TEST_ASSERT_TRUE(deadband_window(d, window(21.0f, 60.0f, 2000), 60000));
+    TEST_ASSERT_EQUAL_UINT32(1, d.sent);
+}
+
+void test_small_changes_held()
+{
+    deadband_window(d, window(21.0f, 60.0f, 2000), 60000);
+    // 0.2 °C, 0.9 %RH, 2 %: all inside the defaults
+    TEST_ASSERT_FALSE(deadband_window(d, window(21.2f, 60.9f, 2080), 120000));
+    TEST_ASSERT_FALSE(deadband_window(d, window(20.8f, 59.1f, 1920), 180000));
+    TEST_ASSERT_EQUAL_UINT32(2, d.skipped);
+}
+
+void test_each_metric_triggers()
+{
+    deadband_window(d, window(21.0f, 60.0f, 2000), 60000);
+    TEST_ASSERT_TRUE(deadband_window(d, window(21.5f, 60.0f, 2000), 120000));
+    TEST_ASSERT_TRUE(deadband_window(d, window(21.5f, 58.5f, 2000), 180000));
+    TEST_ASSERT_TRUE(deadband_window(d, window(21.5f, 58.5f, 3000), 240000));
+    TEST_ASSERT_EQUAL_UINT32(4, d.sent);
+}
+
+void test_drift_measured_from_last_sent()
+{
+    // 0.2 °C per window never trips a 0.3 threshold step to step, but the
+    // reference stays put until something is sent
+    deadband_window(d, window(21.0f, 60.0f, 2000), 60000);
+    TEST_ASSERT_FALSE(deadband_window(d, window(21.2f, 60.0f, 2000), 120000));
+    TEST_ASSERT_TRUE(deadband_window(d, window(21.4f, 60.0f, 2000), 180000));
+    TEST_ASSERT_FALSE(deadband_window(d, window(21.6f, 60.0f, 2000), 240000));
+}
+
+void test_heartbeat()
+{
+    deadband_window(d, window(21.0f, 60.0f, 2000), 60000);
+    TEST_ASSERT_FALSE(deadband_window(d, window(21.0f, 60.0f, 2000), 60000 + config.heartbeat_period - 1));
+    TEST_ASSERT_TRUE(deadband_window(d, window(21.0f, 60.0f, 2000), 60000 + config.heartbeat_period));
+    TEST_ASSERT_FALSE(deadband_window(d, window(21.0f, 60.0f, 2000), 120000 + config.heartbeat_period));
+}
+
+void test_off_sends_everything()
+{
+    config.heartbeat_period = 0;
+    deadband_window(d, window(21.0f, 60.0f, 2000), 60000);
+    TEST_ASSERT_TRUE(deadband_window(d, window(21.0f, 60.0f, 2000), 120000));
+    TEST_ASSERT_EQUAL_UINT32(0, d.skipped);
+}
+
+void test_zero_deadband_is_any_change()
+{
+    config.moisture_deadband = 0;
+    deadband_window(d, window(21.0f, 60.0f, 2000), 60000);
+    TEST_ASSERT_FALSE(deadband_window(d, window(21.0f, 60.0f, 2000), 120000));
+    TEST_ASSERT_TRUE(deadband_window(d, window(21.0f, 60.01f, 2000), 180000));
+}
+
+void test_samples()
+{
+    SensorData s = {21.0f, 60.0f, 2000, false};
+    TEST_ASSERT_FALSE(deadband_sample(d, s, 1000)); // nothing read yet
+    s.valid = true;
+    TEST_ASSERT_TRUE(deadband_sample(d, s, 2000));
+    s.temp = 21.2f;
+    TEST_ASSERT_FALSE(deadband_sample(d, s, 3000));
+    s.temp = 21.4f;
+    TEST_ASSERT_TRUE(deadband_sample(d, s, 4000));
+}
+
+void test_config_bounds()
+{
+    DeviceConfig c;
+    config_defaults(c);
+    TEST_ASSERT_TRUE(config_validate(c));
+    c.heartbeat_period = 1000;
+    TEST_ASSERT_FALSE(config_validate(c));
+    c.heartbeat_period = 0;
+    TEST_ASSERT_TRUE(config_validate(c));
+    c.light_deadband = 101;
+    TEST_ASSERT_FALSE(config_validate(c));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_first_window_always_sent);
+    RUN_TEST(test_small_changes_held);
+    RUN_TEST(test_each_metric_triggers);
+    RUN_TEST(test_drift_measured_from_last_sent);
+    RUN_TEST(test_heartbeat);
+    RUN_TEST(test_off_sends_everything);
+    RUN_TEST(test_zero_deadband_is_any_change);
+    RUN_TEST(test_samples);
+    RUN_TEST(test_config_bounds);
+    return UNITY_END();
+}
@@ -0,0 +1,121 @@
+#include <fakes.h>
+#include <unity.h>
+#include "http_response.h"
+
+static WiFiClient client;
+static char buf[512];
+static HttpResponse resp;
+static FakeHttpResponse answer;
+static uint32_t elapsed_ms; // request sent -> http_read_response() returned
+
+void setUp()
+{
+    fakes_reset();
+    WiFi.begin("ssid", "pass");
+    delay(fake_net.associate_ms);
+    answer = FakeHttpResponse();
+    fake_net.handler = [](const FakeHttpRequest &) { return answer; };
+}
+
+void tearDown()
+{
+    client.stop();
+}
+
+static int submit(size_t len = sizeof(buf), uint32_t timeout_ms = HTTP_RESPONSE_TIMEOUT)
+{
+    static const char req[] = "POST /submit HTTP/1.1\r\nContent-Length: 2\r\n\r\n{}";
+    TEST_ASSERT_TRUE(client.connect("server", 5000));
+    client.write((const uint8_t *)req, sizeof(req) - 1);
+    uint32_t start = millis();
+    int status = http_read_response(client, buf, len, timeout_ms, resp);
+    elapsed_ms = millis() - start;
+    return status;
+}
+
+void test_reads_status_and_body()
+{
+    answer.body = "{\"config_rev\": 2}";
+    TEST_ASSERT_EQUAL(200, submit());
+    TEST_ASSERT_EQUAL(17, resp.content_length);
+    TEST_ASSERT_EQUAL_size_t(17, resp.body_len);
+    TEST_ASSERT_EQUAL_STRING("{\"config_rev\": 2}", resp.body);
+}
+
+void test_latency_tracks_rtt()
+{
+    // HttpClient's 1s poll made this ~1000 ms whatever the server did
+    answer.latency_ms = 37;
+    TEST_ASSERT_EQUAL(200, submit());
+    TEST_ASSERT_TRUE(elapsed_ms >= 37 && elapsed_ms <= 37 + HTTP_POLL_MS);
+}
+
+void test_error_status_keeps_body()
+{
+    answer.status = 503;
+    answer.body = "Service Unavailable";
+    TEST_ASSERT_EQUAL(503, submit());
+    TEST_ASSERT_EQUAL_STRING("Service Unavailable", resp.body);
+}
+
+void test_reset_reported_at_once()
+{
+    answer.reset = true;
+    TEST_ASSERT_EQUAL(HTTP_RESP_CLOSED, submit());
+    TEST_ASSERT_EQUAL(0, elapsed_ms);
+}
+
+void test_lost_response_times_out()
+{
+    answer.drop = true;
+    TEST_ASSERT_EQUAL(HTTP_RESP_TIMEOUT, submit(sizeof(buf), 250));
+    TEST_ASSERT_TRUE(elapsed_ms >= 250 && elapsed_ms <= 250 + HTTP_POLL_MS);
+}
+
+void test_slow_drip_is_collected()
+{
+    answer.drip_ms = 2;
+    TEST_ASSERT_EQUAL(200, submit());
+    TEST_ASSERT_EQUAL_STRING("Data received", resp.body);
+    // ~100 bytes of response, one every 2 ms
+    TEST_ASSERT_TRUE(elapsed_ms > 150 && elapsed_ms < 300);
+}
+
+void test_drip_past_deadline_times_out()
+{
+    answer.drip_ms = 100;
+    TEST_ASSERT_EQUAL(HTTP_RESP_TIMEOUT, submit(sizeof(buf), 1000));
+}
+
+void test_body_larger_than_buffer()
+{
+    answer.body = std::string(200, 'x');
+    TEST_ASSERT_EQUAL(HTTP_RESP_OVERFLOW, submit(128));
+}
+
+void test_body_exactly_fits()
+{
+    // headers + body + NUL fill the buffer to the last byte
+    TEST_ASSERT_EQUAL(200, submit());
+    size_t need = resp.body - buf + resp.body_len + 1;
+    client.stop();
+    TEST_ASSERT_EQUAL(200, submit(need));
+    TEST_ASSERT_EQUAL_STRING("Data received", resp.body);
+    client.stop();
+    TEST_ASSERT_EQUAL(HTTP_RESP_OVERFLOW, submit(need - 1));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_reads_status_and_body);
+    RUN_TEST(test_latency_tracks_rtt);
+    RUN_TEST(test_error_status_keeps_body);
+    RUN_TEST(test_reset_reported_at_once);
+    RUN_TEST(test_lost_response_times_out);
+    RUN_TEST(test_slow_drip_is_collected);
+    RUN_TEST(test_drip_past_deadline_times_out);
+    RUN_TEST(test_body_larger_than_buffer);
+    RUN_TEST(test_body_exactly_fits);
+    return UNITY_END();
+}
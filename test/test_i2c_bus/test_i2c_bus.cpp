@@ -0,0 +1,196 @@
+#include <fakes.h>
+#include <unity.h>
+#include "i2c_bus.h"
+#include "prediction.h"
+#include "sensor_drivers.h"
+
+void setUp()
+{
+    fakes_reset();
+    i2c_setup();
+}
+
+void tearDown() {}
+
+static uint32_t count(I2cResult r)
+{
+    return i2c_stats().count[r];
+}
+
+void test_fast_mode()
+{
+    TEST_ASSERT_EQUAL_UINT32(I2C_CLOCK_HZ, Wire.getClock());
+    // a DHT20 sample: 3-byte trigger + 7-byte read, ~0.3 ms on the wire
+    uint8_t b[7];
+    static const uint8_t trigger[] = {0xAC, 0x33, 0x00};
+    TEST_ASSERT_EQUAL(I2C_OK, i2c_write(DHT20_ADDR, trigger, 3));
+    TEST_ASSERT_EQUAL(I2C_OK, i2c_read(DHT20_ADDR, b, 7));
+    TEST_ASSERT_TRUE(fake_i2c.bus_us < 300);
+}
+
+void test_results_counted_by_kind()
+{
+    uint8_t b[8];
+    i2c_write(0x71, nullptr, 0); // no mux there
+    fake_dht.connected = false;
+    i2c_read(DHT20_ADDR, b, 7);
+    fake_dht.connected = true;
+    i2c_read(DHT20_ADDR, b, 8); // it only ever sends 7
+    i2c_read(DHT20_ADDR, b, 7);
+    TEST_ASSERT_EQUAL_UINT32(2, count(I2C_NACK_ADDR));
+    TEST_ASSERT_EQUAL_UINT32(1, count(I2C_SHORT_READ));
+    TEST_ASSERT_EQUAL_UINT32(1, count(I2C_OK));
+    TEST_ASSERT_EQUAL_STRING("short_read", i2c_result_name(I2C_SHORT_READ));
+}
+
+void test_nacks_never_trigger_recovery()
+{
+    fake_dht.connected = false;
+    uint8_t b;
+    for (int i = 0; i < 10; i++)
+        i2c_read(DHT20_ADDR, &b, 1);
+    TEST_ASSERT_EQUAL_UINT32(0, i2c_stats().recoveries);
+}
+
+void test_recovers_after_repeated_timeouts()
+{
+    // writes report a timeout as such; a read that times out comes back
+    // empty like a NACK, and only a held SDA tells them apart
+    uint8_t b = 0;
+    fake_i2c.timeouts = I2C_RECOVER_AFTER;
+    for (int i = 0; i < I2C_RECOVER_AFTER - 1; i++)
+        TEST_ASSERT_EQUAL(I2C_TIMEOUT, i2c_write(DHT20_ADDR, &b, 1));
+    TEST_ASSERT_EQUAL_UINT32(0, i2c_stats().recoveries);
+    i2c_write(DHT20_ADDR, &b, 1);
+    TEST_ASSERT_EQUAL_UINT32(1, i2c_stats().recoveries);
+    TEST_ASSERT_EQUAL(I2C_OK, i2c_read(DHT20_ADDR, &b, 1));
+    TEST_ASSERT_EQUAL_UINT32(I2C_CLOCK_HZ, Wire.getClock()); // controller restarted as it was
+}
+
+void test_stuck_sda_clocked_free()
+{
+    uint8_t b;
+    fake_i2c.sda_stuck = true;
+    fake_i2c.stuck_clocks = 5;
+    // the first failure finds SDA low and recovers straight away
+    TEST_ASSERT_EQUAL(I2C_BUS_ERROR, i2c_read(DHT20_ADDR, &b, 1));
+    TEST_ASSERT_FALSE(fake_i2c.sda_stuck);
+    TEST_ASSERT_EQUAL_UINT32(5, fake_i2c.scl_pulses);
+    TEST_ASSERT_EQUAL_UINT32(1, i2c_stats().recoveries);
+    TEST_ASSERT_EQUAL(I2C_OK, i2c_read(DHT20_ADDR, &b, 1));
+}
+
+void test_stuck_for_good()
+{
+    fake_i2c.sda_stuck = true;
+    fake_i2c.stuck_clocks = 100;
+    TEST_ASSERT_FALSE(i2c_recover());
+    TEST_ASSERT_EQUAL_UINT32(I2C_RECOVER_CLOCKS, fake_i2c.scl_pulses);
+    TEST_ASSERT_EQUAL_UINT32(1, i2c_stats().recover_failed);
+}
+
+void test_stuck_at_boot()
+{
+    fake_i2c.sda_stuck = true;
+    i2c_setup();
+    TEST_ASSERT_FALSE(fake_i2c.sda_stuck);
+    TEST_ASSERT_EQUAL_UINT32(1, i2c_stats().recoveries);
+}
+
+void test_dht20_one_read_per_sample()
+{
+    Dht20Climate d;
+    SensorData s = {};
+    fake_dht.humidity = 42.0f;
+    TEST_ASSERT_TRUE(d.begin());
+    d.poll(s);
+    uint32_t before = fake_i2c.transactions;
+    fake_advance_ms(DHT20_CONVERSION_MS);
+    TEST_ASSERT_EQUAL(SENSOR_FRESH, d.poll(s));
+    // the fetch and the next trigger, no status polls in between
+    TEST_ASSERT_EQUAL_UINT32(2, fake_i2c.transactions - before);
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 42.0f, s.moisture);
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 21.5f, s.temp);
+}
+
+void test_dht20_saturated_reads_as_watered()
+{
+    Dht20Climate d;
+    SensorData s = {};
+    fake_dht.humidity = 100.0f; // the top raw code, 0xFFFFF
+    d.begin();
+    d.poll(s);
+    fake_advance_ms(DHT20_CONVERSION_MS);
+    TEST_ASSERT_EQUAL(SENSOR_FRESH, d.poll(s));
+    TEST_ASSERT_TRUE(s.moisture < 100.0f);
+    TEST_ASSERT_TRUE(s.moisture >= WATERED_RH);
+
+    Prediction p;
+    prediction_init(p, 5, 0);
+    prediction_sample(p, 50, 60, 1000);
+    prediction_sample(p, s.moisture, 60, 2000);
+    TEST_ASSERT_TRUE(p.predicted);
+    TEST_ASSERT_EQUAL_UINT32(2000, p.last_watered);
+}
+
+void test_dht20_status_byte_checked()
+{
+    Dht20Climate d;
+    SensorData s = {};
+    d.begin();
+    d.poll(s);
+    fake_dht.conversion_ms = 120; // slower than the datasheet
+    fake_dht.started_us = fake_now_us;
+    fake_advance_ms(DHT20_CONVERSION_MS);
+    TEST_ASSERT_EQUAL(SENSOR_ERROR, d.poll(s));
+    TEST_ASSERT_EQUAL_UINT32(1, count(I2C_NOT_READY));
+}
+
+void test_dht20_reinitialized_after_brownout()
+{
+    Dht20Climate d;
+    SensorData s = {};
+    d.begin();
+    d.poll(s);
+    fake_dht.calibrated = false;
+    fake_advance_ms(100);
+    TEST_ASSERT_EQUAL(SENSOR_ERROR, d.poll(s)); // notices, redoes the init before the next trigger
+    TEST_ASSERT_TRUE(fake_dht.calibrated);
+    fake_advance_ms(100);
+    TEST_ASSERT_EQUAL(SENSOR_FRESH, d.poll(s));
+}
+
+void test_dht20_collision_fails_crc()
+{
+    Dht20Climate d;
+    SensorData s = {};
+    d.begin();
+    d.poll(s);
+    // a second sensor on the bus at 0x38 (two mux channels open)
+    fake_i2c.mux_present[0] = true;
+    fake_i2c.mux_select[0] = 1;
+    fake_dht_mux[0][0] = FakeDht();
+    fake_dht_mux[0][0].humidity = 80.0f;
+    fake_dht_mux[0][0].triggered = true;
+    fake_advance_ms(100);
+    TEST_ASSERT_EQUAL(SENSOR_ERROR, d.poll(s));
+    TEST_ASSERT_EQUAL_UINT32(1, count(I2C_CRC));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_fast_mode);
+    RUN_TEST(test_results_counted_by_kind);
+    RUN_TEST(test_nacks_never_trigger_recovery);
+    RUN_TEST(test_recovers_after_repeated_timeouts);
+    RUN_TEST(test_stuck_sda_clocked_free);
+    RUN_TEST(test_stuck_for_good);
+    RUN_TEST(test_stuck_at_boot);
+    RUN_TEST(test_dht20_one_read_per_sample);
+    RUN_TEST(test_dht20_saturated_reads_as_watered);
+    RUN_TEST(test_dht20_status_byte_checked);
+    RUN_TEST(test_dht20_reinitialized_after_brownout);
+    RUN_TEST(test_dht20_collision_fails_crc);
+    return UNITY_END();
+}
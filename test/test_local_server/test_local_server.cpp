@@ -0,0 +1,301 @@
+#include <ArduinoJson.h>
+#include <fakes.h>
+#include <stdlib.h>
+#include <string>
+#include <unity.h>
+#include "config.h"
+#include "local_server.h"
+#include "recent.h"
+#include "segment_writer.h"
+#include "wifi_manager.h"
+
+void setUp()
+{
+    fakes_reset();
+    config_defaults(config);
+    nvs_handle_t h;
+    nvs_open("storage", NVS_READWRITE, &h);
+    nvs_set_str(h, "ssid", "greenhouse");
+    nvs_set_str(h, "pass", "succulent");
+    nvs_close(h);
+    wifi_setup();
+    while (!wifi_connected()) {
+        delay(50);
+        wifi_loop();
+    }
+    recent_clear();
+    local_server_setup();
+}
+
+void tearDown() {}
+
+static void add_samples(int n, uint8_t plants = 1)
+{
+    for (int i = 0; i < n; i++) {
+        SensorData s = {20.0f + i * 0.01f, 40.0f + i * 0.5f, 3000, true};
+        recent_add(s, i % plants, 1000 * (i + 1));
+    }
+}
+
+// queues a request, polls until the board has answered it
+static FakeInbound &get(const char *target, uint32_t latency_ms = 0)
+{
+    FakeInbound in;
+    in.request = std::string("GET ") + target + " HTTP/1.1\r\nHost: plant.local\r\nAccept: */*\r\n\r\n";
+    in.latency_ms = latency_ms;
+    fake_net.inbound.push_back(in);
+    for (int i = 0; i < 100; i++) {
+        local_server_loop();
+        if (fake_net.inbound.back().closed)
+            break;
+        delay(LOCAL_SERVER_PERIOD);
+    }
+    TEST_ASSERT_TRUE(fake_net.inbound.back().closed);
+    return fake_net.inbound.back();
+}
+
+static std::string headers(const FakeInbound &in)
+{
+    return in.response.substr(0, in.response.find("\r\n\r\n") + 4);
+}
+
+// the body with the chunk framing taken off; fails the test on bad framing
+static std::string dechunk(const FakeInbound &in)
+{
+    std::string body;
+    size_t pos = in.response.find("\r\n\r\n") + 4;
+    for (;;) {
+        size_t eol = in.response.find("\r\n", pos);
+        TEST_ASSERT_TRUE(eol != std::string::npos);
+        size_t len = strtoul(in.response.substr(pos, eol - pos).c_str(), nullptr, 16);
+        pos = eol + 2;
+        if (len == 0)
+            break;
+        body += in.response.substr(pos, len);
+        pos += len;
+        TEST_ASSERT_EQUAL_STRING("\r\n", in.response.substr(pos, 2).c_str());
+        pos += 2;
+    }
+    TEST_ASSERT_EQUAL_STRING("\r\n", in.response.substr(pos).c_str());
+    return body;
+}
+
+void test_ring_keeps_newest()
+{
+    add_samples(RECENT_MAX + 10);
+    TEST_ASSERT_EQUAL_size_t(RECENT_MAX, recent_count());
+    TEST_ASSERT_EQUAL_UINT32(11000, recent_at(0).ms);
+    TEST_ASSERT_EQUAL_UINT32((RECENT_MAX + 10) * 1000, recent_at(RECENT_MAX - 1).ms);
+
+    SensorData bad = {0, 0, 0, false};
+    recent_add(bad, 0, 1);
+    TEST_ASSERT_EQUAL_UINT32((RECENT_MAX + 10) * 1000, recent_at(RECENT_MAX - 1).ms);
+}
+
+void test_json_newest_rows_oldest_first()
+{
+    add_samples(10);
+    FakeInbound &in = get("/recent.json?n=3");
+    TEST_ASSERT_TRUE(in.response.rfind("HTTP/1.1 200 OK\r\n", 0) == 0);
+    TEST_ASSERT_TRUE(headers(in).find("Transfer-Encoding: chunked\r\n") != std::string::npos);
+    TEST_ASSERT_TRUE(headers(in).find("Content-Type: application/json\r\n") != std::string::npos);
+
+    JsonDocument d;
+    std::string body = dechunk(in);
+    TEST_ASSERT_EQUAL(DeserializationError::Ok, deserializeJson(d, body.c_str(), body.size()).code);
+    JsonVariantConst rows = d["samples"];
+    TEST_ASSERT_EQUAL_size_t(3, rows.size());
+    TEST_ASSERT_EQUAL_UINT32(8000, rows[0]["ms"].as<uint32_t>());
+    TEST_ASSERT_EQUAL_UINT32(10000, rows[2]["ms"].as<uint32_t>());
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 20.09, rows[2]["temp"].as<double>());
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 44.5, rows[2]["moisture"].as<double>());
+    TEST_ASSERT_EQUAL_INT(73, rows[2]["light"].as<int>());
+    TEST_ASSERT_FLOAT_WITHIN(0.05, 101.2, rows[2]["lux"].as<double>());
+    TEST_ASSERT_EQUAL_UINT32(millis(), d["now"].as<uint32_t>());
+}
+
+void test_small_response_is_one_write()
+{
+    add_samples(5);
+    uint32_t before = fake_net.inbound_writes;
+    get("/recent.json");
+    TEST_ASSERT_EQUAL_UINT32(1, fake_net.inbound_writes - before);
+    TEST_ASSERT_EQUAL_UINT32(1, local_server_stats().segments);
+}
+
+void test_csv_one_plant()
+{
+    add_samples(12, 3);
+    FakeInbound &in = get("/recent.csv?plant=1");
+    TEST_ASSERT_TRUE(headers(in).find("Content-Type: text/csv\r\n") != std::string::npos);
+    std::string body = dechunk(in);
+    TEST_ASSERT_EQUAL_STRING("ms,plant,temp,moisture,light,lux\n"
+                             "2000,1,20.01,40.50,73,101.2\n"
+                             "5000,1,20.04,42.00,73,101.2\n"
+                             "8000,1,20.07,43.50,73,101.2\n"
+                             "11000,1,20.10,45.00,73,101.2\n",
+                             body.c_str());
+}
+
+void test_since_only_newer()
+{
+    add_samples(10);
+    std::string body = dechunk(get("/recent.csv?since=8000"));
+    TEST_ASSERT_EQUAL_STRING("ms,plant,temp,moisture,light,lux\n"
+                             "9000,0,20.08,44.00,73,101.2\n"
+                             "10000,0,20.09,44.50,73,101.2\n",
+                             body.c_str());
+}
+
+void test_everything_held_in_segment_chunks()
+{
+    add_samples(RECENT_MAX);
+    FakeInbound &in = get("/recent.csv?n=5000");
+    std::string body = dechunk(in);
+    size_t lines = 0;
+    for (char c : body)
+        lines += c == '\n';
+    TEST_ASSERT_EQUAL_size_t(RECENT_MAX + 1, lines);
+    // every write is one full chunk in one TCP segment, the last one short
+    const LocalServerStats &ls = local_server_stats();
+    TEST_ASSERT_EQUAL_UINT32(ls.segments, fake_net.inbound_writes);
+    TEST_ASSERT_TRUE(ls.segments > 1);
+    TEST_ASSERT_TRUE(in.response.size() <= ls.segments * TCP_SEGMENT);
+    TEST_ASSERT_EQUAL_UINT32(RECENT_MAX, ls.rows);
+    TEST_ASSERT_EQUAL_UINT32(body.size(), ls.bytes);
+}
+
+void test_errors()
+{
+    TEST_ASSERT_TRUE(get("/").response.rfind("HTTP/1.1 404 ", 0) == 0);
+    TEST_ASSERT_TRUE(get("/recent.json?n=x").response.rfind("HTTP/1.1 400 ", 0) == 0);
+    TEST_ASSERT_TRUE(get("/recent.json?plant=300").response.rfind("HTTP/1.1 400 ", 0) == 0);
+    TEST_ASSERT_TRUE(get(("/recent.json?" + std::string(LOCAL_LINE_MAX, 'a')).c_str()).response.rfind("HTTP/1.1 414 ", 0) == 0);
+
+    FakeInbound post;
+    post.request = "POST /recent.json HTTP/1.1\r\nContent-Length: 0\r\n\r\n";
+    fake_net.inbound.push_back(post);
+    local_server_loop();
+    TEST_ASSERT_TRUE(fake_net.inbound.back().response.rfind("HTTP/1.1 405 ", 0) == 0);
+    TEST_ASSERT_EQUAL_UINT32(5, local_server_stats().errors);
+    TEST_ASSERT_EQUAL_UINT32(0, local_server_stats().requests);
+}
+
+static FakeTask *accept_task()
+{
+    for (FakeTask *t : fake_tasks)
+        if (!strcmp(t->name, "local"))
+            return t;
+    return nullptr;
+}
+
+// the accept task's select(), for ulTaskNotifyTake() to wake on
+static uint64_t next_connects_at()
+{
+    if (fake_net.inbound_next >= fake_net.inbound.size())
+        return UINT64_MAX;
+    return fake_net.inbound[fake_net.inbound_next].connected_us;
+}
+
+void test_slow_request_doesnt_block()
+{
+    add_samples(3);
+    FakeInbound in;
+    in.request = "GET /recent.json HTTP/1.1\r\n\r\n";
+    in.latency_ms = 30;
+    fake_net.inbound.push_back(in);
+    uint32_t start = millis();
+    TEST_ASSERT_FALSE(local_server_busy());
+    local_server_loop(); // accepted, nothing to read yet
+    TEST_ASSERT_EQUAL_UINT32(start, millis());
+    TEST_ASSERT_FALSE(fake_net.inbound.back().closed);
+    TEST_ASSERT_TRUE(local_server_busy()); // polled quickly until it's in
+    TEST_ASSERT_EQUAL_UINT32(0, accept_task()->notified); // not waiting for another
+    delay(30);
+    local_server_loop();
+    TEST_ASSERT_TRUE(fake_net.inbound.back().closed);
+    TEST_ASSERT_FALSE(local_server_busy());
+    TEST_ASSERT_EQUAL_UINT32(1, local_server_stats().requests);
+}
+
+void test_accept_task_wakes_loop()
+{
+    add_samples(3);
+    FakeTask *task = accept_task();
+    TEST_ASSERT_TRUE(task != nullptr);
+    task->gives_at = next_connects_at;
+    local_server_loop();
+    TEST_ASSERT_TRUE(local_server_listening());
+    TEST_ASSERT_EQUAL_UINT32(1, task->notified); // waiting for a connection
+
+    FakeInbound in;
+    in.request = "GET /recent.json HTTP/1.1\r\n\r\n";
+    uint64_t connects = fake_now_us + 300000;
+    in.connected_us = connects;
+    fake_net.inbound.push_back(in);
+    TEST_ASSERT_EQUAL_UINT32(1, ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000)));
+    TEST_ASSERT_EQUAL_UINT64(connects, fake_now_us); // as it connected, not at the timeout
+    TEST_ASSERT_EQUAL_UINT32(0, task->notified);
+    local_server_loop();
+    TEST_ASSERT_TRUE(fake_net.inbound.back().closed);
+    TEST_ASSERT_EQUAL_UINT64(connects, fake_net.inbound.back().closed_us);
+    TEST_ASSERT_EQUAL_UINT32(1, task->notified); // and for the next
+
+    uint64_t before = fake_now_us;
+    TEST_ASSERT_EQUAL_UINT32(0, ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000)));
+    TEST_ASSERT_EQUAL_UINT64(before + 1000000, fake_now_us);
+}
+
+void test_not_accepted_before_it_connects()
+{
+    FakeInbound in;
+    in.request = "GET /recent.json HTTP/1.1\r\n\r\n";
+    in.connected_us = fake_now_us + 50000;
+    fake_net.inbound.push_back(in);
+    local_server_loop();
+    TEST_ASSERT_EQUAL_size_t(0, fake_net.inbound_next);
+    delay(50);
+    local_server_loop();
+    TEST_ASSERT_TRUE(fake_net.inbound.back().closed);
+}
+
+void test_silent_client_times_out()
+{
+    FakeInbound in;
+    in.request = "GET /recent.json HTTP/1.1\r\n"; // never finishes its headers
+    fake_net.inbound.push_back(in);
+    local_server_loop();
+    delay(LOCAL_REQUEST_TIMEOUT);
+    local_server_loop();
+    TEST_ASSERT_TRUE(fake_net.inbound.back().closed);
+    TEST_ASSERT_EQUAL_STRING("", fake_net.inbound.back().response.c_str());
+    TEST_ASSERT_EQUAL_UINT32(1, local_server_stats().timeouts);
+}
+
+void test_not_listening_without_wifi()
+{
+    fake_net.ap_up = false;
+    FakeInbound in;
+    in.request = "GET /recent.json HTTP/1.1\r\n\r\n";
+    fake_net.inbound.push_back(in);
+    local_server_loop();
+    TEST_ASSERT_EQUAL_size_t(0, fake_net.inbound_next);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_ring_keeps_newest);
+    RUN_TEST(test_json_newest_rows_oldest_first);
+    RUN_TEST(test_small_response_is_one_write);
+    RUN_TEST(test_csv_one_plant);
+    RUN_TEST(test_since_only_newer);
+    RUN_TEST(test_everything_held_in_segment_chunks);
+    RUN_TEST(test_errors);
+    RUN_TEST(test_slow_request_doesnt_block);
+    RUN_TEST(test_accept_task_wakes_loop);
+    RUN_TEST(test_not_accepted_before_it_connects);
+    RUN_TEST(test_silent_client_times_out);
+    RUN_TEST(test_not_listening_without_wifi);
+    return UNITY_END();
+}
@@ -0,0 +1,98 @@
+#include <math.h>
+#include <unity.h>
+#include "config.h"
+#include "lux.h"
+
+void setUp()
+{
+    config_defaults(config);
+}
+
+void tearDown() {}
+
+// the same models with <cmath>, to check the compile-time math against
+static double reference_lux(int raw)
+{
+    double x = raw;
+    double v = (((LUX_ADC_A4 * x + LUX_ADC_A3) * x + LUX_ADC_A2) * x + LUX_ADC_A1) * x + LUX_ADC_A0;
+    double r = LUX_R_FIXED * (LUX_VCC - v) / v;
+    return 10 * pow(r / LUX_R10, -1 / LUX_GAMMA);
+}
+
+void test_constexpr_math()
+{
+    TEST_ASSERT_FLOAT_WITHIN(1e-9, log(0.001), lux_detail::ln(0.001));
+    TEST_ASSERT_FLOAT_WITHIN(1e-9, log(123456.0), lux_detail::ln(123456.0));
+    TEST_ASSERT_FLOAT_WITHIN(1e-9, exp(-7.5), lux_detail::exp(-7.5));
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, exp(9.2), lux_detail::exp(9.2));
+}
+
+void test_table_matches_models()
+{
+    for (int raw = 1; raw < 4096; raw += 37)
+        TEST_ASSERT_FLOAT_WITHIN(0.05 + reference_lux(raw) * 1e-4, reference_lux(raw), light_lux_uncalibrated(raw));
+}
+
+void test_known_points()
+{
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, light_lux(0));
+    TEST_ASSERT_FLOAT_WITHIN(0.05, 4.8, light_lux(1000));
+    TEST_ASSERT_FLOAT_WITHIN(0.05, 101.2, light_lux(3000)); // the sim's daylight
+    TEST_ASSERT_FLOAT_WITHIN(0.05, 1255.0, light_lux(4095));
+}
+
+void test_monotonic()
+{
+    for (int raw = 1; raw < 4096; raw++)
+        TEST_ASSERT_TRUE(light_lux(raw) >= light_lux(raw - 1));
+}
+
+void test_out_of_range_clamped()
+{
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, light_lux(-5));
+    TEST_ASSERT_EQUAL_FLOAT(light_lux(4095), light_lux(9999));
+}
+
+void test_calibration()
+{
+    float base = light_lux(3000);
+    config.lux_gain = 1500;
+    TEST_ASSERT_FLOAT_WITHIN(0.01, base * 1.5f, light_lux(3000));
+    config.lux_gain = 1000;
+    config.adc_offset = -40;
+    TEST_ASSERT_EQUAL_FLOAT(light_lux_uncalibrated(2960), light_lux(3000));
+}
+
+void test_calibration_config()
+{
+    // negative offsets come through a delta like any other field
+    JsonDocument d;
+    deserializeJson(d, "{\"lux_gain\": 1120, \"adc_offset\": -35}");
+    TEST_ASSERT_TRUE(config_apply(d.as<JsonObjectConst>(), 1));
+    TEST_ASSERT_EQUAL_INT(1120, config.lux_gain);
+    TEST_ASSERT_EQUAL_INT(-35, config.adc_offset);
+
+    DeviceConfig c;
+    config_defaults(c);
+    c.lux_gain = 50;
+    TEST_ASSERT_FALSE(config_validate(c));
+    config_defaults(c);
+    c.adc_offset = 401;
+    TEST_ASSERT_FALSE(config_validate(c));
+    // unsigned fields still refuse negatives
+    deserializeJson(d, "{\"lux_gain\": -1}");
+    TEST_ASSERT_FALSE(config_apply(d.as<JsonObjectConst>(), 2));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_constexpr_math);
+    RUN_TEST(test_table_matches_models);
+    RUN_TEST(test_known_points);
+    RUN_TEST(test_monotonic);
+    RUN_TEST(test_out_of_range_clamped);
+    RUN_TEST(test_calibration);
+    RUN_TEST(test_calibration_config);
+    return UNITY_END();
+}
@@ -0,0 +1,281 @@
+#include <ArduinoJson.h>
+#include <fakes.h>
+#include <string>
+#include <unity.h>
+#include "config.h"
+#include "mqtt.h"
+#include "transport.h"
+#include "uplink.h"
+#include "wifi_manager.h"
+
+#define UP_TOPIC "plant/plant-240ac4000001/up"
+#define DOWN_TOPIC "plant/plant-240ac4000001/down"
+
+static std::string replied;
+static uint32_t replies;
+
+static void on_reply(const char *body, size_t len)
+{
+    replied.assign(body, len);
+    replies++;
+}
+
+void setUp()
+{
+    mqtt_disconnect(); // the session outlives a test otherwise
+    fakes_reset();
+    config_defaults(config);
+    nvs_handle_t h;
+    nvs_open("storage", NVS_READWRITE, &h);
+    nvs_set_str(h, "ssid", "greenhouse");
+    nvs_set_str(h, "pass", "succulent");
+    nvs_close(h);
+    wifi_setup();
+    while (!wifi_connected()) {
+        delay(50);
+        wifi_loop();
+    }
+    replied.clear();
+    replies = 0;
+    transport_on_reply(on_reply);
+}
+
+void tearDown() {}
+
+static void use_mqtt(uint8_t qos)
+{
+    config.transport = TRANSPORT_MQTT;
+    config.mqtt_qos = qos;
+    config.mqtt_port = MQTT_DEFAULT_PORT;
+}
+
+static bool send(const char *msg)
+{
+    size_t n = uplink_build(msg, nullptr, millis());
+    TEST_ASSERT_TRUE(n > 0);
+    return transport_send(n);
+}
+
+static void poll_for(uint32_t ms)
+{
+    uint32_t start = millis();
+    while (millis() - start < ms) {
+        transport_poll(millis());
+        delay(TRANSPORT_POLL_PERIOD);
+    }
+}
+
+void test_length_encoding()
+{
+    const uint32_t values[] = {0, 127, 128, 16383, 16384, 2097151, 2097152, 268435455};
+    const size_t sizes[] = {1, 1, 2, 2, 3, 3, 4, 4};
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        uint8_t buf[4];
+        uint32_t back;
+        TEST_ASSERT_EQUAL_size_t(sizes[i], mqtt_encode_length(buf, values[i]));
+        TEST_ASSERT_EQUAL_INT(sizes[i], mqtt_decode_length(buf, sizes[i], back));
+        TEST_ASSERT_EQUAL_UINT32(values[i], back);
+        TEST_ASSERT_EQUAL_INT(0, mqtt_decode_length(buf, sizes[i] - 1, back));
+    }
+    const uint8_t bad[] = {0xFF, 0xFF, 0xFF, 0xFF, 0x01};
+    uint32_t n;
+    TEST_ASSERT_EQUAL_INT(-1, mqtt_decode_length(bad, sizeof(bad), n));
+}
+
+void test_http_by_default()
+{
+    TEST_ASSERT_EQUAL_UINT8(TRANSPORT_HTTP, config.transport);
+    TEST_ASSERT_TRUE(send("x"));
+    TEST_ASSERT_EQUAL_UINT32(1, fake_net.requests);
+    TEST_ASSERT_EQUAL_UINT32(0, fake_mqtt.connects);
+    TEST_ASSERT_EQUAL_STRING("http", transport_current().name);
+}
+
+void test_qos1_publish_waits_for_puback()
+{
+    use_mqtt(1);
+    std::string published;
+    fake_mqtt.handler = [&published](const FakeMqttPublish &pub) {
+        published = pub.payload;
+        TEST_ASSERT_EQUAL_STRING(UP_TOPIC, pub.topic.c_str());
+        TEST_ASSERT_EQUAL_UINT8(1, pub.qos);
+        FakeMqttAck ack;
+        ack.latency_ms = 40;
+        return ack;
+    };
+    uint32_t start = millis();
+    TEST_ASSERT_TRUE(send("Temperature: 21.50°C"));
+    TEST_ASSERT_TRUE(millis() - start >= 40);
+    TEST_ASSERT_EQUAL_STRING("plant-240ac4000001", fake_mqtt.client_id.c_str());
+    TEST_ASSERT_EQUAL_UINT16(MQTT_KEEPALIVE_S, fake_mqtt.keepalive_s);
+    TEST_ASSERT_EQUAL_STRING(DOWN_TOPIC, fake_mqtt.subscription.c_str());
+    TEST_ASSERT_EQUAL_UINT32(1, fake_mqtt.pubacks);
+
+    // the payload is the same document HTTP would have POSTed
+    JsonDocument d;
+    TEST_ASSERT_EQUAL(DeserializationError::Ok, deserializeJson(d, published.c_str()).code);
+    TEST_ASSERT_EQUAL_STRING("Temperature: 21.50°C", d["send_val"].as<const char *>());
+}
+
+void test_session_kept_between_publishes()
+{
+    use_mqtt(1);
+    for (int i = 0; i < 5; i++) {
+        TEST_ASSERT_TRUE(send("x"));
+        poll_for(1000);
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, fake_net.connects);
+    TEST_ASSERT_EQUAL_UINT32(1, fake_mqtt.connects);
+    TEST_ASSERT_EQUAL_UINT32(5, fake_mqtt.publishes);
+    TEST_ASSERT_TRUE(mqtt_connected());
+}
+
+void test_qos0_does_not_wait()
+{
+    use_mqtt(0);
+    TEST_ASSERT_TRUE(send("x")); // connects
+    fake_mqtt.handler = [](const FakeMqttPublish &pub) {
+        TEST_ASSERT_EQUAL_UINT8(0, pub.qos);
+        FakeMqttAck ack;
+        ack.latency_ms = 500;
+        return ack;
+    };
+    uint32_t start = millis();
+    TEST_ASSERT_TRUE(send("x"));
+    TEST_ASSERT_EQUAL_UINT32(0, millis() - start);
+    TEST_ASSERT_EQUAL_UINT32(2, fake_mqtt.publishes);
+    TEST_ASSERT_EQUAL_UINT32(0, fake_mqtt.pubacks);
+}
+
+void test_missing_puback_drops_session()
+{
+    use_mqtt(1);
+    fake_mqtt.handler = [](const FakeMqttPublish &) {
+        FakeMqttAck ack;
+        ack.drop = true;
+        return ack;
+    };
+    uint32_t drops = mqtt_stats().drops;
+    uint32_t start = millis();
+    TEST_ASSERT_FALSE(send("x"));
+    TEST_ASSERT_TRUE(millis() - start >= MQTT_TIMEOUT_MS);
+    TEST_ASSERT_TRUE(millis() - start < MQTT_TIMEOUT_MS + 100);
+    TEST_ASSERT_FALSE(mqtt_connected());
+    TEST_ASSERT_EQUAL_UINT32(drops + 1, mqtt_stats().drops);
+
+    fake_mqtt.handler = nullptr;
+    TEST_ASSERT_TRUE(send("x"));
+    TEST_ASSERT_EQUAL_UINT32(2, fake_mqtt.connects);
+}
+
+void test_broker_reset_fails_the_send()
+{
+    use_mqtt(1);
+    TEST_ASSERT_TRUE(send("x"));
+    fake_mqtt.handler = [](const FakeMqttPublish &) {
+        FakeMqttAck ack;
+        ack.reset = true;
+        return ack;
+    };
+    TEST_ASSERT_FALSE(send("x"));
+    TEST_ASSERT_FALSE(mqtt_connected());
+}
+
+void test_refused_connection()
+{
+    use_mqtt(1);
+    fake_net.server_up = false;
+    uint32_t failures = mqtt_stats().connect_failures;
+    transport_stats_reset();
+    TEST_ASSERT_FALSE(send("x"));
+    TEST_ASSERT_EQUAL_UINT32(failures + 1, mqtt_stats().connect_failures);
+    TEST_ASSERT_EQUAL_UINT32(1, transport_stats().sends);
+    TEST_ASSERT_EQUAL_UINT32(0, transport_stats().delivered);
+}
+
+void test_reply_comes_after_delivery()
+{
+    use_mqtt(1);
+    fake_mqtt.handler = [](const FakeMqttPublish &pub) {
+        FakeMqttAck ack;
+        ack.reply_topic = pub.topic.substr(0, pub.topic.rfind('/')) + "/down";
+        ack.reply = "{\"config_rev\": 7, \"config\": {\"uplink_period\": 60000}}";
+        return ack;
+    };
+    TEST_ASSERT_TRUE(send("x"));
+    TEST_ASSERT_EQUAL_UINT32(1, replies);
+    TEST_ASSERT_EQUAL_STRING("{\"config_rev\": 7, \"config\": {\"uplink_period\": 60000}}", replied.c_str());
+}
+
+void test_push_between_uplinks()
+{
+    use_mqtt(0);
+    TEST_ASSERT_TRUE(send("x"));
+    poll_for(500);
+    uint32_t pushes = mqtt_stats().pushes;
+    TEST_ASSERT_TRUE(fake_mqtt_push(DOWN_TOPIC, "{\"raw_s\": 60}"));
+    TEST_ASSERT_FALSE(fake_mqtt_push("plant/someone-else/down", "{}"));
+    poll_for(500);
+    TEST_ASSERT_EQUAL_UINT32(1, replies);
+    TEST_ASSERT_EQUAL_STRING("{\"raw_s\": 60}", replied.c_str());
+    TEST_ASSERT_EQUAL_UINT32(pushes + 1, mqtt_stats().pushes);
+}
+
+void test_keepalive_ping()
+{
+    use_mqtt(1);
+    TEST_ASSERT_TRUE(send("x"));
+    poll_for(MQTT_KEEPALIVE_S * 500 + 1000);
+    TEST_ASSERT_EQUAL_UINT32(1, fake_mqtt.pings);
+    TEST_ASSERT_TRUE(mqtt_connected());
+
+    // a broker that stops answering is noticed within MQTT_TIMEOUT_MS
+    fake_mqtt.latency_ms = 60000;
+    poll_for(MQTT_KEEPALIVE_S * 500 + MQTT_TIMEOUT_MS);
+    TEST_ASSERT_EQUAL_UINT32(2, fake_mqtt.pings);
+    TEST_ASSERT_FALSE(mqtt_connected());
+}
+
+void test_switching_back_to_http()
+{
+    use_mqtt(1);
+    TEST_ASSERT_TRUE(send("x"));
+    config.transport = TRANSPORT_HTTP;
+    TEST_ASSERT_TRUE(send("x"));
+    TEST_ASSERT_EQUAL_UINT32(1, fake_mqtt.disconnects);
+    TEST_ASSERT_FALSE(mqtt_connected());
+    TEST_ASSERT_EQUAL_UINT32(2, fake_net.requests); // the PUBLISH and the POST
+}
+
+void test_config_validation()
+{
+    DeviceConfig c;
+    config_defaults(c);
+    c.transport = TRANSPORTS;
+    TEST_ASSERT_FALSE(config_validate(c));
+    config_defaults(c);
+    c.mqtt_qos = 2;
+    TEST_ASSERT_FALSE(config_validate(c));
+    config_defaults(c);
+    c.mqtt_port = 0;
+    TEST_ASSERT_FALSE(config_validate(c));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_length_encoding);
+    RUN_TEST(test_http_by_default);
+    RUN_TEST(test_qos1_publish_waits_for_puback);
+    RUN_TEST(test_session_kept_between_publishes);
+    RUN_TEST(test_qos0_does_not_wait);
+    RUN_TEST(test_missing_puback_drops_session);
+    RUN_TEST(test_broker_reset_fails_the_send);
+    RUN_TEST(test_refused_connection);
+    RUN_TEST(test_reply_comes_after_delivery);
+    RUN_TEST(test_push_between_uplinks);
+    RUN_TEST(test_keepalive_ping);
+    RUN_TEST(test_switching_back_to_http);
+    RUN_TEST(test_config_validation);
+    return UNITY_END();
+}
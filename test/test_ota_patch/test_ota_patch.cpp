@@ -0,0 +1,329 @@
+#include <string.h>
+#include <unity.h>
+#include <vector>
+#include "ota_patch.h"
+
+// The old image is a fixed pattern; the fixture is what flask/ota_delta.py's
+// make_patch() produced (inflated) for new_image() below against it:
+//   A 4 | D 204 696 | A 51 | C 0 200 | E
+#define OLD_SIZE 1024
+#define NEW_SIZE 951
+
+static const uint8_t old_sha[32] = {
+    0x95, 0x57, 0xfb, 0xb3, 0x10, 0x24, 0x23, 0x0d, 0x5a, 0xa3, 0xce, 0x5f, 0xf6, 0x24, 0xfd, 0x0d,
+    0x53, 0x74, 0xe1, 0x57, 0x21, 0xd1, 0x35, 0xdc, 0x27, 0xf9, 0x9b, 0xb9, 0x03, 0x1d, 0xc7, 0x59,
+};
+
+static const uint8_t fixture[] = {
+    0x53, 0x53, 0x50, 0x32, 0x00, 0x04, 0x00, 0x00, 0xb7, 0x03, 0x00, 0x00, 0x95, 0x57, 0xfb, 0xb3,
+    0x10, 0x24, 0x23, 0x0d, 0x5a, 0xa3, 0xce, 0x5f, 0xf6, 0x24, 0xfd, 0x0d, 0x53, 0x74, 0xe1, 0x57,
+    0x21, 0xd1, 0x35, 0xdc, 0x27, 0xf9, 0x9b, 0xb9, 0x03, 0x1d, 0xc7, 0x59, 0x56, 0xfe, 0xac, 0xfd,
+    0xa0, 0x54, 0x85, 0xf5, 0x73, 0x00, 0x62, 0xe2, 0xee, 0x04, 0x49, 0xa4, 0xcc, 0x20, 0x6b, 0xd4,
+    0x74, 0x44, 0xc0, 0xee, 0xee, 0xa9, 0x2f, 0xfb, 0xc4, 0x56, 0x3c, 0x44, 0x41, 0x04, 0x00, 0x00,
+    0x00, 0x7c, 0x82, 0x89, 0x90, 0x44, 0xcc, 0x00, 0x00, 0x00, 0xb8, 0x02, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x41, 0x33, 0x00, 0x00, 0x00, 0x6e, 0x65, 0x77, 0x20, 0x73,
+    0x74, 0x72, 0x69, 0x6e, 0x67, 0x20, 0x74, 0x61, 0x62, 0x6c, 0x65, 0x00, 0x6e, 0x65, 0x77, 0x20,
+    0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x20, 0x74, 0x61, 0x62, 0x6c, 0x65, 0x00, 0x6e, 0x65, 0x77,
+    0x20, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67, 0x20, 0x74, 0x61, 0x62, 0x6c, 0x65, 0x00, 0x43, 0x00,
+    0x00, 0x00, 0x00, 0xc8, 0x00, 0x00, 0x00, 0x45,
+};
+
+struct Image {
+    std::vector<uint8_t> old;
+    std::vector<uint8_t> out;
+    bool write_fails = false;
+};
+
+static Image img;
+
+static bool read_old(uint32_t offset, uint8_t *buf, size_t len, void *ctx)
+{
+    Image *i = (Image *)ctx;
+    if (offset + len > i->old.size())
+        return false;
+    memcpy(buf, i->old.data() + offset, len);
+    return true;
+}
+
+static bool write_new(const uint8_t *buf, size_t len, void *ctx)
+{
+    Image *i = (Image *)ctx;
+    if (i->write_fails)
+        return false;
+    i->out.insert(i->out.end(), buf, buf + len);
+    return true;
+}
+
+static std::vector<uint8_t> old_image()
+{
+    std::vector<uint8_t> old(OLD_SIZE);
+    for (int i = 0; i < OLD_SIZE; i++)
+        old[i] = ((i * 7 + 3) & 0xFF) ^ (i >> 8);
+    return old;
+}
+
+// the code moved down, some addresses in it changed, a new string table
+static std::vector<uint8_t> new_image()
+{
+    std::vector<uint8_t> old = old_image();
+    std::vector<uint8_t> img(old.begin() + 200, old.begin() + 900);
+    for (size_t k = 0; k < 700; k += 50)
+        img[k]++;
+    for (int n = 0; n < 3; n++) {
+        static const char s[] = "new string table";
+        img.insert(img.end(), s, s + sizeof(s));
+    }
+    img.insert(img.end(), old.begin(), old.begin() + 200);
+    return img;
+}
+
+static void put_u32(std::vector<uint8_t> &p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++)
+        p.push_back(v >> (8 * i));
+}
+
+// a hand-made patch: header for the fixture's old image, then ops
+static std::vector<uint8_t> header(uint32_t new_size)
+{
+    std::vector<uint8_t> p(OTA_PATCH_MAGIC, OTA_PATCH_MAGIC + 4);
+    put_u32(p, OLD_SIZE);
+    put_u32(p, new_size);
+    p.insert(p.end(), old_sha, old_sha + 32);
+    p.insert(p.end(), 32, 0xAB); // new image hash, not checked here
+    return p;
+}
+
+static OtaPatcher patcher;
+
+static OtaPatchStatus apply(const std::vector<uint8_t> &patch, size_t chunk = 0)
+{
+    patcher.begin(OLD_SIZE, old_sha, read_old, write_new, &img);
+    OtaPatchStatus s = OTA_PATCH_OK;
+    if (chunk == 0)
+        chunk = patch.size();
+    for (size_t i = 0; i < patch.size() && s == OTA_PATCH_OK; i += chunk)
+        s = patcher.feed(patch.data() + i, patch.size() - i < chunk ? patch.size() - i : chunk);
+    return s;
+}
+
+static std::vector<uint8_t> fixture_patch()
+{
+    return std::vector<uint8_t>(fixture, fixture + sizeof(fixture));
+}
+
+void setUp()
+{
+    img = Image();
+    img.old = old_image();
+}
+
+void tearDown() {}
+
+void test_fixture_rebuilds_target()
+{
+    TEST_ASSERT_EQUAL(OTA_PATCH_DONE, apply(fixture_patch()));
+    std::vector<uint8_t> expected = new_image();
+    TEST_ASSERT_EQUAL_size_t(NEW_SIZE, expected.size());
+    TEST_ASSERT_EQUAL_UINT32(NEW_SIZE, patcher.new_size());
+    TEST_ASSERT_EQUAL_UINT32(NEW_SIZE, patcher.written());
+    TEST_ASSERT_EQUAL_size_t(NEW_SIZE, img.out.size());
+    TEST_ASSERT_EQUAL_MEMORY(expected.data(), img.out.data(), NEW_SIZE);
+    // what ota_check() compares the written image's hash with
+    TEST_ASSERT_EQUAL_MEMORY(fixture + 44, patcher.new_sha256(), 32);
+}
+
+void test_fixture_in_any_chunks()
+{
+    std::vector<uint8_t> expected = new_image();
+    for (size_t chunk = 1; chunk <= 77; chunk += 19) {
+        setUp();
+        TEST_ASSERT_EQUAL(OTA_PATCH_DONE, apply(fixture_patch(), chunk));
+        TEST_ASSERT_EQUAL_size_t(NEW_SIZE, img.out.size());
+        TEST_ASSERT_EQUAL_MEMORY(expected.data(), img.out.data(), NEW_SIZE);
+    }
+}
+
+void test_wrong_base_hash()
+{
+    std::vector<uint8_t> p = fixture_patch();
+    p[12 + 31] ^= 1;
+    TEST_ASSERT_EQUAL(OTA_PATCH_WRONG_BASE, apply(p));
+    TEST_ASSERT_EQUAL_size_t(0, img.out.size());
+}
+
+void test_wrong_base_size()
+{
+    patcher.begin(OLD_SIZE - 1, old_sha, read_old, write_new, &img);
+    std::vector<uint8_t> p = fixture_patch();
+    TEST_ASSERT_EQUAL(OTA_PATCH_WRONG_BASE, patcher.feed(p.data(), p.size()));
+    TEST_ASSERT_EQUAL_size_t(0, img.out.size());
+}
+
+void test_bad_magic()
+{
+    std::vector<uint8_t> p = fixture_patch();
+    p[3] = '1'; // the format before the base hash was added
+    TEST_ASSERT_EQUAL(OTA_PATCH_BAD_HEADER, apply(p));
+}
+
+void test_truncated_patch_never_finishes()
+{
+    std::vector<uint8_t> p = fixture_patch();
+    for (size_t cut : {(size_t)10, (size_t)OTA_PATCH_HEADER_LEN, (size_t)200, p.size() - 1}) {
+        setUp();
+        std::vector<uint8_t> part(p.begin(), p.begin() + cut);
+        // OK is "send more"; ota.cpp only takes an image that reached DONE
+        TEST_ASSERT_EQUAL(OTA_PATCH_OK, apply(part));
+        if (cut < p.size() - 1)
+            TEST_ASSERT_TRUE(patcher.written() < NEW_SIZE);
+    }
+}
+
+void test_corrupt_op()
+{
+    std::vector<uint8_t> p = fixture_patch();
+    p[OTA_PATCH_HEADER_LEN] = 'X';
+    TEST_ASSERT_EQUAL(OTA_PATCH_BAD_OP, apply(p));
+}
+
+void test_corrupt_length_runs_out_of_range()
+{
+    std::vector<uint8_t> p = fixture_patch();
+    p[OTA_PATCH_HEADER_LEN + 4] = 0x7F; // the first literal now claims 2 GB
+    TEST_ASSERT_EQUAL(OTA_PATCH_OUT_OF_RANGE, apply(p));
+    TEST_ASSERT_EQUAL_size_t(0, img.out.size());
+}
+
+void test_copy_past_old_image()
+{
+    std::vector<uint8_t> p = header(100);
+    p.push_back('C');
+    put_u32(p, OLD_SIZE - 50);
+    put_u32(p, 100);
+    TEST_ASSERT_EQUAL(OTA_PATCH_OUT_OF_RANGE, apply(p));
+    TEST_ASSERT_EQUAL_size_t(0, img.out.size());
+
+    setUp();
+    p = header(100);
+    p.push_back('D');
+    put_u32(p, 0xFFFFFFF0u); // off + len wraps
+    put_u32(p, 100);
+    TEST_ASSERT_EQUAL(OTA_PATCH_OUT_OF_RANGE, apply(p));
+}
+
+void test_output_overflow()
+{
+    // more than new_size, from any op
+    std::vector<uint8_t> p = header(10);
+    p.push_back('A');
+    put_u32(p, 11);
+    p.insert(p.end(), 11, 'x');
+    TEST_ASSERT_EQUAL(OTA_PATCH_OUT_OF_RANGE, apply(p));
+    TEST_ASSERT_EQUAL_size_t(0, img.out.size());
+
+    setUp();
+    p = header(10);
+    p.push_back('C');
+    put_u32(p, 0);
+    put_u32(p, 6);
+    p.push_back('C');
+    put_u32(p, 0);
+    put_u32(p, 5);
+    TEST_ASSERT_EQUAL(OTA_PATCH_OUT_OF_RANGE, apply(p));
+    TEST_ASSERT_EQUAL_size_t(6, img.out.size());
+
+    // the fixture against a header announcing a smaller image
+    setUp();
+    p = fixture_patch();
+    p[8] = (NEW_SIZE - 1) & 0xFF;
+    TEST_ASSERT_EQUAL(OTA_PATCH_OUT_OF_RANGE, apply(p));
+    TEST_ASSERT_TRUE(img.out.size() < NEW_SIZE);
+}
+
+void test_end_before_image_complete()
+{
+    std::vector<uint8_t> p = header(10);
+    p.push_back('A');
+    put_u32(p, 5);
+    p.insert(p.end(), 5, 'x');
+    p.push_back('E');
+    TEST_ASSERT_EQUAL(OTA_PATCH_OUT_OF_RANGE, apply(p));
+}
+
+void test_trailing_data()
+{
+    std::vector<uint8_t> p = fixture_patch();
+    p.push_back(0);
+    TEST_ASSERT_EQUAL(OTA_PATCH_TRAILING_DATA, apply(p));
+}
+
+void test_write_failure()
+{
+    img.write_fails = true;
+    TEST_ASSERT_EQUAL(OTA_PATCH_IO_ERROR, apply(fixture_patch()));
+    // and it stays failed
+    TEST_ASSERT_EQUAL(OTA_PATCH_IO_ERROR, patcher.feed((const uint8_t *)"E", 1));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_fixture_rebuilds_target);
+    RUN_TEST(test_fixture_in_any_chunks);
+    RUN_TEST(test_wrong_base_hash);
+    RUN_TEST(test_wrong_base_size);
+    RUN_TEST(test_bad_magic);
+    RUN_TEST(test_truncated_patch_never_finishes);
+    RUN_TEST(test_corrupt_op);
+    RUN_TEST(test_corrupt_length_runs_out_of_range);
+    RUN_TEST(test_copy_past_old_image);
+    RUN_TEST(test_output_overflow);
+    RUN_TEST(test_end_before_image_complete);
+    RUN_TEST(test_trailing_data);
+    RUN_TEST(test_write_failure);
+    return UNITY_END();
+}
@@ -0,0 +1,184 @@
+#include <fakes.h>
+#include <unity.h>
+#include "config.h"
+#include "i2c_bus.h"
+#include "plants.h"
+
+static const uint8_t pins[] = {33, 32};
+
+void setUp()
+{
+    fakes_reset();
+    config_defaults(config);
+    i2c_setup();
+    plants_clear();
+}
+
+void tearDown() {}
+
+// n DHT20s behind the muxes, 8 a mux, and nothing straight on the bus
+static void fit(int n)
+{
+    fake_dht.connected = false;
+    for (int i = 0; i < n; i++) {
+        fake_i2c.mux_present[i / 8] = true;
+        fake_dht_mux[i / 8][i % 8].connected = true;
+        fake_dht_mux[i / 8][i % 8].humidity = 10.0f + i;
+    }
+}
+
+// visits every plant once per tick until one comes back fresh or it gives up
+static int next_fresh(uint32_t tick)
+{
+    for (int i = 0; i < 64; i++) {
+        fake_advance_ms(tick);
+        int id = plants_sample_next();
+        if (id >= 0)
+            return id;
+    }
+    return -1;
+}
+
+void test_no_mux_uses_direct_sensor()
+{
+    TEST_ASSERT_EQUAL_size_t(1, plants_discover(pins, 2, millis()));
+    TEST_ASSERT_EQUAL_UINT8(PLANT_NO_MUX, plant_at(0).wiring.mux);
+    TEST_ASSERT_EQUAL_UINT8(33, plant_at(0).wiring.light_pin);
+    TEST_ASSERT_TRUE(plant_at(0).present);
+}
+
+void test_discovers_mux_channels()
+{
+    fit(3);
+    fake_dht_mux[1][5].connected = true; // second shelf
+    fake_i2c.mux_present[1] = true;
+    TEST_ASSERT_EQUAL_size_t(4, plants_discover(pins, 2, millis()));
+    TEST_ASSERT_EQUAL_UINT8(0x70, plant_at(2).wiring.mux);
+    TEST_ASSERT_EQUAL_UINT8(2, plant_at(2).wiring.channel);
+    TEST_ASSERT_EQUAL_UINT8(0x71, plant_at(3).wiring.mux);
+    TEST_ASSERT_EQUAL_UINT8(5, plant_at(3).wiring.channel);
+    // shelves take turns on the light pins
+    TEST_ASSERT_EQUAL_UINT8(33, plant_at(0).wiring.light_pin);
+    TEST_ASSERT_EQUAL_UINT8(32, plant_at(3).wiring.light_pin);
+}
+
+void test_round_robin_reads_each_plant()
+{
+    fit(3);
+    plants_discover(pins, 2, millis());
+    uint32_t tick = plants_tick(1000);
+    // conversions were started at discovery, so the first lap already reads
+    for (int i = 0; i < 3; i++)
+        TEST_ASSERT_EQUAL_INT(i, next_fresh(tick));
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL_INT(i, next_fresh(tick));
+        TEST_ASSERT_FLOAT_WITHIN(0.001, 10.0f + i, plant_at(i).last.moisture); // 20-bit on the wire
+    }
+    TEST_ASSERT_EQUAL_UINT32(2, plant_at(1).reads);
+}
+
+void test_visit_never_waits_for_conversion()
+{
+    fit(1);
+    plants_discover(pins, 2, millis());
+    fake_advance_ms(1000);
+    uint64_t before = fake_now_us;
+    TEST_ASSERT_EQUAL_INT(0, plants_sample_next());
+    // mux select, 7-byte read and 3-byte trigger at 400 kHz, no waiting
+    TEST_ASSERT_TRUE(fake_now_us - before < 400);
+    // straight back: the conversion it just started isn't done yet
+    TEST_ASSERT_EQUAL_INT(-1, plants_sample_next());
+    fake_advance_ms(80);
+    TEST_ASSERT_EQUAL_INT(0, plants_sample_next());
+}
+
+void test_other_mux_closed_before_select()
+{
+    // same channel on two muxes: both sensors answer if both stay open
+    fake_dht.connected = false;
+    fake_i2c.mux_present[0] = fake_i2c.mux_present[1] = true;
+    fake_dht_mux[0][0].connected = fake_dht_mux[1][0].connected = true;
+    TEST_ASSERT_EQUAL_size_t(2, plants_discover(pins, 2, millis()));
+    for (int lap = 0; lap < 4; lap++) {
+        next_fresh(500);
+        TEST_ASSERT_TRUE(fake_i2c.mux_select[0] == 0 || fake_i2c.mux_select[1] == 0);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, plant_at(0).errors);
+    TEST_ASSERT_EQUAL_UINT32(0, plant_at(1).errors);
+}
+
+void test_missing_sensor_is_skipped()
+{
+    fit(2);
+    plants_discover(pins, 2, millis());
+    fake_dht_mux[0][0].connected = false; // unplugged
+    TEST_ASSERT_EQUAL_INT(1, next_fresh(500));
+    TEST_ASSERT_EQUAL_INT(1, next_fresh(500));
+    fake_dht_mux[0][0].connected = true; // and back
+    fake_advance_ms(500);
+    plants_sample_next(); // starts a conversion
+    TEST_ASSERT_EQUAL_INT(1, next_fresh(500));
+    TEST_ASSERT_EQUAL_INT(0, next_fresh(500));
+}
+
+void test_per_plant_state()
+{
+    fit(2);
+    plants_discover(pins, 2, millis());
+    TEST_ASSERT_EQUAL_size_t(config.periods_stored, plant_at(1).prediction.capacity);
+    TEST_ASSERT_FALSE(plant_at(0).deadband.primed);
+    int id = plants_add({0x72, 4, 32}, millis());
+    TEST_ASSERT_EQUAL_INT(2, id);
+    TEST_ASSERT_FALSE(plant_at(2).present); // no mux at 0x72
+}
+
+void test_registry_full()
+{
+    for (int i = 0; i < PLANTS_MAX; i++)
+        TEST_ASSERT_EQUAL_INT(i, plants_add({PLANT_NO_MUX, 0, 33}, 0));
+    TEST_ASSERT_EQUAL_INT(-1, plants_add({PLANT_NO_MUX, 0, 33}, 0));
+}
+
+void test_tick()
+{
+    fit(4);
+    plants_discover(pins, 2, millis());
+    TEST_ASSERT_EQUAL_UINT32(250, plants_tick(1000));
+    plants_clear();
+    TEST_ASSERT_EQUAL_UINT32(1000, plants_tick(1000));
+    for (int i = 0; i < PLANTS_MAX; i++)
+        plants_add({PLANT_NO_MUX, 0, 33}, 0);
+    TEST_ASSERT_EQUAL_UINT32(PLANT_TICK_MIN, plants_tick(500));
+}
+
+void test_nvs_key()
+{
+    char key[16];
+    fit(1);
+    fake_dht_mux[0][7].connected = true;
+    plants_discover(pins, 2, millis());
+    plant_nvs_key(plant_at(1), key, sizeof(key));
+    TEST_ASSERT_EQUAL_STRING("periods_70_7", key);
+    plants_clear();
+    fake_dht.connected = true;
+    fake_i2c.mux_present[0] = false;
+    plants_discover(pins, 2, millis());
+    plant_nvs_key(plant_at(0), key, sizeof(key));
+    TEST_ASSERT_EQUAL_STRING("periods", key); // what the single-pot board always used
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_no_mux_uses_direct_sensor);
+    RUN_TEST(test_discovers_mux_channels);
+    RUN_TEST(test_round_robin_reads_each_plant);
+    RUN_TEST(test_visit_never_waits_for_conversion);
+    RUN_TEST(test_other_mux_closed_before_select);
+    RUN_TEST(test_missing_sensor_is_skipped);
+    RUN_TEST(test_per_plant_state);
+    RUN_TEST(test_registry_full);
+    RUN_TEST(test_tick);
+    RUN_TEST(test_nvs_key);
+    return UNITY_END();
+}
@@ -0,0 +1,151 @@
+#include <unity.h>
+#include "prediction.h"
+
+#define DAY 86400000UL
+
+static Prediction p;
+
+void setUp()
+{
+    prediction_init(p, 5, 0);
+}
+
+void tearDown() {}
+
+// watered at `start`, dry (below 60%) `period` later
+static uint32_t cycle(uint32_t start, uint32_t period)
+{
+    prediction_sample(p, 100, 60, start);
+    prediction_sample(p, 80, 60, start + period / 2);
+    prediction_sample(p, 50, 60, start + period);
+    return start + period;
+}
+
+void test_no_history_no_countdown()
+{
+    prediction_sample(p, 100, 60, 1000);
+    TEST_ASSERT_TRUE(p.predicted);
+    TEST_ASSERT_EQUAL_UINT32(0, p.millis_left);
+    TEST_ASSERT_EQUAL_UINT32(0, prediction_average(p));
+}
+
+void test_records_drying_period()
+{
+    cycle(0, 3 * DAY);
+    TEST_ASSERT_EQUAL_size_t(1, p.count);
+    TEST_ASSERT_EQUAL_UINT32(3 * DAY, p.periods[0]);
+    TEST_ASSERT_TRUE(p.dirty);
+}
+
+void test_one_period_per_cycle()
+{
+    cycle(0, 2 * DAY);
+    // still dry on the next samples, nothing new until it's watered again
+    prediction_sample(p, 45, 60, 2 * DAY + 1000);
+    prediction_sample(p, 40, 60, 3 * DAY);
+    TEST_ASSERT_EQUAL_size_t(1, p.count);
+}
+
+void test_watering_starts_countdown_from_average()
+{
+    uint32_t t = cycle(0, 2 * DAY);
+    t = cycle(t, 4 * DAY);
+    prediction_sample(p, 100, 60, t + 1000);
+    TEST_ASSERT_EQUAL_UINT32(3 * DAY, p.millis_left);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 3.0f, p.days_left);
+}
+
+// the DHT20 saturates at its top code, 0xFFFFF, never a full 100.00%
+#define SATURATED (0xFFFFF * 100.0f / 0x100000)
+
+void test_saturated_reading_is_a_watering()
+{
+    prediction_sample(p, SATURATED, 60, 0);
+    TEST_ASSERT_TRUE(p.predicted);
+    prediction_sample(p, 50, 60, 2 * DAY);
+    TEST_ASSERT_EQUAL_size_t(1, p.count);
+    prediction_sample(p, SATURATED, 60, 2 * DAY + 1000);
+    TEST_ASSERT_EQUAL_UINT32(2 * DAY + 1000, p.last_watered);
+    TEST_ASSERT_EQUAL_UINT32(2 * DAY, p.millis_left);
+}
+
+void test_countdown_decrements_and_stops_at_zero()
+{
+    uint32_t t = cycle(0, DAY);
+    prediction_sample(p, 100, 60, t);
+    prediction_sample(p, 90, 60, t + DAY / 4);
+    TEST_ASSERT_EQUAL_UINT32(DAY * 3 / 4, p.millis_left);
+    prediction_sample(p, 70, 60, t + 2 * DAY);
+    TEST_ASSERT_EQUAL_UINT32(0, p.millis_left);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, p.days_left);
+}
+
+void test_countdown_from_stored_history()
+{
+    const uint32_t stored[] = {2 * DAY, 4 * DAY};
+    prediction_load(p, stored, 2);
+    prediction_sample(p, 100, 60, 1000);
+    TEST_ASSERT_EQUAL_UINT32(3 * DAY, p.millis_left);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 3.0f, p.days_left);
+    prediction_sample(p, 90, 60, 1000 + DAY);
+    TEST_ASSERT_EQUAL_UINT32(2 * DAY, p.millis_left);
+    prediction_sample(p, 70, 60, 1000 + 4 * DAY);
+    TEST_ASSERT_EQUAL_UINT32(0, p.millis_left);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, p.days_left);
+}
+
+void test_oldest_period_dropped_at_capacity()
+{
+    prediction_set_capacity(p, 2);
+    uint32_t t = cycle(0, 1 * DAY);
+    t = cycle(t, 2 * DAY);
+    t = cycle(t, 4 * DAY);
+    TEST_ASSERT_EQUAL_size_t(2, p.count);
+    TEST_ASSERT_EQUAL_UINT32(2 * DAY, p.periods[0]);
+    TEST_ASSERT_EQUAL_UINT32(4 * DAY, p.periods[1]);
+}
+
+void test_capacity_shrink_trims_history()
+{
+    uint32_t t = 0;
+    for (int i = 1; i <= 4; i++)
+        t = cycle(t, i * DAY);
+    p.dirty = false;
+    prediction_set_capacity(p, 2);
+    TEST_ASSERT_EQUAL_size_t(2, p.count);
+    TEST_ASSERT_EQUAL_UINT32(3 * DAY, p.periods[0]);
+    TEST_ASSERT_TRUE(p.dirty);
+}
+
+void test_load_respects_capacity()
+{
+    const uint32_t stored[] = {1, 2, 3, 4, 5, 6, 7};
+    prediction_load(p, stored, 7);
+    TEST_ASSERT_EQUAL_size_t(5, p.count);
+    TEST_ASSERT_EQUAL_UINT32(3, prediction_average(p));
+    TEST_ASSERT_FALSE(p.dirty);
+}
+
+void test_period_across_millis_wrap()
+{
+    prediction_init(p, 5, 0xFFFF0000u);
+    cycle(0xFFFF0000u, DAY); // ends after millis() wrapped
+    TEST_ASSERT_EQUAL_UINT32(DAY, p.periods[0]);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_no_history_no_countdown);
+    RUN_TEST(test_records_drying_period);
+    RUN_TEST(test_one_period_per_cycle);
+    RUN_TEST(test_watering_starts_countdown_from_average);
+    RUN_TEST(test_saturated_reading_is_a_watering);
+    RUN_TEST(test_countdown_decrements_and_stops_at_zero);
+    RUN_TEST(test_countdown_from_stored_history);
+    RUN_TEST(test_oldest_period_dropped_at_capacity);
+    RUN_TEST(test_capacity_shrink_trims_history);
+    RUN_TEST(test_load_respects_capacity);
+    RUN_TEST(test_period_across_millis_wrap);
+    return UNITY_END();
+}
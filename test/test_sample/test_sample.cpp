@@ -0,0 +1,71 @@
+#include <string.h>
+#include <unity.h>
+#include "config.h"
+#include "sample.h"
+
+void setUp()
+{
+    config_defaults(config); // lux calibration
+}
+
+void tearDown() {}
+
+static SensorData reading(float temp, float moisture, int light)
+{
+    SensorData s;
+    s.temp = temp;
+    s.moisture = moisture;
+    s.light = light;
+    s.valid = true;
+    return s;
+}
+
+void test_light_percent_matches_map()
+{
+    TEST_ASSERT_EQUAL_INT(0, light_percent(0));
+    TEST_ASSERT_EQUAL_INT(100, light_percent(4095));
+    TEST_ASSERT_EQUAL_INT(49, light_percent(2047)); // map() truncates
+}
+
+void test_message_format()
+{
+    char buf[SAMPLE_MSG_MAX];
+    size_t n = sample_message(reading(21.5f, 55.0f, 3000), 60, 2500, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING("Temperature: 21.50°C / 70.70°F, Low Moisture: 55.00%, Light: 73% (101 lx)", buf);
+    TEST_ASSERT_EQUAL_size_t(strlen(buf), n);
+}
+
+void test_message_low_light()
+{
+    char buf[SAMPLE_MSG_MAX];
+    sample_message(reading(-3.25f, 80.0f, 100), 60, 2500, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING("Temperature: -3.25°C / 26.15°F, Moisture: 80.00%, Low Light: 2% (0 lx)", buf);
+}
+
+void test_message_worst_case_fits()
+{
+    // widest values the DHT20/ADC can produce
+    char buf[SAMPLE_MSG_MAX];
+    config.lux_gain = 10000;
+    size_t n = sample_message(reading(-40.0f, 99.99f, 4094), 100, 4095, buf, sizeof(buf));
+    TEST_ASSERT_TRUE(n < SAMPLE_MSG_MAX - 1);
+}
+
+void test_message_truncates()
+{
+    char buf[16];
+    size_t n = sample_message(reading(21.5f, 55.0f, 3000), 60, 2500, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_size_t(15, n);
+    TEST_ASSERT_EQUAL_STRING("Temperature: 21", buf);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_light_percent_matches_map);
+    RUN_TEST(test_message_format);
+    RUN_TEST(test_message_low_light);
+    RUN_TEST(test_message_worst_case_fits);
+    RUN_TEST(test_message_truncates);
+    return UNITY_END();
+}
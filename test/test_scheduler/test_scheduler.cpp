@@ -0,0 +1,183 @@
+#include <unity.h>
+#include "scheduler.h"
+
+static uint32_t a_runs, b_runs;
+static Scheduler *current; // for jobs that touch the scheduler they run in
+static int self_id;
+
+static void job_a()
+{
+    a_runs++;
+}
+
+static void job_b()
+{
+    b_runs++;
+}
+
+static void job_cancels_itself()
+{
+    a_runs++;
+    current->cancel(self_id);
+}
+
+void setUp()
+{
+    a_runs = b_runs = 0;
+}
+
+void tearDown() {}
+
+void test_before_across_wrap()
+{
+    TEST_ASSERT_TRUE(sched_before(10, 20));
+    TEST_ASSERT_FALSE(sched_before(20, 10));
+    TEST_ASSERT_FALSE(sched_before(20, 20));
+    // 0xFFFFFFF0 is 0x20 ms before 0x10, once millis() has wrapped
+    TEST_ASSERT_TRUE(sched_before(0xFFFFFFF0u, 0x10));
+    TEST_ASSERT_FALSE(sched_before(0x10, 0xFFFFFFF0u));
+}
+
+void test_runs_across_wrap()
+{
+    Scheduler s;
+    uint32_t now = 0xFFFFFFA0u; // 96 ms before millis() wraps
+    int id = s.add("a", job_a, 100, 50, now);
+    TEST_ASSERT_EQUAL_UINT32(0xFFFFFFD2u, s.job(id).deadline);
+    s.run_due(now + 49);
+    TEST_ASSERT_EQUAL_UINT32(0, a_runs);
+    s.run_due(now + 50);
+    TEST_ASSERT_EQUAL_UINT32(1, a_runs);
+    // the next deadline is past the wrap and still 100 ms away, not "overdue"
+    TEST_ASSERT_EQUAL_UINT32(0x36u, s.job(id).deadline);
+    TEST_ASSERT_EQUAL_UINT32(100, s.time_until_next(now + 50));
+    s.run_due(now + 120); // wrapped, 30 ms early
+    TEST_ASSERT_EQUAL_UINT32(1, a_runs);
+    TEST_ASSERT_EQUAL_UINT32(0, s.job(id).skipped);
+    s.run_due(now + 150);
+    TEST_ASSERT_EQUAL_UINT32(2, a_runs);
+}
+
+void test_runs_in_deadline_order()
+{
+    Scheduler s;
+    s.add("a", job_a, 300, 300, 0);
+    s.add("b", job_b, 100, 100, 0);
+    TEST_ASSERT_EQUAL_UINT32(100, s.run_due(0));
+    TEST_ASSERT_EQUAL_UINT32(100, s.run_due(100));
+    TEST_ASSERT_EQUAL_UINT32(1, b_runs);
+    TEST_ASSERT_EQUAL_UINT32(0, a_runs);
+    s.run_due(300);
+    TEST_ASSERT_EQUAL_UINT32(1, a_runs);
+    TEST_ASSERT_EQUAL_UINT32(2, b_runs);
+}
+
+void test_late_job_runs_once()
+{
+    Scheduler s;
+    int id = s.add("a", job_a, 100, 100, 0);
+    // loop() was stuck for 5.5 periods: one run, the backlog skipped
+    s.run_due(650);
+    TEST_ASSERT_EQUAL_UINT32(1, a_runs);
+    TEST_ASSERT_EQUAL_UINT32(5, s.job(id).skipped);
+    // and it stays on its original grid
+    TEST_ASSERT_EQUAL_UINT32(700, s.job(id).deadline);
+    TEST_ASSERT_EQUAL_UINT32(50, s.run_due(650));
+    TEST_ASSERT_EQUAL_UINT32(1, a_runs);
+}
+
+void test_set_period_on_queued_job()
+{
+    Scheduler s;
+    int a = s.add("a", job_a, 1000, 1000, 0);
+    s.add("b", job_b, 500, 500, 0);
+
+    // shorter: pulled in, ahead of b
+    s.set_period(a, 200, 100);
+    TEST_ASSERT_EQUAL_UINT32(300, s.job(a).deadline);
+    TEST_ASSERT_EQUAL_UINT32(200, s.time_until_next(100));
+    s.run_due(300);
+    TEST_ASSERT_EQUAL_UINT32(1, a_runs);
+    TEST_ASSERT_EQUAL_UINT32(0, b_runs);
+    TEST_ASSERT_EQUAL_UINT32(500, s.job(a).deadline);
+
+    // longer: the run already due stays, the one after moves
+    s.set_period(a, 1000, 300);
+    TEST_ASSERT_EQUAL_UINT32(500, s.job(a).deadline);
+    s.run_due(500);
+    TEST_ASSERT_EQUAL_UINT32(2, a_runs);
+    TEST_ASSERT_EQUAL_UINT32(1, b_runs);
+    TEST_ASSERT_EQUAL_UINT32(1500, s.job(a).deadline);
+}
+
+void test_cancel_queued_job()
+{
+    Scheduler s;
+    int a = s.add("a", job_a, 100, 100, 0);
+    s.add("b", job_b, 300, 300, 0);
+    s.cancel(a);
+    TEST_ASSERT_FALSE(s.job(a).active);
+    TEST_ASSERT_EQUAL_UINT32(300, s.time_until_next(0));
+    s.run_due(1000);
+    TEST_ASSERT_EQUAL_UINT32(0, a_runs);
+    TEST_ASSERT_EQUAL_UINT32(1, b_runs);
+
+    // re-armed later, it runs again
+    s.run_at(a, 1050);
+    TEST_ASSERT_EQUAL_UINT32(50, s.time_until_next(1000));
+    s.run_due(1050);
+    TEST_ASSERT_EQUAL_UINT32(1, a_runs);
+}
+
+void test_job_cancelling_itself()
+{
+    Scheduler s;
+    current = &s;
+    self_id = s.add("a", job_cancels_itself, 100, 100, 0);
+    s.run_due(100);
+    s.run_due(1000);
+    TEST_ASSERT_EQUAL_UINT32(1, a_runs);
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, s.time_until_next(1000));
+}
+
+void test_wait_until_next()
+{
+    Scheduler s;
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, s.time_until_next(0));
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, s.run_due(0));
+    s.add("a", job_a, 1000, 250, 0);
+    s.add("once", job_b, 0, 40, 0);
+    TEST_ASSERT_EQUAL_UINT32(40, s.run_due(0));
+    TEST_ASSERT_EQUAL_UINT32(30, s.time_until_next(10));
+    TEST_ASSERT_EQUAL_UINT32(0, s.time_until_next(60)); // overdue
+    // the one-shot is gone once it has run
+    TEST_ASSERT_EQUAL_UINT32(190, s.run_due(60));
+    TEST_ASSERT_EQUAL_UINT32(1, b_runs);
+    TEST_ASSERT_EQUAL_UINT32(1000, s.run_due(250));
+}
+
+void test_table_full()
+{
+    Scheduler s;
+    for (int i = 0; i < SCHED_MAX_JOBS; i++)
+        TEST_ASSERT_EQUAL_INT(i, s.add("a", job_a, 100, 0, 0));
+    TEST_ASSERT_EQUAL_INT(-1, s.add("a", job_a, 100, 0, 0));
+    // all due at once: each runs once
+    s.run_due(0);
+    TEST_ASSERT_EQUAL_UINT32(SCHED_MAX_JOBS, a_runs);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_before_across_wrap);
+    RUN_TEST(test_runs_across_wrap);
+    RUN_TEST(test_runs_in_deadline_order);
+    RUN_TEST(test_late_job_runs_once);
+    RUN_TEST(test_set_period_on_queued_job);
+    RUN_TEST(test_cancel_queued_job);
+    RUN_TEST(test_job_cancelling_itself);
+    RUN_TEST(test_wait_until_next);
+    RUN_TEST(test_table_full);
+    return UNITY_END();
+}
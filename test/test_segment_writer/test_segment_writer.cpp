@@ -0,0 +1,98 @@
+#include <ArduinoJson.h>
+#include <fakes.h>
+#include <string>
+#include <unity.h>
+#include "segment_writer.h"
+
+static WiFiClient client;
+static std::string seen; // bodies the stand-in server received
+
+void setUp()
+{
+    fakes_reset();
+    WiFi.begin("ssid", "pass");
+    delay(fake_net.associate_ms);
+    seen.clear();
+    fake_net.handler = [](const FakeHttpRequest &req) {
+        seen = req.body;
+        return FakeHttpResponse();
+    };
+    TEST_ASSERT_TRUE(client.connect("server", 5000));
+}
+
+void tearDown()
+{
+    client.stop();
+}
+
+static void head(SegmentWriter &out, size_t body_len)
+{
+    char h[96];
+    snprintf(h, sizeof(h), "POST /submit HTTP/1.1\r\nContent-Length: %u\r\n\r\n", (unsigned)body_len);
+    out.print(h);
+}
+
+void test_small_writes_share_a_segment()
+{
+    SegmentWriter out(client);
+    head(out, 10);
+    for (int i = 0; i < 10; i++)
+        out.write((uint8_t)('0' + i));
+    TEST_ASSERT_EQUAL_UINT32(0, fake_net.writes); // nothing sent until flush
+    TEST_ASSERT_TRUE(out.flush());
+    TEST_ASSERT_EQUAL_UINT32(1, fake_net.writes);
+    TEST_ASSERT_EQUAL_STRING("0123456789", seen.c_str());
+}
+
+void test_byte_stream_fills_whole_segments()
+{
+    const size_t body = 2 * TCP_SEGMENT + 100;
+    SegmentWriter out(client);
+    head(out, body);
+    size_t total = out.written() + body;
+    for (size_t i = 0; i < body; i++)
+        out.write((uint8_t)'a' + i % 26);
+    TEST_ASSERT_TRUE(out.flush());
+    TEST_ASSERT_EQUAL_size_t(total, out.written());
+    TEST_ASSERT_EQUAL_UINT32((total + TCP_SEGMENT - 1) / TCP_SEGMENT, fake_net.writes);
+    TEST_ASSERT_EQUAL_size_t(body, seen.size());
+    TEST_ASSERT_EQUAL_UINT64(total, fake_net.bytes_out);
+}
+
+void test_json_streams_without_a_copy()
+{
+    JsonDocument doc;
+    doc["send_val"] = "Temperature: 21.50°C / 70.70°F, Moisture: 55.00%, Light: 73%";
+    JsonArray b = doc["b"].to<JsonArray>();
+    for (int i = 0; i < 400; i++)
+        b.add(i);
+    size_t len = measureJson(doc);
+
+    SegmentWriter out(client);
+    head(out, len);
+    TEST_ASSERT_EQUAL_size_t(len, serializeJson(doc, out));
+    TEST_ASSERT_TRUE(out.flush());
+    std::string expect;
+    serializeJson(doc, expect);
+    TEST_ASSERT_EQUAL_STRING(expect.c_str(), seen.c_str());
+    TEST_ASSERT_EQUAL_UINT32(out.sent_segments(), fake_net.writes);
+}
+
+void test_closed_connection_fails()
+{
+    client.stop();
+    SegmentWriter out(client);
+    out.print("POST /submit HTTP/1.1\r\n");
+    TEST_ASSERT_FALSE(out.flush());
+    TEST_ASSERT_FALSE(out.ok());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_small_writes_share_a_segment);
+    RUN_TEST(test_byte_stream_fills_whole_segments);
+    RUN_TEST(test_json_streams_without_a_copy);
+    RUN_TEST(test_closed_connection_fails);
+    return UNITY_END();
+}
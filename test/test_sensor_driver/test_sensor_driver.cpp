@@ -0,0 +1,142 @@
+#include <fakes.h>
+#include <type_traits>
+#include <unity.h>
+#include "sensor_driver.h"
+
+// Drivers with scripted behaviour: the pipeline compiles against these the
+// same way it does against sensor_drivers.h
+struct MockClimate : SensorDriver<MockClimate> {
+    bool answers = true, bad_reading = false;
+    uint32_t conversion_ms = 80, started_at = 0;
+    int starts = 0, fetches = 0;
+    float temp = 20.0f;
+
+    bool begin() { return answers; }
+    bool start()
+    {
+        if (!answers)
+            return false;
+        started_at = millis();
+        starts++;
+        return true;
+    }
+    bool busy() { return millis() - started_at < conversion_ms; }
+    bool fetch(SensorData &s)
+    {
+        fetches++;
+        if (!answers || bad_reading)
+            return false;
+        s.temp = temp;
+        s.moisture = 50.0f;
+        return true;
+    }
+};
+
+struct MockLight : SensorDriver<MockLight> {
+    int raw = 1234;
+
+    bool begin() { return true; }
+    bool start() { return true; }
+    bool busy() { return false; }
+    bool fetch(SensorData &s)
+    {
+        s.light = raw;
+        return true;
+    }
+};
+
+typedef SensorPipeline<MockClimate, MockLight> Pipeline;
+
+// nothing to dispatch at runtime: no vtable, no bigger than its parts
+static_assert(!std::is_polymorphic<Pipeline>::value, "drivers must not be virtual");
+static_assert(!std::is_polymorphic<MockClimate>::value, "drivers must not be virtual");
+
+static Pipeline p;
+static SensorData s;
+
+void setUp()
+{
+    fakes_reset();
+    p = Pipeline();
+    s = SensorData();
+}
+
+void tearDown() {}
+
+void test_first_poll_starts_conversion()
+{
+    TEST_ASSERT_TRUE(p.begin());
+    TEST_ASSERT_EQUAL(SENSOR_IDLE, p.poll(s));
+    TEST_ASSERT_TRUE(p.climate.converting());
+    TEST_ASSERT_FALSE(s.valid);
+    TEST_ASSERT_EQUAL_INT(1234, s.light); // light has no conversion to wait for
+}
+
+void test_collects_then_restarts()
+{
+    p.begin();
+    p.poll(s);
+    fake_advance_ms(80);
+    p.light.raw = 99;
+    TEST_ASSERT_EQUAL(SENSOR_FRESH, p.poll(s));
+    TEST_ASSERT_TRUE(s.valid);
+    TEST_ASSERT_EQUAL_FLOAT(20.0f, s.temp);
+    TEST_ASSERT_EQUAL_INT(99, s.light);
+    TEST_ASSERT_EQUAL_INT(2, p.climate.starts);
+}
+
+void test_never_waits()
+{
+    p.begin();
+    p.poll(s);
+    uint64_t before = fake_now_us;
+    fake_advance_ms(40);
+    TEST_ASSERT_EQUAL(SENSOR_IDLE, p.poll(s));
+    TEST_ASSERT_EQUAL_UINT64(before + 40000, fake_now_us);
+    // the running conversion isn't restarted by an early poll
+    TEST_ASSERT_EQUAL_INT(1, p.climate.starts);
+    fake_advance_ms(40);
+    TEST_ASSERT_EQUAL(SENSOR_FRESH, p.poll(s));
+}
+
+void test_errors()
+{
+    p.begin();
+    p.poll(s);
+    fake_advance_ms(100);
+    p.climate.bad_reading = true;
+    TEST_ASSERT_EQUAL(SENSOR_ERROR, p.poll(s));
+    TEST_ASSERT_FALSE(s.valid);
+    p.climate.answers = false; // unplugged
+    fake_advance_ms(100);
+    TEST_ASSERT_EQUAL(SENSOR_ERROR, p.poll(s));
+    TEST_ASSERT_FALSE(p.climate.converting());
+    TEST_ASSERT_EQUAL(SENSOR_ERROR, p.poll(s));
+    p.climate.answers = true;
+    p.climate.bad_reading = false;
+    TEST_ASSERT_EQUAL(SENSOR_IDLE, p.poll(s));
+    fake_advance_ms(100);
+    TEST_ASSERT_EQUAL(SENSOR_FRESH, p.poll(s));
+}
+
+void test_abandon_restarts()
+{
+    p.begin();
+    p.poll(s);
+    p.climate.abandon();
+    fake_advance_ms(100);
+    TEST_ASSERT_EQUAL(SENSOR_IDLE, p.poll(s));
+    TEST_ASSERT_EQUAL_INT(0, p.climate.fetches);
+    TEST_ASSERT_EQUAL_INT(2, p.climate.starts);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_first_poll_starts_conversion);
+    RUN_TEST(test_collects_then_restarts);
+    RUN_TEST(test_never_waits);
+    RUN_TEST(test_errors);
+    RUN_TEST(test_abandon_restarts);
+    return UNITY_END();
+}
@@ -0,0 +1,269 @@
+#include <fakes.h>
+#include <string>
+#include <unity.h>
+#include "config.h"
+#include "http_response.h"
+#include "tls_client.h"
+#include "transport.h"
+#include "uplink.h"
+#include "wifi_manager.h"
+
+#define HOST "3.149.230.7"
+
+static std::string replied;
+static uint32_t replies;
+
+static void on_reply(const char *body, size_t len)
+{
+    replied.assign(body, len);
+    replies++;
+}
+
+void setUp()
+{
+    config.transport = TRANSPORT_HTTP;
+    transport_current(); // closes the connection the last test left open
+    fakes_reset();
+    config_defaults(config);
+    fake_tls.ca_pem = TLS_CA_PEM;
+    nvs_handle_t h;
+    nvs_open("storage", NVS_READWRITE, &h);
+    nvs_set_str(h, "ssid", "greenhouse");
+    nvs_set_str(h, "pass", "succulent");
+    nvs_close(h);
+    wifi_setup();
+    while (!wifi_connected()) {
+        delay(50);
+        wifi_loop();
+    }
+    replied.clear();
+    replies = 0;
+    transport_on_reply(on_reply);
+}
+
+void tearDown() {}
+
+static void use_https()
+{
+    config.transport = TRANSPORT_HTTPS;
+    config.tls_port = TLS_DEFAULT_PORT;
+}
+
+static bool send(const char *msg)
+{
+    size_t n = uplink_build(msg, nullptr, millis());
+    TEST_ASSERT_TRUE(n > 0);
+    return transport_send(n);
+}
+
+static void poll_for(uint32_t ms)
+{
+    uint32_t start = millis();
+    while (millis() - start < ms) {
+        transport_poll(millis());
+        delay(TRANSPORT_POLL_PERIOD);
+    }
+}
+
+// one GET over c, as the server sees it
+static int get(TlsClient &c)
+{
+    static const char req[] = "GET /config HTTP/1.1\r\nHost: " HOST "\r\nConnection: keep-alive\r\n\r\n";
+    TEST_ASSERT_EQUAL_size_t(sizeof(req) - 1, c.write((const uint8_t *)req, sizeof(req) - 1));
+    char buf[256];
+    HttpResponse resp;
+    return http_read_response(c, buf, sizeof(buf), HTTP_RESPONSE_TIMEOUT, resp);
+}
+
+void test_full_handshake_then_request()
+{
+    TlsClient c;
+    TEST_ASSERT_TRUE(c.begin(TLS_CA_PEM));
+    uint32_t start = millis();
+    TEST_ASSERT_EQUAL_INT(1, c.connect(HOST, TLS_DEFAULT_PORT));
+    // two round trips and the certificate verify
+    TEST_ASSERT_TRUE(millis() - start >= 2 * fake_tls.latency_ms + fake_tls.full_cpu_us / 1000);
+    TEST_ASSERT_FALSE(c.resumed());
+    TEST_ASSERT_EQUAL_UINT32(1, c.stats().handshakes);
+    TEST_ASSERT_EQUAL_UINT32(1, fake_tls.full_handshakes);
+    TEST_ASSERT_TRUE(c.connected());
+
+    TEST_ASSERT_EQUAL_INT(200, get(c));
+    TEST_ASSERT_EQUAL_INT(200, get(c)); // same connection
+    TEST_ASSERT_EQUAL_UINT32(2, fake_net.requests);
+    TEST_ASSERT_EQUAL_UINT32(1, fake_net.connects);
+}
+
+void test_reconnect_resumes_the_session()
+{
+    TlsClient c;
+    c.begin(TLS_CA_PEM);
+    TEST_ASSERT_EQUAL_INT(1, c.connect(HOST, TLS_DEFAULT_PORT));
+    uint32_t full_us = c.stats().handshake_us;
+    c.stop();
+
+    uint64_t cpu = fake_tls.cpu_us;
+    TEST_ASSERT_EQUAL_INT(1, c.connect(HOST, TLS_DEFAULT_PORT));
+    TEST_ASSERT_TRUE(c.resumed());
+    TEST_ASSERT_EQUAL_UINT32(1, c.stats().resumed);
+    TEST_ASSERT_EQUAL_UINT32(1, fake_tls.resumed_handshakes);
+    TEST_ASSERT_EQUAL_UINT64(fake_tls.resume_cpu_us, fake_tls.cpu_us - cpu);
+    TEST_ASSERT_TRUE(c.stats().handshake_us - full_us < full_us / 10);
+    TEST_ASSERT_EQUAL_INT(200, get(c));
+
+    // and again: the resumed session is the one offered next
+    c.stop();
+    TEST_ASSERT_EQUAL_INT(1, c.connect(HOST, TLS_DEFAULT_PORT));
+    TEST_ASSERT_TRUE(c.resumed());
+    TEST_ASSERT_EQUAL_UINT32(1, fake_tls.full_handshakes);
+}
+
+void test_server_without_resumption()
+{
+    fake_tls.resumption = false;
+    TlsClient c;
+    c.begin(TLS_CA_PEM);
+    TEST_ASSERT_EQUAL_INT(1, c.connect(HOST, TLS_DEFAULT_PORT));
+    c.stop();
+    TEST_ASSERT_EQUAL_INT(1, c.connect(HOST, TLS_DEFAULT_PORT));
+    TEST_ASSERT_FALSE(c.resumed());
+    TEST_ASSERT_EQUAL_UINT32(2, c.stats().handshakes);
+    TEST_ASSERT_EQUAL_INT(200, get(c));
+}
+
+void test_expired_ticket_falls_back_to_full()
+{
+    TlsClient c;
+    c.begin(TLS_CA_PEM);
+    TEST_ASSERT_EQUAL_INT(1, c.connect(HOST, TLS_DEFAULT_PORT));
+    c.stop();
+    fake_advance_us((uint64_t)fake_tls.ticket_lifetime_s * 1000000);
+    TEST_ASSERT_EQUAL_INT(1, c.connect(HOST, TLS_DEFAULT_PORT));
+    TEST_ASSERT_FALSE(c.resumed());
+    TEST_ASSERT_EQUAL_UINT32(2, fake_tls.full_handshakes);
+}
+
+void test_unknown_ca_rejected()
+{
+    fake_tls.ca_pem = "-----BEGIN CERTIFICATE-----\nsomeone else's\n-----END CERTIFICATE-----\n";
+    TlsClient c;
+    c.begin(TLS_CA_PEM);
+    TEST_ASSERT_EQUAL_INT(0, c.connect(HOST, TLS_DEFAULT_PORT));
+    TEST_ASSERT_EQUAL_INT(MBEDTLS_ERR_X509_CERT_VERIFY_FAILED, c.stats().last_error);
+    TEST_ASSERT_EQUAL_UINT32(1, c.stats().failures);
+    TEST_ASSERT_FALSE(c.connected());
+    TEST_ASSERT_EQUAL_UINT32(0, fake_tls.full_handshakes);
+}
+
+void test_hostname_mismatch_rejected()
+{
+    fake_tls.server_name = "plants.example.com";
+    TlsClient c;
+    c.begin(TLS_CA_PEM);
+    TEST_ASSERT_EQUAL_INT(0, c.connect(HOST, TLS_DEFAULT_PORT));
+    TEST_ASSERT_EQUAL_INT(MBEDTLS_ERR_X509_CERT_VERIFY_FAILED, c.stats().last_error);
+}
+
+void test_unparseable_ca()
+{
+    TlsClient c;
+    TEST_ASSERT_FALSE(c.begin("not a certificate"));
+    TEST_ASSERT_EQUAL_INT(0, c.connect(HOST, TLS_DEFAULT_PORT));
+    TEST_ASSERT_EQUAL_UINT32(0, fake_net.connects);
+}
+
+void test_https_keeps_the_connection()
+{
+    use_https();
+    TEST_ASSERT_TRUE(send("x"));
+    uint64_t cpu = fake_tls.cpu_us;
+    transport_stats_reset();
+    for (int i = 0; i < 5; i++) {
+        poll_for(1000);
+        TEST_ASSERT_TRUE(send("Temperature: 21.50°C"));
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, fake_net.connects);
+    TEST_ASSERT_EQUAL_UINT32(1, fake_tls.full_handshakes);
+    TEST_ASSERT_EQUAL_UINT32(6, fake_net.requests);
+    // per sample, only the records' AES-GCM: well under a millisecond
+    TEST_ASSERT_TRUE(fake_tls.cpu_us - cpu < 5 * 1000);
+    TEST_ASSERT_TRUE(transport_stats().busy_max_us < 2 * fake_tls.latency_ms * 1000);
+}
+
+void test_idle_connection_closed_then_resumed()
+{
+    use_https();
+    TEST_ASSERT_TRUE(send("x"));
+    poll_for(TLS_IDLE_CLOSE_MS + 1000);
+    TEST_ASSERT_EQUAL_UINT32(0, fake_tls.idle_closes); // we closed first
+    TEST_ASSERT_TRUE(send("x"));
+    TEST_ASSERT_EQUAL_UINT32(2, fake_net.connects);
+    TEST_ASSERT_EQUAL_UINT32(1, fake_tls.full_handshakes);
+    TEST_ASSERT_EQUAL_UINT32(1, fake_tls.resumed_handshakes);
+}
+
+void test_server_closing_first()
+{
+    use_https();
+    fake_tls.idle_timeout_s = 5;
+    TEST_ASSERT_TRUE(send("x"));
+    delay(6000); // no polls: the close_notify is only seen at the next send
+    TEST_ASSERT_TRUE(send("x"));
+    TEST_ASSERT_EQUAL_UINT32(1, fake_tls.idle_closes);
+    TEST_ASSERT_EQUAL_UINT32(2, fake_net.requests);
+    TEST_ASSERT_EQUAL_UINT32(1, fake_tls.resumed_handshakes);
+}
+
+void test_reply_handed_on()
+{
+    use_https();
+    fake_net.handler = [](const FakeHttpRequest &req) {
+        TEST_ASSERT_EQUAL_STRING("/submit", req.path.c_str());
+        TEST_ASSERT_EQUAL_STRING("keep-alive", req.headers.at("Connection").c_str());
+        FakeHttpResponse resp;
+        resp.content_type = "application/json";
+        resp.body = "{\"config_rev\": 3, \"config\": {\"uplink_period\": 60000}}";
+        return resp;
+    };
+    TEST_ASSERT_TRUE(send("x"));
+    TEST_ASSERT_EQUAL_UINT32(1, replies);
+    TEST_ASSERT_EQUAL_STRING("{\"config_rev\": 3, \"config\": {\"uplink_period\": 60000}}", replied.c_str());
+}
+
+void test_failed_handshake_fails_the_send()
+{
+    use_https();
+    fake_tls.ca_pem = "-----BEGIN CERTIFICATE-----\nsomeone else's\n-----END CERTIFICATE-----\n";
+    TEST_ASSERT_FALSE(send("x"));
+    TEST_ASSERT_EQUAL_UINT32(0, fake_net.requests); // nothing sent to a server we couldn't verify
+}
+
+void test_config_validation()
+{
+    DeviceConfig c;
+    config_defaults(c);
+    TEST_ASSERT_EQUAL_UINT16(TLS_DEFAULT_PORT, c.tls_port);
+    c.transport = TRANSPORT_HTTPS;
+    TEST_ASSERT_TRUE(config_validate(c));
+    c.tls_port = 0;
+    TEST_ASSERT_FALSE(config_validate(c));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_full_handshake_then_request);
+    RUN_TEST(test_reconnect_resumes_the_session);
+    RUN_TEST(test_server_without_resumption);
+    RUN_TEST(test_expired_ticket_falls_back_to_full);
+    RUN_TEST(test_unknown_ca_rejected);
+    RUN_TEST(test_hostname_mismatch_rejected);
+    RUN_TEST(test_unparseable_ca);
+    RUN_TEST(test_https_keeps_the_connection);
+    RUN_TEST(test_idle_connection_closed_then_resumed);
+    RUN_TEST(test_server_closing_first);
+    RUN_TEST(test_reply_handed_on);
+    RUN_TEST(test_failed_handshake_fails_the_send);
+    RUN_TEST(test_config_validation);
+    return UNITY_END();
+}
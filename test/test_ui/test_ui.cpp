@@ -0,0 +1,157 @@
+#include <TFT_eSPI.h>
+#include <fakes.h>
+#include <unity.h>
+#include "breaker.h"
+#include "input.h"
+#include "ui.h"
+
+static TFT_eSPI tft;
+static UiSnapshot snap;
+
+void setUp()
+{
+    fakes_reset();
+    fake_advance_ms(1000);
+    input_setup();
+    ui_setup(tft);
+    tft.init();
+    memset(&snap, 0, sizeof(snap));
+    snap.sensor = {21.5f, 62.0f, 3000, true};
+    snap.dry = 50;
+    snap.shade = 1000;
+    ui_publish(snap);
+}
+
+void tearDown() {}
+
+// what the UI task does: take the next event, draw
+static bool step()
+{
+    InputEvent ev;
+    if (!input_wait(ev, 0))
+        return false;
+    ui_handle(ev);
+    return true;
+}
+
+static void press(uint8_t pin)
+{
+    fake_interrupt(pin);
+    TEST_ASSERT_TRUE(step());
+    fake_advance_ms(200);
+}
+
+static const char *line(int y)
+{
+    auto it = fake_tft.lines.find(y);
+    return it == fake_tft.lines.end() ? "" : it->second.c_str();
+}
+
+void test_task_starts_above_loop()
+{
+    TEST_ASSERT_EQUAL_size_t(1, fake_tasks.size());
+    TEST_ASSERT_TRUE(fake_tasks[0]->priority > 1);
+    TEST_ASSERT_EQUAL(FALLING, fake_isr[BUTTON_LEFT_PIN].mode);
+    TEST_ASSERT_EQUAL(FALLING, fake_isr[BUTTON_RIGHT_PIN].mode);
+}
+
+void test_refresh_draws_live_page()
+{
+    TEST_ASSERT_TRUE(input_post(INPUT_REFRESH));
+    TEST_ASSERT_TRUE(step());
+    TEST_ASSERT_EQUAL(UI_PAGE_LIVE, ui_page());
+    TEST_ASSERT_EQUAL_STRING("Temp.: 21.50 C", line(0));
+    TEST_ASSERT_EQUAL_STRING("Moist.: 62.00%", line(32));
+    TEST_ASSERT_EQUAL_STRING("Getting water data...", line(96));
+}
+
+void test_buttons_cycle_pages()
+{
+    press(BUTTON_RIGHT_PIN);
+    TEST_ASSERT_EQUAL(UI_PAGE_HISTORY, ui_page());
+    TEST_ASSERT_EQUAL_STRING("Drying history", line(0));
+    press(BUTTON_RIGHT_PIN);
+    press(BUTTON_RIGHT_PIN);
+    TEST_ASSERT_EQUAL(UI_PAGE_STATUS, ui_page());
+    press(BUTTON_RIGHT_PIN);
+    TEST_ASSERT_EQUAL(UI_PAGE_LIVE, ui_page());
+    press(BUTTON_LEFT_PIN);
+    TEST_ASSERT_EQUAL(UI_PAGE_STATUS, ui_page());
+}
+
+void test_bounce_is_one_press()
+{
+    fake_interrupt(BUTTON_RIGHT_PIN);
+    fake_advance_us(3000);
+    fake_interrupt(BUTTON_RIGHT_PIN);
+    fake_advance_us(3000);
+    fake_interrupt(BUTTON_RIGHT_PIN);
+    TEST_ASSERT_TRUE(step());
+    TEST_ASSERT_FALSE(step());
+    TEST_ASSERT_EQUAL(UI_PAGE_HISTORY, ui_page());
+}
+
+void test_refreshes_do_not_pile_up()
+{
+    for (int i = 0; i < 20; i++)
+        input_post(INPUT_REFRESH);
+    TEST_ASSERT_TRUE(step());
+    TEST_ASSERT_FALSE(step());
+    TEST_ASSERT_EQUAL_UINT32(0, input_dropped());
+}
+
+void test_history_newest_first()
+{
+    const uint32_t day = 86400000;
+    uint32_t periods[] = {4 * day, 3 * day + day / 2, 5 * day, 4 * day + day / 10};
+    memcpy(snap.periods, periods, sizeof(periods));
+    snap.period_count = 4;
+    ui_publish(snap);
+    press(BUTTON_RIGHT_PIN);
+    TEST_ASSERT_EQUAL_STRING("4 cycles, avg 4.2d", line(17));
+    TEST_ASSERT_EQUAL_STRING("4.1 5.0 3.5", line(34));
+    TEST_ASSERT_EQUAL_STRING("4.0", line(51));
+}
+
+void test_status_page()
+{
+    snap.wifi_up = true;
+    snap.rssi = -67;
+    snap.ip = (uint32_t)IPAddress(192, 168, 1, 50);
+    snap.breaker = BREAKER_OPEN;
+    snap.queued = 12;
+    snap.uptime_s = 2 * 86400 + 3 * 3600 + 4 * 60;
+    snap.config_rev = 3;
+    ui_publish(snap);
+    press(BUTTON_LEFT_PIN);
+    TEST_ASSERT_EQUAL(UI_PAGE_STATUS, ui_page());
+    TEST_ASSERT_EQUAL_STRING("WiFi -67 dBm", line(17));
+    TEST_ASSERT_EQUAL_STRING("192.168.1.50", line(34));
+    TEST_ASSERT_EQUAL_STRING("Uplink open", line(51));
+    TEST_ASSERT_EQUAL_STRING("Queue 12 lost 0", line(68));
+    TEST_ASSERT_EQUAL_STRING("Up 2d 03:04 rev 3", line(102));
+}
+
+void test_press_while_loop_is_busy()
+{
+    // loop() is stuck in an uplink for seconds; the press is queued from the
+    // ISR and the task draws it without loop() being involved at all
+    fake_interrupt(BUTTON_RIGHT_PIN);
+    TEST_ASSERT_TRUE(step());
+    TEST_ASSERT_EQUAL(UI_PAGE_HISTORY, ui_page());
+    TEST_ASSERT_TRUE(ui_stats().max_input_us < 50000);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_task_starts_above_loop);
+    RUN_TEST(test_refresh_draws_live_page);
+    RUN_TEST(test_buttons_cycle_pages);
+    RUN_TEST(test_bounce_is_one_press);
+    RUN_TEST(test_refreshes_do_not_pile_up);
+    RUN_TEST(test_history_newest_first);
+    RUN_TEST(test_status_page);
+    RUN_TEST(test_press_while_loop_is_busy);
+    return UNITY_END();
+}
@@ -0,0 +1,355 @@
+#include <ArduinoJson.h>
+#include <fakes.h>
+#include <unity.h>
+#include "boot_profile.h"
+#include "config.h"
+#include "latency.h"
+#include "power_stats.h"
+#include "uplink.h"
+
+// uplink.cpp keeps its report timers between calls, so the tests below run
+// in order on one timeline, each starting where the previous one left off
+static uint32_t now;
+static char body[UPLINK_BODY_MAX];
+static JsonDocument parsed;
+
+void setUp() {}
+void tearDown() {}
+
+static JsonDocument &build(const char *msg, const WindowStats *window = nullptr)
+{
+    size_t n = uplink_build(msg, window, now);
+    TEST_ASSERT_TRUE(n > 0);
+    TEST_ASSERT_EQUAL_size_t(n, serializeJson(uplink_document(), body, sizeof(body)));
+    TEST_ASSERT_EQUAL(DeserializationError::Ok, deserializeJson(parsed, body, n).code);
+    return parsed;
+}
+
+void test_first_request_has_sample_and_boot()
+{
+    boot_mark("reset", 0);
+    boot_mark("setup", 750000);
+    JsonDocument &d = build("Temperature: 21.50°C");
+    TEST_ASSERT_EQUAL_STRING("Temperature: 21.50°C", d["send_val"].as<const char *>());
+    TEST_ASSERT_EQUAL_UINT32(config.rev, d["config_rev"].as<uint32_t>());
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 750.0, d["boot"]["setup"].as<double>());
+    TEST_ASSERT_TRUE(d["power"].isNull());
+}
+
+void test_boot_sent_until_delivered()
+{
+    now += 1000;
+    TEST_ASSERT_FALSE(build("x")["boot"].isNull());
+    uplink_delivered();
+    now += 1000;
+    TEST_ASSERT_TRUE(build("x")["boot"].isNull());
+}
+
+void test_power_and_heap_once_a_minute()
+{
+    now = POWER_REPORT_PERIOD;
+    power_set(POWER_RADIO, true, 0);
+    fake_heap_free = 150000;
+    JsonDocument &d = build("x");
+    TEST_ASSERT_FALSE(d["power"]["radio"].isNull());
+    TEST_ASSERT_EQUAL_UINT32(POWER_REPORT_PERIOD, d["power"]["radio"]["on_ms"].as<uint32_t>());
+    TEST_ASSERT_EQUAL_UINT32(150000, d["heap"]["free"].as<uint32_t>());
+
+    now += 1000;
+    TEST_ASSERT_TRUE(build("x")["power"].isNull());
+}
+
+void test_latency_snapshot_resets_histograms()
+{
+    latency_record(LAT_LOOP, 300);
+    latency_record(LAT_LOOP, 5000);
+    now = 2 * LATENCY_REPORT_PERIOD;
+    JsonDocument &d = build("x");
+    TEST_ASSERT_EQUAL_UINT32(2, d["latency"]["loop"]["n"].as<uint32_t>());
+    TEST_ASSERT_EQUAL_UINT32(5000, d["latency"]["loop"]["max_us"].as<uint32_t>());
+    TEST_ASSERT_EQUAL_size_t(LATENCY_BUCKETS, d["latency"]["loop"]["b"].size());
+    TEST_ASSERT_EQUAL_UINT32(0, latency_histogram(LAT_LOOP).count);
+}
+
+void test_latency_kept_until_delivered()
+{
+    // the request above was never delivered: its snapshot goes out again
+    latency_record(LAT_LOOP, 700);
+    now = 3 * LATENCY_REPORT_PERIOD;
+    JsonDocument &d = build("x");
+    TEST_ASSERT_EQUAL_UINT32(3, d["latency"]["loop"]["n"].as<uint32_t>());
+    TEST_ASSERT_EQUAL_UINT32(5000, d["latency"]["loop"]["max_us"].as<uint32_t>());
+    // recorded while that request was on its way
+    latency_record(LAT_HTTP_RESPONSE, 20000);
+    uplink_delivered();
+
+    // delivered: gone for good, and what came in meanwhile is kept
+    now += 1000;
+    TEST_ASSERT_TRUE(build("x")["latency"].isNull());
+    TEST_ASSERT_EQUAL_UINT32(0, latency_histogram(LAT_LOOP).count);
+    TEST_ASSERT_EQUAL_UINT32(1, latency_histogram(LAT_HTTP_RESPONSE).count);
+    uplink_delivered();
+}
+
+void test_body_too_large()
+{
+    static char huge[UPLINK_BODY_MAX];
+    memset(huge, 'x', sizeof(huge) - 1);
+    huge[sizeof(huge) - 1] = '\0';
+    TEST_ASSERT_EQUAL_size_t(0, uplink_build(huge, nullptr, now));
+}
+
+void test_response_plain_text_ignored()
+{
+    const char *resp = "Data received";
+    TEST_ASSERT_EQUAL(UPLINK_RESP_NONE, uplink_handle_response(resp, strlen(resp), now));
+}
+
+void test_response_applies_config()
+{
+    config_defaults(config);
+    const char *resp = "{\"config_rev\": 7, \"config\": {\"uplink_period\": 5000}}";
+    TEST_ASSERT_EQUAL(UPLINK_RESP_APPLIED, uplink_handle_response(resp, strlen(resp), now));
+    TEST_ASSERT_EQUAL_UINT32(5000, config.uplink_period);
+    TEST_ASSERT_EQUAL_UINT32(7, config.rev);
+}
+
+void test_response_rejects_bad_config()
+{
+    const char *resp = "{\"config_rev\": 8, \"config\": {\"sensor_period\": 10}}";
+    TEST_ASSERT_EQUAL(UPLINK_RESP_REJECTED, uplink_handle_response(resp, strlen(resp), now));
+    TEST_ASSERT_EQUAL_UINT32(7, config.rev);
+}
+
+void test_full_report_fits()
+{
+    // power + heap + every latency stage in one request
+    for (int i = 0; i < LAT_STAGES; i++)
+        latency_record((LatencyStage)i, 1000);
+    now = 4 * LATENCY_REPORT_PERIOD;
+    JsonDocument &d = build("Temperature: 21.50°C / 70.70°F, Low Moisture: 55.00%, Light: 73%");
+    TEST_ASSERT_FALSE(d["power"].isNull());
+    TEST_ASSERT_EQUAL_size_t(LAT_STAGES, d["latency"].size());
+    TEST_ASSERT_TRUE(uplink_pool_peak() <= UPLINK_POOL_SIZE);
+}
+
+static SensorData sample(float moisture)
+{
+    SensorData s = {21.5f, moisture, 3000, true};
+    return s;
+}
+
+static void drain()
+{
+    while (uplink_queued()) {
+        build("x");
+        uplink_delivered();
+    }
+}
+
+void test_queued_samples_ride_along_until_delivered()
+{
+    drain();
+    uplink_queue(sample(60), now);
+    uplink_queue(sample(59), now + 1000);
+    now += 3000;
+    JsonDocument &d = build("x");
+    TEST_ASSERT_EQUAL_size_t(2, d["backlog"].size());
+    TEST_ASSERT_EQUAL_UINT32(3000, d["backlog"][0]["age"].as<uint32_t>());
+    TEST_ASSERT_EQUAL_UINT32(2000, d["backlog"][1]["age"].as<uint32_t>());
+    TEST_ASSERT_TRUE(strstr(d["backlog"][1]["send_val"].as<const char *>(), "Moisture: 59.00%") != nullptr);
+
+    // not acknowledged: the next request carries them again, plus the new one
+    uplink_queue(sample(58), now);
+    TEST_ASSERT_EQUAL_size_t(3, build("x")["backlog"].size());
+    uplink_delivered();
+    TEST_ASSERT_EQUAL_size_t(0, uplink_queued());
+    TEST_ASSERT_TRUE(build("x")["backlog"].isNull());
+}
+
+void test_backlog_sent_in_batches()
+{
+    for (int i = 0; i < UPLINK_BATCH_MAX + 5; i++)
+        uplink_queue(sample(50), now);
+    TEST_ASSERT_EQUAL_size_t(UPLINK_BATCH_MAX, build("x")["backlog"].size());
+    uplink_delivered();
+    TEST_ASSERT_EQUAL_size_t(5, uplink_queued());
+    drain();
+}
+
+void test_full_queue_drops_oldest()
+{
+    uint32_t before = uplink_queue_dropped();
+    for (int i = 0; i < UPLINK_QUEUE_MAX + 3; i++)
+        uplink_queue(sample(i % 100), now + i);
+    TEST_ASSERT_EQUAL_size_t(UPLINK_QUEUE_MAX, uplink_queued());
+    TEST_ASSERT_EQUAL_UINT32(before + 3, uplink_queue_dropped());
+    now += UPLINK_QUEUE_MAX + 3;
+    JsonDocument &d = build("x");
+    TEST_ASSERT_EQUAL_UINT32(3, d["dropped"].as<uint32_t>());
+    TEST_ASSERT_TRUE(strstr(d["backlog"][0]["send_val"].as<const char *>(), "Moisture: 3.00%") != nullptr);
+    uplink_delivered();
+    TEST_ASSERT_TRUE(build("x")["dropped"].isNull());
+    drain();
+}
+
+void test_full_report_with_backlog_fits()
+{
+    // worst case: every report due and a full batch of the longest messages
+    SensorData worst = {-40.0f, 100.0f, 0, true};
+    for (int i = 0; i < UPLINK_BATCH_MAX; i++)
+        uplink_queue(worst, now);
+    for (int i = 0; i < LAT_STAGES; i++)
+        latency_record((LatencyStage)i, 1000);
+    now = 6 * LATENCY_REPORT_PERIOD;
+    JsonDocument &d = build("Temperature: -40.00°C / -40.00°F, Low Moisture: 100.00%, Low Light: 100%");
+    TEST_ASSERT_EQUAL_size_t(UPLINK_BATCH_MAX, d["backlog"].size());
+    TEST_ASSERT_FALSE(d["latency"].isNull());
+    TEST_ASSERT_TRUE(uplink_pool_peak() <= UPLINK_POOL_SIZE);
+    drain();
+}
+
+static WindowStats minute(float moisture)
+{
+    WindowStats w;
+    window_start(w, now);
+    for (int i = 0; i < 60; i++) {
+        SensorData s = {21.5f + (i % 2), moisture, 3000, true};
+        window_add(w, s);
+    }
+    window_close(w, now + 60000);
+    return w;
+}
+
+void test_window_instead_of_sample()
+{
+    WindowStats w = minute(55);
+    JsonDocument &d = build(nullptr, &w);
+    TEST_ASSERT_TRUE(d["send_val"].isNull());
+    TEST_ASSERT_EQUAL_UINT32(60000, d["window"]["ms"].as<uint32_t>());
+    TEST_ASSERT_EQUAL_UINT32(60, d["window"]["n"].as<uint32_t>());
+    JsonArray temp = d["window"]["temp"];
+    TEST_ASSERT_EQUAL_size_t(4, temp.size());
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 21.5, temp[0].as<float>());
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 22.5, temp[1].as<float>());
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 22.0, temp[2].as<float>());
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 0.5, temp[3].as<float>()); // rounded to 0.01
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 55.0, d["window"]["moisture"][2].as<float>());
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 73.0, d["window"]["light"][2].as<float>());
+}
+
+void test_queued_windows_ride_along()
+{
+    drain();
+    uplink_queue_window(minute(50), now);
+    uplink_queue(sample(49), now + 500);
+    now += 60000;
+    WindowStats w = minute(48);
+    JsonDocument &d = build("x", &w);
+    TEST_ASSERT_EQUAL_size_t(2, d["backlog"].size());
+    TEST_ASSERT_EQUAL_UINT32(60000, d["backlog"][0]["age"].as<uint32_t>());
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 50.0, d["backlog"][0]["window"]["moisture"][2].as<float>());
+    TEST_ASSERT_TRUE(d["backlog"][0]["send_val"].isNull());
+    TEST_ASSERT_TRUE(strstr(d["backlog"][1]["send_val"].as<const char *>(), "Moisture: 49.00%") != nullptr);
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 48.0, d["window"]["moisture"][2].as<float>());
+    uplink_delivered();
+    TEST_ASSERT_EQUAL_size_t(0, uplink_queued());
+}
+
+void test_other_plants_tagged()
+{
+    drain();
+    WindowStats w = minute(40);
+    w.plant = 3;
+    uplink_queue_window(w, now);
+    uplink_queue(sample(41), now, 5);
+    uplink_queue(sample(42), now, 0);
+    JsonDocument &d = build("x", nullptr);
+    TEST_ASSERT_EQUAL_UINT8(3, d["backlog"][0]["window"]["plant"].as<uint8_t>());
+    TEST_ASSERT_EQUAL_UINT8(5, d["backlog"][1]["plant"].as<uint8_t>());
+    TEST_ASSERT_TRUE(d["backlog"][2]["plant"].isNull()); // plant 0 stays as it always was
+    uplink_delivered();
+}
+
+void test_raw_burst_on_request()
+{
+    TEST_ASSERT_FALSE(uplink_raw(now));
+    const char *resp = "{\"raw_s\": 300}";
+    TEST_ASSERT_EQUAL(UPLINK_RESP_NONE, uplink_handle_response(resp, strlen(resp), now));
+    TEST_ASSERT_TRUE(uplink_raw(now));
+    TEST_ASSERT_TRUE(uplink_raw(now + 299999));
+    TEST_ASSERT_FALSE(uplink_raw(now + 300000));
+    TEST_ASSERT_EQUAL_UINT8(0, uplink_raw_plant());
+    resp = "{\"raw_s\": 300, \"raw_plant\": 2}";
+    uplink_handle_response(resp, strlen(resp), now);
+    TEST_ASSERT_EQUAL_UINT8(2, uplink_raw_plant());
+
+    // 0 ends it early; and the server can't leave a device raw for good
+    TEST_ASSERT_EQUAL(UPLINK_RESP_NONE, uplink_handle_response("{\"raw_s\": 0}", 12, now));
+    TEST_ASSERT_FALSE(uplink_raw(now));
+    resp = "{\"raw_s\": 999999}";
+    uplink_handle_response(resp, strlen(resp), now);
+    TEST_ASSERT_TRUE(uplink_raw(now + UPLINK_RAW_MAX * 1000 - 1));
+    TEST_ASSERT_FALSE(uplink_raw(now + UPLINK_RAW_MAX * 1000));
+}
+
+void test_raw_burst_with_config()
+{
+    const char *resp = "{\"raw_s\": 60, \"config_rev\": 9, \"config\": {\"aggregate_window\": 300000}}";
+    TEST_ASSERT_EQUAL(UPLINK_RESP_APPLIED, uplink_handle_response(resp, strlen(resp), now));
+    TEST_ASSERT_EQUAL_UINT32(300000, config.aggregate_window);
+    TEST_ASSERT_TRUE(uplink_raw(now + 59999));
+    TEST_ASSERT_FALSE(uplink_raw(now + 60000));
+}
+
+void test_full_report_with_window_backlog_fits()
+{
+    // worst case for windows: a full batch of them plus every report
+    for (int i = 0; i < UPLINK_BATCH_MAX; i++) {
+        WindowStats w = minute(-123.45f);
+        w.temp.min = -40.123f;
+        w.light.m2 = 1e6f;
+        uplink_queue_window(w, now);
+    }
+    for (int i = 0; i < LAT_STAGES; i++)
+        latency_record((LatencyStage)i, 1000);
+    now = 8 * LATENCY_REPORT_PERIOD;
+    WindowStats w = minute(100);
+    JsonDocument &d = build("Temperature: -40.00°C / -40.00°F, Low Moisture: 100.00%, Low Light: 100%", &w);
+    TEST_ASSERT_EQUAL_size_t(UPLINK_BATCH_MAX, d["backlog"].size());
+    TEST_ASSERT_FALSE(d["latency"].isNull());
+    TEST_ASSERT_FALSE(d["power"].isNull());
+    TEST_ASSERT_TRUE(uplink_pool_peak() <= UPLINK_POOL_SIZE);
+    drain();
+}
+
+int main()
+{
+    fakes_reset();
+    config_defaults(config);
+    power_stats_setup(0);
+    latency_reset();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_first_request_has_sample_and_boot);
+    RUN_TEST(test_boot_sent_until_delivered);
+    RUN_TEST(test_power_and_heap_once_a_minute);
+    RUN_TEST(test_latency_snapshot_resets_histograms);
+    RUN_TEST(test_latency_kept_until_delivered);
+    RUN_TEST(test_body_too_large);
+    RUN_TEST(test_response_plain_text_ignored);
+    RUN_TEST(test_response_applies_config);
+    RUN_TEST(test_response_rejects_bad_config);
+    RUN_TEST(test_full_report_fits);
+    RUN_TEST(test_queued_samples_ride_along_until_delivered);
+    RUN_TEST(test_backlog_sent_in_batches);
+    RUN_TEST(test_full_queue_drops_oldest);
+    RUN_TEST(test_full_report_with_backlog_fits);
+    RUN_TEST(test_window_instead_of_sample);
+    RUN_TEST(test_queued_windows_ride_along);
+    RUN_TEST(test_other_plants_tagged);
+    RUN_TEST(test_raw_burst_on_request);
+    RUN_TEST(test_raw_burst_with_config);
+    RUN_TEST(test_full_report_with_window_backlog_fits);
+    return UNITY_END();
+}
@@ -0,0 +1,134 @@
+#include <fakes.h>
+#include <unity.h>
+#include "wifi_manager.h"
+
+void setUp()
+{
+    fakes_reset();
+    nvs_handle_t h;
+    nvs_open("storage", NVS_READWRITE, &h);
+    nvs_set_str(h, "ssid", "greenhouse");
+    nvs_set_str(h, "pass", "succulent");
+    nvs_close(h);
+}
+
+void tearDown() {}
+
+static void run(unsigned long ms)
+{
+    unsigned long start = millis();
+    while (millis() - start < ms) {
+        delay(50);
+        wifi_loop();
+    }
+}
+
+// power on with what NVS has, the radio starting from scratch
+static void boot()
+{
+    WiFi = FakeWiFi();
+    wifi_setup();
+}
+
+static unsigned long run_until_connected()
+{
+    unsigned long start = millis();
+    while (!wifi_connected() && millis() - start < 60000) {
+        delay(50);
+        wifi_loop();
+    }
+    return millis() - start;
+}
+
+void test_first_boot_scans_and_caches()
+{
+    fake_net.dhcp_ms = 400;
+    boot();
+    TEST_ASSERT_EQUAL(WIFI_STATE_SCAN_CONNECT, wifi_state());
+    run_until_connected();
+    TEST_ASSERT_EQUAL_UINT32(1, fake_net.dhcp_requests);
+    TEST_ASSERT_TRUE(fake_nvs.count("storage/ap_cache"));
+}
+
+void test_reboot_fast_connects_on_cached_lease()
+{
+    fake_net.dhcp_ms = 400;
+    boot();
+    run_until_connected();
+
+    boot();
+    TEST_ASSERT_EQUAL(WIFI_STATE_FAST_CONNECT, wifi_state());
+    unsigned long took = run_until_connected();
+    TEST_ASSERT_TRUE(took < fake_net.associate_ms + fake_net.dhcp_ms);
+    TEST_ASSERT_EQUAL_UINT32(1, fake_net.dhcp_requests);
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)IPAddress(192, 168, 1, 50), (uint32_t)WiFi.localIP());
+}
+
+void test_cached_lease_is_renewed()
+{
+    fake_net.dhcp_ms = 400;
+    boot();
+    run_until_connected();
+    boot();
+    run_until_connected();
+
+    run(WIFI_LEASE_CHECK_DELAY - 100);
+    TEST_ASSERT_EQUAL(WIFI_STATE_CONNECTED, wifi_state());
+    TEST_ASSERT_EQUAL_UINT32(1, fake_net.dhcp_requests);
+
+    // DHCP on the live link; no address to use until it has one
+    run(200);
+    TEST_ASSERT_EQUAL(WIFI_STATE_DHCP, wifi_state());
+    TEST_ASSERT_FALSE(wifi_connected());
+    TEST_ASSERT_EQUAL_UINT32(2, fake_net.dhcp_requests);
+    uint32_t associations = fake_net.associations;
+
+    run_until_connected();
+    TEST_ASSERT_EQUAL_UINT32(associations, fake_net.associations);
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)IPAddress(192, 168, 1, 50), (uint32_t)WiFi.localIP());
+
+    // the DHCP client keeps it from here on
+    run(3 * WIFI_LEASE_CHECK_DELAY);
+    TEST_ASSERT_EQUAL(WIFI_STATE_CONNECTED, wifi_state());
+    TEST_ASSERT_EQUAL_UINT32(2, fake_net.dhcp_requests);
+}
+
+void test_no_lease_falls_back_to_scan()
+{
+    boot();
+    run_until_connected();
+    boot();
+    run_until_connected();
+
+    fake_net.dhcp_ms = WIFI_DHCP_TIMEOUT * 2; // nobody answers in time
+    run(WIFI_LEASE_CHECK_DELAY + 100);
+    TEST_ASSERT_EQUAL(WIFI_STATE_DHCP, wifi_state());
+    run(WIFI_DHCP_TIMEOUT + 100);
+    TEST_ASSERT_EQUAL(WIFI_STATE_SCAN_CONNECT, wifi_state());
+}
+
+void test_link_lost_while_renewing()
+{
+    fake_net.dhcp_ms = 400;
+    boot();
+    run_until_connected();
+    boot();
+    run_until_connected();
+
+    run(WIFI_LEASE_CHECK_DELAY + 100);
+    TEST_ASSERT_EQUAL(WIFI_STATE_DHCP, wifi_state());
+    fake_net.ap_up = false;
+    run(100);
+    TEST_ASSERT_EQUAL(WIFI_STATE_FAST_CONNECT, wifi_state());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_first_boot_scans_and_caches);
+    RUN_TEST(test_reboot_fast_connects_on_cached_lease);
+    RUN_TEST(test_cached_lease_is_renewed);
+    RUN_TEST(test_no_lease_falls_back_to_scan);
+    RUN_TEST(test_link_lost_while_renewing);
+    return UNITY_END();
+}
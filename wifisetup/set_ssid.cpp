@@ -48,6 +48,12 @@ void setup() {
 
         Serial.printf((err != ESP_OK) ? "Failed!\n" : "Done\n");
 
+        // Drop the cached AP/lease from the old network so the firmware
+        // does a full scan on its next boot
+        Serial.printf("Clearing cached AP in NVS ... ");
+        err = nvs_erase_key(my_handle, "ap_cache");
+        Serial.printf((err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) ? "Failed!\n" : "Done\n");
+
         // Commit written value.
         // After setting any values, nvs_commit() must be called to ensure changes
         // are written to flash storage. Implementations may write to storage at